@@ -86,4 +86,15 @@ do {				\
 void hmac_md5(unsigned char* text, int text_len, unsigned char* key,
               int key_len, uint8_t *digest);
 
+/* HMAC-MD5 with the padded key blocks hashed once per key */
+typedef struct {
+	md5_ctxt	hmac_ictx;	/* MD5 state after (K XOR ipad) */
+	md5_ctxt	hmac_octx;	/* MD5 state after (K XOR opad) */
+} hmac_md5_ctxt;
+
+void hmac_md5_init_key(hmac_md5_ctxt *hctx, const unsigned char *key,
+              int key_len);
+void hmac_md5_calc(const hmac_md5_ctxt *hctx, const unsigned char *text,
+              int text_len, uint8_t *digest);
+
 #endif /* ! _LIBZEBRA_MD5_H_*/
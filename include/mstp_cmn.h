@@ -20,8 +20,7 @@
 #include "mstp_mapping.h"
 typedef enum mstpd_message_type_enum {
     e_mstpd_timer=1,
-    e_mstpd_lport_up,
-    e_mstpd_lport_down,
+    e_mstpd_lport_link_change,
     e_mstpd_rx_bpdu,
     e_mstpd_lport_add,
     e_mstpd_lport_delete,
@@ -34,7 +33,10 @@ typedef enum mstpd_message_type_enum {
     e_mstpd_cist_port_config,
     e_mstpd_msti_config,
     e_mstpd_msti_port_config,
-    e_mstpd_msti_config_delete
+    e_mstpd_msti_config_delete,
+    e_mstpd_db_resync,
+    e_mstpd_lport_speed_change,
+    e_mstpd_lport_mac_change
 } mstpd_message_type;
 
 typedef struct mstp_lport_state_change {
@@ -42,9 +44,13 @@ typedef struct mstp_lport_state_change {
     int lportindex;
 } mstp_lport_state_change;
 
+typedef struct mstp_lport_link_change {
+    PORT_MAP up;        /* ports whose link came up in one reconfigure pass */
+    PORT_MAP down;      /* ports whose link went down in the same pass */
+} mstp_lport_link_change;
+
 typedef struct mstp_lport_add {
-    char *lportname;
-    int lportindex;
+    PORT_MAP lports;    /* all L2 ports added in one reconfigure pass */
 } mstp_lport_add;
 
 typedef struct mstp_lport_delete {
@@ -53,13 +59,11 @@ typedef struct mstp_lport_delete {
 } mstp_lport_delete;
 
 typedef struct mstp_vlan_add {
-    char *name;
-    int vid;
+    VID_MAP vids;   /* all VLANs added in one reconfigure pass */
 } mstp_vlan_add;
 
 typedef struct mstp_vlan_delete {
-    char *name;
-    int vid;
+    VID_MAP vids;   /* all VLANs deleted in one reconfigure pass */
 } mstp_vlan_delete;
 
 typedef struct mstp_admin_status {
@@ -90,6 +94,7 @@ int mstp_free_event_queue(void);
 int mstpd_send_event(mstpd_message *pmsg);
 mstpd_message* mstpd_wait_for_next_event(void);
 void mstpd_event_free(mstpd_message *pmsg);
+void mstpd_process_event(mstpd_message *pmsg);
 void mstp_processLportUpEvent(mstpd_message *msg);
 void mstp_processLportDownEvent(mstpd_message *msg);
 void update_mstp_global_config(mstpd_message *msg);
@@ -16,6 +16,7 @@
 #ifndef __MSTP_FSM__H__
 #define __MSTP_FSM__H__
 
+#include <sys/time.h>
 #include <dynamic-string.h>
 #include <vswitch-idl.h>
 #include <openvswitch/vlog.h>
@@ -53,6 +54,18 @@
 #define DEF_MSTP_LAG_PRIORITY       4
 #define DEF_MSTP_COST               20000
 #define DEF_LINK_TYPE               "point_to_point"
+#define DEF_FLAP_DAMPENING          false
+#define DEF_FLAP_PENALTY            1000
+#define DEF_FLAP_SUPPRESS           2000
+#define DEF_FLAP_REUSE              750
+#define DEF_FLAP_HALF_LIFE          15
+/* Upper bounds of the flap dampening knobs, the penalty is capped at four
+ * times the suppress threshold and one more penalty is added on top of
+ * that, which has to fit in 32 bits */
+#define MAX_FLAP_PENALTY            100000
+#define MAX_FLAP_SUPPRESS           100000
+#define MAX_FLAP_REUSE              (MAX_FLAP_SUPPRESS - 1)
+#define MAX_FLAP_HALF_LIFE          3600
 #define BLOCK_ALL_MSTP              "block_all_mstp"
 
 /*********** MSTP_CONFIG OF BRIDGE TABLE **************************/
@@ -80,6 +93,25 @@
 #define MSTP_PORT_COST              "mstp_admin_path_cost"
 #define MSTP_CONFIG_REV             "mstp_config_revision"
 #define MSTP_CONFIG_NAME            "mstp_config_name"
+/* Link flap dampening, set in the bridge other_config:
+ *   mstp_flap_dampening  "true" to enable it              (default false)
+ *   mstp_flap_penalty    charged to a port per link down   (default 1000,
+ *                                                     max 100000)
+ *   mstp_flap_suppress   penalty at which the link ups of the port are
+ *                        ignored                           (default 2000,
+ *                                                     max 100000)
+ *   mstp_flap_reuse      penalty at which the port is used again, must be
+ *                        below mstp_flap_suppress          (default 750)
+ *   mstp_flap_half_life  seconds for the penalty to halve  (default 15,
+ *                                                     1 to 3600)
+ * Values that are not positive numbers keep the default, values above the
+ * maximum are clamped to it, a reuse not below the suppress threshold
+ * reverts both to their defaults. */
+#define MSTP_FLAP_DAMPENING         "mstp_flap_dampening"
+#define MSTP_FLAP_PENALTY           "mstp_flap_penalty"
+#define MSTP_FLAP_SUPPRESS          "mstp_flap_suppress"
+#define MSTP_FLAP_REUSE             "mstp_flap_reuse"
+#define MSTP_FLAP_HALF_LIFE         "mstp_flap_half_life"
 #define MSTP_INSTANCE_CONFIG        "mstp_instances_configured"
 #define MSTP_TX_BPDU                "mstp_tx_bpdu"
 #define MSTP_RX_BPDU                "mstp_rx_bpdu"
@@ -604,6 +636,9 @@ void     mstp_getMstiVidMap(uint16_t mstid, VID_MAP *vidMap);
 void     mstp_getMstiVidMapFromCfg(uint16_t mstid, VID_MAP *vidMap,
         bool pending);
 uint16_t mstp_getMstIdForVid(VID_t vid);
+void     mstp_setVidMapMstId(const VID_MAP *vidMap, uint16_t mstid);
+void     mstp_clearVidMstIdTable(void);
+uint32_t mstp_vidMstIdTableMismatches(void);
 uint16_t mstp_getMstIdForVidFromCfg(VID_t vid, bool pending);
 void     mstp_printVidMap(VID_MAP *srcVidMap, uint16_t lineLen,
         uint16_t indent);
@@ -951,7 +986,8 @@ bool isMstp64Instance(void);
 #define MSTP_FWD_LPORTS                (mstp_CB.fwdLports)
 #define MSTP_BLK_LPORTS                (mstp_CB.blkLports)
 #define MSTP_MSGS                      (mstp_CB.msgs)
-#define MSTP_TREE_MSGS_QUEUE           (mstp_CB.msgs.treeMsgQueue)
+#define MSTP_TREE_MSGS                 (mstp_CB.msgs.treeMsgs)
+#define MSTP_TREE_MSGS_DIRTY           (mstp_CB.msgs.treeMsgsDirty)
 #define STP_PROTOCOL_VERSION_MSTP      3
 #define MSTP_ENABLED \
 ((Spanning == true) && (Stp_version == STP_PROTOCOL_VERSION_MSTP))
@@ -991,6 +1027,40 @@ bool isMstp64Instance(void);
 ((i) == MSTP_CISTID ? MSTP_CIST_VALID : MSTP_MSTI_VALID(i))
 
 #define MSTP_COMM_PORT_PTR(p)          (mstp_Bridge.PortInfo[(p)])
+
+/*---------------------------------------------------------------------------
+ * Iterate, in ascending order, over the logical ports that have the common
+ * per-port data allocated. Per-tree (CIST or MSTI) port data never exists
+ * without it, so tree loops use the same iterator and check their own port
+ * pointer. The map is scanned a word at a time (see 'findNextBitSet').
+ * Iterations are counted per thread, only the protocol thread adds its
+ * count to 'mstp_perfStats' (the show handlers run the loops as well).
+ *---------------------------------------------------------------------------*/
+extern __thread uint64_t mstp_activePortIters;
+
+#define MSTP_FOR_EACH_ACTIVE_LPORT(lport)                                    \
+   for((lport) = (LPORT_t)find_first_port_set(&mstp_Bridge.activeLports);   \
+       IS_VALID_LPORT(lport) && (++mstp_activePortIters, TRUE);             \
+       (lport) = (LPORT_t)find_next_port_set(&mstp_Bridge.activeLports,     \
+                                             (lport)))
+
+/*---------------------------------------------------------------------------
+ * Size of the per-tree bit maps of the Bridge ('reconfigTrees',
+ * 'prsHeldTrees'): a tree is bit 'mstid + 1', the CIST included.
+ *---------------------------------------------------------------------------*/
+#define MSTP_ROLES_DIRTY_MAP_BITS      (MSTP_INSTANCES_MAX + 1)
+
+/*---------------------------------------------------------------------------
+ * Used to mark the tree's part of the port's next BPDU (the CIST parameters
+ * or the MSTI Configuration Message) as changed since the port's BPDU was
+ * last sent, so 'mstp_txMstp' encodes it again. Applied by the state
+ * machines wherever a variable conveyed in the BPDU changes, e.g. where
+ * 'newInfo' or 'newInfoMsti' is set; the port's 'txDirtyTrees' is indexed
+ * like 'prsHeldTrees'.
+ *---------------------------------------------------------------------------*/
+#define MSTP_TX_TREE_CHANGED(mstid, lport) \
+   setBit(MSTP_COMM_PORT_PTR(lport)->txDirtyTrees.map, (mstid) + 1, \
+          MSTP_ROLES_DIRTY_MAP_BITS)
 #define MSTP_COMM_PORT_SET_BIT(m,b) \
    setBit((m),(b),MSTP_PORT_BIT_MAP_MAX)
 #define MSTP_COMM_PORT_CLR_BIT(m,b) \
@@ -1059,6 +1129,21 @@ bool isMstp64Instance(void);
  *---------------------------------------------------------------------------*/
 #define MSTP_MSTI_PORT_PTR(i,p)        (MSTP_MSTI_INFO(i)->MstiPortInfo[(p)])
 
+/*---------------------------------------------------------------------------
+ * Used for reference to the timers and the PRT state of a CIST or MSTI port
+ * ('p' is the port's 'MSTP_CIST_PORT_INFO_t' or 'MSTP_MSTI_PORT_INFO_t'),
+ * kept in the per-tree arrays of 'mstp_treePortHot'.
+ *---------------------------------------------------------------------------*/
+#define MSTP_PORT_HOT(p,f) \
+   (mstp_treePortHot[(p)->hotMstid].f[(p)->hotLport])
+
+/*---------------------------------------------------------------------------
+ * Used to bind a newly allocated CIST or MSTI port data structure to its
+ * slot in 'mstp_treePortHot'
+ *---------------------------------------------------------------------------*/
+#define MSTP_PORT_HOT_BIND(p,i,l) \
+   ((p)->hotMstid = (i), (p)->hotLport = (l))
+
 /*---------------------------------------------------------------------------
  * Used to test, set and clear MSTI port variables held in 'bitMap' field
  * of the 'MSTP_MSTI_PORT_INFO_t' data structure
@@ -1602,7 +1687,6 @@ typedef struct MSTP_MIB_VLAN_MAP_t
  *---------------------------------------------------------------------------*/
 typedef struct MSTP_TREE_MSG_t
 {
-   QUEUE_THREAD link;  /* link to the next state change block */
    MSTID_t      mstid;
    bool      rootInfoChanged;
    PORT_MAP     portsFwd;
@@ -1615,9 +1699,18 @@ typedef struct MSTP_TREE_MSG_t
    PORT_MAP     portsClearEdge;
 } MSTP_TREE_MSG_t;
 
+/* One slot per tree (the CIST and the MSTIs, indexed by MSTID) plus one
+ * for the ports state propagated while MSTP is disabled */
+#define MSTP_TREE_MSG_SLOTS            (MSTP_INSTANCES_MAX + 2)
+#define MSTP_TREE_MSG_SLOT(mstid)                                            \
+   (((mstid) == MSTP_NON_STP_BRIDGE) ? (MSTP_INSTANCES_MAX + 1) : (mstid))
+
 typedef struct MSTP_MESSAGES_t
 {
-   QUEUE_HEAD treeMsgQueue; /* per tree msgs to inform other subsystems */
+   MSTP_TREE_MSG_t treeMsgs[MSTP_TREE_MSG_SLOTS]; /* per tree msgs to inform
+                                                   * other subsystems      */
+   MSTI_MAP        treeMsgsDirty; /* slots holding pending info, the bit
+                                   * number is the slot index plus one    */
 
 } MSTP_TREE_MSGS_t;
 
@@ -2371,6 +2464,11 @@ typedef enum
    MSTP_TCM_STATE_MAX
 
 } MSTP_TCM_STATE_e;
+
+/* TCM states 'tcProp' has an effect in, in the other ones it is just cleared
+ * on the way to or in the 'LEARNING' state (802.1Q-REV/D5.0 13.36) */
+#define MSTP_TCM_STATE_TAKES_TC_PROP(s)                                      \
+   (((s) >= MSTP_TCM_STATE_DETECTED) && ((s) < MSTP_TCM_STATE_MAX))
 #ifdef MSTP_DEBUG
 typedef MSTP_TCM_STATE_e MSTP_TCM_STATE_t;
 #else /* !MSTP_DEBUG */
@@ -2414,6 +2512,117 @@ typedef struct MSTP_TC_HISTORY_t
    MSTP_PRT_STATE_t          newState;   /* state after TC                    */
 } MSTP_TC_HISTORY_t;
 
+/*---------------------------------------------------------------------------
+ * State machines run through the per-event scheduler (see 'mstp_smEnter')
+ *---------------------------------------------------------------------------*/
+typedef enum MSTP_SM_ID_e
+{
+   MSTP_SM_ID_PIM = 0,
+   MSTP_SM_ID_PRS,
+   MSTP_SM_ID_PRT,
+   MSTP_SM_ID_PST,
+   MSTP_SM_ID_TCM
+
+} MSTP_SM_ID_t;
+
+/*---------------------------------------------------------------------------
+ * A state machine invocation that is in progress
+ *---------------------------------------------------------------------------*/
+#define MSTP_SM_FRAMES_MAX 64
+
+typedef struct MSTP_SM_FRAME_t
+{
+   MSTP_SM_ID_t   sm;      /* state machine                                 */
+   MSTID_t        mstid;   /* tree it runs for                              */
+   LPORT_t        lport;   /* port it runs for, 0 for per-tree machines     */
+   bool           pending; /* a nested call has been merged into this one   */
+} MSTP_SM_FRAME_t;
+
+/*---------------------------------------------------------------------------
+ * Daemon performance statistics (see 'mstpd/daemon/perf_stats')
+ *---------------------------------------------------------------------------*/
+typedef struct MSTP_PERF_STATS_t
+{
+   struct timeval daemonStartTime;  /* time the OVSDB session was created */
+   uint32_t       dbInitMsec;       /* time spent populating default rows */
+   uint32_t       firstBpduTxMsec;  /* daemon start to first BPDU TX      */
+   bool           firstBpduTxDone;  /* first BPDU has been transmitted    */
+   uint32_t       vlanAddEvents;    /* # of batched VLAN add events       */
+   uint32_t       vlanAddVids;      /* # of VLANs carried by those events */
+   uint32_t       vlanDelEvents;    /* # of batched VLAN delete events    */
+   uint32_t       vlanDelVids;      /* # of VLANs carried by those events */
+   uint32_t       lportAddEvents;   /* # of batched L2 port add events    */
+   uint32_t       lportAddPorts;    /* # of ports carried by those events */
+   uint32_t       dbResyncs;        /* # of resyncs after OVSDB reconnect */
+   uint32_t       digestBuilds;     /* # of config digest computations    */
+   uint32_t       digestSkips;      /* # of digest requests w/o changes   */
+   uint64_t       digestUsec;       /* total time spent computing digests */
+   uint32_t       rolesCistCalls;   /* # of CIST port role selections     */
+   uint32_t       rolesMstiCalls;   /* # of MSTI port role selections     */
+   uint64_t       rolesPortsVisited;/* # of ports examined by them        */
+   uint64_t       rolesUsec;        /* total time spent selecting roles   */
+   uint32_t       timerTicks;       /* # of timer tick events processed   */
+   uint64_t       tickUsec;         /* total time spent in timer ticks    */
+   uint64_t       activePortIters;  /* # of active port loop iterations   */
+   uint32_t       rxBpdus;          /* # of BPDUs run through the PRX SM  */
+   uint64_t       rxBpduUsec;       /* total time spent processing them   */
+   uint32_t       rxBpduRepeats;    /* # of BPDUs same as the previous one*/
+   uint32_t       rcvInfoFastPath;  /* # of trees that skipped decoding   */
+   uint32_t       rolesSkipped;     /* # of role selections with nothing
+                                     * they read changed since the last */
+   uint64_t       rxBpduRoleRuns;   /* # of role selections run for BPDUs */
+   uint32_t       rxBpduRoleRunsMax;/* most of them run for a single BPDU */
+   uint32_t       events;           /* # of protocol thread events        */
+   uint64_t       smRuns;           /* # of state machine invocations run */
+   uint64_t       smMerged;         /* # of nested invocations merged     */
+   uint64_t       smReruns;         /* # of extra passes they caused      */
+   uint32_t       smMaxDepth;       /* deepest state machine nesting      */
+   uint32_t       mstiSyncs;        /* # of MSTI resyncs with the CIST    */
+   uint64_t       mstiSyncTrees;    /* # of MSTIs they ran the PRS SM for */
+   uint64_t       mstiSyncUsec;     /* total time spent in them           */
+   uint32_t       mstiSyncUsecMax;  /* longest of them                    */
+   uint32_t       reconfigFull;     /* # of full protocol re-inits        */
+   uint32_t       reconfigScoped;   /* # of trees reconfigured in place   */
+   uint64_t       reconfigFwdDrops; /* # of tree ports that left the
+                                     * Forwarding state because of them   */
+   uint32_t       rgnReconfigs;     /* # of MST Config Id changes applied
+                                     * in place                           */
+   uint32_t       rgnBoundaryChgs;  /* # of ports they moved across the
+                                     * Region boundary                    */
+   uint32_t       lportSpeedEvents; /* # of speed changes of up ports     */
+   uint32_t       lportSpeedCostChgs;/* # of them that changed path cost  */
+   uint64_t       treeMsgSlotsUsed; /* # of tree msg slots taken in use,
+                                     * each was an allocation before      */
+   uint32_t       treeMsgDrains;    /* # of times the slots were cleared
+                                     * after publication                  */
+   uint32_t       tcPropCalls;      /* # of 'setTcPropTree' calls         */
+   uint64_t       tcPropKicks;      /* # of TCM runs they made            */
+   uint64_t       tcPropUsec;       /* total time spent in them           */
+   uint64_t       txBpdus;          /* # of BPDUs the PTX SM transmitted  */
+   uint64_t       txEventPorts;     /* # of (event, port) pairs with TX   */
+   uint64_t       txEventRepeats;   /* # of BPDUs sent on a port that had
+                                     * already sent one in the same event */
+   uint32_t       txDeferredFlushes;/* # of times pending TX was flushed  */
+   uint64_t       txDeferredPorts;  /* # of ports those flushes kicked    */
+   uint32_t       linkBatches;      /* # of batched link change events    */
+   uint32_t       linkBatchPorts;   /* # of ports carried by those events */
+   uint32_t       prsHeldCalls;     /* # of role selections held for them */
+   uint32_t       prsHeldRuns;      /* # of role selections run instead   */
+   uint32_t       flapSuppressions; /* # of ports put in suppression      */
+   uint32_t       flapReuses;       /* # of ports released from it        */
+   uint32_t       flapIgnoredUps;   /* # of link ups ignored meanwhile    */
+   uint64_t       txTmplSends;      /* # of BPDUs sent from port templates*/
+   uint32_t       txTmplBuilds;     /* # of port templates built          */
+   uint64_t       txTmplBytes;      /* # of template bytes (re)written    */
+   uint64_t       txTmplFrameBytes; /* # of frame bytes sent from them,
+                                     * all encoded anew before templates  */
+   uint64_t       txTmplUsec;       /* total time spent encoding BPDUs    */
+   uint64_t       txTmplMsgs;       /* # of CIST parts and MSTI messages
+                                     * sent from templates                */
+   uint64_t       txTmplMsgsClean;  /* # of them not encoded, unchanged
+                                     * since last sent                    */
+} MSTP_PERF_STATS_t;
+
 /*---------------------------------------------------------------------------
  * Used to encode trapSource (hpSwitchStpErrantBpduDetector)
  *---------------------------------------------------------------------------*/
@@ -2465,38 +2674,110 @@ typedef struct MSTP_PORT_HISTORY
    uint32_t                      valid;
 }MSTP_PORT_HISTORY_t;
 
+/*---------------------------------------------------------------------------
+ * Per-tree timers and PRT state of every port, kept out of the CIST/MSTI
+ * port structures in arrays indexed by the logical port number, so that
+ * the timer tick reads a few bytes per tree instead of touching each
+ * tree's port structure. Accessed through 'MSTP_PORT_HOT'.
+ *---------------------------------------------------------------------------*/
+typedef struct MSTP_TREE_PORT_HOT_t
+{
+   /* State Machine Timers (802.1Q-REV/D5.0 13.21) */
+   uint8_t           fdWhile[MAX_LPORTS + 1];       /*  d)                   */
+   uint8_t           rrWhile[MAX_LPORTS + 1];       /*  e)                   */
+   uint8_t           rbWhile[MAX_LPORTS + 1];       /*  f)                   */
+   uint8_t           tcWhile[MAX_LPORTS + 1];       /*  g)                   */
+   uint8_t           rcvdInfoWhile[MAX_LPORTS + 1]; /*  h)                   */
+
+   /* Port Role Transitions State Machine state (802.1Q-REV/D5.0 13.34) */
+   MSTP_PRT_STATE_t  prtState[MAX_LPORTS + 1];
+
+} MSTP_TREE_PORT_HOT_t;
+
+/*---------------------------------------------------------------------------
+ * Per-port information the Port Role Selection of a tree reads, as it was
+ * when the port roles of the tree were last computed. A new record is built
+ * over zeroed memory at each role selection and compared with the stored
+ * one as a whole (see 'mstp_roleInputsChanged').
+ *---------------------------------------------------------------------------*/
+#define MSTP_ROLE_INPUT_PORT_ENABLED      0x01
+#define MSTP_ROLE_INPUT_RESTRICTED_ROLE   0x02
+#define MSTP_ROLE_INPUT_RCVD_INTERNAL     0x04
+#define MSTP_ROLE_INPUT_SEND_RSTP         0x08
+#define MSTP_ROLE_INPUT_SELF_SENT_PKT     0x10
+#define MSTP_ROLE_INPUT_LOOP_INCONSISTENT 0x20
+#define MSTP_ROLE_INPUT_INFO_NOT_AGED     0x40 /* 'rcvdInfoWhile' not zero */
+
+typedef struct MSTP_CIST_ROLE_INPUTS_t
+{
+   MSTP_CIST_PORT_PRI_VECTOR_t  portPriority;
+   MSTP_CIST_MSG_PRI_VECTOR_t   msgPriority;
+   MSTP_CIST_PORT_TIMES_t       portTimes;
+   uint32_t                     ExternalPortPathCost;
+   uint32_t                     InternalPortPathCost;
+   MSTP_PORT_ID_t               portId;
+   MSTP_INFO_IS_t               infoIs;
+   uint8_t                      flags;    /* MSTP_ROLE_INPUT_XXX */
+} MSTP_CIST_ROLE_INPUTS_t;
+
+typedef struct MSTP_MSTI_ROLE_INPUTS_t
+{
+   MSTP_MSTI_PORT_PRI_VECTOR_t  portPriority;
+   MSTP_MSTI_MSG_PRI_VECTOR_t   msgPriority;
+   MSTP_MSTI_PORT_TIMES_t       portTimes;
+   uint32_t                     InternalPortPathCost;
+   MSTP_PORT_ID_t               portId;
+   MSTP_INFO_IS_t               infoIs;
+   MSTP_INFO_IS_t               cistInfoIs;       /* the role of a boundary */
+   MSTP_PORT_ROLE_t             cistSelectedRole; /* port follows the CIST  */
+   uint8_t                      flags;    /* MSTP_ROLE_INPUT_XXX */
+} MSTP_MSTI_ROLE_INPUTS_t;
+
+/*---------------------------------------------------------------------------
+ * Per-tree information the Port Role Selection reads, besides that of the
+ * ports, as it was when the port roles of the tree were last computed.
+ *---------------------------------------------------------------------------*/
+typedef struct MSTP_CIST_TREE_ROLE_INPUTS_t
+{
+   PORT_MAP                      lports;
+   MSTP_CIST_BRIDGE_PRI_VECTOR_t BridgePriority;
+   MSTP_CIST_BRIDGE_TIMES_t      BridgeTimes;
+   uint32_t                      FwdDelay;  /* written to the database   */
+   uint16_t                      HelloTime; /* when this Bridge is Root  */
+   uint16_t                      MaxAge;
+   uint8_t                       TxHoldCount;
+} MSTP_CIST_TREE_ROLE_INPUTS_t;
+
+typedef struct MSTP_MSTI_TREE_ROLE_INPUTS_t
+{
+   PORT_MAP                      lports;
+   MSTP_MSTI_BRIDGE_PRI_VECTOR_t BridgePriority;
+   MSTP_MSTI_BRIDGE_TIMES_t      BridgeTimes;
+} MSTP_MSTI_TREE_ROLE_INPUTS_t;
+
 /*---------------------------------------------------------------------------
  * MSTI Per-Port Parameters.
  *---------------------------------------------------------------------------*/
 typedef struct MSTP_MSTI_PORT_INFO_t
 {
-   /* Statistics MIB support (RFC1493 MIB) */
-   uint32_t                          forwardTransitions;
-   time_t                            forwardTransitionsLastUpdated;
+   /*------------------------------------------------------------------------
+    * Hot state touched on every timer tick and role selection pass is kept
+    * together at the start of the structure, ahead of the priority vectors,
+    * the configuration and the debug counters/history.
+    * The timers and the PRT state live in 'mstp_treePortHot', at the slot
+    * given by 'hotMstid' and 'hotLport'.
+    *------------------------------------------------------------------------*/
+   MSTID_t                           hotMstid;
+   LPORT_t                           hotLport;
 
-   /* State Machine Performance Parameters (802.1Q-REV/D5.0) */
-   uint32_t                          InternalPortPathCost;/* 13.37.1         */
-   bool                             useCfgPathCost;/* indicates whether to use
-                                                    * user configured path cost
-                                                    * value or 'autodetect' it
-                                                    * from the link speed */
-   uint32_t                           mstiPort_uptime;
-
-   bool                             loopInconsistent;   /* TRUE if port
-                                                          * state is
-                                                          * inconsistent */
+   /* Per-Port State Machines states (802.1Q-REV/D5.0) */
+   MSTP_PIM_STATE_t                  pimState;           /* 13.32            */
+   MSTP_PST_STATE_t                  pstState;           /* 13.35            */
+   MSTP_TCM_STATE_t                  tcmState;           /* 13.36            */
 
-   bool                             rootInconsistent;
    /* Per-Port Variables (802.1Q-REV/D5.0 13.24) */
    MSTP_INFO_IS_t                    infoIs;             /*  x)              */
    MSTP_RCVD_INFO_t                  rcvdInfo;           /* ac)              */
-   MSTP_MSTI_DESIGNATED_PRI_VECTOR_t designatedPriority; /* al)              */
-   MSTP_MSTI_DESIGNATED_TIMES_t      designatedTimes;    /* am)              */
-   MSTP_MSTI_MSG_PRI_VECTOR_t        msgPriority;        /* an)              */
-   MSTP_MSTI_MSG_TIMES_t             msgTimes;           /* ao)              */
-   MSTP_PORT_ID_t                    portId;             /* ap)              */
-   MSTP_MSTI_PORT_PRI_VECTOR_t       portPriority;       /* aq)              */
-   MSTP_MSTI_PORT_TIMES_t            portTimes;          /* ar)              */
    MSTP_PORT_ROLE_t                  role;               /* as)              */
    MSTP_PORT_ROLE_t                  selectedRole;       /* at)              */
    uint32_t                          bitMap[((MSTP_MSTI_PORT_BIT_MAP_MAX+31)/32)];
@@ -2524,18 +2805,33 @@ typedef struct MSTP_MSTI_PORT_INFO_t
                                      mastered               ay)
    */
 
-   /* State Machine Timers (802.1Q-REV/D5.0 13.21) */
-   uint8_t                            fdWhile;            /*  d)              */
-   uint8_t                            rrWhile;            /*  e)              */
-   uint8_t                            rbWhile;            /*  f)              */
-   uint8_t                            tcWhile;            /*  g)              */
-   uint8_t                            rcvdInfoWhile;      /*  h)              */
+   MSTP_MSTI_DESIGNATED_PRI_VECTOR_t designatedPriority; /* al)              */
+   MSTP_MSTI_DESIGNATED_TIMES_t      designatedTimes;    /* am)              */
+   MSTP_MSTI_MSG_PRI_VECTOR_t        msgPriority;        /* an)              */
+   MSTP_MSTI_MSG_TIMES_t             msgTimes;           /* ao)              */
+   MSTP_PORT_ID_t                    portId;             /* ap)              */
+   MSTP_MSTI_PORT_PRI_VECTOR_t       portPriority;       /* aq)              */
+   MSTP_MSTI_PORT_TIMES_t            portTimes;          /* ar)              */
+   MSTP_MSTI_ROLE_INPUTS_t           roleInputs; /* as of the last role
+                                                  * selection            */
 
-   /* Per-Port State Machines states (802.1Q-REV/D5.0) */
-   MSTP_PIM_STATE_t                  pimState;           /* 13.32            */
-   MSTP_PRT_STATE_t                  prtState;           /* 13.34            */
-   MSTP_PST_STATE_t                  pstState;           /* 13.35            */
-   MSTP_TCM_STATE_t                  tcmState;           /* 13.36            */
+   /* Statistics MIB support (RFC1493 MIB) */
+   uint32_t                          forwardTransitions;
+   time_t                            forwardTransitionsLastUpdated;
+
+   /* State Machine Performance Parameters (802.1Q-REV/D5.0) */
+   uint32_t                          InternalPortPathCost;/* 13.37.1         */
+   bool                             useCfgPathCost;/* indicates whether to use
+                                                    * user configured path cost
+                                                    * value or 'autodetect' it
+                                                    * from the link speed */
+   uint32_t                           mstiPort_uptime;
+
+   bool                             loopInconsistent;   /* TRUE if port
+                                                          * state is
+                                                          * inconsistent */
+
+   bool                             rootInconsistent;
 
    /* Counters used for debugging and troubleshooting purposes */
    MSTP_MSTI_PORT_DBG_CNTS_t         dbgCnts;
@@ -2607,33 +2903,24 @@ typedef struct MSTP_CIST_PORT_DBG_CNTS_t
  *---------------------------------------------------------------------------*/
 typedef struct MSTP_CIST_PORT_INFO_t
 {
-   /* Statistics MIB support (RFC1493 MIB) */
-   uint32_t                          forwardTransitions;
-   time_t                            forwardTransitionsLastUpdated;
+   /*------------------------------------------------------------------------
+    * Hot state touched on every timer tick and role selection pass is kept
+    * together at the start of the structure, ahead of the priority vectors,
+    * the configuration and the debug counters/history.
+    * The timers and the PRT state live in 'mstp_treePortHot', at the slot
+    * given by 'hotMstid' (always the CIST) and 'hotLport'.
+    *------------------------------------------------------------------------*/
+   MSTID_t                           hotMstid;
+   LPORT_t                           hotLport;
 
-   /* State Machine Performance Parameters (802.1Q-REV/D5.0)  */
-   uint32_t                          InternalPortPathCost;/* 13.37.1 */
-   bool                             useCfgPathCost;/* indicates whether to use
-                                                    * user configured path cost
-                                                    * value or 'autodetect' it
-                                                    * from the link speed */
-  uint32_t                           cistPort_uptime;
-
-   bool                             loopInconsistent;  /* TREU if port
-                                                         * state is
-                                                         * inconsistent */
+   /* Per-Port State Machines states (802.1Q-REV/D5.0) */
+   MSTP_PIM_STATE_t                  pimState;           /* 13.32            */
+   MSTP_PST_STATE_t                  pstState;           /* 13.35            */
+   MSTP_TCM_STATE_t                  tcmState;           /* 13.36            */
 
-   bool                             rootInconsistent;
    /* Per-Port Variables (802.1Q-REV/D5.0 13.24) */
    MSTP_INFO_IS_t                    infoIs;             /*  x)               */
    MSTP_RCVD_INFO_t                  rcvdInfo;           /* ac)               */
-   MSTP_CIST_DESIGNATED_PRI_VECTOR_t designatedPriority; /* al)               */
-   MSTP_CIST_DESIGNATED_TIMES_t      designatedTimes;    /* am)               */
-   MSTP_CIST_MSG_PRI_VECTOR_t        msgPriority;        /* an)               */
-   MSTP_CIST_MSG_TIMES_t             msgTimes;           /* ao)               */
-   MSTP_PORT_ID_t                    portId;             /* ap)               */
-   MSTP_CIST_PORT_PRI_VECTOR_t       portPriority;       /* aq)               */
-   MSTP_CIST_PORT_TIMES_t            portTimes;          /* ar)               */
    MSTP_PORT_ROLE_t                  role;               /* as)               */
    MSTP_PORT_ROLE_t                  selectedRole;       /* at)               */
    uint32_t                        bitMap[((MSTP_CIST_PORT_BIT_MAP_MAX+31)/32)];
@@ -2659,18 +2946,33 @@ typedef struct MSTP_CIST_PORT_INFO_t
                                      synced                 av)
    */
 
-   /* State Machine Timers (802.1Q-REV/D5.0 13.21) */
-   uint8_t                            fdWhile;            /*  d)              */
-   uint8_t                            rrWhile;            /*  e)              */
-   uint8_t                            rbWhile;            /*  f)              */
-   uint8_t                            tcWhile;            /*  g)              */
-   uint8_t                            rcvdInfoWhile;      /*  h)              */
+   MSTP_CIST_DESIGNATED_PRI_VECTOR_t designatedPriority; /* al)               */
+   MSTP_CIST_DESIGNATED_TIMES_t      designatedTimes;    /* am)               */
+   MSTP_CIST_MSG_PRI_VECTOR_t        msgPriority;        /* an)               */
+   MSTP_CIST_MSG_TIMES_t             msgTimes;           /* ao)               */
+   MSTP_PORT_ID_t                    portId;             /* ap)               */
+   MSTP_CIST_PORT_PRI_VECTOR_t       portPriority;       /* aq)               */
+   MSTP_CIST_PORT_TIMES_t            portTimes;          /* ar)               */
+   MSTP_CIST_ROLE_INPUTS_t           roleInputs; /* as of the last role
+                                                  * selection             */
 
-   /* Per-Port State Machines states (802.1Q-REV/D5.0) */
-   MSTP_PIM_STATE_t                  pimState;           /* 13.32            */
-   MSTP_PRT_STATE_t                  prtState;           /* 13.34            */
-   MSTP_PST_STATE_t                  pstState;           /* 13.35            */
-   MSTP_TCM_STATE_t                  tcmState;           /* 13.36            */
+   /* Statistics MIB support (RFC1493 MIB) */
+   uint32_t                          forwardTransitions;
+   time_t                            forwardTransitionsLastUpdated;
+
+   /* State Machine Performance Parameters (802.1Q-REV/D5.0)  */
+   uint32_t                          InternalPortPathCost;/* 13.37.1 */
+   bool                             useCfgPathCost;/* indicates whether to use
+                                                    * user configured path cost
+                                                    * value or 'autodetect' it
+                                                    * from the link speed */
+  uint32_t                           cistPort_uptime;
+
+   bool                             loopInconsistent;  /* TREU if port
+                                                         * state is
+                                                         * inconsistent */
+
+   bool                             rootInconsistent;
 
    /* Counters used for debugging and troubleshooting purposes */
    MSTP_CIST_PORT_DBG_CNTS_t         dbgCnts;
@@ -2763,6 +3065,30 @@ typedef struct MSTP_COMM_PORT_INFO_t
    uint32_t                        dbxRxCnt;
    uint32_t                        dbxRxRate;
 
+   /* Last BPDU decoded on this port (see 'mstp_rcvInfo') */
+   uint8_t                         *lastRxBpdu;   /* copy of the BPDU data   */
+   uint16_t                         lastRxBpduLen;/* its length, 0 if none   */
+   uint32_t                         lastRxBpduGen;/* 'rxInfoGen' it was
+                                                   * decoded at             */
+
+   /* Link flap dampening (see 'mstp_flapDampLinkDown') */
+   uint32_t                         flapPenalty;  /* decaying flap penalty  */
+   bool                             flapSuppressed;/* link ups are ignored
+                                                   * until the penalty falls
+                                                   * to the reuse threshold */
+   uint32_t                         flapSuppressCnt;/* # of times suppressed */
+   uint32_t                         flapIgnoredUps;/* # of link ups ignored */
+
+   /* BPDU template of this port (see 'mstp_txMstp') */
+   uint8_t                         *txBpdu;       /* the BPDU sent last,
+                                                   * patched for the next  */
+   MSTI_MAP                         txDirtyTrees; /* trees whose part of it
+                                                   * changed since (see
+                                                   * 'MSTP_TX_TREE_CHANGED')*/
+   MSTI_MAP                         txMstiSent;   /* MSTIs with a message
+                                                   * in it                  */
+   uint32_t                         txInfoGen;    /* 'txInfoGen' it was
+                                                   * sent at                */
 
 } MSTP_COMM_PORT_INFO_t;
 
@@ -2786,8 +3112,15 @@ typedef struct MSTP_MSTI_INFO_t
    MSTP_MSTI_ROOT_PRI_VECTOR_t       rootPriority;            /* g)          */
    MSTP_MSTI_ROOT_TIMES_t            rootTimes;               /* h)          */
 
+   /* Inputs of the last Port Role Selection, none if not 'rolesValid' */
+   MSTP_MSTI_TREE_ROLE_INPUTS_t      roleInputs;
+   bool                              rolesValid;
+
    /* Per-Bridge State Machines states (802.1Q-REV/D5.0) */
    MSTP_PRS_STATE_t                  prsState;                /* 13.33       */
+   PORT_MAP                          tcPropPorts;/* ports whose TCM is in a
+                                                  * state 'tcProp' has an
+                                                  * effect in             */
 
    /* VLAN group number associated with this instance */
    VLAN_GROUP_t                      vlanGroupNum;
@@ -2834,8 +3167,15 @@ typedef struct MSTP_CIST_INFO_t
                                                          * value propagated
                                                          * by the CIST Root */
 
+   /* Inputs of the last Port Role Selection, none if not 'rolesValid' */
+   MSTP_CIST_TREE_ROLE_INPUTS_t      roleInputs;
+   bool                              rolesValid;
+
    /* Per-Bridge State Machines states (802.1Q-REV/D5.0) */
    MSTP_PRS_STATE_t                  prsState;                /* 13.33       */
+   PORT_MAP                          tcPropPorts;/* ports whose TCM is in a
+                                                  * state 'tcProp' has an
+                                                  * effect in             */
 
    /* The CST Root change history information */
    uint32_t                           cstRootChangeCnt;/* # of times the CST
@@ -2879,6 +3219,34 @@ typedef struct MSTP_BRIDGE_INFO_t
 
    /* CIST and MSTIs common Per-Port information */
    MSTP_COMM_PORT_INFO_t       *PortInfo[MAX_LPORTS + 1];
+   PORT_MAP                     activeLports;/* lports that have 'PortInfo'
+                                              * allocated                 */
+   uint32_t                     rxInfoGen;   /* bumped on any change that
+                                              * may alter how a received
+                                              * BPDU is classified        */
+   uint32_t                     txInfoGen;   /* bumped on any change that
+                                              * may alter a sent BPDU but
+                                              * is not marked per tree    */
+   MSTI_MAP                     reconfigTrees;/* trees with a priority or
+                                               * path cost change to be
+                                               * applied by reselection */
+   bool                         rgnReconfig; /* MST Configuration Identifier
+                                              * changed, the ports' Region
+                                              * boundary is to be checked */
+   bool                         prsHold;     /* Port Role Selection is held
+                                              * while a batch of link
+                                              * changes is applied        */
+   MSTI_MAP                     prsHeldTrees;/* trees it was held for     */
+   MSTP_BRIDGE_IDENTIFIER_t     prsHeldRgnRootID;/* CIST Regional Root when
+                                                  * it was taken           */
+
+   /* Link flap dampening configuration and the ports being dampened */
+   bool                         flapDampEnabled;
+   uint32_t                     flapPenalty; /* added on every link down  */
+   uint32_t                     flapSuppress;/* suppress at or above      */
+   uint32_t                     flapReuse;   /* reuse at or below         */
+   uint32_t                     flapHalfLife;/* penalty half-life, seconds*/
+   PORT_MAP                     flapDampLports;/* ports with a penalty    */
 
    /* CIST and MSTIs common State Machine Performance Parameters
     * (802.1Q-REV/D5.0) */
@@ -2903,9 +3271,15 @@ typedef struct MSTP_BRIDGE_INFO_t
                                                   * path costs from 802.1d or
                                                   * 802.1t are used          */
    uint8_t                       trap_mask;       /* enabled STP traps        */
-   bool                        preventTx;       /* Used to lock/unlock BPDU
+   uint32_t                    preventTx;       /* Used to lock/unlock BPDU
                                                   * transmission on all MSTP
-                                                  * ports                    */
+                                                  * ports, nesting depth of
+                                                  * the locks taken          */
+   PORT_MAP                     txPendingLports; /* ports whose PTX SM was
+                                                  * kicked while locked      */
+   PORT_MAP                     txEventLports;   /* ports that transmitted
+                                                  * during the current
+                                                  * event                    */
    PORT_MAP                     bpduFilterLports;/* BPDU-Filtered ports      */
    /* Ports with bpdu protection enabled */
    PORT_MAP                     bpduProtectionLports;/* BPDU-Protected
@@ -3065,6 +3439,22 @@ typedef struct MSTP_MSTI_CONFIG_MSG_t
 } MSTP_MSTI_CONFIG_MSG_t;
 #pragma pack(pop)
 
+/*---------------------------------------------------------------------------
+ * Parsed descriptor of the received BPDU that is being processed. It is
+ * built once by 'mstp_decodeBpdu' so that the per-tree helpers neither
+ * re-validate the frame nor search the MSTI Configuration Messages.
+ *---------------------------------------------------------------------------*/
+typedef struct MSTP_RX_BPDU_DESC_t
+{
+   const MSTP_RX_PDU      *pkt;         /* described packet, NULL if none    */
+   MSTP_BPDU_TYPE_t        bpduType;    /* as returned by 'mstp_getBpduType' */
+   uint16_t                v3Len;       /* Version 3 Length (host order)     */
+   uint8_t                 numMstiMsgs; /* # of MSTI Configuration Messages  */
+   bool                    repeated;    /* same as the last BPDU decoded on
+                                         * the port, flags aside            */
+   MSTP_MSTI_CONFIG_MSG_t *mstiMsg[MSTP_INSTANCES_MAX + 1];/* by MSTID     */
+} MSTP_RX_BPDU_DESC_t;
+
 /*****************************************************************************
  *        MSTP Debug support
  *****************************************************************************/
@@ -3108,7 +3498,14 @@ MSTP_CB_t         mstp_CB;
 MSTP_BRIDGE_INFO_t
                          mstp_Bridge;
 VID_MAP           mstp_MstiVidTable[MSTP_INSTANCES_MAX + 1];
+uint8_t           mstp_VidMstIdTable[MAX_VLAN_ID + 1];
+MSTID_t           mstp_MstCfgTable[MSTP_MST_CFG_TBL_SIZE];
+bool              mstp_MstCfgTableDirty;
+bool              mstp_smMergeNested;
 MSTID_t           mstp_vlanGroupNumToMstIdTable[MSTP_INSTANCES_MAX + 1];
+MSTP_PERF_STATS_t mstp_perfStats;
+MSTP_TREE_PORT_HOT_t
+                  mstp_treePortHot[MSTP_INSTANCES_MAX + 1];
 const uint8_t     mstp_DigestSignatureKey[MSTP_DIGEST_KEY_LEN];
 
 struct_handle_t     gMstpStructMem[MSTP_MAX_LOG_THROTTLE_CLIENT];
@@ -3209,6 +3606,12 @@ void mstp_updateMstpCBPortMaps(LPORT_t lport);
 void mstp_updatePortOperEdgeState(MSTID_t mstid, LPORT_t lport, bool state);
 bool
 mstpCistCompareRootTimes(MSTP_CIST_ROOT_TIMES_t *rootTime,  uint16_t helloTime);
+int
+mstp_cistPriorityVectorsCompare(MSTP_CIST_BRIDGE_PRI_VECTOR_t *v1,
+                                MSTP_CIST_BRIDGE_PRI_VECTOR_t *v2);
+int
+mstp_mstiPriorityVectorsCompare(MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v1,
+                                MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v2);
 void mstp_processTimerTickEvent();
 void mstp_collectNotForwardingPorts(PORT_MAP *pmap);
 void mstp_blockedPortsBackToForward(PORT_MAP *pmap);
@@ -3221,8 +3624,16 @@ bool mstp_isTopologyChange(MSTID_t mstid);
 int  mstp_getCistUptime(LPORT_t lport);
 int  mstp_getMstiUptime(MSTID_t mstid, LPORT_t lport);
 void mstp_portAutoDetectParamsSet(LPORT_t lport, SPEED_DPLX *pSpeed);
+bool mstp_portSpeedChange(LPORT_t lport, SPEED_DPLX *pSpeed);
+void mstp_holdPrs(void);
+void mstp_releasePrs(const PORT_MAP *syncPorts);
+bool mstp_flapDampLinkDown(LPORT_t lport);
+void mstp_flapDampTick(PORT_MAP *reuse);
+void mstp_flapDampReset(PORT_MAP *reuse);
 MSTP_BPDU_TYPE_t
             mstp_getBpduType(MSTP_RX_PDU *pkt);
+void mstp_parseRxBpdu(MSTP_RX_PDU *pkt);
+void mstp_clearRxBpduDesc(void);
 VLAN_GROUP_t
             mstp_mapMstIdToVlanGroupNum(MSTID_t mstid);
 void mstp_unmapMstIdFromVlanGroupNum(MSTID_t mstid);
@@ -3244,6 +3655,9 @@ MSTP_MSTI_CONFIG_MSG_t *
                                           MSTP_MSTI_CONFIG_MSG_t *current);
 MSTP_TREE_MSG_t *
             mstp_findMstiPortStateChgMsg(MSTID_t mstid);
+MSTP_TREE_MSG_t *
+            mstp_getMstiPortStateChgMsg(MSTID_t mstid);
+void mstp_clearMstiPortStateChgMsg(MSTID_t mstid);
 void mstp_disableForwarding(MSTID_t mstid, LPORT_t lport);
 void mstp_disableLearning(MSTID_t mstid, LPORT_t lport);
 void mstp_enableForwarding(MSTID_t msti, LPORT_t lport);
@@ -3286,18 +3700,26 @@ void mstp_syncMaster(void);
 void mstp_txTcn(LPORT_t lport);
 void mstp_txConfig(LPORT_t lport);
 void mstp_txMstp(LPORT_t lport);
+void mstp_txBpduTemplateReset(LPORT_t lport);
 void mstp_updtRcvdInfoWhile(MSTID_t mstid, LPORT_t lport);
 void mstp_updtRolesDisabledTree(MSTID_t mstid);
 void mstp_updtRolesTree(MSTID_t mstid);
+bool mstp_roleInputsChanged(MSTID_t mstid);
+bool mstp_roleInputsPortCurrent(MSTID_t mstid, LPORT_t lport);
+void mstp_roleInputsPortUpdated(MSTID_t mstid, LPORT_t lport);
 bool mstp_AllSyncedCondition(MSTID_t mstid, LPORT_t lport);
 bool mstp_allTransmitReadyCondition(LPORT_t lport);
 bool mstp_ReRootedCondition(MSTID_t mstid, LPORT_t lport);
 uint16_t
             mstp_forwardDelayParameter(LPORT_t lport);
 bool mstp_isPortRoleSetOnAnyTree(LPORT_t lport, MSTP_PORT_ROLE_t role);
+void mstp_setScopedReconfig(MSTID_t mstid, LPORT_t lport);
+void mstp_setRegionReconfig(void);
+void mstp_updtBridgePriorityVector(MSTID_t mstid);
 void mstp_informOtherSubsystems(uint32_t operation);
 void
 mstp_informDBOnPortStateChange(uint32_t operation);
+void mstp_republishPortStates(void);
 void mstp_updateCstRootHistory (MSTP_BRIDGE_IDENTIFIER_t rootID);
 void mstp_updateIstRootHistory (MSTP_BRIDGE_IDENTIFIER_t rgnRootID);
 void mstp_updateMstiRootHistory(MSTID_t mstid,
@@ -3324,6 +3746,7 @@ void mstp_processTimerTickEvent();
  */
 bool mstp_updateMstiVidMapping(MSTID_t mstid,
                                       VID_MAP newVidMap);
+bool mstp_reevalPortRegion(LPORT_t lport);
 /*standard mib*/
 /*
  * mstp_recv.c
@@ -3419,6 +3842,12 @@ bool mstpValidTcHistory(bool originated, MSTID_t mstid,
 void intf_get_port_name(LPORT_t lport, char *port_name);
 bool intf_get_lport_speed_duplex(LPORT_t lport, SPEED_DPLX *sd);
 int mstp_util_get_valid_l2_ports(const struct ovsrec_bridge *bridge_row);
+uint32_t mstp_perfElapsedMsec(const struct timeval *start);
+uint32_t mstp_perfElapsedUsec(const struct timeval *start);
+void mstp_perfFirstBpduTx(void);
+bool mstp_smEnter(MSTP_SM_ID_t sm, MSTID_t mstid, LPORT_t lport);
+bool mstp_smRerun(void);
+void mstp_smLeave(void);
 
 void mstp_protocolData(MSTP_RX_PDU *msg);
 void mstp_errantProtocolData(MSTP_RX_PDU *msg, TRAP_SOURCE_TYPE_e source);
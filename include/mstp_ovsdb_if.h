@@ -107,6 +107,11 @@ typedef struct mstp_global_config {
     char config_name[MSTP_MAX_CONFIG_NAME_LEN];
     uint32_t config_revision;
     char config_digest[100];
+    bool flap_dampening;
+    uint32_t flap_penalty;
+    uint32_t flap_suppress;
+    uint32_t flap_reuse;
+    uint32_t flap_half_life;
 } mstp_global_config;
 
 typedef struct mstp_msti_config {
@@ -295,10 +300,11 @@ void mstp_util_set_msti_table_value (const char *key, int64_t value, int mstid);
 void mstp_util_set_msti_port_table_value (const char *key, int64_t value, int mstid, int lport);
 void mstp_util_set_msti_port_table_string (const char *key, char *string, int mstid, int lport);
 void mstp_util_msti_flush_mac_address(int mstid,int lport);
-void handle_vlan_add_in_mstp_config(int vlan);
-void handle_vlan_delete_in_mstp_config(int vlan);
+void handle_vlan_add_in_mstp_config(const VID_MAP *vids);
+void handle_vlan_delete_in_mstp_config(const VID_MAP *vids);
 void update_port_entry_in_cist_mstp_instances(char *name, int operation);
 void update_port_entry_in_msti_mstp_instances(char *name, int operation);
+void add_port_entries_in_mstp_instances(const PORT_MAP *lports);
 void update_mstp_on_lport_add(int lport);
 bool is_lport_down(int lport);
 bool is_lport_up(int lport);
@@ -307,4 +313,7 @@ void enable_logical_port(int lport);
 void enable_or_disable_port(int lport,bool enable);
 bool mstpd_is_valid_port_row(const struct ovsrec_port *prow);
 bool intf_get_link_state(const struct ovsrec_port *port_row);
+void mstpd_init_lag_id_pool(uint16_t count);
+uint16_t mstpd_alloc_lag_id(void);
+void mstpd_free_lag_id(uint16_t id);
 #endif /* __MSTP_OVSDB_IF__H__ */
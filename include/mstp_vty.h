@@ -29,6 +29,7 @@
 #define MSTP_CISTID                 0
 #define MSTP_MSTID_MIN              1
 #define MSTP_MSTID_MAX              64
+#define MSTP_VID_TABLE_SIZE         4096  /* VLAN ID to MSTID lookup */
 #define MSTP_MAX_CONFIG_NAME_LEN    32
 #define MSTP_BRIDGE_PRIORITY_MULTIPLIER 4096
 #define MSTP_PORT_PRIORITY_MULTIPLIER 16
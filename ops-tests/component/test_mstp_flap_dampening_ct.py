@@ -0,0 +1,230 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2015-2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+OpenSwitch Test for MSTP link flap dampening.
+"""
+
+from __future__ import unicode_literals, absolute_import
+from __future__ import print_function, division
+
+import re
+import time
+
+TOPOLOGY = """
+#
+# +-------+     +-------+
+# |       |     |       |
+# |       +-----+       |
+# | Sw1   +-----+   Sw2 |
+# |       |     |       |
+# +-------+     +-------+
+#
+# Nodes
+[type=openswitch name="OpenSwitch 1"] sw1
+[type=openswitch name="OpenSwitch 2"] sw2
+
+# Links
+sw1:1 -- sw2:1
+sw1:2 -- sw2:2
+"""
+
+HELLO_TIME = 2
+LOW_PRIORITY = 4
+FLAPS = 3
+# other_config knob -> value, a short half-life so the test does not wait
+FLAP_CONFIG = {'mstp_flap_dampening': 'true',
+               'mstp_flap_penalty': '1000',
+               'mstp_flap_suppress': '2000',
+               'mstp_flap_reuse': '750',
+               'mstp_flap_half_life': '5'}
+# values the daemon has to reject or clamp
+FLAP_BAD_CONFIG = [('mstp_flap_half_life', '0'),
+                   ('mstp_flap_half_life', '65536'),
+                   ('mstp_flap_half_life', '-1'),
+                   ('mstp_flap_suppress', '4294967295'),
+                   ('mstp_flap_penalty', 'abc')]
+
+
+def enable_l2port(sw, port):
+    with sw.libs.vtysh.ConfigInterface(port) as ctx:
+        ctx.no_routing()
+        ctx.no_shutdown()
+
+
+def wait_until_interface_up(switch, portlbl, timeout=30, polling_frequency=1):
+    """
+    Wait until the interface, as mapped by the given portlbl, is marked as up.
+
+    :param switch: The switch node.
+    :param str portlbl: Port label that is mapped to the interfaces.
+    :param int timeout: Number of seconds to wait.
+    :param int polling_frequency: Frequency of the polling.
+    :return: None if interface is brought-up. If not, an assertion is raised.
+    """
+    for i in range(timeout):
+        status = switch.libs.vtysh.show_interface(portlbl)
+        if status['interface_state'] == 'up':
+            break
+        time.sleep(polling_frequency)
+    else:
+        assert False, (
+            'Interface {}:{} never brought-up after '
+            'waiting for {} seconds'.format(
+                switch.identifier, portlbl, timeout
+            )
+        )
+
+
+def set_flap_config(sw, config):
+    sw.send_command('ovs-vsctl set bridge bridge_normal ' +
+                    ' '.join('other_config:%s=%s' % (key, value)
+                             for key, value in config.items()),
+                    shell='bash')
+
+
+def remove_flap_config(sw):
+    sw.send_command('ovs-vsctl remove bridge bridge_normal other_config ' +
+                    ' '.join(FLAP_CONFIG.keys()), shell='bash')
+
+
+def flap_counts(sw):
+    result = sw.send_command(
+        'ovs-appctl -t ops-stpd mstpd/daemon/perf_stats', shell='bash')
+    enabled = re.search('Flap dampening\s*:\s*(?P<enabled>\w+)', result)
+    counts = re.search('Flap suppress / reuse / ups\s*:\s*(?P<suppress>\d+)'
+                       '\s*/\s*(?P<reuse>\d+)\s*/\s*(?P<ups>\d+)', result)
+    assert enabled is not None and counts is not None, \
+        "No flap dampening counters in perf_stats"
+    return (enabled.group('enabled'), int(counts.group('suppress')),
+            int(counts.group('reuse')), int(counts.group('ups')))
+
+
+def port_suppressed(sw, port):
+    result = sw.send_command(
+        'ovs-appctl -t ops-stpd mstpd/daemon/comm_port %s' % port,
+        shell='bash')
+    result = re.search('Flap suppressed\s*:\s*(?P<suppressed>\w+)', result)
+    assert result is not None, "No flap state for port {}".format(port)
+    return result.group('suppressed') == 'Yes'
+
+
+def cleanup_config(sw):
+    with sw.libs.vtysh.Configure() as ctx:
+        ctx.no_spanning_tree_hello_time()
+        ctx.no_spanning_tree_priority()
+        ctx.no_spanning_tree()
+
+
+def test_mstp_flap_dampening(topology):
+    """
+    Test that a flapping port is suppressed and released again.
+
+    sw1 is the CIST root, so port 1 of sw2 is its Root port and port 2 its
+    Alternate port. With flap dampening enabled on sw2, port 1 is flapped
+    until its penalty crosses the suppress threshold: its following link
+    up is ignored and port 2 takes over as the Root port. Once the penalty
+    has decayed to the reuse threshold port 1 is the Root port again.
+    Out of range dampening knobs must neither stop nor crash the daemon.
+    """
+    sw1 = topology.get('sw1')
+    sw2 = topology.get('sw2')
+
+    assert sw1 is not None
+    assert sw2 is not None
+
+    for sw in [sw1, sw2]:
+        cleanup_config(sw)
+
+    for sw in [sw1, sw2]:
+        enable_l2port(sw, '1')
+        enable_l2port(sw, '2')
+        for switch, portlbl in [(sw, '1'), (sw, '2')]:
+            wait_until_interface_up(switch, portlbl)
+        with sw.libs.vtysh.Configure() as ctx:
+            ctx.spanning_tree_hello_time(HELLO_TIME)
+
+    with sw1.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_priority(LOW_PRIORITY)
+
+    for sw in [sw1, sw2]:
+        with sw.libs.vtysh.Configure() as ctx:
+            ctx.spanning_tree()
+
+    # Covergence should happen with HELLO_TIME * 2
+    time.sleep(HELLO_TIME * 5)
+
+    sw2_port1 = sw2.ports['1']
+    sw2_port2 = sw2.ports['2']
+
+    sw2_show = sw2.libs.vtysh.show_spanning_tree()
+    assert(sw2_show[sw2_port1]['role'] == 'Root'), \
+        "Port role has not updated correctly"
+    assert(sw2_show[sw2_port2]['role'] == 'Alternate'), \
+        "Port role has not updated correctly"
+
+    set_flap_config(sw2, FLAP_CONFIG)
+    time.sleep(1)
+    enabled, suppress, reuse, ups = flap_counts(sw2)
+    assert(enabled == 'Enabled'), "Flap dampening is not enabled"
+
+    for i in range(FLAPS):
+        with sw2.libs.vtysh.ConfigInterface('1') as ctx:
+            ctx.shutdown()
+        with sw2.libs.vtysh.ConfigInterface('1') as ctx:
+            ctx.no_shutdown()
+    time.sleep(HELLO_TIME * 2)
+
+    new_enabled, new_suppress, new_reuse, new_ups = flap_counts(sw2)
+    assert(new_suppress == suppress + 1), "The port was not suppressed"
+    assert(new_ups > ups), "No link up was ignored"
+    assert(port_suppressed(sw2, sw2_port1)), "The port was not suppressed"
+
+    sw2_show = sw2.libs.vtysh.show_spanning_tree()
+    assert(sw2_show[sw2_port1]['State'] != 'Forwarding'), \
+        "The suppressed port is forwarding"
+    assert(sw2_show[sw2_port2]['role'] == 'Root'), \
+        "The Alternate port did not take over"
+
+    # The penalty decays from at most FLAPS * penalty to reuse in about
+    # two half-lives
+    for i in range(60):
+        if not port_suppressed(sw2, sw2_port1):
+            break
+        time.sleep(1)
+    else:
+        assert False, "The port was never released from suppression"
+    time.sleep(HELLO_TIME * 5)
+
+    new_enabled, new_suppress, new_reuse, new_ups = flap_counts(sw2)
+    assert(new_reuse == reuse + 1), "The port release was not counted"
+    sw2_show = sw2.libs.vtysh.show_spanning_tree()
+    assert(sw2_show[sw2_port1]['role'] == 'Root'), \
+        "The released port is not the Root port again"
+    assert(sw2_show[sw2_port1]['State'] == 'Forwarding'), \
+        "The released port is not forwarding"
+
+    for key, value in FLAP_BAD_CONFIG:
+        set_flap_config(sw2, {key: value})
+        time.sleep(1)
+        enabled, suppress, reuse, ups = flap_counts(sw2)
+        assert(enabled == 'Enabled'), \
+            "Flap dampening changed with {}={}".format(key, value)
+
+    remove_flap_config(sw2)
+    for sw in [sw1, sw2]:
+        cleanup_config(sw)
@@ -0,0 +1,226 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2015-2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+OpenSwitch Test for an MSTI priority change leaving the other trees alone.
+"""
+
+from __future__ import unicode_literals, absolute_import
+from __future__ import print_function, division
+
+import re
+import time
+
+TOPOLOGY = """
+#
+# +-------+     +-------+
+# |       |     |       |
+# |       +-----+       |
+# | Sw1   +-----+   Sw2 |
+# |       |     |       |
+# +-------+     +-------+
+#
+# Nodes
+[type=openswitch name="OpenSwitch 1"] sw1
+[type=openswitch name="OpenSwitch 2"] sw2
+
+# Links
+sw1:1 -- sw2:1
+sw1:2 -- sw2:2
+"""
+
+HELLO_TIME = 2
+REGION_1 = "Region-One"
+VERSION = "8"
+LOW_PRIORITY = 4
+LOWEST_PRIORITY = 1
+# instance -> VLAN
+INSTANCES = {1: 2, 2: 3, 3: 4}
+CHANGED_INSTANCE = 1
+
+
+def enable_l2port(sw, port, vlans):
+    with sw.libs.vtysh.ConfigInterface(port) as ctx:
+        ctx.no_routing()
+        ctx.no_shutdown()
+        for vlan in vlans:
+            ctx.vlan_trunk_allowed(str(vlan))
+
+
+def configure_vlan(sw, vlan):
+    with sw.libs.vtysh.ConfigVlan(str(vlan)) as ctx:
+        ctx.no_shutdown()
+
+
+def config_mstp_region(sw, region_name, version):
+    with sw.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_config_name(region_name)
+        ctx.spanning_tree_config_revision(version)
+        ctx.spanning_tree_hello_time(HELLO_TIME)
+
+
+def wait_until_interface_up(switch, portlbl, timeout=30, polling_frequency=1):
+    """
+    Wait until the interface, as mapped by the given portlbl, is marked as up.
+
+    :param switch: The switch node.
+    :param str portlbl: Port label that is mapped to the interfaces.
+    :param int timeout: Number of seconds to wait.
+    :param int polling_frequency: Frequency of the polling.
+    :return: None if interface is brought-up. If not, an assertion is raised.
+    """
+    for i in range(timeout):
+        status = switch.libs.vtysh.show_interface(portlbl)
+        if status['interface_state'] == 'up':
+            break
+        time.sleep(polling_frequency)
+    else:
+        assert False, (
+            'Interface {}:{} never brought-up after '
+            'waiting for {} seconds'.format(
+                switch.identifier, portlbl, timeout
+            )
+        )
+
+
+def ops_get_system_mac_address(sw):
+    result = sw.send_command('ovs-vsctl list system | grep system_mac',
+                             shell='bash')
+    result = re.search('\s*system_mac\s*:\s*"(?P<sys_mac>.*)"', result)
+    result = result.groupdict()
+    sw_mac = result['sys_mac']
+    return sw_mac
+
+
+def reconfig_counts(sw):
+    result = sw.send_command(
+        'ovs-appctl -t ops-stpd mstpd/daemon/perf_stats', shell='bash')
+    result = re.search('Reconfigs full / in place\s*:\s*(?P<full>\d+)'
+                       '\s*/\s*(?P<scoped>\d+)', result)
+    assert result is not None, "No reconfiguration counters in perf_stats"
+    return int(result.group('full')), int(result.group('scoped'))
+
+
+def tree_ports(sw, ports, trees):
+    """
+    Return the role and state of the given ports on the given trees.
+    """
+    show = sw.libs.vtysh.show_spanning_tree_mst()
+    return dict(((tree, port), (show[tree][port]['role'],
+                                show[tree][port]['State']))
+                for tree in trees for port in ports)
+
+
+def cleanup_config(sw):
+    with sw.libs.vtysh.Configure() as ctx:
+        ctx.no_spanning_tree_config_name()
+        ctx.no_spanning_tree_config_revision()
+        ctx.no_spanning_tree_hello_time()
+        ctx.no_spanning_tree_priority()
+        ctx.no_spanning_tree()
+
+
+def test_mstp_instance_priority_change(topology):
+    """
+    Test that changing the priority of one MSTI only reselects that MSTI.
+
+    Build a topology of two switches with two links and three MSTIs, sw1
+    being the root of the CIST and of every MSTI. Lower the priority of
+    sw2 on one MSTI so that it becomes its regional root. While that MSTI
+    converges, the port roles and states of the CIST and of the other MSTIs
+    must not change on either switch, and the change must not have caused a
+    full protocol re-initialization.
+    """
+    sw1 = topology.get('sw1')
+    sw2 = topology.get('sw2')
+
+    assert sw1 is not None
+    assert sw2 is not None
+
+    for sw in [sw1, sw2]:
+        cleanup_config(sw)
+
+    for sw in [sw1, sw2]:
+        for vlan in INSTANCES.values():
+            configure_vlan(sw, vlan)
+        enable_l2port(sw, '1', INSTANCES.values())
+        enable_l2port(sw, '2', INSTANCES.values())
+        for switch, portlbl in [(sw, '1'), (sw, '2')]:
+            wait_until_interface_up(switch, portlbl)
+        config_mstp_region(sw, REGION_1, VERSION)
+        with sw.libs.vtysh.Configure() as ctx:
+            for instance, vlan in INSTANCES.items():
+                ctx.spanning_tree_instance_vlan(instance, vlan)
+
+    with sw1.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_priority(LOW_PRIORITY)
+        for instance in INSTANCES:
+            ctx.spanning_tree_instance_priority(instance, LOW_PRIORITY)
+
+    for sw in [sw1, sw2]:
+        with sw.libs.vtysh.Configure() as ctx:
+            ctx.spanning_tree()
+
+    # Covergence should happen with HELLO_TIME * 2
+    time.sleep(HELLO_TIME * 5)
+
+    sw2_mac = ops_get_system_mac_address(sw2)
+    ports = {sw1: [sw1.ports['1'], sw1.ports['2']],
+             sw2: [sw2.ports['1'], sw2.ports['2']]}
+    changed = 'MST%d' % CHANGED_INSTANCE
+    others = ['MST0'] + ['MST%d' % instance for instance in INSTANCES
+                         if instance != CHANGED_INSTANCE]
+
+    before = {}
+    for sw in [sw1, sw2]:
+        before[sw] = tree_ports(sw, ports[sw], others)
+        print(before[sw])
+        for (tree, port), (role, state) in before[sw].items():
+            assert(state in ['Forwarding', 'Blocking']), \
+                "{} port {} did not converge".format(tree, port)
+    full, scoped = reconfig_counts(sw2)
+
+    with sw2.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_instance_priority(CHANGED_INSTANCE, LOWEST_PRIORITY)
+
+    # Sample the other trees while the changed MSTI converges
+    end = time.time() + HELLO_TIME * 5
+    while time.time() < end:
+        for sw in [sw1, sw2]:
+            now = tree_ports(sw, ports[sw], others)
+            assert(now == before[sw]), \
+                "Other trees changed: {} -> {}".format(before[sw], now)
+        time.sleep(0.5)
+
+    sw2_show_mst = sw2.libs.vtysh.show_spanning_tree_mst()
+    assert(sw2_show_mst[changed]['root_address'] == sw2_mac), \
+        "sw2 is not the regional root of the changed MSTI"
+    for port in ports[sw2]:
+        assert(sw2_show_mst[changed][port]['role'] == 'Designated'), \
+            "Port role has not updated correctly"
+
+    new_full, new_scoped = reconfig_counts(sw2)
+    assert(new_full == full), \
+        "The priority change caused a full re-initialization"
+    assert(new_scoped > scoped), \
+        "The priority change was not applied in place"
+
+    for sw in [sw1, sw2]:
+        with sw.libs.vtysh.Configure() as ctx:
+            for instance in INSTANCES:
+                ctx.no_spanning_tree_instance(instance)
+        cleanup_config(sw)
@@ -0,0 +1,221 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2015-2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+OpenSwitch Test for MSTI port roles when a neighbour leaves the region.
+"""
+
+from __future__ import unicode_literals, absolute_import
+from __future__ import print_function, division
+
+import re
+import json
+import time
+from pytest import mark
+
+TOPOLOGY = """
+#
+# +-------+     +-------+
+# |       <----->       |
+# | OPS1  |     | OPS2  |
+# |       <----->       |
+# +-------+     +-------+
+#
+# Nodes
+[type=openswitch name="OpenSwitch 1"] ops1
+[type=openswitch name="OpenSwitch 2"] ops2
+
+# Links
+ops1:1 -- ops2:1
+ops1:2 -- ops2:2
+"""
+
+HELLO_TIME = 2
+REGION_1 = "Region-One"
+REGION_2 = "Region-Two"
+VERSION = "1"
+INSTANCE = 1
+VLAN = 2
+LOW_PRIORITY = 4
+
+
+def wait_until_interface_up(switch, portlbl, timeout=30, polling_frequency=1):
+    """
+    Wait until the interface, as mapped by the given portlbl, is marked as up.
+
+    :param switch: The switch node.
+    :param str portlbl: Port label that is mapped to the interfaces.
+    :param int timeout: Number of seconds to wait.
+    :param int polling_frequency: Frequency of the polling.
+    :return: None if interface is brought-up. If not, an assertion is raised.
+    """
+    for i in range(timeout):
+        status = switch.libs.vtysh.show_interface(portlbl)
+        if status['interface_state'] == 'up':
+            break
+        time.sleep(polling_frequency)
+    else:
+        assert False, (
+            'Interface {}:{} never brought-up after '
+            'waiting for {} seconds'.format(
+                switch.identifier, portlbl, timeout
+            )
+        )
+
+
+def enable_l2port(ops, port, vlan):
+    with ops.libs.vtysh.ConfigInterface(port) as ctx:
+        ctx.no_routing()
+        ctx.no_shutdown()
+        ctx.vlan_trunk_allowed(str(vlan))
+
+
+def configure_vlan(ops, vlan):
+    with ops.libs.vtysh.ConfigVlan(str(vlan)) as ctx:
+        ctx.no_shutdown()
+
+
+def config_mstp_region(ops, region_name, version, hello_time):
+    with ops.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_config_name(region_name)
+        ctx.spanning_tree_config_revision(version)
+        ctx.spanning_tree_hello_time(hello_time)
+
+
+def get_system_mac_address(ops):
+    result = ops.send_command('ovs-vsctl list system | grep system_mac',
+                              shell='bash')
+    result = re.search('\s*system_mac\s*:\s*"(?P<sys_mac>.*)"', result)
+    result = result.groupdict()
+    ops_mac = result['sys_mac']
+    return ops_mac
+
+
+def msti_role_for_cist_role(cist_role):
+    # At the region boundary every MSTI port takes the CIST port role,
+    # except that the CIST Root Port is the Master Port of the MSTIs.
+    if cist_role.lower() == 'root':
+        return 'master'
+    return cist_role.lower()
+
+
+def cleanup_config(switch):
+    with switch.libs.vtysh.Configure() as ctx:
+        ctx.no_spanning_tree_config_name()
+        ctx.no_spanning_tree_config_revision()
+        ctx.no_spanning_tree_hello_time()
+        ctx.no_spanning_tree_priority()
+        ctx.no_spanning_tree()
+
+
+@mark.platform_incompatible(['docker'])
+def test_stp_mist_region_boundary(topology):
+    """
+    Test that MSTI port roles follow the CIST ones when the neighbour of a
+    switch moves out of its region, and follow the MSTI information again
+    when it moves back in.
+
+    Both switches start in the same region with ops1 the CIST root and the
+    MSTI regional root. ops1 is then moved to another region, which puts
+    both ops2 ports at the region boundary: ops2 becomes the regional root
+    of the MSTI and the MSTI port roles must match the CIST ones, with the
+    Root Port shown as Master. ops1 is then moved back.
+    """
+    ops1 = topology.get('ops1')
+    ops2 = topology.get('ops2')
+
+    assert ops1 is not None
+    assert ops2 is not None
+
+    ops2_port1 = ops2.ports['1']
+    ops2_port2 = ops2.ports['2']
+
+    for ops in [ops1, ops2]:
+        cleanup_config(ops)
+
+    for ops in [ops1, ops2]:
+        configure_vlan(ops, VLAN)
+        enable_l2port(ops, '1', VLAN)
+        enable_l2port(ops, '2', VLAN)
+        for switch, portlbl in [(ops, '1'), (ops, '2')]:
+            wait_until_interface_up(switch, portlbl)
+        config_mstp_region(ops, REGION_1, VERSION, HELLO_TIME)
+        with ops.libs.vtysh.Configure() as ctx:
+            ctx.spanning_tree_instance_vlan(INSTANCE, VLAN)
+
+    with ops1.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_priority(LOW_PRIORITY)
+        ctx.spanning_tree_instance_priority(INSTANCE, LOW_PRIORITY)
+
+    for ops in [ops1, ops2]:
+        with ops.libs.vtysh.Configure() as ctx:
+            ctx.spanning_tree()
+
+    # Covergence should happen with HELLO_TIME * 2
+    time.sleep(HELLO_TIME * 5)
+
+    ops1_mac = get_system_mac_address(ops1)
+    ops2_mac = get_system_mac_address(ops2)
+    mst = 'MST%d' % INSTANCE
+
+    ops2_show_mst = ops2.libs.vtysh.show_spanning_tree_mst()
+    print(json.dumps(ops2_show_mst, indent=4))
+
+    assert(ops2_show_mst[mst]['root_address'] == ops1_mac), \
+        "MSTI regional root is not ops1 within the region"
+    assert(ops2_show_mst[mst][ops2_port1]['role'] == 'Root'), \
+        "MSTI port role has not updated correctly"
+    assert(ops2_show_mst[mst][ops2_port2]['role'] == 'Alternate'), \
+        "MSTI port role has not updated correctly"
+
+    # Move the neighbour out of the region
+    config_mstp_region(ops1, REGION_2, VERSION, HELLO_TIME)
+    time.sleep(HELLO_TIME * 5)
+
+    ops2_show_mst = ops2.libs.vtysh.show_spanning_tree_mst()
+    print(json.dumps(ops2_show_mst, indent=4))
+
+    assert(ops2_show_mst[mst]['root_address'] == ops2_mac), \
+        "ops2 is not the MSTI regional root out of the region"
+    for port in [ops2_port1, ops2_port2]:
+        cist_role = ops2_show_mst['MST0'][port]['role']
+        msti_role = ops2_show_mst[mst][port]['role']
+        assert(msti_role.lower() == msti_role_for_cist_role(cist_role)), \
+            "MSTI port role {} does not follow CIST port role {}".format(
+                msti_role, cist_role)
+        assert(ops2_show_mst[mst][port]['State'] ==
+               ops2_show_mst['MST0'][port]['State']), \
+            "MSTI port state does not follow CIST port state"
+
+    # Move the neighbour back into the region
+    config_mstp_region(ops1, REGION_1, VERSION, HELLO_TIME)
+    time.sleep(HELLO_TIME * 5)
+
+    ops2_show_mst = ops2.libs.vtysh.show_spanning_tree_mst()
+    print(json.dumps(ops2_show_mst, indent=4))
+
+    assert(ops2_show_mst[mst]['root_address'] == ops1_mac), \
+        "MSTI regional root is not ops1 back in the region"
+    assert(ops2_show_mst[mst][ops2_port1]['role'] == 'Root'), \
+        "MSTI port role has not updated correctly"
+    assert(ops2_show_mst[mst][ops2_port2]['role'] == 'Alternate'), \
+        "MSTI port role has not updated correctly"
+
+    for ops in [ops1, ops2]:
+        with ops.libs.vtysh.Configure() as ctx:
+            ctx.no_spanning_tree_instance(INSTANCE)
+        cleanup_config(ops)
@@ -0,0 +1,233 @@
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2015-2016 Hewlett Packard Enterprise Development LP
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+OpenSwitch Test for port states when the region configuration changes.
+"""
+
+from __future__ import unicode_literals, absolute_import
+from __future__ import print_function, division
+
+import re
+import time
+from pytest import mark
+
+TOPOLOGY = """
+#
+# +-------+     +-------+     +-------+
+# |       |     |       |     |       |
+# | OPS1  <-----> OPS2  <-----> OPS3  |
+# |       |     |       |     |       |
+# +-------+     +-------+     +-------+
+#
+# Nodes
+[type=openswitch name="OpenSwitch 1"] ops1
+[type=openswitch name="OpenSwitch 2"] ops2
+[type=openswitch name="OpenSwitch 3"] ops3
+
+# Links
+ops1:1 -- ops2:1
+ops2:2 -- ops3:1
+"""
+
+HELLO_TIME = 2
+REGION_1 = "Region-One"
+REGION_2 = "Region-Two"
+REGION_3 = "Region-Three"
+VERSION = "1"
+NEW_VERSION = "2"
+INSTANCE = 1
+VLAN = 2
+LOW_PRIORITY = 4
+
+
+def wait_until_interface_up(switch, portlbl, timeout=30, polling_frequency=1):
+    """
+    Wait until the interface, as mapped by the given portlbl, is marked as up.
+
+    :param switch: The switch node.
+    :param str portlbl: Port label that is mapped to the interfaces.
+    :param int timeout: Number of seconds to wait.
+    :param int polling_frequency: Frequency of the polling.
+    :return: None if interface is brought-up. If not, an assertion is raised.
+    """
+    for i in range(timeout):
+        status = switch.libs.vtysh.show_interface(portlbl)
+        if status['interface_state'] == 'up':
+            break
+        time.sleep(polling_frequency)
+    else:
+        assert False, (
+            'Interface {}:{} never brought-up after '
+            'waiting for {} seconds'.format(
+                switch.identifier, portlbl, timeout
+            )
+        )
+
+
+def enable_l2port(ops, port, vlan):
+    with ops.libs.vtysh.ConfigInterface(port) as ctx:
+        ctx.no_routing()
+        ctx.no_shutdown()
+        ctx.vlan_trunk_allowed(str(vlan))
+
+
+def configure_vlan(ops, vlan):
+    with ops.libs.vtysh.ConfigVlan(str(vlan)) as ctx:
+        ctx.no_shutdown()
+
+
+def config_mstp_region(ops, region_name, version, hello_time):
+    with ops.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_config_name(region_name)
+        ctx.spanning_tree_config_revision(version)
+        ctx.spanning_tree_hello_time(hello_time)
+
+
+def region_counts(ops):
+    result = ops.send_command(
+        'ovs-appctl -t ops-stpd mstpd/daemon/perf_stats', shell='bash')
+    changes = re.search('Region changes / boundary\s*:\s*(?P<changes>\d+)'
+                        '\s*/\s*(?P<boundary>\d+)', result)
+    drops = re.search('Region forwarding drops\s*:\s*(?P<drops>\d+)',
+                      result)
+    assert changes is not None and drops is not None, \
+        "No region counters in perf_stats"
+    return (int(changes.group('changes')), int(changes.group('boundary')),
+            int(drops.group('drops')))
+
+
+def cist_ports(ports):
+    """
+    Return the CIST role and state of the given (switch, port) pairs.
+    """
+    result = {}
+    for ops, port in ports:
+        show = ops.libs.vtysh.show_spanning_tree_mst()
+        result[(ops.identifier, port)] = (show['MST0'][port]['role'],
+                                          show['MST0'][port]['State'])
+    return result
+
+
+def check_stay_forwarding(ports, duration):
+    """
+    Sample the given (switch, port) pairs for the given number of seconds
+    and check that they keep the CIST role they have and stay Forwarding.
+    """
+    before = cist_ports(ports)
+    print(before)
+    for (switch, port), (role, state) in before.items():
+        assert(state == 'Forwarding'), \
+            "{} port {} is not forwarding".format(switch, port)
+    end = time.time() + duration
+    while time.time() < end:
+        now = cist_ports(ports)
+        assert(now == before), \
+            "Ports changed: {} -> {}".format(before, now)
+        time.sleep(0.5)
+
+
+def cleanup_config(switch):
+    with switch.libs.vtysh.Configure() as ctx:
+        ctx.no_spanning_tree_config_name()
+        ctx.no_spanning_tree_config_revision()
+        ctx.no_spanning_tree_hello_time()
+        ctx.no_spanning_tree_priority()
+        ctx.no_spanning_tree()
+
+
+@mark.platform_incompatible(['docker'])
+def test_stp_mist_region_change(topology):
+    """
+    Test that a change of the region configuration leaves the ports that do
+    not move across the region boundary forwarding.
+
+    ops1 and ops2 are in one region with ops1 the CIST root, ops3 is in
+    another region. ops3 is first moved to a third region: none of the
+    ports move across the boundary, so they all stay forwarding and ops3
+    must neither re-classify a port nor drop one out of forwarding. The
+    revision of ops1 is then changed, which moves the ops1 - ops2 link
+    to the boundary: the ops2 - ops3 link ports must stay forwarding.
+    """
+    ops1 = topology.get('ops1')
+    ops2 = topology.get('ops2')
+    ops3 = topology.get('ops3')
+
+    assert ops1 is not None
+    assert ops2 is not None
+    assert ops3 is not None
+
+    for ops in [ops1, ops2, ops3]:
+        cleanup_config(ops)
+
+    for ops, ports, region in [(ops1, ['1'], REGION_1),
+                               (ops2, ['1', '2'], REGION_1),
+                               (ops3, ['1'], REGION_2)]:
+        configure_vlan(ops, VLAN)
+        for portlbl in ports:
+            enable_l2port(ops, portlbl, VLAN)
+            wait_until_interface_up(ops, portlbl)
+        config_mstp_region(ops, region, VERSION, HELLO_TIME)
+        with ops.libs.vtysh.Configure() as ctx:
+            ctx.spanning_tree_instance_vlan(INSTANCE, VLAN)
+
+    with ops1.libs.vtysh.Configure() as ctx:
+        ctx.spanning_tree_priority(LOW_PRIORITY)
+
+    for ops in [ops1, ops2, ops3]:
+        with ops.libs.vtysh.Configure() as ctx:
+            ctx.spanning_tree()
+
+    # Covergence should happen with HELLO_TIME * 2
+    time.sleep(HELLO_TIME * 5)
+
+    ops2_show_mst = ops2.libs.vtysh.show_spanning_tree_mst()
+    assert(ops2_show_mst['MST0'][ops2.ports['1']]['role'] == 'Root'), \
+        "Port role has not updated correctly"
+    ops3_show_mst = ops3.libs.vtysh.show_spanning_tree_mst()
+    assert(ops3_show_mst['MST0'][ops3.ports['1']]['role'] == 'Root'), \
+        "Port role has not updated correctly"
+
+    # Move ops3 to another region, no port crosses the boundary
+    changes, boundary, drops = region_counts(ops3)
+    config_mstp_region(ops3, REGION_3, VERSION, HELLO_TIME)
+    check_stay_forwarding([(ops1, ops1.ports['1']),
+                           (ops2, ops2.ports['1']),
+                           (ops2, ops2.ports['2']),
+                           (ops3, ops3.ports['1'])], HELLO_TIME * 5)
+
+    new_changes, new_boundary, new_drops = region_counts(ops3)
+    assert(new_changes > changes), \
+        "The region change was not applied in place"
+    assert(new_boundary == boundary), \
+        "A port was re-classified although it stayed out of the region"
+    assert(new_drops == drops), \
+        "A port stopped forwarding on the region change"
+
+    # Move the ops1 - ops2 link to the boundary
+    config_mstp_region(ops1, REGION_1, NEW_VERSION, HELLO_TIME)
+    check_stay_forwarding([(ops2, ops2.ports['2']),
+                           (ops3, ops3.ports['1'])], HELLO_TIME * 5)
+
+    ops2_show_mst = ops2.libs.vtysh.show_spanning_tree_mst()
+    assert(ops2_show_mst['MST0'][ops2.ports['1']]['role'] == 'Root'), \
+        "Port role has not updated correctly"
+
+    for ops in [ops1, ops2, ops3]:
+        with ops.libs.vtysh.Configure() as ctx:
+            ctx.no_spanning_tree_instance(INSTANCE)
+        cleanup_config(ops)
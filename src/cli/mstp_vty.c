@@ -199,38 +199,46 @@ compare_nodes_by_vlan_id_in_numerical(const void *a_, const void *b_)
 }
 
 /*-----------------------------------------------------------------------------
- | Function:        mstp_util_get_mstid_for_vlanID
- | Responsibility:  Utility API to get the instance ID to which the VLAN belongs
+ | Function:        mstp_util_get_vid_mstid_table
+ | Responsibility:  Utility API to build a VLAN ID to instance ID lookup table,
+ |                  so that per-VLAN checks of a VLAN range are O(1) each
  | Parameters:
- |      vlan_id:    VLAN ID
- |      bridge_row: bridge row pointer
+ |      bridge_row:   bridge row pointer
+ |      vid_to_mstid: table of MSTP_VID_TABLE_SIZE entries to fill, VLANs
+ |                    not mapped to any MST instance are set to MSTP_CISTID
  | Return:
- |      InstId:     Returns MSTP instance ID,
- |                  MSTP_INVALID_ID If no instance mapped
+ |      e_vtysh_ok on success, e_vtysh_error otherwise
  ------------------------------------------------------------------------------
  */
-int64_t
-mstp_util_get_mstid_for_vlanID(int64_t vlan_id,
-        const struct ovsrec_bridge *bridge_row) {
+int
+mstp_util_get_vid_mstid_table(const struct ovsrec_bridge *bridge_row,
+        uint8_t *vid_to_mstid) {
 
+    const struct ovsrec_mstp_instance *mstp_row = NULL;
     int i = 0, j = 0;
 
+    memset(vid_to_mstid, MSTP_CISTID, MSTP_VID_TABLE_SIZE);
     if (!bridge_row) {
-        VLOG_DBG("Invalid arguments for mstp_util_get_mstid_for_vlanID %s: %d\n",
+        VLOG_DBG("Invalid arguments for mstp_util_get_vid_mstid_table %s: %d\n",
                 __FILE__, __LINE__);
         return e_vtysh_error;
     }
     /* Loop for all instance in bridge table */
     for (i=0; i < bridge_row->n_mstp_instances; i++) {
-        /* Loop for all vlans in one MST instance table */
-        for (j=0; j<bridge_row->value_mstp_instances[i]->n_vlans; j++) {
-            /* Return the instance ID if the VLAN exist in the instance*/
-            if(vlan_id == bridge_row->value_mstp_instances[i]->vlans[j]->id) {
-                return bridge_row->key_mstp_instances[i];
+        mstp_row = bridge_row->value_mstp_instances[i];
+        if (!mstp_row) {
+            continue;
+        }
+        /* Record the instance ID for all vlans in one MST instance table */
+        for (j=0; j < mstp_row->n_vlans; j++) {
+            if (mstp_row->vlans[j]->id > 0 &&
+                    mstp_row->vlans[j]->id < MSTP_VID_TABLE_SIZE) {
+                vid_to_mstid[mstp_row->vlans[j]->id] =
+                    bridge_row->key_mstp_instances[i];
             }
         }
     }
-    return MSTP_INVALID_ID;
+    return e_vtysh_ok;
 }
 
 /*-----------------------------------------------------------------------------
@@ -2364,6 +2372,7 @@ DEFUN(cli_mstp_inst_vlanid,
     struct range_list *temp_to_free, *temp_to_display, *list = NULL;
     const struct ovsrec_vlan *vlan_row = NULL;
     const struct ovsrec_bridge *bridge_row = NULL;
+    uint8_t vid_to_mstid[MSTP_VID_TABLE_SIZE];
     char *in = xmalloc ((strlen(argv[1]) + 1) * sizeof (char));
     strncpy(in, argv[1], strlen(argv[1]) + 1);
     list = cmd_get_range_value(in, 0);
@@ -2372,6 +2381,8 @@ DEFUN(cli_mstp_inst_vlanid,
         return CMD_ERR_NO_MATCH;
     temp_to_free = temp_to_display = list;
     START_DB_TXN(txn);
+    bridge_row = ovsrec_bridge_first(idl);
+    mstp_util_get_vid_mstid_table(bridge_row, vid_to_mstid);
     while (list != NULL)
     {
         vlan_id = list->value;
@@ -2411,10 +2422,8 @@ DEFUN(cli_mstp_inst_vlanid,
             }
 
             /* Check if the vlan is already mapped to another instance */
-            bridge_row = ovsrec_bridge_first(idl);
-            mstp_old_inst_id =
-                mstp_util_get_mstid_for_vlanID(vlan_row->id, bridge_row);
-            if (mstp_old_inst_id != MSTP_INVALID_ID) {
+            mstp_old_inst_id = vid_to_mstid[vlan_row->id];
+            if (mstp_old_inst_id != MSTP_CISTID) {
                 vty_out(vty, "Error : Vlan ID-%s is already mapped to other instance, aborting the VLAN's ",vlan_id);
                 while (temp_to_display->link != NULL)
                 {
@@ -2442,6 +2451,9 @@ DEFUN(cli_mstp_inst_vlanid,
             cli_do_config_abort(txn);
             return CMD_WARNING;
         }
+        if (vlanid < MSTP_VID_TABLE_SIZE) {
+            vid_to_mstid[vlanid] = atoi(argv[0]);
+        }
         list = list->link;
     }
     temp_to_free = cmd_free_memory_range_list(temp_to_free);
@@ -2467,6 +2479,7 @@ DEFUN(cli_no_mstp_inst_vlanid,
     const struct ovsrec_vlan *vlan_row = NULL;
     const struct ovsrec_mstp_instance *mstp_inst_row = NULL;
     const struct ovsrec_bridge *bridge_row = NULL;
+    uint8_t vid_to_mstid[MSTP_VID_TABLE_SIZE];
     char *in = xmalloc ((strlen(argv[1]) + 1) * sizeof (char));
     strncpy(in, argv[1], strlen(argv[1]) + 1);
     list = cmd_get_range_value(in, 0);
@@ -2475,6 +2488,8 @@ DEFUN(cli_no_mstp_inst_vlanid,
         return CMD_ERR_NO_MATCH;
     temp_to_free = temp_to_display = list;
     START_DB_TXN(txn);
+    bridge_row = ovsrec_bridge_first(idl);
+    mstp_util_get_vid_mstid_table(bridge_row, vid_to_mstid);
     while (list != NULL)
     {
         vlan_id = list->value;
@@ -2514,9 +2529,7 @@ DEFUN(cli_no_mstp_inst_vlanid,
             }
 
             /* Check if the vlan is already mapped to another instance */
-            bridge_row = ovsrec_bridge_first(idl);
-            mstp_old_inst_id =
-                mstp_util_get_mstid_for_vlanID(vlan_row->id, bridge_row);
+            mstp_old_inst_id = vid_to_mstid[vlan_row->id];
             if (mstp_old_inst_id != mstid) {
                 vty_out(vty, "Error : Vlan ID-%s is not mapped to this instance, aborting the VLAN's ",vlan_id);
                 while (temp_to_display->link != NULL)
@@ -2572,6 +2585,9 @@ DEFUN(cli_no_mstp_inst_vlanid,
             cli_do_config_abort(txn);
             return CMD_WARNING;
         }
+        if (vlanid < MSTP_VID_TABLE_SIZE) {
+            vid_to_mstid[vlanid] = MSTP_CISTID;
+        }
         list = list->link;
     }
     temp_to_free = cmd_free_memory_range_list(temp_to_free);
@@ -58,8 +58,13 @@
 
 #define SHIFT(X, s) (((X) << (s)) | ((X) >> (32 - (s))))
 
-#define F(X, Y, Z) (((X) & (Y)) | ((~X) & (Z)))
-#define G(X, Y, Z) (((X) & (Z)) | ((Y) & (~Z)))
+/*
+ * F and G in their select form: same truth tables as the textbook
+ * (X & Y) | (~X & Z) and (X & Z) | (Y & ~Z), one operation shorter and
+ * without the complement, which keeps the round dependency chain short.
+ */
+#define F(X, Y, Z) ((Z) ^ ((X) & ((Y) ^ (Z))))
+#define G(X, Y, Z) ((Y) ^ ((Z) & ((X) ^ (Y))))
 #define H(X, Y, Z) ((X) ^ (Y) ^ (Z))
 #define I(X, Y, Z) ((Y) ^ ((X) | (~Z)))
 
@@ -169,8 +174,13 @@ void md5_loop(md5_ctxt *ctxt, const void *vinput, uint len)
 	gap = MD5_BUFLEN - ctxt->md5_i;
 
 	if (len >= gap) {
-		memcpy (ctxt->md5_buf + ctxt->md5_i, input, gap);
-		md5_calc(ctxt->md5_buf, ctxt);
+		if (ctxt->md5_i == 0) {
+			/* Nothing buffered: hash whole blocks in place. */
+			gap = 0;
+		} else {
+			memcpy (ctxt->md5_buf + ctxt->md5_i, input, gap);
+			md5_calc(ctxt->md5_buf, ctxt);
+		}
 
 		for (i = gap; i + MD5_BUFLEN <= len; i += MD5_BUFLEN) {
 			md5_calc((input + i), ctxt);
@@ -244,6 +254,14 @@ static void md5_calc(const uint8_t *b64, md5_ctxt * ctxt)
 	uint32_t D = ctxt->md5_std;
 #if (BYTE_ORDER == LITTLE_ENDIAN)
 	const uint32_t *X = (const uint32_t *)b64;
+	uint32_t Xa[16];
+
+	/* md5_loop() hashes caller blocks in place, which need not be
+	 * word aligned; copy those so the rounds only do aligned loads. */
+	if ((uintptr_t)b64 & (sizeof(uint32_t) - 1)) {
+		memcpy(Xa, b64, sizeof(Xa));
+		X = Xa;
+	}
 #elif (BYTE_ORDER == BIG_ENDIAN)
 	uint32_t X[16];
 
@@ -313,21 +331,18 @@ static void md5_calc(const uint8_t *b64, md5_ctxt * ctxt)
 	ctxt->md5_std += D;
 }
 
-/* From RFC 2104 */
+/*
+ * Precompute the MD5 states after the inner and outer padded key blocks.
+ * Those two 64 byte blocks only depend on the key, so callers that sign
+ * many messages with the same key only pay for the message itself.
+ */
 void
-hmac_md5(text, text_len, key, key_len, digest)
-unsigned char*  text;			/* pointer to data stream */
-int             text_len;		/* length of data stream */
-unsigned char*  key;			/* pointer to authentication key */
-int             key_len;		/* length of authentication key */
-uint8_t *       digest;			/* caller digest to be filled in */
-
+hmac_md5_init_key(hmac_md5_ctxt *hctx, const unsigned char *key, int key_len)
 {
-    MD5_CTX context;
-    unsigned char k_ipad[65];    /* inner padding -
+    unsigned char k_ipad[64];    /* inner padding -
 				 * key XORd with ipad
 				 */
-    unsigned char k_opad[65];    /* outer padding -
+    unsigned char k_opad[64];    /* outer padding -
 				 * key XORd with opad
 				 */
     unsigned char tk[16];
@@ -367,21 +382,47 @@ uint8_t *       digest;			/* caller digest to be filled in */
        k_ipad[i] ^= 0x36;
        k_opad[i] ^= 0x5c;
     }
+
+    MD5Init(&hctx->hmac_ictx);
+    MD5Update(&hctx->hmac_ictx, k_ipad, 64);
+    MD5Init(&hctx->hmac_octx);
+    MD5Update(&hctx->hmac_octx, k_opad, 64);
+}
+
+/* HMAC-MD5 of 'text' with a key prepared by hmac_md5_init_key() */
+void
+hmac_md5_calc(const hmac_md5_ctxt *hctx, const unsigned char *text,
+              int text_len, uint8_t *digest)
+{
+    MD5_CTX context;
+
     /*
      * perform inner MD5
      */
-    MD5Init(&context);			/* init context for 1st
-					 * pass */
-    MD5Update(&context, k_ipad, 64);	/* start with inner pad */
+    context = hctx->hmac_ictx;		/* resume after inner pad */
     MD5Update(&context, text, text_len); /* then text of datagram */
     MD5Final(digest, &context);	/* finish up 1st pass */
     /*
      * perform outer MD5
      */
-    MD5Init(&context);			/* init context for 2nd
-					 * pass */
-    MD5Update(&context, k_opad, 64);	/* start with outer pad */
+    context = hctx->hmac_octx;		/* resume after outer pad */
     MD5Update(&context, digest, 16);	/* then results of 1st
 					 * hash */
     MD5Final(digest, &context);	/* finish up 2nd pass */
 }
+
+/* From RFC 2104 */
+void
+hmac_md5(text, text_len, key, key_len, digest)
+unsigned char*  text;			/* pointer to data stream */
+int             text_len;		/* length of data stream */
+unsigned char*  key;			/* pointer to authentication key */
+int             key_len;		/* length of authentication key */
+uint8_t *       digest;			/* caller digest to be filled in */
+
+{
+    hmac_md5_ctxt hctx;
+
+    hmac_md5_init_key(&hctx, key, key_len);
+    hmac_md5_calc(&hctx, text, text_len, digest);
+}
@@ -194,6 +194,7 @@ mstpd_init(const char *db_path, struct unixctl_server *appctl)
     unixctl_command_register("mstpd/daemon/mstp_debug_sm", "", 2, 2, mstpd_daemon_debug_sm_unixctl_list, NULL);
     unixctl_command_register("mstpd/daemon/mstp_digest", "", 0, 0, mstpd_daemon_digest_unixctl_list, NULL);
     unixctl_command_register("mstpd/daemon/intf_to_mstp_map", "", 0, 1, mstpd_daemon_intf_to_mstp_map_unixctl_list, NULL);
+    unixctl_command_register("mstpd/daemon/perf_stats", "", 0, 0, mstpd_daemon_perf_stats_unixctl_list, NULL);
 
     INIT_DIAG_DUMP_BASIC(mstpd_diag_dump_basic_cb);
 
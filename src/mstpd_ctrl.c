@@ -49,6 +49,11 @@ VLOG_DEFINE_THIS_MODULE(mstpd_ctrl);
  * Local functions prototypes (forward declarations)
  *---------------------------------------------------------------------------*/
 void mstp_checkDynReconfigChanges(void);
+void mstp_applyScopedReconfigChanges(void);
+static uint32_t mstp_getTreeFwdPorts(MSTID_t mstid, PORT_MAP *fwdPorts);
+static uint32_t mstp_countFwdTreePorts(void);
+static void mstp_applyLinkChanges(const PORT_MAP *up, const PORT_MAP *down);
+static void mstp_reuseFlapPorts(PORT_MAP *reuse);
 
 
 void
@@ -399,15 +404,24 @@ deregister_stp_mcast_addr(int lport)
 } /* deregister_stp_mcast_addr */
 
 
-/************************************************************************
- * MSTP Protocol Thread
- ************************************************************************/
-void *
-mstpd_protocol_thread(void *arg)
+/**PROC+***********************************************************
+ * Name:    mstpd_process_event
+ *
+ * Purpose:  Run the protocol for one event of the protocol thread queue.
+ *           Transmission is held until the event has been processed in
+ *           its entirety, the port state changes are then reported to
+ *           the DB.
+ *
+ * Params:    pmsg -> event, still owned by the caller
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+void
+mstpd_process_event(mstpd_message *pmsg)
 {
-    VLOG_DBG("MSTP Protocol thread");
-    mstpd_message *pmsg;
     mstp_lport_state_change *state;
+    mstp_lport_link_change *link_change;
     mstp_lport_add *l2port_add;
     mstp_lport_delete *l2port_delete;
     mstp_vlan_add *vlan_add;
@@ -415,93 +429,96 @@ mstpd_protocol_thread(void *arg)
     mstp_admin_status *status;
     MSTP_RX_PDU *pkt;
     bool informDB = TRUE;
+    bool txDeferred = FALSE;
     uint32_t vlan = 0;
     uint32_t lport = 0;
     char port[PORTNAME_LEN] = {0};
 
-    /* Detach thread to avoid memory leak upon exit. */
-    pthread_detach(pthread_self());
-    clear_port_map(&ports_up);
-    clear_port_map(&l2ports);
-    clear_port_map(&temp_l2ports);
-    mstp_Bridge.ForceVersion = MSTP_PROTOCOL_VERSION_ID_MST;
-    mstpInitialInit();
+    mstp_perfStats.events++;
 
-    VLOG_DBG("%s : waiting for events in the main loop", __FUNCTION__);
+    /* Anything but a timer tick or a BPDU may change how a received
+     * BPDU is classified, forget the BPDUs recorded so far. It may as
+     * well change configured parameters conveyed in the BPDUs sent,
+     * which the state machines do not mark per tree (see
+     * 'MSTP_TX_TREE_CHANGED') */
+    if((pmsg->msg_type != e_mstpd_timer) &&
+       (pmsg->msg_type != e_mstpd_rx_bpdu))
+    {
+        mstp_Bridge.rxInfoGen++;
+        mstp_Bridge.txInfoGen++;
+    }
 
-    /*******************************************************************
-     * The main receive loop.
-     *******************************************************************/
-    while (1) {
+    /* Hold BPDU transmission until the event has been processed in
+     * its entirety, each port then transmits its final information
+     * once instead of once per state machine that changed it */
+    clear_port_map(&mstp_Bridge.txEventLports);
+    txDeferred = MSTP_ENABLED;
+    if (txDeferred) {
+        mstp_preventTxOnBridge();
+    }
 
-        pmsg = mstpd_wait_for_next_event();
-        informDB = TRUE;
+    switch (pmsg->msg_type)
+    {
+        case e_mstpd_global_config:
+            update_mstp_global_config(pmsg);
+            VLOG_DBG("Received a Global Config Update");
+            break;
 
-        if (mstpd_shutdown) {
+        case e_mstpd_cist_config:
+            update_mstp_cist_config(pmsg);
+            VLOG_DBG("Received a CIST config Update");
             break;
-        }
 
-        if (!pmsg) {
-            VLOG_ERR("MSTPD protocol: Received NULL event!");
-            continue;
-        }
+        case e_mstpd_cist_port_config:
+            update_mstp_cist_port_config(pmsg);
+            VLOG_DBG("Received a CIST Port config Update");
+            break;
 
-        switch (pmsg->msg_type)
-        {
-            case e_mstpd_global_config:
-                update_mstp_global_config(pmsg);
-                VLOG_DBG("Received a Global Config Update");
-                break;
-
-            case e_mstpd_cist_config:
-                update_mstp_cist_config(pmsg);
-                VLOG_DBG("Received a CIST config Update");
-                break;
-
-            case e_mstpd_cist_port_config:
-                update_mstp_cist_port_config(pmsg);
-                VLOG_DBG("Received a CIST Port config Update");
-                break;
-
-            case e_mstpd_msti_config:
-                update_mstp_msti_config(pmsg);
-                VLOG_DBG("Received a MSTI config Update");
-                break;
-
-            case e_mstpd_msti_port_config:
-                update_mstp_msti_port_config(pmsg);
-                VLOG_DBG("Received a MSTI Port config Update");
-                break;
-
-            case e_mstpd_msti_config_delete:
-                delete_mstp_msti_config(pmsg);
-                VLOG_DBG("Received a MSTI config Update");
-                break;
-            case e_mstpd_vlan_add:
-                vlan = 0;
-                VLOG_DBG("%s: Received VLAN Add Event", __FUNCTION__);
-                vlan_add = (mstp_vlan_add *)pmsg->msg;
-                vlan = vlan_add->vid;
-                VLOG_DBG("Received an VLAN Add event: %d",vlan);
-                handle_vlan_add_in_mstp_config(vlan);
-                break;
-            case e_mstpd_vlan_delete:
-                vlan = 0;
-                VLOG_DBG("%s: Received VLAN Delete Event", __FUNCTION__);
-                vlan_delete = (mstp_vlan_delete *)pmsg->msg;
-                vlan = vlan_delete->vid;
-                VLOG_DBG("Received an VLAN Delete event: %d",vlan);
-                break;
-            case e_mstpd_lport_add:
-                VLOG_DBG("%s : Recieved lport add event", __FUNCTION__);
-                lport = 0;
-                l2port_add = (mstp_lport_add *)pmsg->msg;
-                lport = l2port_add->lportindex;
-                memset(port,0,PORTNAME_LEN);
-                set_port(&l2ports,lport);
-                intf_get_port_name(lport,port);
-                update_port_entry_in_cist_mstp_instances(port,e_mstpd_lport_add);
-                update_port_entry_in_msti_mstp_instances(port,e_mstpd_lport_add);
+        case e_mstpd_msti_config:
+            update_mstp_msti_config(pmsg);
+            VLOG_DBG("Received a MSTI config Update");
+            break;
+
+        case e_mstpd_msti_port_config:
+            update_mstp_msti_port_config(pmsg);
+            VLOG_DBG("Received a MSTI Port config Update");
+            break;
+
+        case e_mstpd_msti_config_delete:
+            delete_mstp_msti_config(pmsg);
+            VLOG_DBG("Received a MSTI config Update");
+            break;
+        case e_mstpd_vlan_add:
+            VLOG_DBG("%s: Received VLAN Add Event", __FUNCTION__);
+            vlan_add = (mstp_vlan_add *)pmsg->msg;
+            vlan = count_vids(&vlan_add->vids);
+            VLOG_DBG("Received an VLAN Add event: %d VLANs",vlan);
+            mstp_perfStats.vlanAddEvents++;
+            mstp_perfStats.vlanAddVids += vlan;
+            handle_vlan_add_in_mstp_config(&vlan_add->vids);
+            break;
+        case e_mstpd_vlan_delete:
+            VLOG_DBG("%s: Received VLAN Delete Event", __FUNCTION__);
+            vlan_delete = (mstp_vlan_delete *)pmsg->msg;
+            vlan = count_vids(&vlan_delete->vids);
+            VLOG_DBG("Received an VLAN Delete event: %d VLANs",vlan);
+            mstp_perfStats.vlanDelEvents++;
+            mstp_perfStats.vlanDelVids += vlan;
+            handle_vlan_delete_in_mstp_config(&vlan_delete->vids);
+            break;
+        case e_mstpd_lport_add:
+            VLOG_DBG("%s : Recieved lport add event", __FUNCTION__);
+            l2port_add = (mstp_lport_add *)pmsg->msg;
+            mstp_perfStats.lportAddEvents++;
+            mstp_perfStats.lportAddPorts +=
+                get_num_of_ports_set(&l2port_add->lports);
+            bit_or_port_maps(&l2port_add->lports, &l2ports);
+            /* Create the CIST/MSTI port rows for the whole set at once */
+            add_port_entries_in_mstp_instances(&l2port_add->lports);
+            for (lport = find_first_port_set(&l2port_add->lports);
+                    lport <= MAX_LPORTS;
+                    lport = find_next_port_set(&l2port_add->lports, lport))
+            {
                 update_mstp_on_lport_add(lport);
                 if (MSTP_ENABLED)
                 {
@@ -524,203 +541,252 @@ mstpd_protocol_thread(void *arg)
                         set_port(&temp_l2ports,lport);
                     }
                 }
-                break;
-            case e_mstpd_lport_delete:
-                VLOG_DBG("%s : Recieved lport delete event", __FUNCTION__);
-                lport = 0;
-                memset(port,0,PORTNAME_LEN);
-                l2port_delete = (mstp_lport_delete *)pmsg->msg;
-                lport = l2port_delete->lportindex;
-                strncpy(port,l2port_delete->lportname,PORTNAME_LEN);
-                VLOG_DBG("Received an l2port delete event : %d",lport);
-                clear_port(&l2ports,lport);
-                update_port_entry_in_cist_mstp_instances(port,e_mstpd_lport_delete);
-                update_port_entry_in_msti_mstp_instances(port,e_mstpd_lport_delete);
-                mstp_removeLport(lport);
-                if (MSTP_ENABLED)
-                {
-                    deregister_stp_mcast_addr(lport);
-                }
-                break;
-            case e_mstpd_lport_up:
-            case e_mstpd_lport_down:
-                /***********************************************************
-                 * Msg from OVSDB interface for lports.
-                 ***********************************************************/
-                if (pmsg->msg_type == e_mstpd_lport_up)
-                {
-                    uint16_t lport = 0;
-                    SPEED_DPLX    ports_cfg = {0};
-                    state = (mstp_lport_state_change *)pmsg->msg;
-                    lport = state->lportindex;
-                    intf_get_lport_speed_duplex(lport,&ports_cfg);
-                    if(MSTP_ENABLED)
-                    {
-                        MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
-
-                        if(commPortPtr)
-                        {
-                            /*------------------------------------------------------------
-                             * inform MSTP about 'Up' event for the port
-                             *------------------------------------------------------------*/
-                            mstp_portAutoDetectParamsSet(lport, &ports_cfg);
-                            mstp_portEnable(lport);
-                        }
-                    }
-                    else
-                    {
-                        /*---------------------------------------------------------------
-                         * MSTP is disabled, propagate port 'Up' state throughout
-                         * the system
-                         *---------------------------------------------------------------*/
-                        mstp_noStpPropagatePortUpState(lport);
-                    }
-
-                }
-                else if (pmsg->msg_type == e_mstpd_lport_down)
+            }
+            break;
+        case e_mstpd_lport_delete:
+            VLOG_DBG("%s : Recieved lport delete event", __FUNCTION__);
+            lport = 0;
+            memset(port,0,PORTNAME_LEN);
+            l2port_delete = (mstp_lport_delete *)pmsg->msg;
+            lport = l2port_delete->lportindex;
+            strncpy(port,l2port_delete->lportname,PORTNAME_LEN);
+            VLOG_DBG("Received an l2port delete event : %d",lport);
+            clear_port(&l2ports,lport);
+            update_port_entry_in_cist_mstp_instances(port,e_mstpd_lport_delete);
+            update_port_entry_in_msti_mstp_instances(port,e_mstpd_lport_delete);
+            mstp_removeLport(lport);
+            if (MSTP_ENABLED)
+            {
+                deregister_stp_mcast_addr(lport);
+            }
+            break;
+        case e_mstpd_lport_link_change:
+            /***********************************************************
+             * Msg from OVSDB interface with all the lports whose link
+             * went up or down in one reconfigure pass.
+             ***********************************************************/
+            link_change = (mstp_lport_link_change *)pmsg->msg;
+            VLOG_DBG("%s : Recieved link change event: %d up, %d down",
+                     __FUNCTION__,
+                     get_num_of_ports_set(&link_change->up),
+                     get_num_of_ports_set(&link_change->down));
+            mstp_perfStats.linkBatches++;
+            mstp_perfStats.linkBatchPorts +=
+                get_num_of_ports_set(&link_change->up) +
+                get_num_of_ports_set(&link_change->down);
+            mstp_applyLinkChanges(&link_change->up, &link_change->down);
+            break;
+        case e_mstpd_lport_speed_change:
+            /***********************************************************
+             * Msg from OVSDB interface for an lport that stays up but
+             * changed speed, e.g. a LAG member was added or removed.
+             ***********************************************************/
+            state = (mstp_lport_state_change *)pmsg->msg;
+            lport = state->lportindex;
+            VLOG_DBG("%s : Recieved lport %d speed change event",
+                     __FUNCTION__, lport);
+            mstp_perfStats.lportSpeedEvents++;
+            if(MSTP_ENABLED && MSTP_COMM_PORT_PTR(lport) &&
+               MSTP_COMM_PORT_IS_BIT_SET(MSTP_COMM_PORT_PTR(lport)->bitMap,
+                                         MSTP_PORT_PORT_ENABLED))
+            {
+                SPEED_DPLX    ports_cfg = {0};
+                intf_get_lport_speed_duplex(lport,&ports_cfg);
+                if(mstp_portSpeedChange(lport, &ports_cfg))
+                    mstp_perfStats.lportSpeedCostChgs++;
+            }
+            break;
+        case e_mstpd_lport_mac_change:
+            /***********************************************************
+             * Msg from OVSDB interface for an lport whose MAC address
+             * changed, e.g. the first member of a LAG was removed.
+             ***********************************************************/
+            state = (mstp_lport_state_change *)pmsg->msg;
+            lport = state->lportindex;
+            VLOG_DBG("%s : Recieved lport %d MAC change event",
+                     __FUNCTION__, lport);
+            mstp_txBpduTemplateReset(lport);
+            break;
+        case e_mstpd_admin_status:
+            VLOG_DBG("%s : Admin Status Update", __FUNCTION__);
+            status = (mstp_admin_status *)pmsg->msg;
+            if (status->status == true)
+            {
+                mstp_enable = true;
+                uint16_t port = 0;
+                for (port = find_first_port_set(&l2ports);
+                        port > 0 && port <= MAX_LPORTS;
+                        port = find_next_port_set(&l2ports, port))
                 {
-                    uint16_t lport = 0;
-                    state = (mstp_lport_state_change *)pmsg->msg;
-                    lport = state->lportindex;
-                    if(MSTP_ENABLED)
+                    /*Trying to register a socket*/
+                    if(register_stp_mcast_addr(port) != -1)
                     {
-                        MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
-                        if(commPortPtr)
+                        if(is_port_set(&temp_l2ports,port))
                         {
-                            /*------------------------------------------------------------
-                             * MSTP is enabled, inform it about 'Down' event for the port
-                             *------------------------------------------------------------*/
-                            mstp_portDisable(lport);
+                            clear_port(&temp_l2ports,port);
                         }
                     }
                     else
                     {
-                        /*---------------------------------------------------------------
-                         * MSTP is disabled, propagate port 'Down' state throughout
-                         * the system
-                         *---------------------------------------------------------------*/
-                        mstp_noStpPropagatePortDownState(lport);
+                        /*Unable to register a socket, making a note of the port so that
+                         * we can try to re-attempt in timer tick operation*/
+                        set_port(&temp_l2ports,port);
                     }
-
                 }
-                break;
-            case e_mstpd_admin_status:
-                VLOG_DBG("%s : Admin Status Update", __FUNCTION__);
-                status = (mstp_admin_status *)pmsg->msg;
-                if (status->status == true)
+            }
+            else
+            {
+                mstp_enable = false;
+                uint16_t port = 0;
+                for (port = find_first_port_set(&l2ports);
+                        port > 0 && port <= MAX_LPORTS;
+                        port = find_next_port_set(&l2ports, port))
                 {
-                    mstp_enable = true;
-                    uint16_t port = 0;
-                    for (port = find_first_port_set(&l2ports);
-                            port > 0 && port <= MAX_LPORTS;
-                            port = find_next_port_set(&l2ports, port))
-                    {
-                        /*Trying to register a socket*/
-                        if(register_stp_mcast_addr(port) != -1)
-                        {
-                            if(is_port_set(&temp_l2ports,port))
-                            {
-                                clear_port(&temp_l2ports,port);
-                            }
-                        }
-                        else
-                        {
-                            /*Unable to register a socket, making a note of the port so that
-                             * we can try to re-attempt in timer tick operation*/
-                            set_port(&temp_l2ports,port);
-                        }
-                    }
+                    deregister_stp_mcast_addr(port);
                 }
-                else
-                {
-                    mstp_enable = false;
-                    uint16_t port = 0;
-                    for (port = find_first_port_set(&l2ports);
-                            port > 0 && port <= MAX_LPORTS;
-                            port = find_next_port_set(&l2ports, port))
-                    {
-                        deregister_stp_mcast_addr(port);
-                    }
 
-                }
-                mstp_adminStatusUpdate(mstp_enable);
-                break;
-            case e_mstpd_timer:
-                /***********************************************************
-                 * Msg from MSTP timers.
-                 ***********************************************************/
-                if (MSTP_ENABLED && are_any_ports_set(&temp_l2ports))
+            }
+            mstp_adminStatusUpdate(mstp_enable);
+            break;
+        case e_mstpd_timer:
+            /***********************************************************
+             * Msg from MSTP timers.
+             ***********************************************************/
+            if (MSTP_ENABLED && are_any_ports_set(&temp_l2ports))
+            {
+                uint16_t lport = 0;
+                for (lport = find_first_port_set(&temp_l2ports);
+                        lport > 0 && lport <= MAX_LPORTS;
+                        lport = find_next_port_set(&temp_l2ports, lport))
                 {
-                    uint16_t lport = 0;
-                    for (lport = find_first_port_set(&temp_l2ports);
-                            lport > 0 && lport <= MAX_LPORTS;
-                            lport = find_next_port_set(&temp_l2ports, lport))
+                    /* Try to register a socket, clear the port if successful*/
+                    if (register_stp_mcast_addr(lport) != -1)
                     {
-                        /* Try to register a socket, clear the port if successful*/
-                        if (register_stp_mcast_addr(lport) != -1)
+                        mstp_addLport(lport);
+                        if(!is_lport_down(lport))
                         {
-                            mstp_addLport(lport);
-                            if(!is_lport_down(lport))
-                            {
-                                SPEED_DPLX    ports_cfg = {0};
-                                intf_get_lport_speed_duplex(lport,&ports_cfg);
-                                mstp_portAutoDetectParamsSet(lport, &ports_cfg);
-                                mstp_portEnable(lport);
-                            }
-                            clear_port(&temp_l2ports,lport);
+                            SPEED_DPLX    ports_cfg = {0};
+                            intf_get_lport_speed_duplex(lport,&ports_cfg);
+                            mstp_portAutoDetectParamsSet(lport, &ports_cfg);
+                            mstp_portEnable(lport);
                         }
+                        clear_port(&temp_l2ports,lport);
                     }
                 }
-                if(MSTP_ENABLED)
-                {
-                    mstp_processTimerTickEvent();
-                }
-                VLOG_DBG("%s : Recieved one sec timer tick event", __FUNCTION__);
-                break;
-            case e_mstpd_rx_bpdu:
-                pkt = (MSTP_RX_PDU *)pmsg->msg;
-                /***********************************************************
-                 * Packet has arrived through interface socket.
-                 ************************************************************/
-                VLOG_DBG("%s : MSTP BPDU Packet arrived from interface socket",
-                        __FUNCTION__);
-                if(MSTP_ENABLED)
-                {
-                    MSTP_PKT_TYPE_t pktType;
-                    pktType = mstp_decodeBpdu(pkt);
-                    VLOG_DBG("%d : MSTP BPDU Packet arrived from interface socket", pktType);
-                    switch (pktType) {
-                        case MSTP_UNAUTHORIZED_BPDU_DATA_PKT:
-                            mstp_processUnauthorizedBpdu(pkt, BPDU_PROTECTION);
-                            break;
-
-                        case MSTP_ERRANT_PROTOCOL_DATA_PKT:
-                            mstp_errantProtocolData(pkt, BPDU_FILTER);
-                            break;
-
-                        case MSTP_PROTOCOL_DATA_PKT:
-                            mstp_protocolData(pkt);
-                            informDB = FALSE; /*Call already made in mstp_protocolData*/
-                            break;
-
-                        case MSTP_INVALID_PKT:
-                            break;
-
-                        default:
-                            STP_ASSERT(0);
-                            break;
-                    }
+            }
+            if(MSTP_ENABLED)
+            {
+                PORT_MAP reuse;
+
+                mstp_processTimerTickEvent();
+                mstp_flapDampTick(&reuse);
+                mstp_reuseFlapPorts(&reuse);
+            }
+            VLOG_DBG("%s : Recieved one sec timer tick event", __FUNCTION__);
+            break;
+        case e_mstpd_db_resync:
+            /***********************************************************
+             * OVSDB session was re-established, the config caches have
+             * already been reconciled. Push the current port states
+             * back without touching the protocol.
+             ***********************************************************/
+            VLOG_DBG("%s : Recieved DB resync event", __FUNCTION__);
+            mstp_perfStats.dbResyncs++;
+            if(MSTP_ENABLED)
+            {
+                mstp_republishPortStates();
+            }
+            break;
+        case e_mstpd_rx_bpdu:
+            pkt = (MSTP_RX_PDU *)pmsg->msg;
+            /***********************************************************
+             * Packet has arrived through interface socket.
+             ************************************************************/
+            VLOG_DBG("%s : MSTP BPDU Packet arrived from interface socket",
+                    __FUNCTION__);
+            if(MSTP_ENABLED)
+            {
+                MSTP_PKT_TYPE_t pktType;
+                pktType = mstp_decodeBpdu(pkt);
+                VLOG_DBG("%d : MSTP BPDU Packet arrived from interface socket", pktType);
+                switch (pktType) {
+                    case MSTP_UNAUTHORIZED_BPDU_DATA_PKT:
+                        mstp_processUnauthorizedBpdu(pkt, BPDU_PROTECTION);
+                        break;
+
+                    case MSTP_ERRANT_PROTOCOL_DATA_PKT:
+                        mstp_errantProtocolData(pkt, BPDU_FILTER);
+                        break;
+
+                    case MSTP_PROTOCOL_DATA_PKT:
+                        mstp_protocolData(pkt);
+                        informDB = FALSE; /*Call already made in mstp_protocolData*/
+                        break;
+
+                    case MSTP_INVALID_PKT:
+                        break;
+
+                    default:
+                        STP_ASSERT(0);
+                        break;
                 }
-                break;
-            default:
-                VLOG_ERR("%s : message from unknown sender",
-                     __FUNCTION__);
+            }
+            break;
+        default:
+            VLOG_ERR("%s : message from unknown sender",
+                 __FUNCTION__);
+    }
+
+    mstp_applyScopedReconfigChanges();
+    if (informDB) {
+        mstp_informDBOnPortStateChange(pmsg->msg_type);
+    }
+    /* The lock is gone if the event re-initialized or disabled MSTP */
+    if (txDeferred && MSTP_ENABLED && (mstp_Bridge.preventTx > 0)) {
+        mstp_doPendingTxOnBridge();
+    }
+    mstp_checkDynReconfigChanges();
+
+    mstp_perfStats.activePortIters += mstp_activePortIters;
+    mstp_activePortIters = 0;
+} /* mstpd_process_event */
+
+/************************************************************************
+ * MSTP Protocol Thread
+ ************************************************************************/
+void *
+mstpd_protocol_thread(void *arg)
+{
+    VLOG_DBG("MSTP Protocol thread");
+    mstpd_message *pmsg;
+
+    /* Detach thread to avoid memory leak upon exit. */
+    pthread_detach(pthread_self());
+    clear_port_map(&ports_up);
+    clear_port_map(&l2ports);
+    clear_port_map(&temp_l2ports);
+    mstp_Bridge.ForceVersion = MSTP_PROTOCOL_VERSION_ID_MST;
+    mstpInitialInit();
+
+    VLOG_DBG("%s : waiting for events in the main loop", __FUNCTION__);
+
+    /*******************************************************************
+     * The main receive loop.
+     *******************************************************************/
+    while (1) {
+
+        pmsg = mstpd_wait_for_next_event();
+
+        if (mstpd_shutdown) {
+            break;
         }
 
-        if (informDB) {
-            mstp_informDBOnPortStateChange(pmsg->msg_type);
+        if (!pmsg) {
+            VLOG_ERR("MSTPD protocol: Received NULL event!");
+            continue;
         }
-        mstp_checkDynReconfigChanges();
+
+        mstpd_process_event(pmsg);
 
         mstpd_event_free(pmsg);
 
@@ -808,6 +874,7 @@ mstp_processTimerTickEvent()
    MSTP_COMM_PORT_INFO_t *commPortPtr;
    LPORT_t                lport;
    char  lport_name[PORTNAME_LEN];
+   struct timeval         start;
 
    if(MSTP_ENABLED == false)
    {
@@ -818,10 +885,12 @@ mstp_processTimerTickEvent()
        *---------------------------------------------------------------------*/
       return;
    }
+   mstp_perfStats.timerTicks++;
+   gettimeofday(&start, NULL);
    /*------------------------------------------------------------------------
     * run Port Timers state machine for every active Port
     *------------------------------------------------------------------------*/
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       commPortPtr = MSTP_COMM_PORT_PTR(lport);
       if(commPortPtr)
@@ -867,6 +936,7 @@ mstp_processTimerTickEvent()
          }
       }
    }
+   mstp_perfStats.tickUsec += mstp_perfElapsedUsec(&start);
 }
 
 /** ======================================================================= **
@@ -887,9 +957,14 @@ mstp_processTimerTickEvent()
  *                  c) Port Identifier Priority (CIST | MSTI)
  *                  d) Port Path Cost (CIST | MSTI)
  *                  (P802.1D/D1 17.13)
+ *                  Items b), c) and d) are applied in place instead, see
+ *                  'mstp_applyScopedReconfigChanges'.
+ *                  MstConfigId (configName, revisionLevel, digest) changes
+ *                  are applied in place as well, see
+ *                  'mstp_applyRegionReconfigChange'.
  *                  In the current MSTP implementation the following dynamic
  *                  reconfiguration changes also cause MSTP re-initialization:
- *                  - MstConfigId (configName, revisionLevel, digest)
+ *                  - VIDs mapped to a new MSTI
  *                  - 'restrictedRole' per-port parameter change
  *
  *
@@ -915,6 +990,8 @@ mstp_checkDynReconfigChanges(void)
    }
 
    MSTP_DYN_CFG_PRINTF("!DYN RECONFIG: %s", "start");
+   mstp_perfStats.reconfigFull++;
+   mstp_perfStats.reconfigFwdDrops += mstp_countFwdTreePorts();
    Spanning = false;
 
    /*------------------------------------------------------------------------
@@ -945,6 +1022,326 @@ mstp_checkDynReconfigChanges(void)
    MSTP_DYN_CFG_PRINTF("!DYN RECONFIG: %s", "end");
 }
 
+/**PROC+**********************************************************************
+ * Name:      mstp_applyLinkChanges
+ *
+ * Purpose:   Apply the link state changes of one reconfigure pass as a
+ *            batch: ports go down first, then up, with Port Role Selection
+ *            held so each tree runs it once for the whole batch. Link ups
+ *            of ports suppressed by flap dampening are ignored, the port
+ *            is enabled when it is released (see 'mstp_reuseFlapPorts').
+ *
+ * Params:    up   -> ports whose link came up
+ *            down -> ports whose link went down
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_applyLinkChanges(const PORT_MAP *up, const PORT_MAP *down)
+{
+   MSTP_COMM_PORT_INFO_t *commPortPtr;
+   PORT_MAP               enabled;
+   LPORT_t                lport;
+
+   if(MSTP_ENABLED == false)
+   {
+      /*---------------------------------------------------------------------
+       * MSTP is disabled, propagate port state throughout the system
+       *---------------------------------------------------------------------*/
+      for(lport = (LPORT_t)find_first_port_set(down); IS_VALID_LPORT(lport);
+          lport = (LPORT_t)find_next_port_set(down, lport))
+         mstp_noStpPropagatePortDownState(lport);
+      for(lport = (LPORT_t)find_first_port_set(up); IS_VALID_LPORT(lport);
+          lport = (LPORT_t)find_next_port_set(up, lport))
+         mstp_noStpPropagatePortUpState(lport);
+      return;
+   }
+
+   clear_port_map(&enabled);
+   mstp_holdPrs();
+
+   for(lport = (LPORT_t)find_first_port_set(down); IS_VALID_LPORT(lport);
+       lport = (LPORT_t)find_next_port_set(down, lport))
+   {
+      if(!MSTP_COMM_PORT_PTR(lport))
+         continue;
+
+      mstp_flapDampLinkDown(lport);
+      mstp_portDisable(lport);
+   }
+
+   for(lport = (LPORT_t)find_first_port_set(up); IS_VALID_LPORT(lport);
+       lport = (LPORT_t)find_next_port_set(up, lport))
+   {
+      SPEED_DPLX ports_cfg = {0};
+
+      commPortPtr = MSTP_COMM_PORT_PTR(lport);
+      if(!commPortPtr)
+         continue;
+
+      if(commPortPtr->flapSuppressed)
+      {
+         commPortPtr->flapIgnoredUps++;
+         mstp_perfStats.flapIgnoredUps++;
+         continue;
+      }
+
+      intf_get_lport_speed_duplex(lport, &ports_cfg);
+      mstp_portAutoDetectParamsSet(lport, &ports_cfg);
+      mstp_portEnable(lport);
+      set_port(&enabled, lport);
+   }
+
+   mstp_releasePrs(&enabled);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_reuseFlapPorts
+ *
+ * Purpose:   Enable the ports released from flap suppression whose link
+ *            is up, as one batch.
+ *
+ * Params:    reuse -> ports released from suppression, modified
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_reuseFlapPorts(PORT_MAP *reuse)
+{
+   PORT_MAP none;
+   LPORT_t  lport;
+
+   for(lport = (LPORT_t)find_first_port_set(reuse); IS_VALID_LPORT(lport);
+       lport = (LPORT_t)find_next_port_set(reuse, lport))
+   {
+      if(is_lport_down(lport))
+         clear_port(reuse, lport);
+   }
+
+   if(!are_any_ports_set(reuse))
+      return;
+
+   clear_port_map(&none);
+   mstp_applyLinkChanges(reuse, &none);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_getTreeFwdPorts
+ *
+ * Purpose:   Collect the ports that are Forwarding on the given tree.
+ *
+ * Params:    mstid    -> MST Instance Identifier (the CIST or an MSTI)
+ *            fwdPorts -> filled with the Forwarding ports
+ *
+ * Returns:   number of Forwarding ports
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static uint32_t
+mstp_getTreeFwdPorts(MSTID_t mstid, PORT_MAP *fwdPorts)
+{
+   LPORT_t  lport;
+   uint32_t cnt = 0;
+
+   clear_port_map(fwdPorts);
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
+   {
+      bool fwd;
+
+      if(mstid == MSTP_CISTID)
+         fwd = MSTP_CIST_PORT_PTR(lport) &&
+               MSTP_CIST_PORT_IS_BIT_SET(MSTP_CIST_PORT_PTR(lport)->bitMap,
+                                         MSTP_CIST_PORT_FORWARDING);
+      else
+         fwd = MSTP_MSTI_PORT_PTR(mstid, lport) &&
+               MSTP_MSTI_PORT_IS_BIT_SET(MSTP_MSTI_PORT_PTR(mstid,
+                                                            lport)->bitMap,
+                                         MSTP_MSTI_PORT_FORWARDING);
+      if(fwd)
+      {
+         set_port(fwdPorts, lport);
+         cnt++;
+      }
+   }
+   return cnt;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_countFwdTreePorts
+ *
+ * Purpose:   Count the (tree, port) pairs that are Forwarding, i.e. what a
+ *            full protocol re-initialization takes out of forwarding.
+ *
+ * Params:    none
+ *
+ * Returns:   number of Forwarding tree ports
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static uint32_t
+mstp_countFwdTreePorts(void)
+{
+   PORT_MAP fwdPorts;
+   MSTID_t  mstid;
+   uint32_t cnt = 0;
+
+   if(MSTP_CIST_VALID)
+      cnt += mstp_getTreeFwdPorts(MSTP_CISTID, &fwdPorts);
+   for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_INSTANCES_MAX; mstid++)
+   {
+      if(MSTP_MSTI_VALID(mstid))
+         cnt += mstp_getTreeFwdPorts(mstid, &fwdPorts);
+   }
+   return cnt;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_applyRegionReconfigChange
+ *
+ * Purpose:   Apply a MST Configuration Identifier change recorded by
+ *            'mstp_setRegionReconfig'. The new digest is already in place,
+ *            the BPDUs received from now on are all decoded against it, and
+ *            the ports whose last BPDU moves them across the Region boundary
+ *            are counted.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_applyRegionReconfigChange(void)
+{
+   LPORT_t lport;
+
+   if(!mstp_Bridge.rgnReconfig)
+      return;
+   mstp_Bridge.rgnReconfig = FALSE;
+
+   if((MSTP_ENABLED == false) || MSTP_DYN_RECONFIG_CHANGE || MSTP_BEGIN)
+      return;
+
+   mstp_perfStats.rgnReconfigs++;
+
+   /*------------------------------------------------------------------------
+    * BPDUs decoded against the former identifier can not be taken for
+    * repeated ones anymore.
+    *------------------------------------------------------------------------*/
+   mstp_Bridge.rxInfoGen++;
+
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
+   {
+      if(mstp_reevalPortRegion(lport))
+         mstp_perfStats.rgnBoundaryChgs++;
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_applyScopedReconfigChanges
+ *
+ * Purpose:   Apply Bridge Identifier Priority, Port Identifier Priority and
+ *            Port Path Cost changes recorded by 'mstp_setScopedReconfig',
+ *            after a MST Configuration Identifier change, if any.
+ *            Only the trees they belong to run Port Role Selection, the
+ *            other trees and the ports whose role does not change keep
+ *            forwarding. Ports at the Region boundary follow their new CIST
+ *            role on every MSTI, as 'mstp_syncMstiPortsWithCist' does for
+ *            received BPDUs.
+ *            Nothing is done while a full re-initialization is pending, it
+ *            covers these changes as well.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_applyScopedReconfigChanges(void)
+{
+   PORT_MAP before;
+   PORT_MAP after;
+   MSTID_t  mstid;
+   LPORT_t  lport;
+   int      bit;
+
+   mstp_applyRegionReconfigChange();
+
+   if(!areAnyBitsSetInBitmap(mstp_Bridge.reconfigTrees.map,
+                             MSTP_ROLES_DIRTY_MAP_BITS))
+   {
+      return;
+   }
+
+   if((MSTP_ENABLED == false) || MSTP_DYN_RECONFIG_CHANGE || MSTP_BEGIN)
+   {
+      clearBitmap(mstp_Bridge.reconfigTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
+      return;
+   }
+
+   if(isBitSet(mstp_Bridge.reconfigTrees.map, MSTP_CISTID + 1,
+               MSTP_ROLES_DIRTY_MAP_BITS) && MSTP_CIST_VALID)
+   {
+      mstp_getTreeFwdPorts(MSTP_CISTID, &before);
+      mstp_prsSm(MSTP_CISTID);
+      mstp_getTreeFwdPorts(MSTP_CISTID, &after);
+      bit_sub_port_maps(&after, &before);
+      mstp_perfStats.reconfigFwdDrops += get_num_of_ports_set(&before);
+      mstp_perfStats.reconfigScoped++;
+
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
+      {
+         if(MSTP_COMM_PORT_PTR(lport) &&
+            !MSTP_COMM_PORT_IS_BIT_SET(MSTP_COMM_PORT_PTR(lport)->bitMap,
+                                       MSTP_PORT_RCVD_INTERNAL))
+         {
+            for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_INSTANCES_MAX; mstid++)
+            {
+               if(MSTP_MSTI_VALID(mstid))
+                  mstp_setScopedReconfig(mstid, lport);
+            }
+         }
+      }
+   }
+
+   for(bit = findNextBitSet(mstp_Bridge.reconfigTrees.map, MSTP_CISTID + 1,
+                            MSTP_ROLES_DIRTY_MAP_BITS);
+       bit > 0;
+       bit = findNextBitSet(mstp_Bridge.reconfigTrees.map, bit,
+                            MSTP_ROLES_DIRTY_MAP_BITS))
+   {
+      mstid = (MSTID_t)(bit - 1);
+      if(!MSTP_MSTI_VALID(mstid))
+         continue;
+
+      mstp_getTreeFwdPorts(mstid, &before);
+      mstp_prsSm(mstid);
+      mstp_getTreeFwdPorts(mstid, &after);
+      bit_sub_port_maps(&after, &before);
+      mstp_perfStats.reconfigFwdDrops += get_num_of_ports_set(&before);
+      mstp_perfStats.reconfigScoped++;
+   }
+
+   clearBitmap(mstp_Bridge.reconfigTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
+}
+
 /**PROC+**********************************************************************
  * Name:      update_mstp_global_config
  *
@@ -970,19 +1367,32 @@ void update_mstp_global_config(mstpd_message *pmsg)
         memset(mstp_Bridge.MstConfigId.configName, 0, MSTP_MST_CONFIG_NAME_LEN);
         memcpy(mstp_Bridge.MstConfigId.configName, global_config->config_name,
                 MSTP_MST_CONFIG_NAME_LEN);
-        if (MSTP_ENABLED)
-        {
-            MSTP_DYN_RECONFIG_CHANGE = TRUE;
-        }
+        mstp_setRegionReconfig();
     }
     if(mstp_Bridge.MstConfigId.revisionLevel != global_config->config_revision)
     {
         mstp_Bridge.MstConfigId.revisionLevel = global_config->config_revision;
-        if (MSTP_ENABLED)
-        {
-            MSTP_DYN_RECONFIG_CHANGE = TRUE;
-        }
+        mstp_setRegionReconfig();
     }
+    if(mstp_Bridge.flapDampEnabled && !global_config->flap_dampening)
+    {
+        PORT_MAP reuse;
+
+        mstp_flapDampReset(&reuse);
+        if(MSTP_ENABLED)
+            mstp_reuseFlapPorts(&reuse);
+    }
+    /* 'mstp_global_config_update' bounds the thresholds, the penalty
+     * ceiling and the half-life decay depend on it */
+    STP_ASSERT((global_config->flap_suppress <= MAX_FLAP_SUPPRESS) &&
+               (global_config->flap_penalty <= MAX_FLAP_PENALTY));
+    STP_ASSERT((global_config->flap_half_life != 0) &&
+               (global_config->flap_half_life <= MAX_FLAP_HALF_LIFE));
+    mstp_Bridge.flapDampEnabled = global_config->flap_dampening;
+    mstp_Bridge.flapPenalty = global_config->flap_penalty;
+    mstp_Bridge.flapSuppress = global_config->flap_suppress;
+    mstp_Bridge.flapReuse = global_config->flap_reuse;
+    mstp_Bridge.flapHalfLife = global_config->flap_half_life;
     VLOG_DBG("Config Change in GLOBAL: %d", MSTP_DYN_RECONFIG_CHANGE);
 }
 /**PROC+**********************************************************************
@@ -1020,7 +1430,8 @@ void update_mstp_cist_config(mstpd_message *pmsg)
                 cist_config->priority * PRIORITY_MULTIPLIER);
         if (MSTP_ENABLED)
         {
-            MSTP_DYN_RECONFIG_CHANGE = TRUE;
+            mstp_updtBridgePriorityVector(MSTP_CISTID);
+            mstp_setScopedReconfig(MSTP_CISTID, 0);
         }
     }
 
@@ -1042,7 +1453,7 @@ void update_mstp_cist_config(mstpd_message *pmsg)
         {
             LPORT_t lport;
 
-            for(lport = 1; lport <= MAX_LPORTS; lport ++)
+            MSTP_FOR_EACH_ACTIVE_LPORT(lport)
             {
                 if(MSTP_CIST_PORT_PTR(lport))
                 {
@@ -1073,7 +1484,7 @@ void update_mstp_cist_config(mstpd_message *pmsg)
          *       active topology. But we need propagate the new value down
          *       the tree if this switch is the CIST Root.
          *------------------------------------------------------------------*/
-        for(lport = 1; lport <= MAX_LPORTS; lport ++)
+        MSTP_FOR_EACH_ACTIVE_LPORT(lport)
         {
             if(MSTP_COMM_PORT_PTR(lport))
             {
@@ -1117,7 +1528,7 @@ void update_mstp_cist_config(mstpd_message *pmsg)
 
             MSTP_CIST_ROOT_TIMES.maxAge = mstp_Bridge.MaxAge;
 
-            for(lport = 1; lport <= MAX_LPORTS; lport ++)
+            MSTP_FOR_EACH_ACTIVE_LPORT(lport)
             {
                 if(MSTP_CIST_PORT_PTR(lport))
                 {
@@ -1155,7 +1566,7 @@ void update_mstp_cist_config(mstpd_message *pmsg)
             {
                 LPORT_t lport;
 
-                for(lport = 1; lport <= MAX_LPORTS; lport ++)
+                MSTP_FOR_EACH_ACTIVE_LPORT(lport)
                 {
                     if(MSTP_CIST_PORT_PTR(lport))
                     {
@@ -1232,6 +1643,7 @@ void update_mstp_cist_port_config(mstpd_message *pmsg)
              *------------------------------------------------------------------*/
             MSTP_COMM_PORT_PTR(lport) = (MSTP_COMM_PORT_INFO_t *)malloc(sizeof(MSTP_COMM_PORT_INFO_t));
             memset(MSTP_COMM_PORT_PTR(lport), 0,sizeof(MSTP_COMM_PORT_INFO_t));
+            set_port(&mstp_Bridge.activeLports, lport);
         }
         commPortPtr = MSTP_COMM_PORT_PTR(lport);
         if(!MSTP_CIST_PORT_PTR(lport))
@@ -1240,6 +1652,7 @@ void update_mstp_cist_port_config(mstpd_message *pmsg)
              * Allocate memory to keep CIST port's data
              *------------------------------------------------------------------*/
             MSTP_CIST_PORT_PTR(lport) = (MSTP_CIST_PORT_INFO_t *)calloc(1, sizeof(MSTP_CIST_PORT_INFO_t));
+            MSTP_PORT_HOT_BIND(MSTP_CIST_PORT_PTR(lport), MSTP_CISTID, lport);
         }
         cistPortPtr = MSTP_CIST_PORT_PTR(lport);
         MSTP_SET_PORT_NUM(cistPortPtr->portId,lport);
@@ -1258,8 +1671,8 @@ void update_mstp_cist_port_config(mstpd_message *pmsg)
             if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                         MSTP_PORT_PORT_ENABLED) && MSTP_ENABLED)
             {/* Port is 'Enabled' and the path cost value has changed,
-              * indicate that protocol re-initialization is required */
-                MSTP_DYN_RECONFIG_CHANGE = TRUE;
+              * the CIST reselects the port's role */
+                mstp_setScopedReconfig(MSTP_CISTID, lport);
             }
         }
         if (commPortPtr->ExternalPortPathCost != path_cost)
@@ -1268,8 +1681,8 @@ void update_mstp_cist_port_config(mstpd_message *pmsg)
             if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                         MSTP_PORT_PORT_ENABLED) && MSTP_ENABLED)
             {/* Port is 'Enabled' and the path cost value has changed,
-              * indicate that protocol re-initialization is required */
-                MSTP_DYN_RECONFIG_CHANGE = TRUE;
+              * the CIST reselects the port's role */
+                mstp_setScopedReconfig(MSTP_CISTID, lport);
             }
         }
         MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_MCHECK);
@@ -1316,8 +1729,8 @@ void update_mstp_cist_port_config(mstpd_message *pmsg)
             if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                         MSTP_PORT_PORT_ENABLED) && MSTP_ENABLED)
             {/* Port is 'Enabled' and the priority value has changed,
-              * indicate that protocol re-initialization is required */
-                MSTP_DYN_RECONFIG_CHANGE = TRUE;
+              * the CIST reselects the port's role */
+                mstp_setScopedReconfig(MSTP_CISTID, lport);
             }
         }
 
@@ -1577,7 +1990,15 @@ void update_mstp_msti_config(mstpd_message *pmsg)
     if (mstp_updateMstiVidMapping(msti_data->mstid,msti_data->vlans) && MSTP_ENABLED)
     {
         mstp_buildMstConfigurationDigest(mstp_Bridge.MstConfigId.digest);
-        MSTP_DYN_RECONFIG_CHANGE = TRUE;
+        /*------------------------------------------------------------------
+         * Port roles do not depend on the VIDs an MSTI carries, so moving
+         * VIDs between running trees only changes the digest. A new MSTI
+         * still needs its state machines started by re-initialization.
+         *------------------------------------------------------------------*/
+        if (MSTP_MSTI_INFO(mstid)->valid)
+            mstp_setRegionReconfig();
+        else
+            MSTP_DYN_RECONFIG_CHANGE = TRUE;
     }
     if(MSTP_GET_BRIDGE_PRIORITY(MSTP_MSTI_BRIDGE_IDENTIFIER(mstid)) !=
             msti_data->priority * PRIORITY_MULTIPLIER)
@@ -1586,10 +2007,11 @@ void update_mstp_msti_config(mstpd_message *pmsg)
                 msti_data->priority * PRIORITY_MULTIPLIER);
         if (MSTP_ENABLED)
         {
-            MSTP_DYN_RECONFIG_CHANGE = TRUE;
+            mstp_updtBridgePriorityVector(mstid);
+            mstp_setScopedReconfig(mstid, 0);
         }
     }
-    for (lport = 1; lport <= MAX_LPORTS; lport++ )
+    MSTP_FOR_EACH_ACTIVE_LPORT(lport)
     {
         uint32_t path_cost = 0;
         commPortPtr = MSTP_COMM_PORT_PTR(lport);
@@ -1608,6 +2030,16 @@ void update_mstp_msti_config(mstpd_message *pmsg)
                 VLOG_ERR("Failed to allocate memory for MSTP MSTI Port Info");
                 return;
             }
+            MSTP_PORT_HOT_BIND(MSTP_MSTI_PORT_PTR(mstid, lport), mstid, lport);
+        }
+        else if(MSTP_MSTI_INFO(mstid)->valid)
+        {
+            /*------------------------------------------------------------------
+             * The port is already running on this MSTI, keep its configured
+             * priority and path cost and its protocol state, a bridge
+             * priority change is applied by reselection above.
+             *------------------------------------------------------------------*/
+            continue;
         }
         mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
         MSTP_SET_PORT_NUM(mstiPortPtr->portId,lport);
@@ -1641,8 +2073,11 @@ void update_mstp_msti_config(mstpd_message *pmsg)
      * Mark MST Instance as valid and increment global counter of valid
      * trees.
      *---------------------------------------------------------------------*/
-    MSTP_MSTI_INFO(mstid)->valid = TRUE;
-    MSTP_NUM_OF_VALID_TREES++;
+    if(!MSTP_MSTI_INFO(mstid)->valid)
+    {
+        MSTP_MSTI_INFO(mstid)->valid = TRUE;
+        MSTP_NUM_OF_VALID_TREES++;
+    }
 
 }
 /**PROC+**********************************************************************
@@ -1677,6 +2112,7 @@ void update_mstp_msti_port_config(mstpd_message *pmsg)
          *------------------------------------------------------------------*/
         MSTP_COMM_PORT_PTR(lport) = (MSTP_COMM_PORT_INFO_t *)malloc(sizeof(MSTP_COMM_PORT_INFO_t));
         memset(MSTP_COMM_PORT_PTR(lport), 0,sizeof(MSTP_COMM_PORT_INFO_t));
+        set_port(&mstp_Bridge.activeLports, lport);
     }
     commPortPtr = MSTP_COMM_PORT_PTR(lport);
     if(!MSTP_MSTI_PORT_PTR(mstid, lport))
@@ -1685,6 +2121,7 @@ void update_mstp_msti_port_config(mstpd_message *pmsg)
          * Allocate memory to keep MSTI port's data
          *------------------------------------------------------------------*/
         MSTP_MSTI_PORT_PTR(mstid, lport) = (MSTP_MSTI_PORT_INFO_t *)calloc(1, sizeof(MSTP_MSTI_PORT_INFO_t));
+        MSTP_PORT_HOT_BIND(MSTP_MSTI_PORT_PTR(mstid, lport), mstid, lport);
     }
     mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
     MSTP_SET_PORT_NUM(mstiPortPtr->portId,lport);
@@ -1696,8 +2133,8 @@ void update_mstp_msti_port_config(mstpd_message *pmsg)
         if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                     MSTP_PORT_PORT_ENABLED) && MSTP_ENABLED)
         {/* Port is 'Enabled' and the priority value has changed,
-          * indicate that protocol re-initialization is required */
-            MSTP_DYN_RECONFIG_CHANGE = TRUE;
+          * the MSTI reselects the port's role */
+            mstp_setScopedReconfig(mstid, lport);
         }
     }
     if(msti_port_config->path_cost != 0)
@@ -1711,8 +2148,8 @@ void update_mstp_msti_port_config(mstpd_message *pmsg)
         if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                     MSTP_PORT_PORT_ENABLED) && MSTP_ENABLED)
         {/* Port is 'Enabled' and the path cost value has changed,
-          * indicate that protocol re-initialization is required */
-            MSTP_DYN_RECONFIG_CHANGE = TRUE;
+          * the MSTI reselects the port's role */
+            mstp_setScopedReconfig(mstid, lport);
         }
     }
 }
@@ -1723,7 +2160,6 @@ void delete_mstp_msti_config(mstpd_message *pmsg)
     int mstid = 0,lport = 0;
     msti_config_delete = (mstp_msti_config_delete *)pmsg->msg;
     mstid = msti_config_delete->mstid;
-    MSTP_TREE_MSG_t *m;
 
     STP_ASSERT(MSTP_VALID_MSTID(mstid));
 
@@ -1736,7 +2172,7 @@ void delete_mstp_msti_config(mstpd_message *pmsg)
     /*---------------------------------------------------------------------
      * Delete the MSTI ports data
      *---------------------------------------------------------------------*/
-    for(lport = 1; lport <= MAX_LPORTS; lport++)
+    MSTP_FOR_EACH_ACTIVE_LPORT(lport)
     {
         if(MSTP_MSTI_PORT_PTR(mstid, lport))
         {
@@ -1747,6 +2183,7 @@ void delete_mstp_msti_config(mstpd_message *pmsg)
      * VIDs that are removed from the MSTI should be mapped back to
      * the CIST in the global 'mstp_MstiVidTable'.
      *---------------------------------------------------------------------*/
+    mstp_setVidMapMstId(&mstp_MstiVidTable[mstid], MSTP_CISTID);
     bit_or_vid_maps(&mstp_MstiVidTable[mstid],
             &mstp_MstiVidTable[MSTP_CISTID]);
 
@@ -1768,23 +2205,23 @@ void delete_mstp_msti_config(mstpd_message *pmsg)
     MSTP_NUM_OF_VALID_TREES--;
     /*--------------------------------------------------------------------
      * If there is a pending message to other subsystems queued by this
-     * MSTI we need to remove it from the queue and free memory space,
-     * the message is not valid anymore.
+     * MSTI we need to discard it, the message is not valid anymore.
      *--------------------------------------------------------------------*/
-    m = mstp_findMstiPortStateChgMsg(mstid);
-    if(m != NULL)
-    {
-        remqhere_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
-        free(m);
-    }
+    mstp_clearMstiPortStateChgMsg(mstid);
 
     /*---------------------------------------------------------------------
      * Free memory space allocated for the MSTI
      *---------------------------------------------------------------------*/
     free(MSTP_MSTI_INFO(mstid));
     MSTP_MSTI_INFO(mstid) = NULL;
+    clrBit(mstp_Bridge.reconfigTrees.map, mstid + 1,
+           MSTP_ROLES_DIRTY_MAP_BITS);
 
-    MSTP_DYN_RECONFIG_CHANGE = TRUE;
+    /*---------------------------------------------------------------------
+     * Its VIDs now follow the CIST port states, the other trees keep
+     * running.
+     *---------------------------------------------------------------------*/
+    mstp_setRegionReconfig();
 }
 /**PROC+**********************************************************************
  * Name:      mstp_informDBOnPortStateChange
@@ -1804,8 +2241,7 @@ void
 mstp_informDBOnPortStateChange(uint32_t operation)
 {
    MSTP_TREE_MSG_t *m;
-   MSTP_TREE_MSG_t *m_next;
-   bool            remove_msg = FALSE;
+   int             bit;
    bool           isblk_msg = FALSE, isfwd_msg = FALSE;
    struct ovsdb_idl_txn *txn = NULL;
    const struct ovsrec_port *port_row = NULL;
@@ -1813,11 +2249,11 @@ mstp_informDBOnPortStateChange(uint32_t operation)
    MSTP_OVSDB_LOCK;
    txn = ovsdb_idl_txn_create(idl);
 
-   m_next = (MSTP_TREE_MSG_t*) qfirst_nodis (&MSTP_TREE_MSGS_QUEUE);
-   while(m_next != (MSTP_TREE_MSG_t*) Q_NULL)
+   for(bit = findFirstBitSet(MSTP_TREE_MSGS_DIRTY.map, MSTP_TREE_MSG_SLOTS);
+       bit > 0;
+       bit = findNextBitSet(MSTP_TREE_MSGS_DIRTY.map, bit, MSTP_TREE_MSG_SLOTS))
    {
-      m = m_next;
-      m_next = (MSTP_TREE_MSG_t*)qnext_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
+      m = &MSTP_TREE_MSGS[bit - 1];
        /*---------------------------------------------------------------------
       * propagate 'lport down' requests to DB
        *---------------------------------------------------------------------*/
@@ -1983,17 +2419,93 @@ mstp_informDBOnPortStateChange(uint32_t operation)
                  }
              }
          }
-
-         remove_msg = TRUE;
       }
+   }
 
-      /*---------------------------------------------------------------------
-       * take pending message off the queue and free it
-       *---------------------------------------------------------------------*/
-      if(remove_msg)
+   /*------------------------------------------------------------------------
+    * all pending messages have been delivered, clear their slots in bulk
+    *------------------------------------------------------------------------*/
+   if(operation == e_mstpd_timer)
+   {
+      mstp_clearMstpToOthersMessageQueue();
+      mstp_perfStats.treeMsgDrains++;
+   }
+   ovsdb_idl_txn_commit_block(txn);
+   ovsdb_idl_txn_destroy(txn);
+   MSTP_OVSDB_UNLOCK;
+}
+/**PROC+**********************************************************************
+ * Name:      mstp_republishPortStates
+ *
+ * Purpose:   Write the current role and state of every port on every
+ *            tree back to the DB, e.g. after the OVSDB session was
+ *            re-established. Protocol state is left untouched; columns
+ *            that already hold the right value are not rewritten by the
+ *            IDL, so an in-sync DB sees no update.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge, l2ports
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_republishPortStates(void)
+{
+   struct ovsdb_idl_txn *txn = NULL;
+   MSTP_CIST_PORT_INFO_t *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
+   MSTID_t               mstid;
+   int                   lport;
+
+   MSTP_OVSDB_LOCK;
+   txn = ovsdb_idl_txn_create(idl);
+   for(lport = find_first_port_set(&l2ports); IS_VALID_LPORT(lport);
+       lport = find_next_port_set(&l2ports, lport))
+   {
+      char port[20] = {0};
+      char port_role[20] = {0};
+
+      cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+      if(!cistPortPtr)
+         continue;
+
+      intf_get_port_name(lport,port);
+      mstp_convertPortRoleEnumToString(cistPortPtr->selectedRole,port_role);
+      mstp_util_set_cist_port_table_string(port,PORT_ROLE,port_role);
+      if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
+                                   MSTP_CIST_PORT_FORWARDING))
+         mstp_util_set_cist_port_table_string(port,PORT_STATE,"Forwarding");
+      else if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
+                                        MSTP_CIST_PORT_LEARNING))
+         mstp_util_set_cist_port_table_string(port,PORT_STATE,"Learning");
+      else
+         mstp_util_set_cist_port_table_string(port,PORT_STATE,"Blocking");
+
+      for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_INSTANCES_MAX; mstid++)
       {
-         remqhere_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
-         free(m);
+         if(!MSTP_MSTI_VALID(mstid))
+            continue;
+         mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
+         if(!mstiPortPtr)
+            continue;
+
+         memset(port_role, 0, sizeof(port_role));
+         mstp_convertPortRoleEnumToString(mstiPortPtr->selectedRole,port_role);
+         mstp_util_set_msti_port_table_string(PORT_ROLE,port_role,mstid,lport);
+         if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
+                                      MSTP_MSTI_PORT_FORWARDING))
+            mstp_util_set_msti_port_table_string(PORT_STATE,"Forwarding",
+                                                 mstid,lport);
+         else if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
+                                           MSTP_MSTI_PORT_LEARNING))
+            mstp_util_set_msti_port_table_string(PORT_STATE,"Learning",
+                                                 mstid,lport);
+         else
+            mstp_util_set_msti_port_table_string(PORT_STATE,"Blocking",
+                                                 mstid,lport);
       }
    }
    ovsdb_idl_txn_commit_block(txn);
@@ -2028,6 +2540,7 @@ void update_mstp_on_lport_add(int lport)
          *------------------------------------------------------------------*/
         MSTP_COMM_PORT_PTR(lport) = (MSTP_COMM_PORT_INFO_t *)malloc(sizeof(MSTP_COMM_PORT_INFO_t));
         memset(MSTP_COMM_PORT_PTR(lport), 0,sizeof(MSTP_COMM_PORT_INFO_t));
+        set_port(&mstp_Bridge.activeLports, lport);
     }
     commPortPtr = MSTP_COMM_PORT_PTR(lport);
     if(!MSTP_CIST_PORT_PTR(lport))
@@ -2036,11 +2549,12 @@ void update_mstp_on_lport_add(int lport)
          * Allocate memory to keep CIST port's data
          *------------------------------------------------------------------*/
         MSTP_CIST_PORT_PTR(lport) = (MSTP_CIST_PORT_INFO_t *)calloc(1, sizeof(MSTP_CIST_PORT_INFO_t));
+        MSTP_PORT_HOT_BIND(MSTP_CIST_PORT_PTR(lport), MSTP_CISTID, lport);
     }
     cistPortPtr = MSTP_CIST_PORT_PTR(lport);
     MSTP_SET_PORT_NUM(cistPortPtr->portId,lport);
     path_cost = mstp_portAutoPathCostDetect(lport);
-    cistPortPtr->useCfgPathCost = path_cost;
+    cistPortPtr->useCfgPathCost = 0;
     cistPortPtr->InternalPortPathCost = path_cost;
     if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                 MSTP_PORT_PORT_ENABLED) && MSTP_ENABLED)
@@ -2220,6 +2734,7 @@ void update_mstp_on_lport_add(int lport)
              *------------------------------------------------------------------*/
             MSTP_COMM_PORT_PTR(lport) = (MSTP_COMM_PORT_INFO_t *)malloc(sizeof(MSTP_COMM_PORT_INFO_t));
             memset(MSTP_COMM_PORT_PTR(lport), 0,sizeof(MSTP_COMM_PORT_INFO_t));
+            set_port(&mstp_Bridge.activeLports, lport);
         }
         commPortPtr = MSTP_COMM_PORT_PTR(lport);
         if(!MSTP_MSTI_PORT_PTR(mstid, lport))
@@ -2228,6 +2743,7 @@ void update_mstp_on_lport_add(int lport)
              * Allocate memory to keep MSTI port's data
              *------------------------------------------------------------------*/
             MSTP_MSTI_PORT_PTR(mstid, lport) = (MSTP_MSTI_PORT_INFO_t *)calloc(1, sizeof(MSTP_MSTI_PORT_INFO_t));
+            MSTP_PORT_HOT_BIND(MSTP_MSTI_PORT_PTR(mstid, lport), mstid, lport);
         }
         mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
         MSTP_SET_PORT_NUM(mstiPortPtr->portId,lport);
@@ -466,6 +466,8 @@ mstp_updateMstiVidMapping(MSTID_t mstid, VID_MAP newVidMap)
           * the CIST in the global 'mstp_MstiVidTable'.
           *------------------------------------------------------------------*/
          bit_or_vid_maps(&delVidMap, &mstp_MstiVidTable[MSTP_CISTID]);
+         mstp_setVidMapMstId(&delVidMap, (mstid == MSTP_CISTID) ?
+                             MSTP_NO_MSTID : MSTP_CISTID);
       }
 
       /*---------------------------------------------------------------------
@@ -481,12 +483,17 @@ mstp_updateMstiVidMapping(MSTID_t mstid, VID_MAP newVidMap)
          copy_vid_map(&addVidMap, &tmpVidMap);
          bit_inverse_vid_map(&tmpVidMap);
          bit_and_vid_maps(&tmpVidMap, &mstp_MstiVidTable[MSTP_CISTID]);
+         mstp_setVidMapMstId(&addVidMap, mstid);
       }
 
       /*---------------------------------------------------------------------
        * Store new MSTI's VID mapping data in the global 'mstp_MstiVidTable'
        *---------------------------------------------------------------------*/
       copy_vid_map(&newVidMap, curVidMap);
+#ifndef NDEBUG
+      /* Scans every VID, kept out of builds that define NDEBUG */
+      STP_ASSERT(mstp_vidMstIdTableMismatches() == 0);
+#endif /* NDEBUG */
 
       /*---------------------------------------------------------------------
        * Indicate that MSTI's VID mapping has changed
@@ -496,3 +503,49 @@ mstp_updateMstiVidMapping(MSTID_t mstid, VID_MAP newVidMap)
 
    return res;
 }
+
+/**PROC+**********************************************************************
+ * Name:      mstp_reevalPortRegion
+ *
+ * Purpose:   Re-evaluate whether the port is internal to the MST Region
+ *            after the MST Configuration Identifier of this Bridge has
+ *            changed, by checking the last BPDU received on the port
+ *            against the new identifier. Nothing is received again: the
+ *            flags, timers and counters of that BPDU have been acted upon
+ *            already. The next BPDU from the neighbor is decoded in full
+ *            and re-classifies the port information on every tree, as
+ *            for any BPDU crossing the Region boundary. Until then the
+ *            port keeps its role and state.
+ *
+ * Params:    lport -> logical port number
+ *
+ * Returns:   TRUE if the port moves across the Region boundary,
+ *            FALSE otherwise or if no BPDU is kept to tell
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints: 'rxInfoGen' is expected to be bumped by the caller, so the
+ *              next BPDU is not taken for a repeated one
+ **PROC-**********************************************************************/
+bool
+mstp_reevalPortRegion(LPORT_t lport)
+{
+   static MSTP_RX_PDU     pkt;
+   MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
+   bool                   internal;
+
+   if(!commPortPtr || !MSTP_CIST_PORT_PTR(lport) ||
+      !MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
+                                 MSTP_PORT_PORT_ENABLED) ||
+      (commPortPtr->lastRxBpduLen == 0))
+      return FALSE;
+
+   internal = MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
+                                        MSTP_PORT_RCVD_INTERNAL);
+
+   pkt.pktLen = commPortPtr->lastRxBpduLen;
+   pkt.lport  = lport;
+   memcpy(pkt.data, commPortPtr->lastRxBpdu, pkt.pktLen);
+
+   return (mstp_fromSameRegion(&pkt, lport) != internal);
+}
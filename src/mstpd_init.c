@@ -68,6 +68,19 @@ MSTP_BRIDGE_INFO_t mstp_Bridge;
  *---------------------------------------------------------------------------*/
 VID_MAP mstp_MstiVidTable[MSTP_INSTANCES_MAX + 1];
 
+/*---------------------------------------------------------------------------
+ * VLAN ID to MST Instance Identifier lookup Table, kept in sync with
+ * 'mstp_MstiVidTable' (MSTP_NO_MSTID for VIDs not mapped to any tree).
+ *---------------------------------------------------------------------------*/
+uint8_t mstp_VidMstIdTable[MAX_VLAN_ID + 1];
+
+/*---------------------------------------------------------------------------
+ * MST Configuration Table (802.1Q 13.7) in network byte order, the input
+ * of the configuration digest. Updated together with 'mstp_VidMstIdTable'.
+ *---------------------------------------------------------------------------*/
+MSTID_t mstp_MstCfgTable[MSTP_MST_CFG_TBL_SIZE];
+bool    mstp_MstCfgTableDirty = TRUE;
+
 /*---------------------------------------------------------------------------
  * VLAN group number to MST Instance Identifier mapping Table.
  * Used to communicate to IDL that treats a VLAN group as an ordinal
@@ -75,6 +88,24 @@ VID_MAP mstp_MstiVidTable[MSTP_INSTANCES_MAX + 1];
  *---------------------------------------------------------------------------*/
 MSTID_t mstp_vlanGroupNumToMstIdTable[MSTP_INSTANCES_MAX + 1];
 
+/*---------------------------------------------------------------------------
+ * Startup timing collected for 'mstpd/daemon/perf_stats'.
+ *---------------------------------------------------------------------------*/
+MSTP_PERF_STATS_t mstp_perfStats;
+__thread uint64_t mstp_activePortIters;
+
+/*---------------------------------------------------------------------------
+ * Whether nested PRT, PST and TCM invocations are merged into the one in
+ * progress (see 'mstp_smEnter'). Only cleared by the unit tests, to compare
+ * the outcome with the machines run in place.
+ *---------------------------------------------------------------------------*/
+bool mstp_smMergeNested = TRUE;
+
+/*---------------------------------------------------------------------------
+ * Per-tree timers and PRT state of the ports (see 'MSTP_PORT_HOT').
+ *---------------------------------------------------------------------------*/
+MSTP_TREE_PORT_HOT_t mstp_treePortHot[MSTP_INSTANCES_MAX + 1];
+
 /*---------------------------------------------------------------------------
  * MST Configuration Identifier Digest Signature Key (16 bytes mandatory
  * value as defined in 802.1Q-REV/D5.0 13.7). Used to generate the
@@ -103,6 +134,7 @@ static void mstp_initBridgeMstiData(int mstid,bool init);
 static void mstp_initBridgeTreesData(bool init);
 static void mstp_initBridgeGlobalData(bool init);
 static void mstp_initControlData(void);
+static void mstp_clearPortHot(MSTID_t mstid, LPORT_t lport);
 
 /** ======================================================================= **
  *                                                                           *
@@ -378,11 +410,11 @@ mstp_initMstiPortData(MSTID_t mstid, LPORT_t lport, bool init)
     * State Machine Timers (802.1Q-REV/D5.0 13.21), they will be dynamically
     * set to the appropriate values during the run of the SMs.
     *------------------------------------------------------------------------*/
-   mstiPortPtr->fdWhile = 0;       /* d) */
-   mstiPortPtr->rrWhile = 0;       /* e) */
-   mstiPortPtr->rbWhile = 0;       /* f) */
-   mstiPortPtr->tcWhile = 0;       /* g) */
-   mstiPortPtr->rcvdInfoWhile = 0; /* h) */
+   MSTP_PORT_HOT(mstiPortPtr, fdWhile) = 0;       /* d) */
+   MSTP_PORT_HOT(mstiPortPtr, rrWhile) = 0;       /* e) */
+   MSTP_PORT_HOT(mstiPortPtr, rbWhile) = 0;       /* f) */
+   MSTP_PORT_HOT(mstiPortPtr, tcWhile) = 0;       /* g) */
+   MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) = 0; /* h) */
 
    /*------------------------------------------------------------------------
     * Initialize other Per-Port Variables (802.1Q-REV/D5.0 13.24)
@@ -395,6 +427,7 @@ mstp_initMstiPortData(MSTID_t mstid, LPORT_t lport, bool init)
    mstiPortPtr->rcvdInfo = MSTP_RCVD_INFO_UNKNOWN;                    /* ac) */
    mstiPortPtr->role = MSTP_PORT_ROLE_UNKNOWN;                        /* as) */
    mstiPortPtr->selectedRole = MSTP_PORT_ROLE_UNKNOWN;                /* at) */
+   MSTP_MSTI_INFO(mstid)->rolesValid = FALSE;
    mstiPortPtr->designatedPriority = MSTP_MSTI_BRIDGE_PRIORITY(mstid);/* al) */
    mstiPortPtr->designatedPriority.dsnPortID = mstiPortPtr->portId;
    memset((char*)&mstiPortPtr->designatedTimes, 0,
@@ -420,7 +453,7 @@ mstp_initMstiPortData(MSTID_t mstid, LPORT_t lport, bool init)
     *       it themselves at the time of the SM initialization.
     *------------------------------------------------------------------------*/
    mstiPortPtr->pimState = MSTP_PIM_STATE_UNKNOWN;
-   mstiPortPtr->prtState = MSTP_PRT_STATE_UNKNOWN;
+   MSTP_PORT_HOT(mstiPortPtr, prtState) = MSTP_PRT_STATE_UNKNOWN;
    mstiPortPtr->pstState = MSTP_PST_STATE_UNKNOWN;
    mstiPortPtr->tcmState = MSTP_TCM_STATE_UNKNOWN;
 
@@ -476,11 +509,11 @@ mstp_initCistPortData(LPORT_t lport, bool init)
     * set to the appropriate values during the run of the SMs.
     *------------------------------------------------------------------------*/
 
-   cistPortPtr->fdWhile = 0;       /* d) */
-   cistPortPtr->rrWhile = 0;       /* e) */
-   cistPortPtr->rbWhile = 0;       /* f) */
-   cistPortPtr->tcWhile = 0;       /* g) */
-   cistPortPtr->rcvdInfoWhile = 0; /* h) */
+   MSTP_PORT_HOT(cistPortPtr, fdWhile) = 0;       /* d) */
+   MSTP_PORT_HOT(cistPortPtr, rrWhile) = 0;       /* e) */
+   MSTP_PORT_HOT(cistPortPtr, rbWhile) = 0;       /* f) */
+   MSTP_PORT_HOT(cistPortPtr, tcWhile) = 0;       /* g) */
+   MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) = 0; /* h) */
 
    /*------------------------------------------------------------------------
     * Initialize other Per-Port Variables (802.1Q-REV/D5.0 13.24)
@@ -493,6 +526,7 @@ mstp_initCistPortData(LPORT_t lport, bool init)
    cistPortPtr->rcvdInfo = MSTP_RCVD_INFO_UNKNOWN;                    /* ac) */
    cistPortPtr->role     = MSTP_PORT_ROLE_UNKNOWN;                    /* as) */
    cistPortPtr->selectedRole = MSTP_PORT_ROLE_UNKNOWN;                /* at) */
+   MSTP_CIST_INFO.rolesValid = FALSE;
    cistPortPtr->designatedPriority = MSTP_CIST_BRIDGE_PRIORITY;       /* al) */
    cistPortPtr->designatedPriority.dsnPortID = cistPortPtr->portId;
    memset((char*)&cistPortPtr->designatedTimes, 0,
@@ -519,7 +553,7 @@ mstp_initCistPortData(LPORT_t lport, bool init)
     *       it themselves at the time of the SM initialization.
     *------------------------------------------------------------------------*/
    cistPortPtr->pimState = MSTP_PIM_STATE_UNKNOWN;
-   cistPortPtr->prtState = MSTP_PRT_STATE_UNKNOWN;
+   MSTP_PORT_HOT(cistPortPtr, prtState) = MSTP_PRT_STATE_UNKNOWN;
    cistPortPtr->pstState = MSTP_PST_STATE_UNKNOWN;
    cistPortPtr->tcmState = MSTP_TCM_STATE_UNKNOWN;
 
@@ -675,6 +709,7 @@ mstp_clearBridgeCistData() {
        /*---------------------------------------------------------------------
        * Clear CIST's VLAN IDs mapping data in the global 'mstp_MstiVidTable'
        *---------------------------------------------------------------------*/
+      mstp_setVidMapMstId(&mstp_MstiVidTable[MSTP_CISTID], MSTP_NO_MSTID);
       clear_vid_map(&mstp_MstiVidTable[MSTP_CISTID]);
 
       /*---------------------------------------------------------------------
@@ -701,13 +736,13 @@ mstp_clearBridgeCistData() {
  **PROC-**********************************************************************/
 void
 mstp_clearBridgeMstiData(MSTID_t mstid) {
-    MSTP_TREE_MSG_t *m;
     if(MSTP_MSTI_INFO(mstid) == NULL)
         return;
     /*---------------------------------------------------------------------
      * VIDs that are removed from the MSTI should be mapped back to
      * the CIST in the global 'mstp_MstiVidTable'.
      *---------------------------------------------------------------------*/
+    mstp_setVidMapMstId(&mstp_MstiVidTable[mstid], MSTP_CISTID);
     bit_or_vid_maps(&mstp_MstiVidTable[mstid],
             &mstp_MstiVidTable[MSTP_CISTID]);
 
@@ -721,15 +756,9 @@ mstp_clearBridgeMstiData(MSTID_t mstid) {
     MSTP_NUM_OF_VALID_TREES--;
     /*--------------------------------------------------------------------
      * If there is a pending message to other subsystems queued by this
-     * MSTI we need to remove it from the queue and free memory space,
-     * the message is not valid anymore.
+     * MSTI we need to discard it, the message is not valid anymore.
      *--------------------------------------------------------------------*/
-    m = mstp_findMstiPortStateChgMsg(mstid);
-    if(m != NULL)
-    {
-        remqhere_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
-        free(m);
-    }
+    mstp_clearMstiPortStateChgMsg(mstid);
 
     /*---------------------------------------------------------------------
      * Free memory space allocated for the MSTI
@@ -770,6 +799,35 @@ mstp_clearProtocolData(void)
 
 }
 
+/**PROC+**********************************************************************
+ * Name:      mstp_clearPortHot
+ *
+ * Purpose:   Clear the timers and the PRT state of the port in the tree's
+ *            slot of 'mstp_treePortHot', so that the port's timers do not
+ *            run once its data structure is gone.
+ *
+ * Params:    mstid -> MST instance identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_treePortHot
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_clearPortHot(MSTID_t mstid, LPORT_t lport)
+{
+   MSTP_TREE_PORT_HOT_t *hot = &mstp_treePortHot[mstid];
+
+   hot->fdWhile[lport]       = 0;
+   hot->rrWhile[lport]       = 0;
+   hot->rbWhile[lport]       = 0;
+   hot->tcWhile[lport]       = 0;
+   hot->rcvdInfoWhile[lport] = 0;
+   hot->prtState[lport]      = 0;
+}
+
 /**PROC+**********************************************************************
  * Name:      mstp_clearMstiPortData
  *
@@ -792,6 +850,7 @@ mstp_clearMstiPortData(MSTID_t mstid, LPORT_t lport)
    STP_ASSERT(MSTP_COMM_PORT_PTR(lport));
    STP_ASSERT(MSTP_MSTI_PORT_PTR(mstid, lport));
 
+   mstp_clearPortHot(mstid, lport);
    free(MSTP_MSTI_PORT_PTR(mstid, lport));
    MSTP_MSTI_PORT_PTR(mstid, lport) = NULL;
 
@@ -821,6 +880,7 @@ mstp_clearCistPortData(LPORT_t lport)
    STP_ASSERT(MSTP_COMM_PORT_PTR(lport));
    STP_ASSERT(MSTP_CIST_PORT_PTR(lport));
 
+   mstp_clearPortHot(MSTP_CISTID, lport);
    free(MSTP_CIST_PORT_PTR(lport));
    MSTP_CIST_PORT_PTR(lport) = NULL;
 }
@@ -847,15 +907,18 @@ mstp_clearCommonPortData(LPORT_t lport)
 
    MSTP_COMM_CLR_BPDU_FILTER(lport);
 
+   free(MSTP_COMM_PORT_PTR(lport)->lastRxBpdu);
+   free(MSTP_COMM_PORT_PTR(lport)->txBpdu);
    free(MSTP_COMM_PORT_PTR(lport));
    MSTP_COMM_PORT_PTR(lport) = NULL;
+   clear_port(&mstp_Bridge.activeLports, lport);
 
 }
 /**PROC+**********************************************************************
  * Name:      mstp_clearMstpToOthersMessageQueue
  *
- * Purpose:   Remove from the queue all pending MSTP messages to
- *            other subsytems .
+ * Purpose:   Discard all pending MSTP messages to other subsytems, their
+ *            slots are cleared in bulk.
  *
  * Returns:   none
  *
@@ -865,13 +928,15 @@ mstp_clearCommonPortData(LPORT_t lport)
 void
 mstp_clearMstpToOthersMessageQueue(void)
 {
-   MSTP_TREE_MSG_t *m;
+   int bit;
 
-   while(qempty(&MSTP_TREE_MSGS_QUEUE) == FALSE)
+   for(bit = findFirstBitSet(MSTP_TREE_MSGS_DIRTY.map, MSTP_TREE_MSG_SLOTS);
+       bit > 0;
+       bit = findNextBitSet(MSTP_TREE_MSGS_DIRTY.map, bit, MSTP_TREE_MSG_SLOTS))
    {
-      m = (MSTP_TREE_MSG_t *) remqhi(&MSTP_TREE_MSGS_QUEUE);
-      free(m);
+      memset(&MSTP_TREE_MSGS[bit - 1], 0, sizeof(MSTP_TREE_MSG_t));
    }
+   clearBitmap(MSTP_TREE_MSGS_DIRTY.map, MSTP_TREE_MSG_SLOTS);
 }
 /**PROC+**********************************************************************
  * Name:      mstp_updateMstpCBPortMaps
@@ -899,6 +964,7 @@ mstp_updateMstpCBPortMaps(LPORT_t lport)
    PORT_MAP pmap;
    MSTP_TREE_MSG_t *m;
    PORT_MAP         tmp_pmap;
+   int              bit;
 
    clear_port_map(&pmap);
    set_port(&pmap,lport);
@@ -911,10 +977,11 @@ mstp_updateMstpCBPortMaps(LPORT_t lport)
    bit_and_port_maps(&tmp_pmap, &MSTP_FWD_LPORTS);
    bit_and_port_maps(&tmp_pmap, &MSTP_BLK_LPORTS);
 
-   for(m  = (MSTP_TREE_MSG_t *) qfirst_nodis(&MSTP_TREE_MSGS_QUEUE);
-       m != (MSTP_TREE_MSG_t *) Q_NULL;
-       m  = (MSTP_TREE_MSG_t *) qnext_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link))
+   for(bit = findFirstBitSet(MSTP_TREE_MSGS_DIRTY.map, MSTP_TREE_MSG_SLOTS);
+       bit > 0;
+       bit = findNextBitSet(MSTP_TREE_MSGS_DIRTY.map, bit, MSTP_TREE_MSG_SLOTS))
    {
+      m = &MSTP_TREE_MSGS[bit - 1];
       bit_and_port_maps(&tmp_pmap, &m->portsFwd);
       bit_and_port_maps(&tmp_pmap, &m->portsLrn);
       bit_and_port_maps(&tmp_pmap, &m->portsBlk);
@@ -1096,6 +1163,7 @@ mstp_initBridgeMstiData(int mstid,bool init)
     * (802.1Q-REV/D5.0 13.23 f))
     *------------------------------------------------------------------------*/
    MSTP_MSTI_ROOT_PORT_ID(mstid) = 0;
+   MSTP_MSTI_INFO(mstid)->rolesValid = FALSE;
 
    /*------------------------------------------------------------------------
     * Copy current MSTI Regional Root Bridge ID to be used for further check
@@ -1281,6 +1349,7 @@ mstp_initBridgeCistData(bool init)
     * (802.1Q-REV/D5.0 13.23 f))
     *------------------------------------------------------------------------*/
    MSTP_CIST_ROOT_PORT_ID = 0;
+   MSTP_CIST_INFO.rolesValid = FALSE;
 
    /*------------------------------------------------------------------------
     * Copy current CST and IST Root Bridge IDs (will be used in further checks
@@ -1480,7 +1549,9 @@ mstp_initBridgeGlobalData(bool init)
    mstp_Bridge.TxHoldCount  = MSTP_TX_HOLD_COUNT;
    mstp_Bridge.MigrateTime  = MSTP_MIGRATE_TIME_SEC;
 
-   mstp_Bridge.preventTx    = FALSE;
+   mstp_Bridge.preventTx    = 0;
+   clear_port_map(&mstp_Bridge.txPendingLports);
+   mstp_Bridge.prsHold      = FALSE;
 
 
    /*------------------------------------------------------------------------
@@ -1520,12 +1591,10 @@ mstp_initControlData(void)
     *------------------------------------------------------------------------*/
    memset((char *) &mstp_CB, 0, (sizeof (MSTP_CB_t)));
 
-   /*------------------------------------------------------------------------
-    * initialize trees change message queue.
-    *------------------------------------------------------------------------*/
-   inique(&MSTP_TREE_MSGS_QUEUE);
    /* Clear VIDs mapping for all MSTIs */
    memset(mstp_MstiVidTable, 0x00, sizeof(mstp_MstiVidTable));
    /* Map all VIDs to the CIST */
    MSTP_ADD_ALL_VIDS_TO_VIDMAP(&mstp_MstiVidTable[MSTP_CISTID]);
+   mstp_clearVidMstIdTable();
+   mstp_setVidMapMstId(&mstp_MstiVidTable[MSTP_CISTID], MSTP_CISTID);
 }
@@ -38,6 +38,9 @@
 #include <assert.h>
 #include "mstp_inlines.h"
 #include <openssl/md5.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /* inlines.c in libw.ss compiles this code into library routines by define
  * extern to be nothing before including this file. For all other .c files
@@ -96,6 +99,199 @@ uint8_t bit_count_table[256] = {
 #define __CTZ32(x) __builtin_ctz(x)
 #define __CLZ32(x) __builtin_clz(x)
 #define __FFS32(x) __builtin_ffs(x)
+#define __POPCNT32(x) __builtin_popcount(x)
+#define __POPCNT64(x) __builtin_popcountll(x)
+
+/*****************************************************************************
+ * Word parallel core for the multi-word bitmaps.
+ *
+ * PORT_MAPs and VID_MAPs are arrays of 32-bit words, but nothing in them
+ * depends on that width except where bit positions are reported.  The bulk
+ * operations below run on 128-bit SSE2 vectors when the compiler targets
+ * them and on 64-bit words otherwise, falling back to single 32-bit words
+ * for an odd leftover word.  Bitwise operations do not care about byte
+ * order, so the 64-bit loads go through memcpy() and work on any alignment
+ * the 32-bit maps have.  Searches only use 64-bit words to skip empty
+ * space and take bit positions from the 32-bit words, so they give the
+ * same answer on little and big endian hosts.
+ *
+ * The OR/AND/XOR/SUB callers still mask a final partial word themselves.
+ * The search, count and test helpers read whole 32-bit words, as the
+ * loops they replace did.
+ *****************************************************************************/
+typedef enum
+{
+   BM_OP_OR,
+   BM_OP_AND,
+   BM_OP_XOR,
+   BM_OP_SUB
+} BM_OP_t;
+
+static inline uint64_t
+bmLoad64(const uint32_t *map)
+{
+   uint64_t w;
+
+   memcpy(&w, map, sizeof(w));
+   return w;
+}
+
+static inline void
+bmStore64(uint32_t *map, uint64_t w)
+{
+   memcpy(map, &w, sizeof(w));
+}
+
+static inline __attribute__((always_inline)) void
+bmBulkOp(const uint32_t *fromMap, uint32_t *toMap, uint32_t words, BM_OP_t op)
+{
+   uint32_t i = 0;
+
+#if defined(__SSE2__)
+   for (; i + 4 <= words; i += 4)
+   {
+      __m128i f = _mm_loadu_si128((const __m128i *)(fromMap + i));
+      __m128i t = _mm_loadu_si128((const __m128i *)(toMap + i));
+
+      switch (op)
+      {
+         case BM_OP_OR:  t = _mm_or_si128(t, f);    break;
+         case BM_OP_AND: t = _mm_and_si128(t, f);   break;
+         case BM_OP_XOR: t = _mm_xor_si128(t, f);   break;
+         case BM_OP_SUB: t = _mm_andnot_si128(f, t); break;
+      }
+      _mm_storeu_si128((__m128i *)(toMap + i), t);
+   }
+#endif /* __SSE2__ */
+   for (; i + 2 <= words; i += 2)
+   {
+      uint64_t f = bmLoad64(fromMap + i);
+      uint64_t t = bmLoad64(toMap + i);
+
+      switch (op)
+      {
+         case BM_OP_OR:  t |= f;  break;
+         case BM_OP_AND: t &= f;  break;
+         case BM_OP_XOR: t ^= f;  break;
+         case BM_OP_SUB: t &= ~f; break;
+      }
+      bmStore64(toMap + i, t);
+   }
+   for (; i < words; i++)
+   {
+      switch (op)
+      {
+         case BM_OP_OR:  toMap[i] |= fromMap[i];  break;
+         case BM_OP_AND: toMap[i] &= fromMap[i];  break;
+         case BM_OP_XOR: toMap[i] ^= fromMap[i];  break;
+         case BM_OP_SUB: toMap[i] &= ~fromMap[i]; break;
+      }
+   }
+}
+
+/* true if (map1 & map2) has any bit set, or map1 alone when map2 is NULL */
+static inline bool
+bmAny(const uint32_t *map1, const uint32_t *map2, uint32_t words)
+{
+   uint32_t i = 0;
+
+#if defined(__SSE2__)
+   for (; i + 4 <= words; i += 4)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i *)(map1 + i));
+
+      if (map2)
+      {
+         v = _mm_and_si128(v,
+                           _mm_loadu_si128((const __m128i *)(map2 + i)));
+      }
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, _mm_setzero_si128()))
+          != 0xffff)
+      {
+         return true;
+      }
+   }
+#endif /* __SSE2__ */
+   for (; i + 2 <= words; i += 2)
+   {
+      uint64_t w = bmLoad64(map1 + i);
+
+      if (map2)
+      {
+         w &= bmLoad64(map2 + i);
+      }
+      if (w)
+      {
+         return true;
+      }
+   }
+   for (; i < words; i++)
+   {
+      if (map2 ? (map1[i] & map2[i]) : map1[i])
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+static inline uint32_t
+bmCount(const uint32_t *map, uint32_t words)
+{
+   uint32_t i = 0;
+   uint32_t count = 0;
+
+   for (; i + 2 <= words; i += 2)
+   {
+      count += __POPCNT64(bmLoad64(map + i));
+   }
+   if (i < words)
+   {
+      count += __POPCNT32(map[i]);
+   }
+   return count;
+}
+
+/* 0-based index of the first set bit at or after 'start', or -1.  Bits past
+ * maxBits in the final word are reported like any other; callers range
+ * check the result as they always have. */
+static inline int
+bmFindFrom(const uint32_t *map, uint32_t start, uint32_t maxBits)
+{
+   uint32_t words = (maxBits + 31) / 32;
+   uint32_t idx = start / 32;
+   uint32_t w;
+
+   if (idx >= words)
+   {
+      return -1;
+   }
+
+   /* the common case in a walk: the next bit shares the word */
+   w = map[idx] & (~0u << (start % 32));
+   if (w)
+   {
+      return (int)(idx * 32 + __CTZ32(w));
+   }
+
+   /* skip empty space 64 bits at a time */
+   for (idx++; idx + 2 <= words; idx += 2)
+   {
+      if (bmLoad64(map + idx))
+      {
+         if (!map[idx])
+         {
+            idx++;
+         }
+         return (int)(idx * 32 + __CTZ32(map[idx]));
+      }
+   }
+   if ((idx < words) && map[idx])
+   {
+      return (int)(idx * 32 + __CTZ32(map[idx]));
+   }
+   return -1;
+}
 
 /* Bit map operations
  * Notes:
@@ -203,13 +399,8 @@ void clrBitInByteArray(uint8_t *map, uint32_t bit, uint32_t maxBits)
 extern
 int ones8(uint8_t x)
 {
-   /* This is magic that returns the number of trailing 0s
-     * in any 32 bit number
-   */
-   x -= ((x >> 1) & 0x55);
-   x = (((x >> 2) & 0x33) + (x & 0x33));
-   x = (((x >> 4) + x) & 0x0f);
-   return(x & 0x3f);
+   /* number of bits set in x */
+   return(__POPCNT32(x));
 }
 
 /************ find first bit in bitmap *************/
@@ -240,8 +431,7 @@ int findFirstBitSetInSmallBitmap(const uint32_t *map, uint32_t maxBits)
 extern
 int findFirstBitSet(const uint32_t *map, uint32_t maxBits)
 {
-   uint32_t i;
-   uint32_t lsb; /* least significant bit */
+   int bit;
 
    if (maxBits <= 32)
    {
@@ -254,21 +444,12 @@ int findFirstBitSet(const uint32_t *map, uint32_t maxBits)
        return -1;/*(0xffffffff);*/
    }
 
-   for (i = 0; i < maxBits; i += 32)
+   bit = bmFindFrom(map, 0, maxBits);
+   if ((bit < 0) || ((uint32_t)bit >= maxBits))
    {
-      if (*map)
-      {
-         /* at least one bit is set in this word */
-         /* return which one */
-         /* This is the least significant bit of hi[i] */
-         lsb = __FFS32(*map);
-         if ((i + lsb) > maxBits)
-            return -1;
-         return (i + lsb);
-      }
-      map++;
+      return -1;
    }
-   return -1;
+   return (bit + 1);
 }
 
 extern
@@ -370,10 +551,8 @@ int findNextBitSetInSmallBitmap(const uint32_t *map, uint32_t prevBit,
 extern
 int findNextBitSet(const uint32_t *map, uint32_t prevBit, uint32_t maxBits)
 {
-   int      word;
-   uint32_t i;
-   uint32_t lsb; /* least significant bit */
-   uint32_t mask;
+   int      bit;
+
    if(maxBits <= 32)
    {
       return  findNextBitSetInSmallBitmap(map, prevBit, maxBits);
@@ -388,30 +567,14 @@ int findNextBitSet(const uint32_t *map, uint32_t prevBit, uint32_t maxBits)
        return -1;
    }
 
-   /* Start at the bit just after prevBit */
-   word = prevBit >> 5;
-   map += word;
-   prevBit = prevBit - (word << 5);
-   mask = ~(1u << prevBit) + 1u;
-
-   for (i = word * 32; i < maxBits; i += 32) {
-      mask &= *map;
-      if (mask) {
-         /* at least one bit is set in this word */
-         /* return which one */
-         /* This is the least significant bit of hi[i] */
-         lsb = __CTZ32(mask) + 1;
-         if ((i + lsb) > maxBits)
-         {
-            return -1;
-         }
-         return (i + lsb);
-      }
-      map++;
-      mask = ~0u; /* 0xffffffff */
+   /* Start at the bit just after prevBit; with 1-based bits that is the
+    * 0-based index prevBit */
+   bit = bmFindFrom(map, prevBit, maxBits);
+   if ((bit < 0) || ((uint32_t)bit >= maxBits))
+   {
+      return -1;
    }
-
-   return -1;/*(0xffffffff);*/
+   return (bit + 1);
 }
 
 extern
@@ -780,11 +943,11 @@ void bitOrBitmaps(const uint32_t *fromMap, uint32_t *toMap, uint32_t maxBits)
    }
    if(fromMap && toMap)
    {
-      /* do all but the final word a word at a time */
-      for (i = maxBits; i >= 32; i -= 32)
-      {
-         *toMap++ |= *fromMap++;
-      }
+      /* do all but the final word in bulk */
+      bmBulkOp(fromMap, toMap, maxBits / 32, BM_OP_OR);
+      toMap += maxBits / 32;
+      fromMap += maxBits / 32;
+      i = maxBits % 32;
 
       if (i > 0)
       {
@@ -860,11 +1023,11 @@ void bitAndBitmaps(const uint32_t *fromMap, uint32_t *toMap,
    if(fromMap && toMap)
    {
 
-      /* do all but the final word a word at a time */
-      for (i = maxBits; i >= 32; i -= 32)
-      {
-         *toMap++ &= *fromMap++;
-      }
+      /* do all but the final word in bulk */
+      bmBulkOp(fromMap, toMap, maxBits / 32, BM_OP_AND);
+      toMap += maxBits / 32;
+      fromMap += maxBits / 32;
+      i = maxBits % 32;
 
       if (i > 0)
       {
@@ -921,14 +1084,14 @@ bool bitmapsOverlap(const uint32_t *map1, const uint32_t *map2,
 
    if(map1 && map2)
    {
-      /* do all but the final word a word at a time */
-      for (i = maxBits; i >= 32; i -= 32)
+      /* do all but the final word in bulk */
+      if (bmAny(map1, map2, maxBits / 32))
       {
-         if (*map1++ & *map2++)
-         {
-            return true;
-         }
+         return true;
       }
+      map1 += maxBits / 32;
+      map2 += maxBits / 32;
+      i = maxBits % 32;
 
       if (i > 0)
       {
@@ -1056,11 +1219,11 @@ void bitXorBitmaps(const uint32_t *fromMap, uint32_t *toMap, uint32_t maxBits)
 
    if(fromMap && toMap)
    {
-      /* do all but the final word a word at a time */
-      for (i = maxBits; i >= 32; i -= 32)
-      {
-         *toMap++ ^= *fromMap++;
-      }
+      /* do all but the final word in bulk */
+      bmBulkOp(fromMap, toMap, maxBits / 32, BM_OP_XOR);
+      toMap += maxBits / 32;
+      fromMap += maxBits / 32;
+      i = maxBits % 32;
 
       if (i > 0)
       {
@@ -1141,11 +1304,11 @@ void bitSubBitmaps(const uint32_t *fromMap, uint32_t *toMap, uint32_t maxBits)
    }
    if(fromMap && toMap)
    {
-      /* do all but the final word a word at a time */
-      for (i = maxBits; i >= 32; i -= 32)
-      {
-         *toMap++ &= ~*fromMap++;
-      }
+      /* do all but the final word in bulk */
+      bmBulkOp(fromMap, toMap, maxBits / 32, BM_OP_SUB);
+      toMap += maxBits / 32;
+      fromMap += maxBits / 32;
+      i = maxBits % 32;
 
       if (i > 0)
       {
@@ -1208,7 +1371,6 @@ bool areAnyBitsSetInSmallBitmap(const uint32_t *map, uint32_t maxBits)
 extern
 bool areAnyBitsSetInBitmap(const uint32_t *map, uint32_t maxBits)
 {
-   int i;
    /* maxBits is ignored, if it is not divisible by 32 */
 
    if (maxBits <= 32)
@@ -1221,14 +1383,7 @@ bool areAnyBitsSetInBitmap(const uint32_t *map, uint32_t maxBits)
       return(false);
    }
 
-   for (i = maxBits; i > 0; i -= 32)
-   {
-      if (*map++)
-      {
-         return(true);
-      }
-   }
-   return(false);
+   return(bmAny(map, NULL, (maxBits + 31) / 32));
 }
 
 
@@ -1239,7 +1394,6 @@ extern
 uint32_t getNumOfBitsSetInSmallBitmap(const uint32_t *map, uint32_t maxBits)
 {
    uint32_t count=0;
-   uint32_t val;
 
    if (!map || (maxBits > 32))
    {
@@ -1247,20 +1401,13 @@ uint32_t getNumOfBitsSetInSmallBitmap(const uint32_t *map, uint32_t maxBits)
       return(0);
    }
 
-   /* algorithm from http://graphics.stanford.edu/~seander/bithacks.html */
-   val = map[0] - ((map[0] >> 1) & 0x55555555);
-   val = (val & 0x33333333) + ((val >> 2) & 0x33333333);
-   count = (((val + (val >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+   count = __POPCNT32(map[0]);
    return(count);
 }
 
 extern
 uint32_t getNumOfBitsSetInBitmap(const uint32_t *map, uint32_t maxBits)
 {
-   int i;
-   uint32_t val;
-   uint32_t count=0;
-
    if (maxBits <= 32)
    {
        return getNumOfBitsSetInSmallBitmap(map, maxBits);
@@ -1274,15 +1421,7 @@ uint32_t getNumOfBitsSetInBitmap(const uint32_t *map, uint32_t maxBits)
       return(0);
    }
 
-   for (i = maxBits; i > 0; i -= 32)
-   {
-      /* algorithm @ http://graphics.stanford.edu/~seander/bithacks.html */
-      val = *map - ((*map >> 1) & 0x55555555);
-      val = (val & 0x33333333) + ((val >> 2) & 0x33333333);
-      count += (((val + (val >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-      map++;
-   }
-   return(count);
+   return(bmCount(map, (maxBits + 31) / 32));
 }
 
 
@@ -1345,8 +1484,6 @@ extern
 bool areBitmapsEqual(const uint32_t *map1, const uint32_t *map2,
                         uint32_t maxBits)
 {
-   int i;
-
    if (maxBits <= 32)
    {
       return areSmallBitmapsEqual(map1, map2, maxBits);
@@ -1358,15 +1495,7 @@ bool areBitmapsEqual(const uint32_t *map1, const uint32_t *map2,
       return(false);
    }
 
-   for (i = maxBits; i > 0; i -= 32)
-   {
-      if (*map1++ != *map2++)
-      {
-         return(false);
-      }
-   }
-
-   return(true);
+   return(memcmp(map1, map2, ((maxBits + 31) / 32) * sizeof(uint32_t)) == 0);
 }
 
 
@@ -70,15 +70,6 @@ pthread_mutex_t ovsdb_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define INTF_TO_MSTP_LINK_SPEED(s)    ((s)/MEGA_BITS_PER_SEC)
 #define VERIFY_LAG_IFNAME(s) strncasecmp(s, "lag", 3)
 
-/* NOTE: These  MSTP LAG IDs are only used for MSTP  state machine.
- *       They are not necessarily the same as h/w LAG ID. */
-#define MSTP_LAG_ID_IN_USE   1
-#define VALID_MSTP_LAG_ID(x) ((x)>=mstp_min_lag_id && (x)<=mstp_max_lag_id)
-
-const uint16_t mstp_min_lag_id = 1;
-uint16_t mstp_max_lag_id = 0; // This will be set in mstpd_init_lag_id_pool
-uint16_t *mstp_lag_id_pool = NULL;
-
 struct ovsdb_idl *idl;           /*!< Session handle for OVSDB IDL session. */
 static unsigned int idl_seqno;
 static int system_configured = false;
@@ -88,6 +79,10 @@ struct mstp_cist_data *cist_data;
 VID_MAP cist_vlan_list;
 static int n_cist_vlans = 0;
 bool init_required = true;
+static bool idl_had_lock = false;
+static bool resync_required = false;
+/* Compare cache content instead of row counts on the next reconfigure */
+static bool config_diff_force = false;
 void util_add_default_ports_to_cist();
 void util_add_default_ports_to_mist();
 void util_mstp_set_defaults();
@@ -100,6 +95,10 @@ struct mstp_cist_config mstp_cist_conf;
 PORT_MAP l2ports;
 uint16_t n_l2ports = 1; /*bridge_normal will be set by default*/
 
+/* Link state changes seen during the current reconfigure pass */
+static PORT_MAP link_up_ports;
+static PORT_MAP link_down_ports;
+
 MSTI_MAP mstp_instance_map;
 uint16_t n_msti = 0;
 
@@ -255,64 +254,6 @@ int allocate_static_index(char *name)
     return lport_id;
 }
 
-static void
-mstpd_init_lag_id_pool(uint16_t count)
-{
-    if (mstp_lag_id_pool == NULL) {
-        /* Track how many we're allocating. */
-        mstp_max_lag_id = count;
-
-        /* Allocate an extra one to skip LAG ID 0. */
-        mstp_lag_id_pool = (uint16_t *)xcalloc(count+1, sizeof(uint16_t));
-        VLOG_DBG("mstpd: allocated %d LAG IDs", count);
-    }
-} /* mstpd_init_lag_id_pool */
-
-static uint16_t
-mstpd_alloc_lag_id(void)
-{
-    if (mstp_lag_id_pool != NULL) {
-        uint16_t id;
-
-        for (id=mstp_min_lag_id; id<=mstp_max_lag_id; id++) {
-
-            if (mstp_lag_id_pool[id] == MSTP_LAG_ID_IN_USE) {
-                continue;
-            }
-
-            /* Found an available LAG_ID. */
-            mstp_lag_id_pool[id] = MSTP_LAG_ID_IN_USE;
-            return id;
-        }
-    } else {
-        VLOG_ERR("MSTP LAG ID pool not initialized!");
-    }
-
-    /* No free MSTP LAG ID available if we get here. */
-    return 0;
-
-} /* mstpd_alloc_lag_id */
-
-static void
-mstpd_free_lag_id(uint16_t id)
-{
-    if ((mstp_lag_id_pool != NULL) && VALID_MSTP_LAG_ID(id)) {
-        if (mstp_lag_id_pool[id] == MSTP_LAG_ID_IN_USE) {
-            mstp_lag_id_pool[id] = 0;
-        } else {
-            VLOG_ERR("Trying to free an unused MSTP LAGID (%d)!", id);
-        }
-    } else {
-        if (mstp_lag_id_pool == NULL) {
-            VLOG_ERR("Attempt to free MSTP LAG ID when"
-                     "pool is not initialized!");
-        } else {
-            VLOG_ERR("Attempt to free invalid MSTP LAG ID %d!", id);
-        }
-    }
-
-} /* mstpd_free_lag_id */
-
 /**PROC+**********************************************************************
  * Name:     allocate_reserved_id
  *
@@ -449,6 +390,8 @@ find_iface_data_by_name(char *name)
 void
 mstpd_ovsdb_init(const char *db_path)
 {
+    gettimeofday(&mstp_perfStats.daemonStartTime, NULL);
+
     /* Initialize IDL through a new connection to the dB. */
     idl = ovsdb_idl_create(db_path, &ovsrec_idl_class, false, true);
     idl_seqno = ovsdb_idl_get_seqno(idl);
@@ -845,52 +788,21 @@ static void send_mstp_msti_config_delete(struct mstp_msti_config_delete *msti_co
     }
 }
 
-/**PROC+****************************************************************
- * Name:    send_interface_add_msg
- *
- * Purpose:  Send Interface update to daemon.
- *
- * Params:    none
- *
- * Returns:   none
- *
- **PROC-*****************************************************************/
-
-void
-send_interface_add_msg(struct iface_data *info_ptr)
-{
-    int msgSize = 0;
-    mstpd_message *msg;
-    mstp_lport_add *event;
-    msgSize = sizeof(mstp_lport_add)+sizeof(mstpd_message);
-    msg = (mstpd_message *)alloc_msg(msgSize);
-    if (NULL == msg) {
-        VLOG_ERR("Out of memory for MSTP timer message.");
-        return;
-    }
-
-    if (msg != NULL) {
-	    msg->msg_type = e_mstpd_lport_add;
-        event = ( mstp_lport_add *)(msg+1);
-        event->lportname = info_ptr->name;
-        mstpd_send_event(msg);
-    }
-} /* send_interface_add_msg */
 /**PROC+****************************************************************
  * Name:    send_vlan_add_msg
  *
  * Purpose:  Send VLAN update to daemon.
  *
- * Params:    none
+ * Params:    vids -> all the VLANs added in this reconfigure pass
  *
  * Returns:   none
  *
  **PROC-*****************************************************************/
 
 static void
-send_vlan_add_msg(uint32_t vid)
+send_vlan_add_msg(const VID_MAP *vids)
 {
-    VLOG_DBG("VLAN add send event : %d", vid);
+    VLOG_DBG("VLAN add send event : %d VLANs", count_vids(vids));
     int msgSize = 0;
     mstpd_message *msg;
     mstp_vlan_add *event;
@@ -903,7 +815,7 @@ send_vlan_add_msg(uint32_t vid)
     if(msg != NULL) {
         msg->msg_type = e_mstpd_vlan_add;
         event = (mstp_vlan_add *)(msg+1);
-        event->vid = vid;
+        copy_vid_map(vids, &event->vids);
         mstpd_send_event(msg);
     }
 }
@@ -913,16 +825,16 @@ send_vlan_add_msg(uint32_t vid)
  *
  * Purpose:  Send VLAN update to daemon.
  *
- * Params:    none
+ * Params:    vids -> all the VLANs deleted in this reconfigure pass
  *
  * Returns:   none
  *
  **PROC-*****************************************************************/
 
 static void
-send_vlan_delete_msg(uint32_t vid)
+send_vlan_delete_msg(const VID_MAP *vids)
 {
-    VLOG_DBG("VLAN delete send event : %d", vid);
+    VLOG_DBG("VLAN delete send event : %d VLANs", count_vids(vids));
     int msgSize = 0;
     mstpd_message *msg;
     mstp_vlan_delete *event;
@@ -935,7 +847,7 @@ send_vlan_delete_msg(uint32_t vid)
     if(msg != NULL) {
         msg->msg_type = e_mstpd_vlan_delete;
         event = (mstp_vlan_delete *)(msg+1);
-        event->vid = vid;
+        copy_vid_map(vids, &event->vids);
         mstpd_send_event(msg);
     }
 }
@@ -944,16 +856,16 @@ send_vlan_delete_msg(uint32_t vid)
  *
  * Purpose:  Send L2port update to daemon.
  *
- * Params:    none
+ * Params:    lports -> all the L2 ports added in this reconfigure pass
  *
  * Returns:   none
  *
  **PROC-*****************************************************************/
 
 static void
-send_l2port_add_msg(uint32_t lport)
+send_l2port_add_msg(const PORT_MAP *lports)
 {
-    VLOG_DBG("L2port add send event : %d", lport);
+    VLOG_DBG("L2port add send event : %d ports", get_num_of_ports_set(lports));
     int msgSize = 0;
     mstpd_message *msg;
     mstp_lport_add *event;
@@ -966,7 +878,7 @@ send_l2port_add_msg(uint32_t lport)
     if(msg != NULL) {
         msg->msg_type = e_mstpd_lport_add;
         event = (mstp_lport_add *)(msg+1);
-        event->lportindex = lport;
+        copy_port_map(lports, &event->lports);
         mstpd_send_event(msg);
     }
 }
@@ -1036,6 +948,32 @@ send_admin_status_change_msg(bool status)
     }
 } /* send_admin_status_change_msg */
 
+/**PROC+****************************************************************
+ * Name:    send_db_resync_msg
+ *
+ * Purpose:  Ask the protocol thread to republish its port states after
+ *           the OVSDB session was re-established.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+
+static void
+send_db_resync_msg(void)
+{
+    VLOG_DBG("MSTP_DBG DB resync send event");
+    mstpd_message *msg;
+    msg = (mstpd_message *)alloc_msg(sizeof(mstpd_message));
+    if (NULL == msg) {
+        VLOG_ERR("Out of memory for MSTP DB resync message.");
+        return;
+    }
+    msg->msg_type = e_mstpd_db_resync;
+    mstpd_send_event(msg);
+} /* send_db_resync_msg */
+
 /**PROC+****************************************************************
  * Name:    del_old_interface
  *
@@ -1057,6 +995,7 @@ del_old_interface(struct shash_node *sh_node)
                 mstpd_free_lag_id((idp->lport_id - MAX_PPORTS));
             }
             deregister_stp_mcast_addr(idp->lport_id);
+            free(idp->mac_in_use);
             free(idp->name);
             idp_lookup[idp->lport_id] = NULL;
             free(idp);
@@ -1191,20 +1130,114 @@ add_new_lag_interface(const struct ovsrec_port *prow)
     }
 } /* add_new_interface */
 
+/**PROC+****************************************************************
+ * Name:    note_link_state_change
+ *
+ * Purpose:  Record a link state change of an interface, to be sent to
+ *           the daemon along with the other ones of this reconfigure pass
+ *
+ * Params: iface_data object
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+static void
+note_link_state_change(struct iface_data *info_ptr)
+{
+    if ((info_ptr->lport_id <= 0) || (info_ptr->lport_id > MAX_LPORTS)) {
+        return;
+    }
+    if (info_ptr->link_state == INTERFACE_LINK_STATE_UP) {
+        clear_port(&link_down_ports, info_ptr->lport_id);
+        set_port(&link_up_ports, info_ptr->lport_id);
+    } else {
+        clear_port(&link_up_ports, info_ptr->lport_id);
+        set_port(&link_down_ports, info_ptr->lport_id);
+    }
+} /* note_link_state_change */
+
 /**PROC+****************************************************************
  * Name:    send_link_state_change_msg
  *
- * Purpose:  Send link state update to daemon
+ * Purpose:  Send the link state changes of a reconfigure pass to daemon
+ *           in a single message, so it applies them as one batch
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+static void
+send_link_state_change_msg(void)
+{
+    int msgSize = 0;
+    mstpd_message *msg = NULL;
+    mstp_lport_link_change *event;
+
+    if (!are_any_ports_set(&link_up_ports) &&
+        !are_any_ports_set(&link_down_ports)) {
+        return;
+    }
+    msgSize = sizeof(mstp_lport_link_change)+sizeof(mstpd_message);
+    msg = (mstpd_message *)alloc_msg(msgSize);
+
+    if (msg != NULL) {
+        msg->msg_type = e_mstpd_lport_link_change;
+        event = (mstp_lport_link_change *)(msg+1);
+        copy_port_map(&link_up_ports, &event->up);
+        copy_port_map(&link_down_ports, &event->down);
+        mstpd_send_event(msg);
+    } else {
+      VLOG_ERR("Out of memory for MSTP link state change message.");
+    }
+    clear_port_map(&link_up_ports);
+    clear_port_map(&link_down_ports);
+} /* send_link_state_change_msg */
+
+/**PROC+****************************************************************
+ * Name:    send_link_speed_change_msg
+ *
+ * Purpose:  Send link speed/duplex update of a port that stays up
+ *           to daemon
  *
  * Params: iface_data object
  *
  * Returns:   none
  *
  **PROC-*****************************************************************/
+static void
+send_link_speed_change_msg(struct iface_data *info_ptr)
+{
+    int msgSize = 0;
+    mstpd_message *msg = NULL;
+    mstp_lport_state_change *event;
+    msgSize = sizeof(mstp_lport_state_change)+sizeof(mstpd_message);
+    msg = (mstpd_message *)alloc_msg(msgSize);
 
+    if (msg != NULL) {
+        msg->msg_type = e_mstpd_lport_speed_change;
+        event = ( mstp_lport_state_change *)(msg+1);
+        event->lportname = info_ptr->name;
+        event->lportindex = info_ptr->lport_id;
+        mstpd_send_event(msg);
+    } else {
+      VLOG_ERR("Out of memory for MSTP link speed change message.");
+      return;
+    }
+} /* send_link_speed_change_msg */
 
+/**PROC+****************************************************************
+ * Name:    send_link_mac_change_msg
+ *
+ * Purpose:  Send MAC address update of a port to daemon
+ *
+ * Params: iface_data object
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
 static void
-send_link_state_change_msg(struct iface_data *info_ptr)
+send_link_mac_change_msg(struct iface_data *info_ptr)
 {
     int msgSize = 0;
     mstpd_message *msg = NULL;
@@ -1213,18 +1246,16 @@ send_link_state_change_msg(struct iface_data *info_ptr)
     msg = (mstpd_message *)alloc_msg(msgSize);
 
     if (msg != NULL) {
-	    msg->msg_type = ((info_ptr->link_state == INTERFACE_LINK_STATE_UP) ?
-                         e_mstpd_lport_up :
-                         e_mstpd_lport_down);
+        msg->msg_type = e_mstpd_lport_mac_change;
         event = ( mstp_lport_state_change *)(msg+1);
         event->lportname = info_ptr->name;
         event->lportindex = info_ptr->lport_id;
         mstpd_send_event(msg);
     } else {
-      VLOG_ERR("Out of memory for MSTP link state change message.");
+      VLOG_ERR("Out of memory for MSTP link MAC change message.");
       return;
     }
-} /* send_link_state_change_msg */
+} /* send_link_mac_change_msg */
 
 static void
 update_lag_interface(const struct ovsrec_port *prow,
@@ -1238,6 +1269,7 @@ update_lag_interface(const struct ovsrec_port *prow,
         PORT_DUPLEX new_duplex = HALF_DUPLEX;
         const char *link_state = NULL;
         const char *link_speed = NULL;
+        bool speed_changed = false;
 
         for (int k = 0; k < prow->n_interfaces; k++) {
             ifrow = prow->interfaces[k];
@@ -1249,6 +1281,7 @@ update_lag_interface(const struct ovsrec_port *prow,
         }
         if ((new_duplex != idp->duplex)) {
             idp->duplex = new_duplex;
+            speed_changed = true;
             VLOG_DBG("Lag %s link duplex changed in DB: "
                      " new_duplex=%s ",
                      prow->name,
@@ -1265,7 +1298,11 @@ update_lag_interface(const struct ovsrec_port *prow,
         link_speed = smap_get(&prow->bond_status, PORT_BOND_STATUS_MAP_BOND_SPEED);
         if (link_speed) {
             /* dynamic lag speed. */
-            idp->link_speed = INTF_TO_MSTP_LINK_SPEED(atoi(link_speed));
+            unsigned int new_speed = INTF_TO_MSTP_LINK_SPEED(atoi(link_speed));
+            if (new_speed != idp->link_speed) {
+                idp->link_speed = new_speed;
+                speed_changed = true;
+            }
         }
 
         if ((new_link_state != idp->link_state)) {
@@ -1274,12 +1311,58 @@ update_lag_interface(const struct ovsrec_port *prow,
                      " new_link=%s ",
                      prow->name,
                      (idp->link_state == INTERFACE_LINK_STATE_UP ? "up" : "down"));
-            send_link_state_change_msg(idp);
-
+            note_link_state_change(idp);
+
+        } else if (speed_changed &&
+                   (idp->link_state == INTERFACE_LINK_STATE_UP)) {
+            /* Member added or removed while the LAG stays up, the logical
+             * port keeps its role and state, only its path cost changes. */
+            VLOG_DBG("Lag %s link speed changed in DB: new_speed=%u",
+                     prow->name, idp->link_speed);
+            send_link_speed_change_msg(idp);
         }
     }
 }
 
+/**PROC+****************************************************************
+ * Name:    update_interface_mac
+ *
+ * Purpose:  Track the MAC address BPDUs are sent from on the port, the
+ *           one of its first interface (see 'intf_get_mac_addr'). The
+ *           daemon is told when it changes, e.g. LAG members are added
+ *           or removed, or the hw_intf_info of the interface is updated.
+ *
+ * Params:    prow -> port row
+ *            idp  -> iface_data object of the port
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+static void
+update_interface_mac(const struct ovsrec_port *prow, struct iface_data *idp)
+{
+    const char *mac = NULL;
+
+    if (prow->n_interfaces > 0) {
+        mac = smap_get(&prow->interfaces[0]->hw_intf_info, "mac_addr");
+    }
+    if ((mac == NULL) && (idp->mac_in_use == NULL)) {
+        return;
+    }
+    if (mac && idp->mac_in_use && (strcmp(mac, idp->mac_in_use) == 0)) {
+        return;
+    }
+
+    /* nothing was sent from the port before its MAC was first known */
+    if (idp->mac_in_use) {
+        VLOG_DBG("Interface %s MAC address changed in DB: new_mac=%s",
+                 prow->name, mac ? mac : "none");
+        send_link_mac_change_msg(idp);
+    }
+    free(idp->mac_in_use);
+    idp->mac_in_use = mac ? xstrdup(mac) : NULL;
+}
+
 /***********************************************************************
  * Name:    update_interface_cache
  *
@@ -1356,6 +1439,7 @@ update_interface_cache(void)
             continue;
         }
 
+        update_interface_mac(prow, idp);
         if (!VERIFY_LAG_IFNAME(prow->name)) {
             /* update lag interface */
             update_lag_interface(prow, idp);
@@ -1395,7 +1479,7 @@ update_interface_cache(void)
                          " new_link=%s ",
                          ifrow->name,
                          (idp->link_state == INTERFACE_LINK_STATE_UP ? "up" : "down"));
-                send_link_state_change_msg(idp);
+                note_link_state_change(idp);
 
                 }
             }
@@ -1403,6 +1487,7 @@ update_interface_cache(void)
     }
     /* Destroy the shash of the IDL interfaces. */
     shash_destroy(&sh_idl_interfaces);
+    send_link_state_change_msg();
     return rc;
 
 }
@@ -1427,7 +1512,7 @@ static int update_l2port_cache(void)
     int rc = 0;
     int i = 0;
     bridge_row = ovsrec_bridge_first(idl);
-    if(n_l2ports != bridge_row->n_ports)
+    if(config_diff_force || n_l2ports != bridge_row->n_ports)
     {
         clear_port_map(&temp_ports);
         VLOG_DBG("Update L2 Port Cache : NO of ports changed");
@@ -1487,14 +1572,8 @@ static int update_l2port_cache(void)
             if(are_any_ports_set(&addPortMap))
             {
                 VLOG_DBG("Update L2 Port Cache : Addition of ports");
-                uint16_t lport = 0;
-                for(lport = find_first_port_set(&addPortMap);
-                        lport <= MAX_LPORTS;
-                        lport = find_next_port_set(&addPortMap, lport))
-                {
-                    rc++;
-                    send_l2port_add_msg(lport);
-                }
+                rc += get_num_of_ports_set(&addPortMap);
+                send_l2port_add_msg(&addPortMap);
             }
             copy_port_map(&temp_ports,&l2ports);
             n_l2ports = bridge_row->n_ports;
@@ -1515,7 +1594,7 @@ static int update_l2port_cache(void)
  **PROC-*****************************************************************/
 
 static void
-add_new_vlan(struct shash_node *sh_node)
+add_new_vlan(struct shash_node *sh_node, VID_MAP *vlans_added)
 {
     VLOG_DBG("Add VLAN Cache");
     struct vlan_data *new_vlan = NULL;
@@ -1532,7 +1611,7 @@ add_new_vlan(struct shash_node *sh_node)
 
         new_vlan->vlan_id = vlan_row->id;
         new_vlan->name = xstrdup(vlan_row->name);
-        send_vlan_add_msg(new_vlan->vlan_id);
+        set_vid(vlans_added, new_vlan->vlan_id);
         VLOG_DBG("Created local data for VLAN %d", (int)vlan_row->id);
     }
 } /* add_new_vlan */
@@ -1549,12 +1628,14 @@ add_new_vlan(struct shash_node *sh_node)
 
 
 static void
-del_old_vlan(struct shash_node *sh_node)
+del_old_vlan(struct shash_node *sh_node, VID_MAP *vlans_deleted)
 {
     if (sh_node) {
         VLOG_DBG("Delete VLAN Cache should send an update");
         struct vlan_data *vl = sh_node->data;
-        send_vlan_delete_msg(vl->vlan_id);
+        if (vlans_deleted) {
+            set_vid(vlans_deleted, vl->vlan_id);
+        }
         free(vl->name);
         free(vl);
         shash_delete(&all_vlans, sh_node);
@@ -1564,7 +1645,9 @@ del_old_vlan(struct shash_node *sh_node)
 /**PROC+****************************************************************
  * Name:    update_vlan_cache
  *
- * Purpose:  Update local cache for VLAN
+ * Purpose:  Update local cache for VLAN. All the VLANs added or deleted
+ *           in one pass are sent to the protocol thread as a single
+ *           VID map, so a VLAN range costs one DB commit, not one per VLAN.
  *
  * Params:    none
  *
@@ -1581,9 +1664,12 @@ update_vlan_cache(void)
     struct shash sh_idl_vlans;
     const struct ovsrec_vlan *row;
     struct shash_node *sh_node, *sh_next;
-    struct smap smap = SMAP_INITIALIZER(&smap);
+    VID_MAP vlans_added, vlans_deleted;
     int rc = 0;
 
+    clear_vid_map(&vlans_added);
+    clear_vid_map(&vlans_deleted);
+
     /* Collect all the VLANs in the DB. */
     shash_init(&sh_idl_vlans);
     OVSREC_VLAN_FOR_EACH(row, idl) {
@@ -1601,7 +1687,7 @@ update_vlan_cache(void)
         new_vlan = shash_find_data(&sh_idl_vlans, sh_node->name);
         if (!new_vlan) {
             VLOG_DBG("Found a deleted VLAN %s", sh_node->name);
-            del_old_vlan(sh_node);
+            del_old_vlan(sh_node, &vlans_deleted);
         }
     }
 
@@ -1610,13 +1696,20 @@ update_vlan_cache(void)
         new_vlan = shash_find_data(&all_vlans, sh_node->name);
         if (!new_vlan) {
             VLOG_DBG("Found an added VLAN %s", sh_node->name);
-            add_new_vlan(sh_node);
+            add_new_vlan(sh_node, &vlans_added);
         }
     }
 
     /* Destroy the shash of the IDL vlans */
     shash_destroy(&sh_idl_vlans);
 
+    if (are_any_vids_set(&vlans_deleted)) {
+        send_vlan_delete_msg(&vlans_deleted);
+    }
+    if (are_any_vids_set(&vlans_added)) {
+        send_vlan_add_msg(&vlans_added);
+    }
+
     return rc;
 
 } /* update_vlan_cache */
@@ -1691,6 +1784,7 @@ void
 mstpd_run(void)
 {
     struct ovsdb_idl_txn *txn;
+    struct timeval init_start;
 
     MSTP_OVSDB_LOCK;
 
@@ -1700,12 +1794,23 @@ mstpd_run(void)
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
         VLOG_ERR_RL(&rl, "Another mstpd process is running, "
                     "disabling this process until it goes away");
+        idl_had_lock = false;
         MSTP_OVSDB_UNLOCK;
         return;
     } else if (!ovsdb_idl_has_lock(idl)) {
+        /* The lock is dropped along with the OVSDB session. */
+        idl_had_lock = false;
         MSTP_OVSDB_UNLOCK;
         return;
     }
+    if (!idl_had_lock) {
+        idl_had_lock = true;
+        if (!init_required) {
+            /* Reconnected to OVSDB: reconcile instead of re-initializing */
+            VLOG_INFO("OVSDB session re-established, resyncing MSTP state");
+            resync_required = true;
+        }
+    }
     /* Update the local configuration and push any changes to the DB. */
     mstpd_chk_for_system_configured();
 
@@ -1713,6 +1818,8 @@ mstpd_run(void)
 
         if(init_required)
         {
+            gettimeofday(&init_start, NULL);
+
             /* clean the status parameter for first time even if cist exist */
             util_mstp_status_statistics_clean();
 
@@ -1722,14 +1829,28 @@ mstpd_run(void)
 
             util_mstp_init_config();
             init_required = false;
+
+            mstp_perfStats.dbInitMsec = mstp_perfElapsedMsec(&init_start);
+            VLOG_INFO("MSTP default DB population took %u msec",
+                      mstp_perfStats.dbInitMsec);
         }
 
+        /* After a reconnect the row counts may match a different content,
+         * make this pass compare the caches themselves. */
+        config_diff_force = resync_required;
+
        txn = ovsdb_idl_txn_create(idl);
         if (mstpd_reconfigure()) {
             /* Some OVSDB write needs to happen. */
             ovsdb_idl_txn_commit_block(txn);
         }
         ovsdb_idl_txn_destroy(txn);
+        config_diff_force = false;
+
+        if (resync_required) {
+            resync_required = false;
+            send_db_resync_msg();
+        }
     }
 
     MSTP_OVSDB_UNLOCK;
@@ -1922,6 +2043,47 @@ void update_mstp_counters(LPORT_t lport, const char *key)
     ovsdb_idl_txn_destroy(txn);
     MSTP_OVSDB_UNLOCK;
 }
+/**PROC+***********************************************************
+ * Name:    mstp_flap_config_value
+ *
+ * Purpose: Read a link flap dampening knob from the bridge
+ *          other_config. Values that are not a positive number keep
+ *          the default, values above the maximum are clamped to it.
+ *
+ * Params:    other_config -> bridge other_config
+ *            key          -> knob name
+ *            def_value    -> default value
+ *            max_value    -> maximum value
+ *
+ * Returns:   value of the knob
+ *
+ **PROC-*****************************************************************/
+
+static uint32_t mstp_flap_config_value(const struct smap *other_config,
+                                       const char *key, uint32_t def_value,
+                                       uint32_t max_value)
+{
+    const char *value = smap_get(other_config, key);
+    unsigned long num;
+    char *end = NULL;
+
+    if (!value) {
+        return def_value;
+    }
+    /* an out of range number reads as ULONG_MAX and is clamped below */
+    num = strtoul(value, &end, 10);
+    if ((end == value) || (*end != '\0') ||
+        (strchr(value, '-') != NULL) || (num == 0)) {
+        VLOG_ERR("MSTP invalid %s value %s, using %u", key, value, def_value);
+        return def_value;
+    }
+    if (num > max_value) {
+        VLOG_ERR("MSTP %s value %s above %u, using %u", key, value,
+                 max_value, max_value);
+        return max_value;
+    }
+    return (uint32_t)num;
+}
 /**PROC+***********************************************************
  * Name:    mstp_global_config_update
  *
@@ -1938,6 +2100,12 @@ int mstp_global_config_update(void) {
     const struct ovsrec_system *system_row = NULL;
     const char *mstp_config_name = NULL;
     const char *mstp_config_revision = NULL;
+    const char *flap_value = NULL;
+    bool flap_dampening = DEF_FLAP_DAMPENING;
+    uint32_t flap_penalty = DEF_FLAP_PENALTY;
+    uint32_t flap_suppress = DEF_FLAP_SUPPRESS;
+    uint32_t flap_reuse = DEF_FLAP_REUSE;
+    uint32_t flap_half_life = DEF_FLAP_HALF_LIFE;
     bool config_change = FALSE;
 
     bridge_row = ovsrec_bridge_first(idl);
@@ -1967,6 +2135,45 @@ int mstp_global_config_update(void) {
             config_change = TRUE;
         }
     }
+    /* Optional link flap dampening, values that are not positive numbers
+     * keep the defaults, values too large are clamped, thresholds that do
+     * not make sense (reuse not below suppress) keep the defaults */
+    flap_value = smap_get(&bridge_row->other_config, MSTP_FLAP_DAMPENING);
+    if (flap_value) {
+        flap_dampening = (strcmp(flap_value, "true") == 0);
+    }
+    flap_penalty = mstp_flap_config_value(&bridge_row->other_config,
+                                          MSTP_FLAP_PENALTY,
+                                          DEF_FLAP_PENALTY, MAX_FLAP_PENALTY);
+    flap_suppress = mstp_flap_config_value(&bridge_row->other_config,
+                                           MSTP_FLAP_SUPPRESS,
+                                           DEF_FLAP_SUPPRESS,
+                                           MAX_FLAP_SUPPRESS);
+    flap_reuse = mstp_flap_config_value(&bridge_row->other_config,
+                                        MSTP_FLAP_REUSE,
+                                        DEF_FLAP_REUSE, MAX_FLAP_REUSE);
+    flap_half_life = mstp_flap_config_value(&bridge_row->other_config,
+                                            MSTP_FLAP_HALF_LIFE,
+                                            DEF_FLAP_HALF_LIFE,
+                                            MAX_FLAP_HALF_LIFE);
+    if (flap_reuse >= flap_suppress) {
+        VLOG_ERR("MSTP flap reuse %u not below suppress %u, using defaults",
+                 flap_reuse, flap_suppress);
+        flap_suppress = DEF_FLAP_SUPPRESS;
+        flap_reuse = DEF_FLAP_REUSE;
+    }
+    if ((mstp_global_conf.flap_dampening != flap_dampening) ||
+        (mstp_global_conf.flap_penalty != flap_penalty) ||
+        (mstp_global_conf.flap_suppress != flap_suppress) ||
+        (mstp_global_conf.flap_reuse != flap_reuse) ||
+        (mstp_global_conf.flap_half_life != flap_half_life)) {
+        mstp_global_conf.flap_dampening = flap_dampening;
+        mstp_global_conf.flap_penalty = flap_penalty;
+        mstp_global_conf.flap_suppress = flap_suppress;
+        mstp_global_conf.flap_reuse = flap_reuse;
+        mstp_global_conf.flap_half_life = flap_half_life;
+        config_change = TRUE;
+    }
     if(config_change)
     {
         send_mstp_global_config_update(&mstp_global_conf);
@@ -2004,17 +2211,21 @@ int mstp_cist_config_update(void) {
         VLOG_DBG("MSTP CIST doesnot exist");
         return 0;
     }
-    if (n_cist_vlans != cist_row->n_vlans)
+    if (config_diff_force || n_cist_vlans != cist_row->n_vlans)
     {
-        clear_vid_map(&cist_vlan_list);
+        VID_MAP vlans;
+        clear_vid_map(&vlans);
         for (i = 0; i < cist_row->n_vlans; i++) {
             if (cist_row->vlans[i]) {
                 vlan_row = cist_row->vlans[i];
             }
-            set_vid(&cist_vlan_list,vlan_row->id);
+            set_vid(&vlans,vlan_row->id);
+        }
+        if (!are_vidmaps_equal(&vlans, &cist_vlan_list)) {
+            copy_vid_map(&vlans, &cist_vlan_list);
+            config_change = TRUE;
         }
         n_cist_vlans = cist_row->n_vlans;
-        config_change = TRUE;
     }
     if (mstp_cist_conf.priority != *cist_row->priority) {
         mstp_cist_conf.priority = *cist_row->priority;
@@ -2239,15 +2450,20 @@ int mstp_msti_update_config(void)
         {
             struct mstp_msti_config *msti_data = NULL;
             msti_data = msti_lookup[mstid];
-            if(msti_data->n_vlans != msti_row->n_vlans)
+            if(config_diff_force || msti_data->n_vlans != msti_row->n_vlans)
             {
-                clear_vid_map(&msti_data->vlans);
+                VID_MAP vlans;
+                clear_vid_map(&vlans);
                 for (j = 0; j < msti_row->n_vlans; j++) {
                     vlan_row = msti_row->vlans[j];
-                    set_vid(&msti_data->vlans,vlan_row->id);
+                    set_vid(&vlans,vlan_row->id);
+                }
+                if (!are_vidmaps_equal(&vlans, &msti_data->vlans))
+                {
+                    copy_vid_map(&vlans, &msti_data->vlans);
+                    config_change = TRUE;
                 }
                 msti_data->n_vlans = msti_row->n_vlans;
-                config_change = TRUE;
             }
             if(msti_data->priority != *msti_row->priority)
             {
@@ -2497,9 +2713,9 @@ void clear_interface_cache()
 void clear_vlan_cache()
 {
     struct shash_node *sh_node = NULL, *sh_next = NULL;
- /* Delete VLANS. */
+ /* Delete VLANS, the cache is rebuilt right after so no event is sent. */
     SHASH_FOR_EACH_SAFE(sh_node, sh_next, &all_vlans) {
-            del_old_vlan(sh_node);
+            del_old_vlan(sh_node, NULL);
     }
 }
 
@@ -2659,6 +2875,9 @@ mstpd_is_valid_port_row(const struct ovsrec_port *prow)
  * Name:    util_add_default_ports_to_mist
  *
  * Purpose: Add L2ports to the MIST at the time of INIT.
+ *          All the MSTI port rows of all the instances are created
+ *          in a single transaction, existing rows are looked up
+ *          through a per instance hash instead of a linear scan.
  *
  * Params:    none
  *
@@ -2674,6 +2893,7 @@ util_add_default_ports_to_mist() {
     int64_t port_priority = DEF_MSTP_PORT_PRIORITY;
     int64_t admin_path_cost = 0;
     struct ovsdb_idl_txn *txn = NULL;
+    struct shash mist_ports;
     int i = 0, j = 0,k = 0;
     uint64_t msti_port_count = 0;
 
@@ -2683,31 +2903,42 @@ util_add_default_ports_to_mist() {
         return;
     }
 
+    if (bridge_row->n_mstp_instances == 0) {
+        return;
+    }
+
+    /* Get the valid l2 port count*/
+    msti_port_count = mstp_util_get_valid_l2_ports(bridge_row);
+    if(msti_port_count == 0) {
+        VLOG_INFO("No valid L2 port found%s:%d", __FILE__, __LINE__);
+        return;
+    }
+
+    mstp_port_info = xmalloc(sizeof *mstp_row->mstp_instance_ports * msti_port_count);
+    if (!mstp_port_info)
+    {
+        VLOG_ERR("Failed to allocate memory for MSTI Port Info");
+        return;
+    }
+
+    txn = ovsdb_idl_txn_create(idl);
+
     for (k=0; k < bridge_row->n_mstp_instances; k++) {
         mstp_row = bridge_row->value_mstp_instances[k];
         if(!mstp_row) {
             assert(0);
-            return;
-        }
-
-        txn = ovsdb_idl_txn_create(idl);
-
-        /* Get the valid l2 port count*/
-        msti_port_count = mstp_util_get_valid_l2_ports(bridge_row);
-        if(msti_port_count == 0) {
-            VLOG_INFO("No valid L2 port found%s:%d", __FILE__, __LINE__);
-            ovsdb_idl_txn_commit_block(txn);
-            ovsdb_idl_txn_destroy(txn);
-            return;
+            break;
         }
 
-        mstp_port_info = xmalloc(sizeof *mstp_row->mstp_instance_ports * msti_port_count);
-        if (!mstp_port_info)
-        {
-            VLOG_ERR("Failed to allocate memory for MSTI Port Info");
-            ovsdb_idl_txn_commit_block(txn);
-            ovsdb_idl_txn_destroy(txn);
-            return;
+        /* Index the MSTI port rows already present in this instance */
+        shash_init(&mist_ports);
+        for (i=0; i < mstp_row->n_mstp_instance_ports; i++) {
+            mstp_port_row = mstp_row->mstp_instance_ports[i];
+            if (!mstp_port_row || !mstp_port_row->port) {
+                continue;
+            }
+            shash_add_once(&mist_ports, mstp_port_row->port->name,
+                           mstp_port_row);
         }
 
         for (j=0,i=0; i<bridge_row->n_ports; i++) {
@@ -2726,7 +2957,8 @@ util_add_default_ports_to_mist() {
                 continue;
             }
 
-            mstp_port_row = (struct ovsrec_mstp_instance_port *)util_get_mist_port(bridge_row->ports[i]->name, mstp_row);
+            mstp_port_row = shash_find_data(&mist_ports,
+                                            bridge_row->ports[i]->name);
             if(mstp_port_row) {
                 mstp_port_info[j++] = mstp_port_row;
                 continue;
@@ -2737,22 +2969,12 @@ util_add_default_ports_to_mist() {
             if (!mstp_port_row)
             {
                 VLOG_ERR("Failed to create Transaction for MSTI Port Info");
+                shash_destroy(&mist_ports);
                 ovsdb_idl_txn_commit_block(txn);
                 ovsdb_idl_txn_destroy(txn);
-                if(mstp_port_info)
-                    free(mstp_port_info);
+                free(mstp_port_info);
                 return;
             }
-            if (!bridge_row->ports[i])
-            {
-                VLOG_ERR("Failed to get Port Info for MSTP MSTI PORT");
-                ovsdb_idl_txn_commit_block(txn);
-                ovsdb_idl_txn_destroy(txn);
-                if(mstp_port_info)
-                    free(mstp_port_info);
-                return;
-            }
-
 
             /* FILL the default values for CIST_port entry */
             if (intf_get_link_state(bridge_row->ports[i]) == true) {
@@ -2782,19 +3004,21 @@ util_add_default_ports_to_mist() {
                     bridge_row->ports[i]);
             mstp_port_info[j++] = mstp_port_row;
         }
+        shash_destroy(&mist_ports);
         ovsrec_mstp_instance_set_mstp_instance_ports (mstp_row,
-                mstp_port_info, msti_port_count);
-        if(mstp_port_info)
-            free(mstp_port_info);
-        ovsdb_idl_txn_commit_block(txn);
-        ovsdb_idl_txn_destroy(txn);
+                mstp_port_info, j);
     }
+    free(mstp_port_info);
+    ovsdb_idl_txn_commit_block(txn);
+    ovsdb_idl_txn_destroy(txn);
 }
 
 /**PROC+***********************************************************
  * Name:    util_add_default_ports_to_cist
  *
  * Purpose: Add L2ports to the CIST at the time of INIT.
+ *          Existing CIST port rows are indexed by port name once, so
+ *          the population is linear in the number of ports.
  *
  * Params:    none
  *
@@ -2805,6 +3029,7 @@ void
 util_add_default_ports_to_cist() {
     struct ovsrec_mstp_common_instance_port *cist_port_row = NULL;
     struct ovsrec_mstp_common_instance_port **cist_port_info = NULL;
+    const struct ovsrec_mstp_common_instance_port *cist_port_db_row = NULL;
     struct ovsdb_idl_txn *txn = NULL;
     const struct ovsrec_bridge *bridge_row = NULL;
     const struct ovsrec_mstp_common_instance *cist_row = NULL;
@@ -2823,6 +3048,7 @@ util_add_default_ports_to_cist() {
     bool loop_guard_disable = false;
     bool bpdu_filter_disable = false;
     uint64_t cist_port_count = 0;
+    struct shash cist_ports;
 
     txn = ovsdb_idl_txn_create(idl);
 
@@ -2861,6 +3087,16 @@ util_add_default_ports_to_cist() {
         return;
     }
 
+    /* Index the CIST port rows already present in the DB */
+    shash_init(&cist_ports);
+    OVSREC_MSTP_COMMON_INSTANCE_PORT_FOR_EACH(cist_port_db_row, idl) {
+        if(!cist_port_db_row->port) {
+            continue;
+        }
+        shash_add_once(&cist_ports, cist_port_db_row->port->name,
+                       cist_port_db_row);
+    }
+
     for (i = 0,j =0 ; i < bridge_row->n_ports; i++) {
 
         if(!bridge_row->ports[i])
@@ -2877,7 +3113,7 @@ util_add_default_ports_to_cist() {
             /* port row not interested by mstp */
             continue;
         }
-        cist_port_row = (struct ovsrec_mstp_common_instance_port *)util_get_cist_port(bridge_row->ports[i]->name);
+        cist_port_row = shash_find_data(&cist_ports, bridge_row->ports[i]->name);
         if(cist_port_row) {
             cist_port_info[j++] = cist_port_row;
             continue;
@@ -2887,6 +3123,7 @@ util_add_default_ports_to_cist() {
         if (!cist_port_row)
         {
             VLOG_ERR("Failed to create Transaction for Cist Port Info");
+            shash_destroy(&cist_ports);
             ovsdb_idl_txn_commit_block(txn);
             ovsdb_idl_txn_destroy(txn);
             if(cist_port_info)
@@ -2896,6 +3133,7 @@ util_add_default_ports_to_cist() {
         if (!bridge_row->ports[i])
         {
             VLOG_ERR("Failed to get Port Info for MSTP CIST Port");
+            shash_destroy(&cist_ports);
             ovsdb_idl_txn_commit_block(txn);
             ovsdb_idl_txn_destroy(txn);
             if(cist_port_info)
@@ -2944,6 +3182,7 @@ util_add_default_ports_to_cist() {
         ovsrec_mstp_common_instance_port_set_restricted_port_tcn_disable( cist_port_row, &restricted_port_tcn_disable, 1);
         cist_port_info[j++] = cist_port_row;
     }
+    shash_destroy(&cist_ports);
     ovsrec_mstp_common_instance_set_mstp_common_instance_ports (cist_row,
                 cist_port_info, cist_port_count);
     if(cist_port_info)
@@ -2955,7 +3194,8 @@ util_add_default_ports_to_cist() {
 /**PROC+***********************************************************
  * Name:    util_mstp_instance_status_clean
  *
- * Purpose: Reset the status parameters to default for the CIST
+ * Purpose: Reset the status parameters to default for the MSTIs.
+ *          Must be called with a transaction already open.
  *
  * Params:    none
  *
@@ -2972,9 +3212,6 @@ util_mstp_instance_status_clean(time_t curr_time, const struct ovsrec_system *sy
     const struct ovsrec_mstp_instance_port *mstp_port_row = NULL;
     const struct ovsrec_mstp_instance *mstp_row = NULL;
     const bool topology_unstable = false;
-    struct ovsdb_idl_txn *txn = NULL;
-
-    txn = ovsdb_idl_txn_create(idl);
 
     bridge_row = ovsrec_bridge_first(idl);
     if (!bridge_row) {
@@ -3023,14 +3260,13 @@ util_mstp_instance_status_clean(time_t curr_time, const struct ovsrec_system *sy
             ovsrec_mstp_instance_port_set_designated_port(mstp_port_row, "");
         }
     }
-    ovsdb_idl_txn_commit_block(txn);
-    ovsdb_idl_txn_destroy(txn);
 }
 
 /**PROC+***********************************************************
  * Name:    util_mstp_common_instance_status_clean
  *
- * Purpose: Reset the status parameters to default for the CIST
+ * Purpose: Reset the status parameters to default for the CIST.
+ *          Must be called with a transaction already open.
  *
  * Params:    none
  *
@@ -3050,13 +3286,9 @@ util_mstp_common_instance_status_clean(time_t curr_time, const struct ovsrec_sys
     const bool topology_unstable = false;
     const bool bool_false = false;
     const int64_t def_zero = 0;
-    struct ovsdb_idl_txn *txn = NULL;
-
-    txn = ovsdb_idl_txn_create(idl);
 
     cist_row = ovsrec_mstp_common_instance_first (idl);
     if (!cist_row) {
-        ovsdb_idl_txn_destroy(txn);
         return;
     }
 
@@ -3106,14 +3338,14 @@ util_mstp_common_instance_status_clean(time_t curr_time, const struct ovsrec_sys
         smap_replace(&smap, MSTP_TX_BPDU , "0");
         smap_replace(&smap, MSTP_RX_BPDU , "0");
         ovsrec_mstp_common_instance_port_set_mstp_statistics(cist_port_row, &smap);
+        smap_destroy(&smap);
     }
-    ovsdb_idl_txn_commit_block(txn);
-    ovsdb_idl_txn_destroy(txn);
 }
 /**PROC+***********************************************************
  * Name:    util_mstp_status_statistics_clean
  *
- * Purpose: Reset the status parameters to default at the init
+ * Purpose: Reset the status parameters to default at the init.
+ *          MSTI and CIST rows are cleaned in a single transaction.
  *
  * Params:    none
  *
@@ -3125,6 +3357,7 @@ util_mstp_status_statistics_clean() {
 
     time_t curr_time;
     const struct ovsrec_system *system_row = NULL;
+    struct ovsdb_idl_txn *txn = NULL;
     time(&curr_time);
 
     system_row = ovsrec_system_first(idl);
@@ -3132,8 +3365,11 @@ util_mstp_status_statistics_clean() {
         return;
     }
 
+    txn = ovsdb_idl_txn_create(idl);
     util_mstp_instance_status_clean(curr_time, system_row);
     util_mstp_common_instance_status_clean(curr_time, system_row);
+    ovsdb_idl_txn_commit_block(txn);
+    ovsdb_idl_txn_destroy(txn);
 }
 /**PROC+***********************************************************
  * Name:    util_mstp_set_defaults
@@ -3619,159 +3855,137 @@ void mstp_convertPortRoleEnumToString(MSTP_PORT_ROLE_t role,char *string)
 /**PROC+***********************************************************
  * Name:    handle_vlan_add_in_mstp_config
  *
- * Purpose: Update DB on a VLAN ADD to the Bridge
+ * Purpose: Update DB on a VLAN ADD to the Bridge. The VLANs which are
+ *          not yet mapped to the CIST or to any MSTI are appended to
+ *          the CIST VLAN list in a single transaction.
  *
- * Params:    none
+ * Params:    vids -> VLANs added to the Bridge
  *
  * Returns:   none
  *
  **PROC-*****************************************************************/
 
-void handle_vlan_add_in_mstp_config(int vlan)
+void handle_vlan_add_in_mstp_config(const VID_MAP *vids)
 {
     struct ovsdb_idl_txn *txn = NULL;
     const struct ovsrec_mstp_common_instance *cist_row = NULL;
     const struct ovsrec_vlan *vlan_row = NULL;
     struct ovsrec_vlan **vlans = NULL;
-    int i = 0, vid = 0;
+    int i = 0, vid = 0, n_vlans = 0;
     const struct ovsrec_mstp_instance *msti_row = NULL;
-    bool vlan_found = FALSE;
-    bool cist_vlan_found = FALSE;
-    bool msti_vlan_found = FALSE;
+    VID_MAP new_vids;
+
+    STP_ASSERT(vids);
 
     MSTP_OVSDB_LOCK;
-    txn = ovsdb_idl_txn_create(idl);
-    if (vlan) {
-        OVSREC_VLAN_FOR_EACH(vlan_row, idl) {
-            if (vlan == vlan_row->id) {
-                vlan_found = TRUE;
-                break;
-            }
-        }
-        if (!vlan_found) {
-            ovsdb_idl_txn_commit_block(txn);
-            ovsdb_idl_txn_destroy(txn);
-            MSTP_OVSDB_UNLOCK;
-            return;
-        }
+    cist_row = ovsrec_mstp_common_instance_first(idl);
+    if (!cist_row) {
+        MSTP_OVSDB_UNLOCK;
+        return;
     }
 
+    /* Skip the VLANs which are already mapped to some instance */
+    copy_vid_map(vids, &new_vids);
     OVSREC_MSTP_INSTANCE_FOR_EACH(msti_row, idl) {
         for(vid = 0; vid < msti_row->n_vlans; vid++)
         {
-            if (vlan == msti_row->vlans[vid]->id)
-            {
-                msti_vlan_found = TRUE;
-            }
+            clear_vid(&new_vids, msti_row->vlans[vid]->id);
         }
     }
-    cist_row = ovsrec_mstp_common_instance_first(idl);
-    if (cist_row)
+    for(vid = 0; vid < cist_row->n_vlans; vid++)
     {
-        for(vid = 0; vid < cist_row->n_vlans; vid++)
-        {
-            if (vlan == cist_row->vlans[vid]->id)
-            {
-                cist_vlan_found = TRUE;
-            }
-        }
+        clear_vid(&new_vids, cist_row->vlans[vid]->id);
     }
-    if (!cist_vlan_found && !msti_vlan_found)
-    {
-        /* MSTP instance not found with the incoming instID */
-        if(cist_row) {
-            /* Push the complete vlan list to MSTP instance table
-             * including the new vlan*/
-            vlans =
-                xcalloc(cist_row->n_vlans + 1, sizeof *cist_row->vlans);
-            if (!vlans) {
-                ovsdb_idl_txn_commit_block(txn);
-                ovsdb_idl_txn_destroy(txn);
-            }
-            for (i = 0; i < cist_row->n_vlans; i++) {
-                vlans[i] = cist_row->vlans[i];
-            }
-            vlans[cist_row->n_vlans] = (struct ovsrec_vlan *)vlan_row;
-            ovsrec_mstp_common_instance_set_vlans(cist_row, vlans,
-                    cist_row->n_vlans + 1);
+    if (!are_any_vids_set(&new_vids)) {
+        MSTP_OVSDB_UNLOCK;
+        return;
+    }
+
+    /* Push the complete vlan list to MSTP common instance table
+     * including the new vlans */
+    vlans = xcalloc(cist_row->n_vlans + count_vids(&new_vids),
+                    sizeof *cist_row->vlans);
+    for (i = 0; i < cist_row->n_vlans; i++) {
+        vlans[n_vlans++] = cist_row->vlans[i];
+    }
+    OVSREC_VLAN_FOR_EACH(vlan_row, idl) {
+        if (is_vid_set(&new_vids, vlan_row->id)) {
+            vlans[n_vlans++] = (struct ovsrec_vlan *)vlan_row;
+            clear_vid(&new_vids, vlan_row->id);
         }
     }
-    ovsdb_idl_txn_commit_block(txn);
-    ovsdb_idl_txn_destroy(txn);
-    if (vlans)
-    {
-        free(vlans);
+
+    if (n_vlans != cist_row->n_vlans) {
+        txn = ovsdb_idl_txn_create(idl);
+        ovsrec_mstp_common_instance_set_vlans(cist_row, vlans, n_vlans);
+        ovsdb_idl_txn_commit_block(txn);
+        ovsdb_idl_txn_destroy(txn);
     }
+    free(vlans);
     MSTP_OVSDB_UNLOCK;
 }
 /**PROC+***********************************************************
  * Name:    handle_vlan_delete_in_mstp_config
  *
- * Purpose: Update DB on a VLAN Delete to the Bridge
+ * Purpose: Update DB on a VLAN Delete to the Bridge. The deleted VLANs
+ *          are removed from the CIST and all the MSTIs in a single
+ *          transaction, rows which do not hold any of them are left
+ *          untouched.
  *
- * Params:    none
+ * Params:    vids -> VLANs deleted from the Bridge
  *
  * Returns:   none
  *
  **PROC-*****************************************************************/
 
-void handle_vlan_delete_in_mstp_config(int vlan)
+void handle_vlan_delete_in_mstp_config(const VID_MAP *vids)
 {
     struct ovsdb_idl_txn *txn = NULL;
     const struct ovsrec_mstp_common_instance *cist_row = NULL;
     const struct ovsrec_mstp_instance *msti_row = NULL;
     struct ovsrec_vlan **vlans = NULL;
     int i = 0,j = 0;
+
+    STP_ASSERT(vids);
+
     MSTP_OVSDB_LOCK;
     cist_row = ovsrec_mstp_common_instance_first(idl);
-    if(cist_row) {
-        /* Push the complete vlan list to MSTP Common instance table
-         * including the new vlan*/
-        if (cist_row->n_vlans) {
-            txn = ovsdb_idl_txn_create(idl);
-            vlans =
-                xcalloc(cist_row->n_vlans - 1, sizeof *cist_row->vlans);
-            if (!vlans) {
-                ovsdb_idl_txn_commit_block(txn);
-                ovsdb_idl_txn_destroy(txn);
+    if(cist_row && cist_row->n_vlans) {
+        vlans = xcalloc(cist_row->n_vlans, sizeof *cist_row->vlans);
+        for (j=0, i = 0; i < cist_row->n_vlans; i++) {
+            if(!is_vid_set(vids, cist_row->vlans[i]->id)) {
+                vlans[j++] = cist_row->vlans[i];
             }
-            for (j=0, i = 0; i < cist_row->n_vlans; i++) {
-                if(vlan != cist_row->vlans[i]->id) {
-                    vlans[j++] = cist_row->vlans[i];
-                }
+        }
+        if (j != cist_row->n_vlans) {
+            if (!txn) {
+                txn = ovsdb_idl_txn_create(idl);
             }
-            ovsrec_mstp_common_instance_set_vlans(cist_row, vlans,
-                    cist_row->n_vlans - 1);
-            ovsdb_idl_txn_commit_block(txn);
-            ovsdb_idl_txn_destroy(txn);
-            free(vlans);
+            ovsrec_mstp_common_instance_set_vlans(cist_row, vlans, j);
         }
+        free(vlans);
     }
     OVSREC_MSTP_INSTANCE_FOR_EACH(msti_row,idl) {
-        if(msti_row) {
-            /* Push the complete vlan list to MSTP instance table
-             * including the new vlan*/
-            if (msti_row->n_vlans) {
+        if (!msti_row->n_vlans) {
+            continue;
+        }
+        vlans = xcalloc(msti_row->n_vlans, sizeof *msti_row->vlans);
+        for (j=0, i = 0; i < msti_row->n_vlans; i++) {
+            if(!is_vid_set(vids, msti_row->vlans[i]->id)) {
+                vlans[j++] = msti_row->vlans[i];
+            }
+        }
+        if (j != msti_row->n_vlans) {
+            if (!txn) {
                 txn = ovsdb_idl_txn_create(idl);
-                vlans =
-                    xcalloc(msti_row->n_vlans - 1, sizeof *msti_row->vlans);
-                if (!vlans) {
-                    ovsdb_idl_txn_commit_block(txn);
-                    ovsdb_idl_txn_destroy(txn);
-                }
-                for (j=0, i = 0; i < msti_row->n_vlans; i++) {
-                    if(vlan != msti_row->vlans[i]->id) {
-                        vlans[j++] = msti_row->vlans[i];
-                    }
-                }
-                ovsrec_mstp_instance_set_vlans(msti_row, vlans,
-                        msti_row->n_vlans - 1);
-                ovsdb_idl_txn_commit_block(txn);
-                ovsdb_idl_txn_destroy(txn);
-                free(vlans);
             }
+            ovsrec_mstp_instance_set_vlans(msti_row, vlans, j);
         }
-
+        free(vlans);
+    }
+    if (txn) {
+        ovsdb_idl_txn_commit_block(txn);
+        ovsdb_idl_txn_destroy(txn);
     }
     MSTP_OVSDB_UNLOCK;
 }
@@ -4133,6 +4347,241 @@ void update_port_entry_in_msti_mstp_instances(char *name,int operation) {
     ovsdb_idl_txn_destroy(txn);
     MSTP_OVSDB_UNLOCK;
 }
+/**PROC+***********************************************************
+ * Name:    util_set_default_cist_port_row
+ *
+ * Purpose: Fill the default values of a newly inserted CIST port row
+ *
+ * Params:    cist_port_row -> row to fill
+ *            port_row      -> Port row the entry refers to
+ *            link_up       -> current link state of the port
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+static void
+util_set_default_cist_port_row(
+        const struct ovsrec_mstp_common_instance_port *cist_port_row,
+        const struct ovsrec_port *port_row, bool link_up)
+{
+    int64_t cist_hello_time = DEF_HELLO_TIME;
+    int64_t cist_port_priority = DEF_MSTP_PORT_PRIORITY;
+    int64_t admin_path_cost = 0;
+    bool bool_false = false;
+
+    if (!VERIFY_LAG_IFNAME(port_row->name)) {
+        cist_port_priority = DEF_MSTP_LAG_PRIORITY;
+    }
+    ovsrec_mstp_common_instance_port_set_port(cist_port_row, port_row);
+    ovsrec_mstp_common_instance_port_set_port_state(cist_port_row,
+            link_up ? MSTP_STATE_FORWARD : MSTP_STATE_BLOCK);
+    ovsrec_mstp_common_instance_port_set_port_role(cist_port_row,
+            MSTP_ROLE_DISABLE);
+    ovsrec_mstp_common_instance_port_set_admin_path_cost(cist_port_row,
+            &admin_path_cost, 1);
+    ovsrec_mstp_common_instance_port_set_port_priority(cist_port_row,
+            &cist_port_priority, 1);
+    ovsrec_mstp_common_instance_port_set_link_type(cist_port_row,
+            DEF_LINK_TYPE);
+    ovsrec_mstp_common_instance_port_set_port_hello_time(cist_port_row,
+            &cist_hello_time, 1);
+    ovsrec_mstp_common_instance_port_set_bpdus_rx_enable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_bpdus_tx_enable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_admin_edge_port_disable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_bpdu_guard_disable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_root_guard_disable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_loop_guard_disable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_bpdu_filter_disable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_restricted_port_role_disable(cist_port_row, &bool_false, 1);
+    ovsrec_mstp_common_instance_port_set_restricted_port_tcn_disable(cist_port_row, &bool_false, 1);
+}
+
+/**PROC+***********************************************************
+ * Name:    util_set_default_msti_port_row
+ *
+ * Purpose: Fill the default values of a newly inserted MSTI port row
+ *
+ * Params:    msti_port_row -> row to fill
+ *            port_row      -> Port row the entry refers to
+ *            link_up       -> current link state of the port
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+static void
+util_set_default_msti_port_row(
+        const struct ovsrec_mstp_instance_port *msti_port_row,
+        const struct ovsrec_port *port_row, bool link_up)
+{
+    int64_t port_priority = DEF_MSTP_PORT_PRIORITY;
+    int64_t admin_path_cost = 0;
+
+    if (!VERIFY_LAG_IFNAME(port_row->name)) {
+        port_priority = DEF_MSTP_LAG_PRIORITY;
+    }
+    ovsrec_mstp_instance_port_set_port(msti_port_row, port_row);
+    ovsrec_mstp_instance_port_set_port_state(msti_port_row,
+            link_up ? MSTP_STATE_FORWARD : MSTP_STATE_BLOCK);
+    ovsrec_mstp_instance_port_set_port_role(msti_port_row,
+            MSTP_ROLE_DISABLE);
+    ovsrec_mstp_instance_port_set_admin_path_cost(msti_port_row,
+            &admin_path_cost, 1);
+    ovsrec_mstp_instance_port_set_port_priority(msti_port_row,
+            &port_priority, 1);
+}
+
+/**PROC+***********************************************************
+ * Name:    add_port_entries_in_mstp_instances
+ *
+ * Purpose: Add the CIST and MSTI port rows for a set of new L2 ports.
+ *          The bridge ports and the existing instance port rows are
+ *          indexed by name once and all the rows are inserted in a
+ *          single transaction, so the cost is linear in the number
+ *          of ports.
+ *
+ * Params:    lports -> L2 ports added to the Bridge
+ *
+ * Returns:   none
+ *
+ **PROC-*****************************************************************/
+void add_port_entries_in_mstp_instances(const PORT_MAP *lports)
+{
+    struct ovsdb_idl_txn *txn = NULL;
+    const struct ovsrec_bridge *bridge_row = NULL;
+    const struct ovsrec_mstp_common_instance *cist_row = NULL;
+    const struct ovsrec_mstp_instance *msti_row = NULL;
+    const struct ovsrec_port *port_row = NULL;
+    struct ovsrec_mstp_common_instance_port **cist_port_info = NULL;
+    struct ovsrec_mstp_instance_port **msti_port_info = NULL;
+    const struct ovsrec_port **new_ports = NULL;
+    bool *new_ports_up = NULL;
+    struct iface_data *idp = NULL;
+    struct shash bridge_ports, inst_ports;
+    size_t n_new = 0, n_ports = 0;
+    int i = 0, j = 0;
+    LPORT_t lport = 0;
+
+    STP_ASSERT(lports);
+
+    MSTP_OVSDB_LOCK;
+    bridge_row = ovsrec_bridge_first(idl);
+    if (!bridge_row) {
+        MSTP_OVSDB_UNLOCK;
+        return;
+    }
+
+    shash_init(&bridge_ports);
+    for (i = 0; i < bridge_row->n_ports; i++) {
+        if (bridge_row->ports[i]) {
+            shash_add_once(&bridge_ports, bridge_row->ports[i]->name,
+                           bridge_row->ports[i]);
+        }
+    }
+
+    /* Resolve the new lports to their Port rows */
+    new_ports = xcalloc(get_num_of_ports_set(lports), sizeof *new_ports);
+    new_ports_up = xcalloc(get_num_of_ports_set(lports), sizeof *new_ports_up);
+    for (lport = find_first_port_set(lports);
+            lport <= MAX_LPORTS;
+            lport = find_next_port_set(lports, lport))
+    {
+        idp = find_iface_data_by_index(lport);
+        if (!idp || strcmp(idp->name, DEFAULT_BRIDGE_NAME) == 0) {
+            continue;
+        }
+        port_row = shash_find_data(&bridge_ports, idp->name);
+        if (!port_row) {
+            VLOG_ERR("Failed to find corresponding Port Row for %s",
+                     idp->name);
+            continue;
+        }
+        new_ports[n_new] = port_row;
+        new_ports_up[n_new] = (idp->link_state != INTERFACE_LINK_STATE_DOWN);
+        n_new++;
+    }
+    shash_destroy(&bridge_ports);
+
+    if (n_new == 0) {
+        free(new_ports);
+        free(new_ports_up);
+        MSTP_OVSDB_UNLOCK;
+        return;
+    }
+
+    txn = ovsdb_idl_txn_create(idl);
+
+    cist_row = ovsrec_mstp_common_instance_first(idl);
+    if (cist_row) {
+        shash_init(&inst_ports);
+        cist_port_info =
+            xcalloc(cist_row->n_mstp_common_instance_ports + n_new,
+                    sizeof *cist_row->mstp_common_instance_ports);
+        for (n_ports = 0, i = 0; i < cist_row->n_mstp_common_instance_ports; i++) {
+            cist_port_info[n_ports++] = cist_row->mstp_common_instance_ports[i];
+            if (cist_row->mstp_common_instance_ports[i]->port) {
+                shash_add_once(&inst_ports,
+                        cist_row->mstp_common_instance_ports[i]->port->name,
+                        cist_row->mstp_common_instance_ports[i]);
+            }
+        }
+        for (j = 0; j < n_new; j++) {
+            if (shash_find_data(&inst_ports, new_ports[j]->name)) {
+                continue;
+            }
+            cist_port_info[n_ports] =
+                ovsrec_mstp_common_instance_port_insert(txn);
+            util_set_default_cist_port_row(cist_port_info[n_ports],
+                                           new_ports[j], new_ports_up[j]);
+            n_ports++;
+        }
+        if (n_ports != cist_row->n_mstp_common_instance_ports) {
+            ovsrec_mstp_common_instance_set_mstp_common_instance_ports(
+                    cist_row, cist_port_info, n_ports);
+        }
+        free(cist_port_info);
+        shash_destroy(&inst_ports);
+    }
+
+    for (i = 0; i < bridge_row->n_mstp_instances; i++) {
+        msti_row = bridge_row->value_mstp_instances[i];
+        if (!msti_row) {
+            continue;
+        }
+        shash_init(&inst_ports);
+        msti_port_info =
+            xcalloc(msti_row->n_mstp_instance_ports + n_new,
+                    sizeof *msti_row->mstp_instance_ports);
+        for (n_ports = 0; n_ports < msti_row->n_mstp_instance_ports; n_ports++) {
+            msti_port_info[n_ports] = msti_row->mstp_instance_ports[n_ports];
+            if (msti_port_info[n_ports]->port) {
+                shash_add_once(&inst_ports,
+                        msti_port_info[n_ports]->port->name,
+                        msti_port_info[n_ports]);
+            }
+        }
+        for (j = 0; j < n_new; j++) {
+            if (shash_find_data(&inst_ports, new_ports[j]->name)) {
+                continue;
+            }
+            msti_port_info[n_ports] = ovsrec_mstp_instance_port_insert(txn);
+            util_set_default_msti_port_row(msti_port_info[n_ports],
+                                           new_ports[j], new_ports_up[j]);
+            n_ports++;
+        }
+        if (n_ports != msti_row->n_mstp_instance_ports) {
+            ovsrec_mstp_instance_set_mstp_instance_ports(msti_row,
+                    msti_port_info, n_ports);
+        }
+        free(msti_port_info);
+        shash_destroy(&inst_ports);
+    }
+
+    ovsdb_idl_txn_commit_block(txn);
+    ovsdb_idl_txn_destroy(txn);
+    free(new_ports);
+    free(new_ports_up);
+    MSTP_OVSDB_UNLOCK;
+}
 /**PROC+***********************************************************
  * Name:    is_lport_down
  *
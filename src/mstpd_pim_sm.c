@@ -104,7 +104,7 @@ static void  mstp_syncMstiPortsWithCist(LPORT_t lport);
  *
  * Returns:   none
  *
- * Globals:
+ * Globals:   mstp_Bridge
  *
  **PROC-**********************************************************************/
 void
@@ -122,6 +122,9 @@ mstp_pimSm(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
    statePtr = mstp_utilPimStatePtr(mstid, lport);
    STP_ASSERT(statePtr);
 
+   /* counted and nested, never merged as each call may carry a BPDU */
+   mstp_smEnter(MSTP_SM_ID_PIM, mstid, lport);
+
    /* Check for global (external) conditions that may affect the
     * the current PIM SM state */
    mstp_pimSmGeneralCond(mstid, lport);
@@ -171,11 +174,15 @@ mstp_pimSm(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
    /*------------------------------------------------------------------------
     * when exit the state for PIM SM must be 'CURRENT' || 'DISABLED'
     * NOTE: 'AGED' state could be the legal final state for an MSTI's port
-    *       located on the boundary of a MST region
+    *       located on the boundary of a MST region, or for any port while
+    *       Port Role Selection is held ('mstp_holdPrs'), it runs this
+    *       machine again once released
     *------------------------------------------------------------------------*/
    STP_ASSERT(*statePtr == MSTP_PIM_STATE_CURRENT ||
           *statePtr == MSTP_PIM_STATE_DISABLED ||
-          (mstid != MSTP_CISTID ? *statePtr == MSTP_PIM_STATE_AGED : FALSE));
+          ((mstid != MSTP_CISTID || mstp_Bridge.prsHold) ?
+           *statePtr == MSTP_PIM_STATE_AGED : FALSE));
+   mstp_smLeave();
 }
 /** ======================================================================= **
  *                                                                           *
@@ -518,7 +525,7 @@ mstp_pimSmCurrentCond(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
       updtInfo =
          MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
                                    MSTP_CIST_PORT_UPDT_INFO);
-      rcvdInfoWhile = cistPortPtr->rcvdInfoWhile;
+      rcvdInfoWhile = MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile);
       infoIs        = cistPortPtr->infoIs;
       rcvdXstMsg    = rcvdCistMsg;
       updtXstInfo   = updtCistInfo;
@@ -540,7 +547,7 @@ mstp_pimSmCurrentCond(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
       updtInfo =
          MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
                                    MSTP_MSTI_PORT_UPDT_INFO);
-      rcvdInfoWhile = mstiPortPtr->rcvdInfoWhile;
+      rcvdInfoWhile = MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile);
       infoIs        = mstiPortPtr->infoIs;
       rcvdXstMsg    = rcvdMstiMsg;
       updtXstInfo   = updtMstiInfo;
@@ -971,7 +978,8 @@ mstp_pimSmDisabledAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSED);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREE);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREED);
-      cistPortPtr->rcvdInfoWhile = 0;
+      MSTP_TX_TREE_CHANGED(mstid, lport);
+      MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) = 0;
       cistPortPtr->infoIs = MSTP_INFO_IS_DISABLED;
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_RESELECT);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SELECTED);
@@ -985,7 +993,8 @@ mstp_pimSmDisabledAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSED);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREE);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREED);
-      mstiPortPtr->rcvdInfoWhile = 0;
+      MSTP_TX_TREE_CHANGED(mstid, lport);
+      MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) = 0;
       mstiPortPtr->infoIs = MSTP_INFO_IS_DISABLED;
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_RESELECT);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SELECTED);
@@ -1115,8 +1124,10 @@ static void
 mstp_pimSmUpdateAct(MSTID_t mstid, LPORT_t lport)
 {
    MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
+   bool                   rolesCurrent;
 
    STP_ASSERT(commPortPtr);
+   rolesCurrent = mstp_roleInputsPortCurrent(mstid, lport);
 
    if(mstid == MSTP_CISTID)
    {
@@ -1198,6 +1209,7 @@ mstp_pimSmUpdateAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_UPDT_INFO);
       cistPortPtr->infoIs = MSTP_INFO_IS_MINE;
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
    else
    {
@@ -1243,8 +1255,14 @@ mstp_pimSmUpdateAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_UPDT_INFO);
       mstiPortPtr->infoIs = MSTP_INFO_IS_MINE;
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
 
+   /* the port now has the information the role selection computed for it,
+    * the roles selected from that still hold */
+   if(rolesCurrent)
+      mstp_roleInputsPortUpdated(mstid, lport);
+
    if(MSTP_BEGIN == FALSE)
    {
       /*---------------------------------------------------------------------
@@ -1362,6 +1380,8 @@ mstp_pimSmSuperiorDesignatedAct(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
 
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREED);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSING);
+      /* 'agree', 'proposing' and the port's times may change */
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       /* NOTE: this function updates the 'proposed' flag */
       mstp_recordProposal(pkt, mstid, lport);
       /* update 'TC flags' according to the information in the received BDPU */
@@ -1405,6 +1425,8 @@ mstp_pimSmSuperiorDesignatedAct(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
 
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREED);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSING);
+      /* 'agree' and 'proposing' may change */
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       /* NOTE: this function updates the 'proposed' flag */
       mstp_recordProposal(pkt, mstid, lport);
       /* update 'TC flags' according to the information in the received BDPU */
@@ -1806,6 +1828,8 @@ mstp_syncMstiPortsWithCist(LPORT_t lport)
 {
    MSTP_COMM_PORT_INFO_t *commPortPtr;
    MSTID_t                mstid;
+   struct timeval         start;
+   uint32_t               usec;
 
    STP_ASSERT(MSTP_BEGIN == FALSE);
    STP_ASSERT(IS_VALID_LPORT(lport));
@@ -1815,6 +1839,7 @@ mstp_syncMstiPortsWithCist(LPORT_t lport)
        STP_ASSERT(0);
    }
 
+   gettimeofday(&start, NULL);
    for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_MSTID_MAX; mstid++)
    {
       if(MSTP_MSTI_VALID(mstid))
@@ -1825,6 +1850,16 @@ mstp_syncMstiPortsWithCist(LPORT_t lport)
          MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_RESELECT);
          MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SELECTED);
          mstp_prsSm(mstid);
+         mstp_perfStats.mstiSyncTrees++;
       }
    }
+
+   /* time it takes all MSTIs to follow a CIST change, e.g. a root failure,
+    * including the role selections skipped as nothing they read changed
+    * (see 'mstp_roleInputsChanged') */
+   usec = mstp_perfElapsedUsec(&start);
+   mstp_perfStats.mstiSyncs++;
+   mstp_perfStats.mstiSyncUsec += usec;
+   if(usec > mstp_perfStats.mstiSyncUsecMax)
+      mstp_perfStats.mstiSyncUsecMax = usec;
 }
@@ -80,6 +80,20 @@ mstp_prsSm(MSTID_t mstid)
    STP_ASSERT(mstid <= MSTP_MSTID_MAX);
    STP_ASSERT(MSTP_INSTANCE_IS_VALID(mstid));
 
+   /* a batch of link changes is being applied, 'mstp_releasePrs' runs the
+    * role selection once for all of them */
+   if(mstp_Bridge.prsHold && (MSTP_BEGIN == FALSE))
+   {
+      setBit(mstp_Bridge.prsHeldTrees.map, mstid + 1,
+             MSTP_ROLES_DIRTY_MAP_BITS);
+      mstp_perfStats.prsHeldCalls++;
+      return;
+   }
+
+   /* counted and nested, never merged: outside of a 'mstp_holdPrs' batch
+    * the role selection must have run when this returns */
+   mstp_smEnter(MSTP_SM_ID_PRS, mstid, 0);
+
    mstp_prsSmGeneralCond(mstid);
    do
    {
@@ -102,7 +116,7 @@ mstp_prsSm(MSTID_t mstid)
     * when exit the state for PRS SM must be 'ROLE_SELECTION'
     *------------------------------------------------------------------------*/
    STP_ASSERT(*statePtr == MSTP_PRS_STATE_ROLE_SELECTION);
-
+   mstp_smLeave();
 }
 
 /** ======================================================================= **
@@ -219,7 +233,7 @@ mstp_prsSmRoleSelectionCond(MSTID_t mstid)
    {
       MSTP_CIST_PORT_INFO_t *cistPortPtr;
 
-      for(lport = 1 ; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          cistPortPtr = MSTP_CIST_PORT_PTR(lport);
          if (cistPortPtr && MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
@@ -234,7 +248,7 @@ mstp_prsSmRoleSelectionCond(MSTID_t mstid)
    {
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
 
-      for(lport = 1 ; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
          if (mstiPortPtr && MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
@@ -307,7 +321,13 @@ mstp_prsSmRoleSelectionAct(MSTID_t mstid)
    MSTP_COMM_PORT_INFO_t *commPortPtr = NULL;
 
    mstp_clearReselectTree(mstid);
-   mstp_updtRolesTree(mstid);
+   /* 'reselect' may be set for a tree none of whose role selection inputs
+    * have changed (e.g. MSTIs resynchronized with the CIST), the roles
+    * computed last time still hold for such a tree */
+   if(mstp_roleInputsChanged(mstid))
+      mstp_updtRolesTree(mstid);
+   else
+      mstp_perfStats.rolesSkipped++;
    mstp_setSelectedTree(mstid);
 
    lportRoot = (mstid == MSTP_CISTID) ?
@@ -347,7 +367,7 @@ mstp_prsSmRoleSelectionAct(MSTID_t mstid)
    /*------------------------------------------------------------------------
     * Proceed with all ports but Root Port.
     *------------------------------------------------------------------------*/
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       if(lport == lportRoot)
          continue;
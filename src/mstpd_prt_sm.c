@@ -41,6 +41,7 @@ VLOG_DEFINE_THIS_MODULE(mstpd_prt_sm);
 /*---------------------------------------------------------------------------
  * Local functions prototypes (forward declarations)
  *---------------------------------------------------------------------------*/
+static void mstp_prtSmRun(MSTID_t mstid, LPORT_t lport);
 static void mstp_prtSmGeneralCond(MSTID_t mstid, LPORT_t lport);
 
 /* Disabled Port */
@@ -144,6 +145,36 @@ static void mstp_prtSmBackupPortAct(MSTID_t mstid, LPORT_t lport);
  **PROC-**********************************************************************/
 void
 mstp_prtSm(MSTID_t mstid, LPORT_t lport)
+{
+   /* a nested call for the same tree and port while the machine is already
+    * running for them is merged into the running one, which is evaluated
+    * again once it has settled */
+   if(mstp_smEnter(MSTP_SM_ID_PRT, mstid, lport))
+   {
+      do
+      {
+         mstp_prtSmRun(mstid, lport);
+      }
+      while(mstp_smRerun());
+      mstp_smLeave();
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_prtSmRun
+ *
+ * Purpose:   Run the Port Role Transitions state machine until it settles.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:
+ *
+ **PROC-**********************************************************************/
+static void
+mstp_prtSmRun(MSTID_t mstid, LPORT_t lport)
 {
    bool             next     = FALSE;/* This variable is used to indicate
                                        * that the state change processing is
@@ -348,7 +379,7 @@ mstp_prtSmGeneralCond(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
 
-      statePtr     = &cistPortPtr->prtState;
+      statePtr     = &MSTP_PORT_HOT(cistPortPtr, prtState);
       selected     = MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
                                                MSTP_CIST_PORT_SELECTED);
       updtInfo     = MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
@@ -362,7 +393,7 @@ mstp_prtSmGeneralCond(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(mstiPortPtr);
 
-      statePtr     = &mstiPortPtr->prtState;
+      statePtr     = &MSTP_PORT_HOT(mstiPortPtr, prtState);
       selected     = MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
                                                MSTP_MSTI_PORT_SELECTED);
       updtInfo     = MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
@@ -656,7 +687,7 @@ mstp_prtSmDisabledPortCond(MSTID_t mstid, LPORT_t lport)
                                            MSTP_CIST_PORT_SYNCED);
       reRoot   = MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
                                            MSTP_CIST_PORT_RE_ROOT);
-      fdWhile  = cistPortPtr->fdWhile;
+      fdWhile  = MSTP_PORT_HOT(cistPortPtr, fdWhile);
    }
    else
    {
@@ -673,7 +704,7 @@ mstp_prtSmDisabledPortCond(MSTID_t mstid, LPORT_t lport)
                                            MSTP_MSTI_PORT_SYNCED);
       reRoot   = MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
                                            MSTP_MSTI_PORT_RE_ROOT);
-      fdWhile  = mstiPortPtr->fdWhile;
+      fdWhile  = MSTP_PORT_HOT(mstiPortPtr, fdWhile);
    }
 
    /*------------------------------------------------------------------------
@@ -730,30 +761,34 @@ mstp_prtSmInitPortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
+      if(cistPortPtr->role != MSTP_PORT_ROLE_DISABLED)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       cistPortPtr->role = MSTP_PORT_ROLE_DISABLED;
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARN);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARD);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNCED);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNC);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_RE_ROOT);
-      cistPortPtr->rrWhile = MSTP_CIST_ROOT_TIMES.fwdDelay;
-      cistPortPtr->fdWhile = MSTP_CIST_ROOT_TIMES.maxAge;
-      cistPortPtr->rbWhile = 0;
+      MSTP_PORT_HOT(cistPortPtr, rrWhile) = MSTP_CIST_ROOT_TIMES.fwdDelay;
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = MSTP_CIST_ROOT_TIMES.maxAge;
+      MSTP_PORT_HOT(cistPortPtr, rbWhile) = 0;
    }
    else
    {
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
+      if(mstiPortPtr->role != MSTP_PORT_ROLE_DISABLED)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       mstiPortPtr->role = MSTP_PORT_ROLE_DISABLED;
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNCED);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_RE_ROOT);
-      mstiPortPtr->rrWhile = MSTP_CIST_ROOT_TIMES.fwdDelay;
-      mstiPortPtr->fdWhile = MSTP_CIST_ROOT_TIMES.maxAge;
-      mstiPortPtr->rbWhile = 0;
+      MSTP_PORT_HOT(mstiPortPtr, rrWhile) = MSTP_CIST_ROOT_TIMES.fwdDelay;
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = MSTP_CIST_ROOT_TIMES.maxAge;
+      MSTP_PORT_HOT(mstiPortPtr, rbWhile) = 0;
    }
 
    if(MSTP_BEGIN == FALSE)
@@ -798,6 +833,8 @@ mstp_prtSmDisablePortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
+      if(cistPortPtr->role != cistPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       cistPortPtr->role = cistPortPtr->selectedRole;
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARN);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARD);
@@ -807,6 +844,8 @@ mstp_prtSmDisablePortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
+      if(mstiPortPtr->role != mstiPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       mstiPortPtr->role = mstiPortPtr->selectedRole;
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
@@ -857,9 +896,9 @@ mstp_prtSmDisabledPortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      cistPortPtr->fdWhile = MSTP_CIST_ROOT_TIMES.maxAge;
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = MSTP_CIST_ROOT_TIMES.maxAge;
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNCED);
-      cistPortPtr->rrWhile = 0;
+      MSTP_PORT_HOT(cistPortPtr, rrWhile) = 0;
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNC);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_RE_ROOT);
    }
@@ -868,9 +907,9 @@ mstp_prtSmDisabledPortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      mstiPortPtr->fdWhile = MSTP_CIST_ROOT_TIMES.maxAge;
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = MSTP_CIST_ROOT_TIMES.maxAge;
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNCED);
-      mstiPortPtr->rrWhile = 0;
+      MSTP_PORT_HOT(mstiPortPtr, rrWhile) = 0;
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_RE_ROOT);
    }
@@ -964,8 +1003,8 @@ mstp_prtSmMasterPortCond(MSTID_t mstid, LPORT_t lport)
                                           MSTP_MSTI_PORT_PROPOSED);
    disputed   = MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
                                           MSTP_MSTI_PORT_DISPUTED);
-   fdWhile    = mstiPortPtr->fdWhile;
-   rrWhile    = mstiPortPtr->rrWhile;
+   fdWhile    = MSTP_PORT_HOT(mstiPortPtr, fdWhile);
+   rrWhile    = MSTP_PORT_HOT(mstiPortPtr, rrWhile);
 
    /*------------------------------------------------------------------------
     * check for condition to transition to the next state
@@ -1414,6 +1453,8 @@ mstp_prtSmMasterPortAct(MSTID_t mstid, LPORT_t lport)
    STP_ASSERT(mstiPortPtr);
    STP_ASSERT(mstiPortPtr->selectedRole == MSTP_PORT_ROLE_MASTER);
 
+   if(mstiPortPtr->role != mstiPortPtr->selectedRole)
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    mstiPortPtr->role = mstiPortPtr->selectedRole;
 }
 
@@ -1475,6 +1516,7 @@ mstp_prtSmMasterAgreedAct(MSTID_t mstid, LPORT_t lport)
    MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSED);
    MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
    MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREE);
+   MSTP_TX_TREE_CHANGED(mstid, lport);
 }
 
 /**PROC+**********************************************************************
@@ -1504,7 +1546,7 @@ mstp_prtSmMasterSyncedAct(MSTID_t mstid, LPORT_t lport)
    STP_ASSERT(MSTP_VALID_MSTID(mstid));
    STP_ASSERT(mstiPortPtr);
 
-   mstiPortPtr->rrWhile = 0;
+   MSTP_PORT_HOT(mstiPortPtr, rrWhile) = 0;
    MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNCED);
    MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
 }
@@ -1565,7 +1607,7 @@ mstp_prtSmMasterForwardAct(MSTID_t mstid, LPORT_t lport)
    STP_ASSERT(commPortPtr && mstiPortPtr);
 
    MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
-   mstiPortPtr->fdWhile = 0;
+   MSTP_PORT_HOT(mstiPortPtr, fdWhile) = 0;
    if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap, MSTP_PORT_SEND_RSTP))
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREED);
    else
@@ -1606,7 +1648,7 @@ mstp_prtSmMasterLearnAct(MSTID_t mstid, LPORT_t lport)
    STP_ASSERT(mstiPortPtr);
 
    MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
-   mstiPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+   MSTP_PORT_HOT(mstiPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
    /*------------------------------------------------------------------
     * kick Port State Transitions state machine (per-Tree per-Port)
     *------------------------------------------------------------------*/
@@ -1644,7 +1686,7 @@ mstp_prtSmMasterDiscardAct(MSTID_t mstid, LPORT_t lport)
    MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
    MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
    MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_DISPUTED);
-   mstiPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+   MSTP_PORT_HOT(mstiPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
    /*------------------------------------------------------------------
     * kick Port State Transitions state machine (per-Tree per-Port)
     *------------------------------------------------------------------*/
@@ -1732,9 +1774,9 @@ mstp_prtSmRootPortCond(MSTID_t mstid, LPORT_t lport)
                                            MSTP_CIST_PORT_AGREED);
       proposed = MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
                                            MSTP_CIST_PORT_PROPOSED);
-      fdWhile  = cistPortPtr->fdWhile;
-      rbWhile  = cistPortPtr->rbWhile;
-      rrWhile  = cistPortPtr->rrWhile;
+      fdWhile  = MSTP_PORT_HOT(cistPortPtr, fdWhile);
+      rbWhile  = MSTP_PORT_HOT(cistPortPtr, rbWhile);
+      rrWhile  = MSTP_PORT_HOT(cistPortPtr, rrWhile);
    }
    else
    {
@@ -1761,9 +1803,9 @@ mstp_prtSmRootPortCond(MSTID_t mstid, LPORT_t lport)
                                            MSTP_MSTI_PORT_AGREED);
       proposed = MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
                                            MSTP_MSTI_PORT_PROPOSED);
-      fdWhile  = mstiPortPtr->fdWhile;
-      rbWhile  = mstiPortPtr->rbWhile;
-      rrWhile  = mstiPortPtr->rrWhile;
+      fdWhile  = MSTP_PORT_HOT(mstiPortPtr, fdWhile);
+      rbWhile  = MSTP_PORT_HOT(mstiPortPtr, rbWhile);
+      rrWhile  = MSTP_PORT_HOT(mstiPortPtr, rrWhile);
    }
 
    /*------------------------------------------------------------------------
@@ -2224,8 +2266,10 @@ mstp_prtSmRootPortAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
       STP_ASSERT(cistPortPtr->selectedRole == MSTP_PORT_ROLE_ROOT);
+      if(cistPortPtr->role != cistPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       cistPortPtr->role    = cistPortPtr->selectedRole;
-      cistPortPtr->rrWhile = MSTP_CIST_ROOT_TIMES.fwdDelay;
+      MSTP_PORT_HOT(cistPortPtr, rrWhile) = MSTP_CIST_ROOT_TIMES.fwdDelay;
    }
    else
    {
@@ -2233,8 +2277,10 @@ mstp_prtSmRootPortAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(mstiPortPtr);
       STP_ASSERT(mstiPortPtr->selectedRole == MSTP_PORT_ROLE_ROOT);
+      if(mstiPortPtr->role != mstiPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       mstiPortPtr->role    = mstiPortPtr->selectedRole;
-      mstiPortPtr->rrWhile = MSTP_CIST_ROOT_TIMES.fwdDelay;
+      MSTP_PORT_HOT(mstiPortPtr, rrWhile) = MSTP_CIST_ROOT_TIMES.fwdDelay;
    }
 }
 
@@ -2311,6 +2357,7 @@ mstp_prtSmRootAgreedAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSED);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNC);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREE);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    }
    else
@@ -2321,6 +2368,7 @@ mstp_prtSmRootAgreedAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSED);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREE);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
    }
    /*------------------------------------------------------------------------
@@ -2421,7 +2469,7 @@ mstp_prtSmRootForwardAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      cistPortPtr->fdWhile = 0;
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = 0;
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARD);
    }
    else
@@ -2429,7 +2477,7 @@ mstp_prtSmRootForwardAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      mstiPortPtr->fdWhile = 0;
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = 0;
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
    }
    /*------------------------------------------------------------------------
@@ -2468,14 +2516,14 @@ mstp_prtSmRootLearnAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
 
-      cistPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARN);
    }
    else
    {
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
-      mstiPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
    }
    /*------------------------------------------------------------------
@@ -2615,8 +2663,8 @@ mstp_prtSmDesignatedPortCond(MSTID_t mstid, LPORT_t lport)
                                              MSTP_CIST_PORT_PROPOSED);
       disputed   = MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
                                              MSTP_CIST_PORT_DISPUTED);
-      fdWhile    = cistPortPtr->fdWhile;
-      rrWhile    = cistPortPtr->rrWhile;
+      fdWhile    = MSTP_PORT_HOT(cistPortPtr, fdWhile);
+      rrWhile    = MSTP_PORT_HOT(cistPortPtr, rrWhile);
    }
    else
    {
@@ -2651,8 +2699,8 @@ mstp_prtSmDesignatedPortCond(MSTID_t mstid, LPORT_t lport)
                                              MSTP_MSTI_PORT_PROPOSED);
       disputed   = MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
                                              MSTP_MSTI_PORT_DISPUTED);
-      fdWhile    = mstiPortPtr->fdWhile;
-      rrWhile    = mstiPortPtr->rrWhile;
+      fdWhile    = MSTP_PORT_HOT(mstiPortPtr, fdWhile);
+      rrWhile    = MSTP_PORT_HOT(mstiPortPtr, rrWhile);
    }
 
    /*------------------------------------------------------------------------
@@ -3095,6 +3143,8 @@ mstp_prtSmDesignatedPortAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
       STP_ASSERT(cistPortPtr->selectedRole == MSTP_PORT_ROLE_DESIGNATED);
+      if(cistPortPtr->role != cistPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       cistPortPtr->role = cistPortPtr->selectedRole;
    }
    else
@@ -3103,6 +3153,8 @@ mstp_prtSmDesignatedPortAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(mstiPortPtr);
       STP_ASSERT(mstiPortPtr->selectedRole == MSTP_PORT_ROLE_DESIGNATED);
+      if(mstiPortPtr->role != mstiPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       mstiPortPtr->role = mstiPortPtr->selectedRole;
    }
 }
@@ -3140,6 +3192,7 @@ mstp_prtSmDesignatedProposeAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
 
       operPointToPointMAC = MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                                             MSTP_PORT_OPER_POINT_TO_POINT_MAC);
@@ -3154,6 +3207,7 @@ mstp_prtSmDesignatedProposeAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(mstiPortPtr);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
    }
    /*------------------------------------------------------------------
@@ -3198,6 +3252,7 @@ mstp_prtSmDesignatedAgreedAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSED);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNC);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREE);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    }
    else
@@ -3208,6 +3263,7 @@ mstp_prtSmDesignatedAgreedAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSED);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREE);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
    }
    /*------------------------------------------------------------------
@@ -3245,7 +3301,7 @@ mstp_prtSmDesignatedSyncedAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      cistPortPtr->rrWhile = 0;
+      MSTP_PORT_HOT(cistPortPtr, rrWhile) = 0;
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNCED);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNC);
    }
@@ -3254,7 +3310,7 @@ mstp_prtSmDesignatedSyncedAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      mstiPortPtr->rrWhile = 0;
+      MSTP_PORT_HOT(mstiPortPtr, rrWhile) = 0;
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNCED);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
    }
@@ -3329,7 +3385,7 @@ mstp_prtSmDesignatedForwardAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARD);
-      cistPortPtr->fdWhile = 0;
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = 0;
       if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap, MSTP_PORT_SEND_RSTP))
          MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREED);
       else
@@ -3341,7 +3397,7 @@ mstp_prtSmDesignatedForwardAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(mstiPortPtr);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
-      mstiPortPtr->fdWhile = 0;
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = 0;
       if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap, MSTP_PORT_SEND_RSTP))
          MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREED);
       else
@@ -3383,7 +3439,7 @@ mstp_prtSmDesignatedLearnAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARN);
-      cistPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
    }
    else
    {
@@ -3391,7 +3447,7 @@ mstp_prtSmDesignatedLearnAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(mstiPortPtr);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
-      mstiPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
    }
    /*------------------------------------------------------------------
     * kick Port State Transitions state machine (per-Tree per-Port)
@@ -3431,7 +3487,7 @@ mstp_prtSmDesignatedDiscardAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARN);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARD);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_DISPUTED);
-      cistPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
    }
    else
    {
@@ -3441,7 +3497,7 @@ mstp_prtSmDesignatedDiscardAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_DISPUTED);
-      mstiPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
    }
    /*------------------------------------------------------------------
     * kick Port State Transitions state machine (per-Tree per-Port)
@@ -3525,8 +3581,8 @@ mstp_prtSmAlternatePortCond(MSTID_t mstid, LPORT_t lport)
                                              MSTP_CIST_PORT_AGREE);
       proposed   = MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
                                              MSTP_CIST_PORT_PROPOSED);
-      fdWhile    = cistPortPtr->fdWhile;
-      rbWhile    = cistPortPtr->rbWhile;
+      fdWhile    = MSTP_PORT_HOT(cistPortPtr, fdWhile);
+      rbWhile    = MSTP_PORT_HOT(cistPortPtr, rbWhile);
       role       = cistPortPtr->role;
    }
    else
@@ -3548,8 +3604,8 @@ mstp_prtSmAlternatePortCond(MSTID_t mstid, LPORT_t lport)
                                              MSTP_MSTI_PORT_AGREE);
       proposed   = MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
                                              MSTP_MSTI_PORT_PROPOSED);
-      fdWhile    = mstiPortPtr->fdWhile;
-      rbWhile    = mstiPortPtr->rbWhile;
+      fdWhile    = MSTP_PORT_HOT(mstiPortPtr, fdWhile);
+      rbWhile    = MSTP_PORT_HOT(mstiPortPtr, rbWhile);
       role       = mstiPortPtr->role;
    }
 
@@ -3852,9 +3908,9 @@ mstp_prtSmAlternatePortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      cistPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(cistPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNCED);
-      cistPortPtr->rrWhile = 0;
+      MSTP_PORT_HOT(cistPortPtr, rrWhile) = 0;
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNC);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_RE_ROOT);
    }
@@ -3863,9 +3919,9 @@ mstp_prtSmAlternatePortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      mstiPortPtr->fdWhile = mstp_forwardDelayParameter(lport);
+      MSTP_PORT_HOT(mstiPortPtr, fdWhile) = mstp_forwardDelayParameter(lport);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNCED);
-      mstiPortPtr->rrWhile = 0;
+      MSTP_PORT_HOT(mstiPortPtr, rrWhile) = 0;
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_RE_ROOT);
    }
@@ -3944,6 +4000,7 @@ mstp_prtSmAlternateAgreedAct(MSTID_t mstid, LPORT_t lport)
       STP_ASSERT(cistPortPtr);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSED);
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREE);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    }
    else
@@ -3953,6 +4010,7 @@ mstp_prtSmAlternateAgreedAct(MSTID_t mstid, LPORT_t lport)
       STP_ASSERT(mstiPortPtr);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSED);
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREE);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
    }
    /*------------------------------------------------------------------------
@@ -3988,6 +4046,8 @@ mstp_prtSmBlockPortAct(MSTID_t mstid, LPORT_t lport)
 
       STP_ASSERT(cistPortPtr);
 
+      if(cistPortPtr->role != cistPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       cistPortPtr->role = cistPortPtr->selectedRole;
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARN);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARD);
@@ -3997,6 +4057,8 @@ mstp_prtSmBlockPortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
+      if(mstiPortPtr->role != mstiPortPtr->selectedRole)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
       mstiPortPtr->role = mstiPortPtr->selectedRole;
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARN);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARD);
@@ -4049,13 +4111,13 @@ mstp_prtSmBackupPortAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      cistPortPtr->rbWhile = 2*(commPortPtr->HelloTime);
+      MSTP_PORT_HOT(cistPortPtr, rbWhile) = 2*(commPortPtr->HelloTime);
    }
    else
    {
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      mstiPortPtr->rbWhile = 2*(commPortPtr->HelloTime);
+      MSTP_PORT_HOT(mstiPortPtr, rbWhile) = 2*(commPortPtr->HelloTime);
    }
 }
@@ -41,6 +41,7 @@ VLOG_DEFINE_THIS_MODULE(mstpd_pst_sm);
 /*---------------------------------------------------------------------------
  * Local functions prototypes (forward declarations)
  *---------------------------------------------------------------------------*/
+static void mstp_pstSmRun(MSTID_t mstid, LPORT_t lport);
 static void mstp_pstSmGeneralCond(MSTID_t mstid, LPORT_t lport);
 static void mstp_pstSmDiscardingCond(MSTID_t mstid, LPORT_t lport);
 static void mstp_pstSmLearningCond(MSTID_t mstid, LPORT_t lport);
@@ -72,6 +73,34 @@ static void mstp_pstSmForwardingAct(MSTID_t mstid, LPORT_t lport);
  **PROC-**********************************************************************/
 void
 mstp_pstSm(MSTID_t mstid, LPORT_t lport)
+{
+   /* nested calls are merged, see 'mstp_smEnter' */
+   if(mstp_smEnter(MSTP_SM_ID_PST, mstid, lport))
+   {
+      do
+      {
+         mstp_pstSmRun(mstid, lport);
+      }
+      while(mstp_smRerun());
+      mstp_smLeave();
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_pstSmRun
+ *
+ * Purpose:   Run the Port State Transitions state machine until it settles.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:
+ *
+ **PROC-**********************************************************************/
+static void
+mstp_pstSmRun(MSTID_t mstid, LPORT_t lport)
 {
    MSTP_PST_STATE_t *statePtr = NULL;
 
@@ -421,6 +450,7 @@ mstp_pstSmDiscardingAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARNING);
       mstp_disableForwarding(mstid, lport);
       MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARDING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
    else
    {
@@ -432,6 +462,7 @@ mstp_pstSmDiscardingAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARNING);
       mstp_disableForwarding(mstid, lport);
       MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARDING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
 }
 
@@ -466,6 +497,7 @@ mstp_pstSmLearningAct(MSTID_t mstid, LPORT_t lport)
       STP_ASSERT(cistPortPtr);
 
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARNING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
    else
    {
@@ -474,6 +506,7 @@ mstp_pstSmLearningAct(MSTID_t mstid, LPORT_t lport)
       STP_ASSERT(mstiPortPtr);
 
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARNING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
 
    /*------------------------------------------------------------------------
@@ -514,6 +547,7 @@ mstp_pstSmForwardingAct(MSTID_t mstid, LPORT_t lport)
       STP_ASSERT(cistPortPtr);
 
       MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARDING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
    else
    {
@@ -522,6 +556,7 @@ mstp_pstSmForwardingAct(MSTID_t mstid, LPORT_t lport)
       STP_ASSERT(mstiPortPtr);
 
       MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_FORWARDING);
+      MSTP_TX_TREE_CHANGED(mstid, lport);
    }
 
    /*------------------------------------------------------------------------
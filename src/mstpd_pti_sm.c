@@ -48,6 +48,15 @@ static bool mstp_ptiSmOneSecondCond(LPORT_t lport);
 static bool mstp_ptiSmTickCond(LPORT_t lport);
 static void mstp_ptiSmOneSecondAct(LPORT_t lport);
 static void mstp_ptiSmTickAct(LPORT_t lport);
+static uint8_t mstp_ptiTreePortTick(MSTID_t mstid, LPORT_t lport);
+
+/*--------------------------------------------------------------------------
+ * Outcome of decrementing the timers of a tree on a port
+ *--------------------------------------------------------------------------*/
+#define MSTP_PTI_EXP_PRT   0x01  /* fdWhile, rrWhile or rbWhile expired     */
+#define MSTP_PTI_EXP_TC    0x02  /* tcWhile expired                         */
+#define MSTP_PTI_EXP_INFO  0x04  /* rcvdInfoWhile expired                   */
+#define MSTP_PTI_DEC_FD    0x08  /* fdWhile was decremented                 */
 
 /** ======================================================================= **
  *                                                                           *
@@ -118,6 +127,51 @@ mstp_ptiSm(LPORT_t lport)
  *                                                                           *
  ** ======================================================================= **/
 
+/**PROC+**********************************************************************
+ * Name:      mstp_ptiTreePortTick
+ *
+ * Purpose:   Decrement the running timers of a tree on a port for a timer
+ *            tick and report which of them expired. 'fdWhile' is not
+ *            decremented while the port is in the 'DISABLED_PORT' PRT
+ *            state, the PRT SM holds it at MaxAge there.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   'MSTP_PTI_*' bits of the timers that expired
+ *
+ * Globals:   mstp_treePortHot
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static uint8_t
+mstp_ptiTreePortTick(MSTID_t mstid, LPORT_t lport)
+{
+   MSTP_TREE_PORT_HOT_t *hot = &mstp_treePortHot[mstid];
+   uint8_t               exp = 0;
+
+   if(hot->fdWhile[lport] &&
+      (hot->prtState[lport] != MSTP_PRT_STATE_DISABLED_PORT))
+   {
+      exp |= MSTP_PTI_DEC_FD;
+      if(--hot->fdWhile[lport] == 0)
+         exp |= MSTP_PTI_EXP_PRT;
+   }
+   if(hot->rrWhile[lport] && (--hot->rrWhile[lport] == 0))
+      exp |= MSTP_PTI_EXP_PRT;
+   if(hot->rbWhile[lport] && (--hot->rbWhile[lport] == 0))
+      exp |= MSTP_PTI_EXP_PRT;
+   if(hot->tcWhile[lport] && (--hot->tcWhile[lport] == 0))
+   {/* the TC flag goes out of the next BPDU */
+      exp |= MSTP_PTI_EXP_TC;
+      MSTP_TX_TREE_CHANGED(mstid, lport);
+   }
+   if(hot->rcvdInfoWhile[lport] && (--hot->rcvdInfoWhile[lport] == 0))
+      exp |= MSTP_PTI_EXP_INFO;
+
+   return exp;
+}
+
 /**PROC+**********************************************************************
  * Name:      mstp_ptiSmGeneralCond
  *
@@ -261,6 +315,10 @@ mstp_ptiSmOneSecondAct(LPORT_t lport)
  *             dec(rcvdInfoWhile); dec(rrWhile);
  *             dec(rbWhile);dec(mdelayWhile); dec(edgeDelayWhile);
  *             dec(txCount);)
+ *            Each tree's timers of the port are decremented right before
+ *            their expiration is acted upon, the CIST first and then the
+ *            MSTIs, so a timer started by a state machine run earlier in
+ *            this tick is decremented in this same tick.
  *
  * Params:    lport -> logical port number
  *
@@ -275,7 +333,7 @@ mstp_ptiSmTickAct(LPORT_t lport)
 {
    MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
    MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
-   bool                  call_prtSm  = FALSE;
+   uint8_t                expired     = 0;
    bool                  portEnabled = FALSE;
    MSTID_t                mstid = 0;
    bool                  loopGuardEnabled = FALSE;
@@ -295,7 +353,7 @@ mstp_ptiSmTickAct(LPORT_t lport)
     * The Port should be transitioned to some state on PRT SM before timers
     * become active
     *------------------------------------------------------------------------*/
-   STP_ASSERT(cistPortPtr->prtState != MSTP_PRT_STATE_UNKNOWN);
+   STP_ASSERT(MSTP_PORT_HOT(cistPortPtr, prtState) != MSTP_PRT_STATE_UNKNOWN);
 
    /*------------------------------------------------------------------------
     * update common CIST and MSTIs State Machine Timers
@@ -368,10 +426,11 @@ mstp_ptiSmTickAct(LPORT_t lport)
     * update CIST's State Machine Timers
     *------------------------------------------------------------------------*/
 
-   if(cistPortPtr->tcWhile)
+   expired = mstp_ptiTreePortTick(MSTP_CISTID, lport);
+
+   if(expired & MSTP_PTI_EXP_TC)
    {
-       cistPortPtr->tcWhile--;
-       if(cistPortPtr->tcWhile == 0)
+       if(MSTP_PORT_HOT(cistPortPtr, tcWhile) == 0)
        {
            struct ovsdb_idl_txn *txn = NULL;
            MSTP_OVSDB_LOCK;
@@ -383,10 +442,8 @@ mstp_ptiSmTickAct(LPORT_t lport)
        }
    }
 
-   if(cistPortPtr->fdWhile &&
-      (cistPortPtr->prtState != MSTP_PRT_STATE_DISABLED_PORT))
+   if(expired & MSTP_PTI_DEC_FD)
    {
-      cistPortPtr->fdWhile--;
       struct ovsdb_idl_txn *txn = NULL;
       MSTP_OVSDB_LOCK;
       txn = ovsdb_idl_txn_create(idl);
@@ -394,29 +451,13 @@ mstp_ptiSmTickAct(LPORT_t lport)
           VLOG_ERR("%s Transaction Failed %s:%d", program_name, __FILE__, __LINE__);
           return;
       }
-      mstp_util_set_cist_table_value(FORWARD_DELAY_EXP_TIME, cistPortPtr->fdWhile);
+      mstp_util_set_cist_table_value(FORWARD_DELAY_EXP_TIME, MSTP_PORT_HOT(cistPortPtr, fdWhile));
       ovsdb_idl_txn_commit_block(txn);
       ovsdb_idl_txn_destroy(txn);
       MSTP_OVSDB_UNLOCK;
-      if(cistPortPtr->fdWhile == 0)
-         call_prtSm = TRUE;
-   }
-
-   if(cistPortPtr->rrWhile)
-   {
-      cistPortPtr->rrWhile--;
-      if(cistPortPtr->rrWhile == 0)
-         call_prtSm = TRUE;
    }
 
-   if(cistPortPtr->rbWhile)
-   {
-      cistPortPtr->rbWhile--;
-      if(cistPortPtr->rbWhile == 0)
-         call_prtSm = TRUE;
-   }
-
-   if(call_prtSm)
+   if(expired & MSTP_PTI_EXP_PRT)
    {/* one (or may be all) of Role Timers has expired */
       /*------------------------------------------------------------------
        * kick Port Role Transitions state machine for the CIST
@@ -426,10 +467,9 @@ mstp_ptiSmTickAct(LPORT_t lport)
       mstp_prtSm(MSTP_CISTID, lport);
    }
 
-   if(cistPortPtr->rcvdInfoWhile)
+   if(expired & MSTP_PTI_EXP_INFO)
    {
-      cistPortPtr->rcvdInfoWhile--;
-      if(cistPortPtr->rcvdInfoWhile == 0)
+      if(MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) == 0)
       {/* aging timer has expired */
          if((commPortPtr->rcvdSelfSentPkt == FALSE) &&
             ((cistPortPtr->role == MSTP_PORT_ROLE_ROOT) ||
@@ -500,12 +540,11 @@ mstp_ptiSmTickAct(LPORT_t lport)
 
          if(mstiPortPtr)
          {
-            call_prtSm = FALSE;
+            expired = mstp_ptiTreePortTick(mstid, lport);
 
-            if(mstiPortPtr->tcWhile)
+            if(expired & MSTP_PTI_EXP_TC)
             {
-               mstiPortPtr->tcWhile--;
-               if(mstiPortPtr->tcWhile == 0)
+               if(MSTP_PORT_HOT(mstiPortPtr, tcWhile) == 0)
                {
                    struct ovsdb_idl_txn *txn = NULL;
                    MSTP_OVSDB_LOCK;
@@ -517,29 +556,7 @@ mstp_ptiSmTickAct(LPORT_t lport)
                }
             }
 
-            if(mstiPortPtr->fdWhile &&
-               (mstiPortPtr->prtState != MSTP_PRT_STATE_DISABLED_PORT))
-            {
-               mstiPortPtr->fdWhile--;
-               if(mstiPortPtr->fdWhile == 0)
-                  call_prtSm = TRUE;
-            }
-
-            if(mstiPortPtr->rrWhile)
-            {
-               mstiPortPtr->rrWhile--;
-               if(mstiPortPtr->rrWhile == 0)
-                  call_prtSm = TRUE;
-            }
-
-            if(mstiPortPtr->rbWhile)
-            {
-               mstiPortPtr->rbWhile--;
-               if(mstiPortPtr->rbWhile == 0)
-                  call_prtSm = TRUE;
-            }
-
-            if(call_prtSm)
+            if(expired & MSTP_PTI_EXP_PRT)
             {/* one (or may be all) of Role Timers has expired */
                /*------------------------------------------------------------
                 * kick Port Role Transitions state machine for the MSTI
@@ -549,10 +566,9 @@ mstp_ptiSmTickAct(LPORT_t lport)
                mstp_prtSm(mstid, lport);
             }
 
-            if(mstiPortPtr->rcvdInfoWhile)
+            if(expired & MSTP_PTI_EXP_INFO)
             {
-               mstiPortPtr->rcvdInfoWhile--;
-               if(mstiPortPtr->rcvdInfoWhile == 0)
+               if(MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) == 0)
                {/* aging timer has expired */
                   if((commPortPtr->rcvdSelfSentPkt == FALSE) &&
                         ((mstiPortPtr->role == MSTP_PORT_ROLE_ROOT) ||
@@ -59,6 +59,7 @@ static void mstp_ptxSmTransmitIdleAct(LPORT_t lport);
 static void mstp_ptxSmTransmitConfigAct(LPORT_t lport);
 static void mstp_ptxSmTransmitTcnAct(LPORT_t lport);
 static void mstp_ptxSmTransmitRstpAct(LPORT_t lport);
+static void mstp_ptxSmCountTx(LPORT_t lport);
 
 /** ======================================================================= **
  *                                                                           *
@@ -103,11 +104,14 @@ mstp_ptxSm(LPORT_t lport)
    if((MSTP_BEGIN == FALSE) && MSTP_COMM_IS_BPDU_FILTER(lport))
          return;
 
-   if(mstp_Bridge.preventTx == TRUE)
+   /* state machine initialization is not held back, it transmits nothing */
+   if((MSTP_BEGIN == FALSE) && (mstp_Bridge.preventTx > 0))
    {
       MSTP_SM_ST_PRINTF1(MSTP_PTX,
                          MSTP_PER_PORT_SM_STATE_TRANSITION_FMT,
                          "PTX:", "TX", "LOCKED", lport);
+      /* run again when the lock is released */
+      set_port(&mstp_Bridge.txPendingLports, lport);
       return;
    }
 
@@ -561,6 +565,7 @@ mstp_ptxSmTransmitInitAct(LPORT_t lport)
    STP_ASSERT(commPortPtr);
    MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
+   setBitmap(commPortPtr->txDirtyTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
    commPortPtr->txCount = 0;
 }
 
@@ -623,7 +628,7 @@ mstp_ptxSmTransmitPeriodicAct(LPORT_t lport)
          STP_ASSERT(mstiPortPtr);
          if((mstiPortPtr->role == MSTP_PORT_ROLE_DESIGNATED) ||
             ((mstiPortPtr->role == MSTP_PORT_ROLE_ROOT) &&
-             (mstiPortPtr->tcWhile != 0)))
+             (MSTP_PORT_HOT(mstiPortPtr, tcWhile) != 0)))
          {
             mstiDesignatedOrTCpropagatingRootPort = TRUE;
             break;
@@ -637,7 +642,7 @@ mstp_ptxSmTransmitPeriodicAct(LPORT_t lport)
     *------------------------------------------------------------------------*/
    newInfo = MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,MSTP_PORT_NEW_INFO);
    if(!newInfo &&
-      (cistDesignatedPort || (cistRootPort && (cistPortPtr->tcWhile !=0))))
+      (cistDesignatedPort || (cistRootPort && (MSTP_PORT_HOT(cistPortPtr, tcWhile) !=0))))
    {
       MSTP_COMM_PORT_SET_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    }
@@ -682,6 +687,7 @@ mstp_ptxSmTransmitConfigAct(LPORT_t lport)
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
    mstp_txConfig(lport);
+   mstp_ptxSmCountTx(lport);
    commPortPtr->txCount +=1;
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_TC_ACK);
 }
@@ -714,6 +720,7 @@ mstp_ptxSmTransmitTcnAct(LPORT_t lport)
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
    mstp_txTcn(lport);
+   mstp_ptxSmCountTx(lport);
    commPortPtr->txCount +=1;
 }
 
@@ -746,6 +753,7 @@ mstp_ptxSmTransmitRstpAct(LPORT_t lport)
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO);
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_NEW_INFO_MSTI);
    mstp_txMstp(lport);
+   mstp_ptxSmCountTx(lport);
    commPortPtr->txCount +=1;
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_TC_ACK);
 }
@@ -778,3 +786,31 @@ mstp_ptxSmTransmitIdleAct(LPORT_t lport)
           cistPortPtr->portTimes.helloTime <= MSTP_HELLO_MAX_SEC);
    commPortPtr->helloWhen = cistPortPtr->portTimes.helloTime;
 }
+
+/**PROC+**********************************************************************
+ * Name:      mstp_ptxSmCountTx
+ *
+ * Purpose:   Account a BPDU transmitted on the port, telling apart the
+ *            ones that follow an earlier transmission on the same port
+ *            within the current event.
+ *
+ * Params:    lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge, mstp_perfStats
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_ptxSmCountTx(LPORT_t lport)
+{
+   mstp_perfStats.txBpdus++;
+   if(is_port_set(&mstp_Bridge.txEventLports, lport))
+      mstp_perfStats.txEventRepeats++;
+   else
+   {
+      set_port(&mstp_Bridge.txEventLports, lport);
+      mstp_perfStats.txEventPorts++;
+   }
+}
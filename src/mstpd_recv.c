@@ -69,6 +69,11 @@ MSTP_PKT_TYPE_t mstp_decodeBpdu(MSTP_RX_PDU *pkt)
    lport = GET_PKT_LOGICAL_PORT(pkt);
    STP_ASSERT(IS_VALID_LPORT(lport));
 
+   /*---------------------------------------------------------------------
+    * Forget the previously decoded BPDU, its buffer may have been reused
+    *---------------------------------------------------------------------*/
+   mstp_clearRxBpduDesc();
+
    /*---------------------------------------------------------------------
     * Check if MSTP port's data is allocated.
     * NOTE: It is possible to hit a race condition when BPDU may come
@@ -110,6 +115,11 @@ MSTP_PKT_TYPE_t mstp_decodeBpdu(MSTP_RX_PDU *pkt)
    if(MSTP_COMM_IS_BPDU_FILTER(lport))
       return(MSTP_ERRANT_PROTOCOL_DATA_PKT);
 
+   /*---------------------------------------------------------------------
+    * Parse the BPDU once for all the trees that are going to consume it
+    *---------------------------------------------------------------------*/
+   mstp_parseRxBpdu(pkt);
+
    return(MSTP_PROTOCOL_DATA_PKT);
 }
 /**PROC+**********************************************************************
@@ -134,6 +144,8 @@ mstp_protocolData(MSTP_RX_PDU *pkt)
    MSTP_COMM_PORT_INFO_t *commPortPtr;
    LPORT_t                lport;
    bool                   edgePort;
+   struct timeval         start;
+   uint32_t               roleRuns;
 
    STP_ASSERT(pkt);
 
@@ -221,7 +233,17 @@ mstp_protocolData(MSTP_RX_PDU *pkt)
    /*------------------------------------------------------------------------
     * kick the Port Receive state machine
     *------------------------------------------------------------------------*/
+   gettimeofday(&start, NULL);
+   roleRuns = mstp_perfStats.rolesCistCalls + mstp_perfStats.rolesMstiCalls;
    mstp_prxSm(pkt, lport);
+   mstp_clearRxBpduDesc();
+   roleRuns = mstp_perfStats.rolesCistCalls + mstp_perfStats.rolesMstiCalls -
+              roleRuns;
+   mstp_perfStats.rxBpdus++;
+   mstp_perfStats.rxBpduUsec += mstp_perfElapsedUsec(&start);
+   mstp_perfStats.rxBpduRoleRuns += roleRuns;
+   if(roleRuns > mstp_perfStats.rxBpduRoleRunsMax)
+      mstp_perfStats.rxBpduRoleRunsMax = roleRuns;
 
    /*------------------------------------------------------------------------
     * Inform DB about port state changes, if any
@@ -923,10 +923,154 @@ mstpd_daemon_digest_data_dump(struct ds *ds, int argc, const char *argv[])
       }
    }
 
+   ds_put_format(ds, "\nVID to MSTID table mismatches: %u\n",
+                 mstp_vidMstIdTableMismatches());
    ds_put_format(ds, "\n");
 
 }
 
+/**PROC+**********************************************************************
+ * Name:      mstpd_daemon_perf_stats_unixctl_list
+ *
+ * Purpose:   Show MSTP daemon performance statistics
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ **PROC-**********************************************************************/
+
+void mstpd_daemon_perf_stats_unixctl_list(struct unixctl_conn *conn, int argc,
+                   const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    mstpd_daemon_perf_stats_data_dump(&ds, argc, argv);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstpd_daemon_perf_stats_data_dump
+ *
+ * Purpose:   Dump MSTP daemon performance statistics
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ **PROC-**********************************************************************/
+void
+mstpd_daemon_perf_stats_data_dump(struct ds *ds, int argc, const char *argv[])
+{
+   ds_put_format(ds, "\n");
+   ds_put_format(ds, "Default DB population (msec) : %u\n",
+                 mstp_perfStats.dbInitMsec);
+   if(mstp_perfStats.firstBpduTxDone)
+      ds_put_format(ds, "Time to first BPDU (msec)    : %u\n",
+                    mstp_perfStats.firstBpduTxMsec);
+   else
+      ds_put_format(ds, "Time to first BPDU (msec)    : -\n");
+   ds_put_format(ds, "VLAN add events / VLANs      : %u / %u\n",
+                 mstp_perfStats.vlanAddEvents, mstp_perfStats.vlanAddVids);
+   ds_put_format(ds, "VLAN delete events / VLANs   : %u / %u\n",
+                 mstp_perfStats.vlanDelEvents, mstp_perfStats.vlanDelVids);
+   ds_put_format(ds, "L2 port add events / ports   : %u / %u\n",
+                 mstp_perfStats.lportAddEvents, mstp_perfStats.lportAddPorts);
+   ds_put_format(ds, "DB resyncs after reconnect   : %u\n",
+                 mstp_perfStats.dbResyncs);
+   ds_put_format(ds, "Config digest builds/skipped : %u / %u\n",
+                 mstp_perfStats.digestBuilds, mstp_perfStats.digestSkips);
+   ds_put_format(ds, "Config digest time (usec)    : %llu\n",
+                 (unsigned long long)mstp_perfStats.digestUsec);
+   ds_put_format(ds, "Role selections CIST/MSTI    : %u / %u\n",
+                 mstp_perfStats.rolesCistCalls, mstp_perfStats.rolesMstiCalls);
+   ds_put_format(ds, "Role selection ports visited : %llu\n",
+                 (unsigned long long)mstp_perfStats.rolesPortsVisited);
+   ds_put_format(ds, "Role selection time (usec)   : %llu\n",
+                 (unsigned long long)mstp_perfStats.rolesUsec);
+   ds_put_format(ds, "Timer ticks processed        : %u\n",
+                 mstp_perfStats.timerTicks);
+   ds_put_format(ds, "Timer tick time (usec)       : %llu\n",
+                 (unsigned long long)mstp_perfStats.tickUsec);
+   ds_put_format(ds, "Active port loop iterations  : %llu\n",
+                 (unsigned long long)mstp_perfStats.activePortIters);
+   ds_put_format(ds, "BPDUs processed / time (usec): %u / %llu\n",
+                 mstp_perfStats.rxBpdus,
+                 (unsigned long long)mstp_perfStats.rxBpduUsec);
+   ds_put_format(ds, "BPDUs repeated / fast path   : %u / %u\n",
+                 mstp_perfStats.rxBpduRepeats,
+                 mstp_perfStats.rcvInfoFastPath);
+   ds_put_format(ds, "Role selections skipped      : %u\n",
+                 mstp_perfStats.rolesSkipped);
+   ds_put_format(ds, "Trees recomputed for BPDUs   : %llu (max %u per BPDU)\n",
+                 (unsigned long long)mstp_perfStats.rxBpduRoleRuns,
+                 mstp_perfStats.rxBpduRoleRunsMax);
+   ds_put_format(ds, "Events processed             : %u\n",
+                 mstp_perfStats.events);
+   ds_put_format(ds, "State machine runs / merged  : %llu / %llu\n",
+                 (unsigned long long)mstp_perfStats.smRuns,
+                 (unsigned long long)mstp_perfStats.smMerged);
+   ds_put_format(ds, "State machine reruns         : %llu\n",
+                 (unsigned long long)mstp_perfStats.smReruns);
+   ds_put_format(ds, "State machine max nesting    : %u\n",
+                 mstp_perfStats.smMaxDepth);
+   ds_put_format(ds, "MSTI resyncs / trees         : %u / %llu\n",
+                 mstp_perfStats.mstiSyncs,
+                 (unsigned long long)mstp_perfStats.mstiSyncTrees);
+   ds_put_format(ds, "MSTI resync time (usec)      : %llu (max %u)\n",
+                 (unsigned long long)mstp_perfStats.mstiSyncUsec,
+                 mstp_perfStats.mstiSyncUsecMax);
+   ds_put_format(ds, "Reconfigs full / in place    : %u / %u\n",
+                 mstp_perfStats.reconfigFull,
+                 mstp_perfStats.reconfigScoped);
+   ds_put_format(ds, "Reconfig forwarding drops    : %llu\n",
+                 (unsigned long long)mstp_perfStats.reconfigFwdDrops);
+   ds_put_format(ds, "Region changes / boundary    : %u / %u\n",
+                 mstp_perfStats.rgnReconfigs,
+                 mstp_perfStats.rgnBoundaryChgs);
+   ds_put_format(ds, "Port speed changes / cost    : %u / %u\n",
+                 mstp_perfStats.lportSpeedEvents,
+                 mstp_perfStats.lportSpeedCostChgs);
+   ds_put_format(ds, "Tree msg slots used / drains : %llu / %u\n",
+                 (unsigned long long)mstp_perfStats.treeMsgSlotsUsed,
+                 mstp_perfStats.treeMsgDrains);
+   ds_put_format(ds, "TC propagations / TCM kicks  : %u / %llu\n",
+                 mstp_perfStats.tcPropCalls,
+                 (unsigned long long)mstp_perfStats.tcPropKicks);
+   ds_put_format(ds, "TC propagation time (usec)   : %llu\n",
+                 (unsigned long long)mstp_perfStats.tcPropUsec);
+   ds_put_format(ds, "TX BPDUs / event ports / rep : %llu / %llu / %llu\n",
+                 (unsigned long long)mstp_perfStats.txBpdus,
+                 (unsigned long long)mstp_perfStats.txEventPorts,
+                 (unsigned long long)mstp_perfStats.txEventRepeats);
+   ds_put_format(ds, "Deferred TX flushes / ports  : %u / %llu\n",
+                 mstp_perfStats.txDeferredFlushes,
+                 (unsigned long long)mstp_perfStats.txDeferredPorts);
+   ds_put_format(ds, "Link batches / ports         : %u / %u\n",
+                 mstp_perfStats.linkBatches, mstp_perfStats.linkBatchPorts);
+   ds_put_format(ds, "Held role selections / runs  : %u / %u\n",
+                 mstp_perfStats.prsHeldCalls, mstp_perfStats.prsHeldRuns);
+   ds_put_format(ds, "Flap dampening               : %s\n",
+                 mstp_Bridge.flapDampEnabled ? "Enabled" : "Disabled");
+   ds_put_format(ds, "Flap suppress / reuse / ups  : %u / %u / %u\n",
+                 mstp_perfStats.flapSuppressions, mstp_perfStats.flapReuses,
+                 mstp_perfStats.flapIgnoredUps);
+   ds_put_format(ds, "BPDU encodes / templates     : %llu / %u\n",
+                 (unsigned long long)mstp_perfStats.txTmplSends,
+                 mstp_perfStats.txTmplBuilds);
+   ds_put_format(ds, "BPDU bytes written / sent    : %llu / %llu\n",
+                 (unsigned long long)mstp_perfStats.txTmplBytes,
+                 (unsigned long long)mstp_perfStats.txTmplFrameBytes);
+   ds_put_format(ds, "BPDU tree parts sent / clean : %llu / %llu\n",
+                 (unsigned long long)mstp_perfStats.txTmplMsgs,
+                 (unsigned long long)mstp_perfStats.txTmplMsgsClean);
+   ds_put_format(ds, "BPDU encode time (usec)      : %llu\n",
+                 (unsigned long long)mstp_perfStats.txTmplUsec);
+   ds_put_format(ds, "\n");
+}
 
 /**PROC+**********************************************************************
  * Name:      mstpd_daemon_msti_unixctl_list
@@ -1113,11 +1257,11 @@ mstpd_daemon_cist_port_data_dump(struct ds *ds, int argc, const char *argv[])
       MSTP_CIST_BRIDGE_TIMES_t          b_tms;
 
       ds_put_format(ds,"SM Timers     : ");
-      ds_put_format(ds,"fdWhile=%d ", port->fdWhile);
-      ds_put_format(ds,"rrWhile=%d ", port->rrWhile);
-      ds_put_format(ds,"rbWhile=%d ", port->rbWhile);
-      ds_put_format(ds,"tcWhile=%d ", port->tcWhile);
-      ds_put_format(ds,"rcvdInfoWhile=%d\n", port->rcvdInfoWhile);
+      ds_put_format(ds,"fdWhile=%d ", MSTP_PORT_HOT(port, fdWhile));
+      ds_put_format(ds,"rrWhile=%d ", MSTP_PORT_HOT(port, rrWhile));
+      ds_put_format(ds,"rbWhile=%d ", MSTP_PORT_HOT(port, rbWhile));
+      ds_put_format(ds,"tcWhile=%d ", MSTP_PORT_HOT(port, tcWhile));
+      ds_put_format(ds,"rcvdInfoWhile=%d\n", MSTP_PORT_HOT(port, rcvdInfoWhile));
 
       ds_put_format(ds,"Perf Params   : ");
       {
@@ -1273,7 +1417,7 @@ mstpd_daemon_cist_port_data_dump(struct ds *ds, int argc, const char *argv[])
                                                 MSTP_CIST_PORT_CHANGED_MASTER));
       ds_put_format(ds,"SM states: PIM=%-13s PRT=%-12s PST=%-10s TCM=%-12s\n",
              MSTP_PIM_STATE_s[port->pimState],
-             MSTP_PRT_STATE_s[port->prtState],
+             MSTP_PRT_STATE_s[MSTP_PORT_HOT(port, prtState)],
              MSTP_PST_STATE_s[port->pstState],
              MSTP_TCM_STATE_s[port->tcmState]);
 
@@ -1354,11 +1498,11 @@ mstpd_daemon_msti_port_data_dump(struct ds *ds, int argc, const char *argv[])
 
       ds_put_format(ds,"\n");
       ds_put_format(ds,"SM Timers     : ");
-      ds_put_format(ds,"fdWhile=%d ", port->fdWhile);
-      ds_put_format(ds,"rrWhile=%d ", port->rrWhile);
-      ds_put_format(ds,"rbWhile=%d ", port->rbWhile);
-      ds_put_format(ds,"tcWhile=%d ", port->tcWhile);
-      ds_put_format(ds,"rcvdInfoWhile=%d\n", port->rcvdInfoWhile);
+      ds_put_format(ds,"fdWhile=%d ", MSTP_PORT_HOT(port, fdWhile));
+      ds_put_format(ds,"rrWhile=%d ", MSTP_PORT_HOT(port, rrWhile));
+      ds_put_format(ds,"rbWhile=%d ", MSTP_PORT_HOT(port, rbWhile));
+      ds_put_format(ds,"tcWhile=%d ", MSTP_PORT_HOT(port, tcWhile));
+      ds_put_format(ds,"rcvdInfoWhile=%d\n", MSTP_PORT_HOT(port, rcvdInfoWhile));
 
       ds_put_format(ds,"Perf Params   : ");
 
@@ -1487,7 +1631,7 @@ mstpd_daemon_msti_port_data_dump(struct ds *ds, int argc, const char *argv[])
              MSTP_MSTI_PORT_IS_BIT_SET(port->bitMap,MSTP_MSTI_PORT_MASTERED));
       ds_put_format(ds,"SM states: PIM=%-13s PRT=%-12s PST=%-10s TCM=%-12s\n",
              MSTP_PIM_STATE_s[port->pimState],
-             MSTP_PRT_STATE_s[port->prtState],
+             MSTP_PRT_STATE_s[MSTP_PORT_HOT(port, prtState)],
              MSTP_PST_STATE_s[port->pstState],
              MSTP_TCM_STATE_s[port->tcmState]);
 
@@ -1619,6 +1763,10 @@ mstpd_daemon_comm_port_data_dump(struct ds *ds, int argc, const char *argv[])
       ds_put_format(ds,"inBpduError     : %s\n", port->inBpduError ? "Yes" : "No");
       ds_put_format(ds,"Errant BPDUs    : %d\n", MSTP_COMM_ERRANT_BPDU_COUNT(portNum));
       ds_put_format(ds,"dropBPDUs       : %s\n", port->dropBpdu ? "Yes" : "No" );
+      ds_put_format(ds,"Flap penalty    : %u\n", port->flapPenalty);
+      ds_put_format(ds,"Flap suppressed : %s (%u times, %u link ups ignored)\n",
+             port->flapSuppressed ? "Yes" : "No", port->flapSuppressCnt,
+             port->flapIgnoredUps);
       ds_put_format(ds,"\n");
 
    }
@@ -41,6 +41,8 @@ VLOG_DEFINE_THIS_MODULE(mstpd_tcm_sm);
 /*---------------------------------------------------------------------------
  * Local functions prototypes (forward declarations)
  *---------------------------------------------------------------------------*/
+static void mstp_tcmSmRun(MSTID_t mstid, LPORT_t lport);
+static void mstp_tcmSmUpdtTcPropPorts(MSTID_t mstid, LPORT_t lport);
 static void mstp_tcmSmGeneralCond(MSTID_t mstid, LPORT_t lport);
 static bool mstp_tcmSmInactiveCond(MSTID_t mstid, LPORT_t lport);
 static bool mstp_tcmSmLearningCond(MSTID_t mstid, LPORT_t lport);
@@ -81,6 +83,65 @@ static void mstp_tcmSmAcknowledgedAct(MSTID_t mstid, LPORT_t lport);
  **PROC-**********************************************************************/
 void
 mstp_tcmSm(MSTID_t mstid, LPORT_t lport)
+{
+   /* nested calls are merged, see 'mstp_smEnter' */
+   if(mstp_smEnter(MSTP_SM_ID_TCM, mstid, lport))
+   {
+      do
+      {
+         mstp_tcmSmRun(mstid, lport);
+      }
+      while(mstp_smRerun());
+      mstp_tcmSmUpdtTcPropPorts(mstid, lport);
+      mstp_smLeave();
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_tcmSmUpdtTcPropPorts
+ *
+ * Purpose:   Keep the port in the tree's map of ports 'setTcPropTree'
+ *            propagates topology changes to, according to the state the
+ *            Topology Change state machine has settled in.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ **PROC-**********************************************************************/
+static void
+mstp_tcmSmUpdtTcPropPorts(MSTID_t mstid, LPORT_t lport)
+{
+   MSTP_TCM_STATE_t *statePtr = mstp_utilTcmStatePtr(mstid, lport);
+   PORT_MAP         *pmap;
+
+   pmap = (mstid == MSTP_CISTID) ? &MSTP_CIST_INFO.tcPropPorts :
+                                   &MSTP_MSTI_INFO(mstid)->tcPropPorts;
+
+   if(statePtr && MSTP_TCM_STATE_TAKES_TC_PROP(*statePtr))
+      set_port(pmap, lport);
+   else
+      clear_port(pmap, lport);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_tcmSmRun
+ *
+ * Purpose:   Run the Topology Change state machine until it settles.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:
+ *
+ **PROC-**********************************************************************/
+static void
+mstp_tcmSmRun(MSTID_t mstid, LPORT_t lport)
 {
    MSTP_TCM_STATE_t *statePtr = NULL;
    bool             next     = FALSE;/* This variable is used to indicate
@@ -842,7 +903,9 @@ mstp_tcmSmInactiveAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      cistPortPtr->tcWhile = 0;
+      if(MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
+      MSTP_PORT_HOT(cistPortPtr, tcWhile) = 0;
       MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_TC_ACK);
       /* NOTE: we need to clear 'rcvdTcn' flag as it is possible to have
        *           this flag stuck on the disconnected port (e.g. a port just
@@ -856,7 +919,9 @@ mstp_tcmSmInactiveAct(MSTID_t mstid, LPORT_t lport)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      mstiPortPtr->tcWhile = 0;
+      if(MSTP_PORT_HOT(mstiPortPtr, tcWhile) != 0)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
+      MSTP_PORT_HOT(mstiPortPtr, tcWhile) = 0;
    }
 }
 
@@ -1141,14 +1206,18 @@ mstp_tcmSmAcknowledgedAct(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      cistPortPtr->tcWhile = 0;
+      if(MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
+      MSTP_PORT_HOT(cistPortPtr, tcWhile) = 0;
    }
    else
    {
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      mstiPortPtr->tcWhile = 0;
+      if(MSTP_PORT_HOT(mstiPortPtr, tcWhile) != 0)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
+      MSTP_PORT_HOT(mstiPortPtr, tcWhile) = 0;
    }
 
    MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap, MSTP_PORT_RCVD_TC_ACK);
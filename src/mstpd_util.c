@@ -20,6 +20,7 @@
  **********************************************************************************/
 #include <getopt.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <pthread.h>
 #include <sys/time.h>
@@ -51,12 +52,6 @@ static void    mstp_updtMstiRootInfoChg(MSTID_t mstid);
 static void    mstp_updtMstiPortStateChgMsg(MSTID_t mstid, LPORT_t lport,
                                             MSTP_ACT_TYPE_t state);
 static bool    mstp_isNeighboreBridgeInMyRegion(MSTP_RX_PDU *pkt);
-static int     mstp_cistPriorityVectorsCompare
-                                           (MSTP_CIST_BRIDGE_PRI_VECTOR_t *v1,
-                                            MSTP_CIST_BRIDGE_PRI_VECTOR_t *v2);
-static int     mstp_mstiPriorityVectorsCompare
-                                           (MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v1,
-                                            MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v2);
 static MSTP_MSTI_CONFIG_MSG_t *
                mstp_findMstiCfgMsgInBpdu(MSTP_RX_PDU *pkt, MSTID_t mstid);
 static bool    mstp_isStpConfigBpdu(MSTP_RX_PDU *pkt);
@@ -66,6 +61,10 @@ static bool    mstp_isMstBpdu(MSTP_RX_PDU *pkt);
 static bool    mstp_isSelfSentPkt(MSTP_RX_PDU *pkt);
 static void    mstp_updtRolesCist(void);
 static void    mstp_updtRolesMsti(MSTID_t mstid);
+static uint8_t mstp_roleInputFlags(MSTP_COMM_PORT_INFO_t *commPortPtr,
+                                   bool loopInconsist, uint8_t rcvdInfoWhile);
+static bool    mstp_cistRoleInputsChanged(void);
+static bool    mstp_mstiRoleInputsChanged(MSTID_t mstid);
 static MSTP_RCVD_INFO_t
                mstp_rcvInfoCist(MSTP_RX_PDU *pkt, LPORT_t lport);
 static MSTP_RCVD_INFO_t
@@ -76,6 +75,35 @@ static bool    mstp_isOldRootPropagation(MSTID_t mstid, LPORT_t lport,
                                          MSTP_MST_BPDU_t *bpdu,
                                          MSTP_MSTI_CONFIG_MSG_t *cfgMsgPtr,
                                          bool bpduSameRgn);
+static bool    mstp_isRxBpduRepeated(MSTP_RX_PDU *pkt,
+                                     const MSTP_COMM_PORT_INFO_t *commPortPtr);
+static void    mstp_recordRxBpdu(MSTP_RX_PDU *pkt,
+                                 MSTP_COMM_PORT_INFO_t *commPortPtr);
+static bool    mstp_rcvInfoIsRepeated(MSTP_RX_PDU *pkt, MSTID_t mstid,
+                                      LPORT_t lport);
+static MSTP_MST_BPDU_t *
+               mstp_txBpduTemplate(LPORT_t lport,
+                                   MSTP_COMM_PORT_INFO_t *commPortPtr);
+static void    mstp_txPatch(void *dst, const void *src, size_t len);
+static void    mstp_txPatchShort(uint16_t *dst, uint16_t value);
+static void    mstp_txPatchLong(uint32_t *dst, uint32_t value);
+static void    mstp_txPatchBridgeId(MSTP_BRIDGE_IDENTIFIER_t *dst,
+                                    const MSTP_BRIDGE_IDENTIFIER_t *src);
+static void    mstp_txCistEncode(MSTP_MST_BPDU_t *bpdu,
+                                 MSTP_CIST_PORT_INFO_t *cistPortPtr);
+static void    mstp_txMstiMsgEncode(MSTP_MSTI_INFO_t *mstiPtr,
+                                    MSTP_MSTI_PORT_INFO_t *mstiPortPtr,
+                                    MSTP_MSTI_CONFIG_MSG_t *mstiMsg);
+static bool    mstp_portSpeedDplxApply(LPORT_t lport, SPEED_DPLX *speedDplx,
+                                       bool reselect);
+
+/* descriptor of the received BPDU that is currently being processed */
+static MSTP_RX_BPDU_DESC_t mstp_rxBpduDesc;
+
+/* state machine invocations in progress, innermost last */
+static MSTP_SM_FRAME_t     mstp_smFrames[MSTP_SM_FRAMES_MAX];
+static uint32_t            mstp_smDepth;
+
 /** ====================================================================== **
  *                                                                          *
  *     Global Functions (externed)                                          *
@@ -145,6 +173,125 @@ void mstp_setDynReconfigChangeFlag (void)
    return;
 }
 
+/**PROC+**********************************************************************
+ * Name:      mstp_setScopedReconfig
+ *
+ * Purpose:   Record a change of the Bridge Identifier Priority of a tree
+ *            (lport 0), or of the Port Identifier Priority or Port Path Cost
+ *            of one of its ports, that is to be applied in place: 'reselect'
+ *            is set and 'selected' cleared for the affected ports so the
+ *            tree's Port Role Selection recomputes its priority vectors
+ *            without restarting the protocol on the other trees
+ *            (see 'mstp_applyScopedReconfigChanges').
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number, 0 for all ports of the tree
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ **PROC-**********************************************************************/
+void
+mstp_setScopedReconfig(MSTID_t mstid, LPORT_t lport)
+{
+   LPORT_t p;
+
+   if((MSTP_ENABLED == FALSE) || !MSTP_INSTANCE_IS_VALID(mstid))
+      return;
+
+   for(p = lport ? lport : (LPORT_t)find_first_port_set(&mstp_Bridge.activeLports);
+       IS_VALID_LPORT(p);
+       p = lport ? 0 : (LPORT_t)find_next_port_set(&mstp_Bridge.activeLports, p))
+   {
+      if(mstid == MSTP_CISTID)
+      {
+         MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(p);
+
+         if(cistPortPtr)
+         {
+            MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap,
+                                   MSTP_CIST_PORT_RESELECT);
+            MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap,
+                                   MSTP_CIST_PORT_SELECTED);
+         }
+      }
+      else
+      {
+         MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, p);
+
+         if(mstiPortPtr)
+         {
+            MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap,
+                                   MSTP_MSTI_PORT_RESELECT);
+            MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap,
+                                   MSTP_MSTI_PORT_SELECTED);
+         }
+      }
+   }
+
+   setBit(mstp_Bridge.reconfigTrees.map, mstid + 1,
+          MSTP_ROLES_DIRTY_MAP_BITS);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_setRegionReconfig
+ *
+ * Purpose:   Record a change of the MST Configuration Identifier (name,
+ *            revision level or VIDs to MSTIs mapping digest) that is to be
+ *            applied in place: only the ports that move across the Region
+ *            boundary are re-evaluated, the protocol keeps running on the
+ *            others (see 'mstp_applyScopedReconfigChanges').
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ **PROC-**********************************************************************/
+void
+mstp_setRegionReconfig(void)
+{
+   if(MSTP_ENABLED == TRUE)
+   {
+      mstp_Bridge.rgnReconfig = TRUE;
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_updtBridgePriorityVector
+ *
+ * Purpose:   Copy a changed priority component of the tree's
+ *            'BridgeIdentifier' into its 'BridgePriority' vector
+ *            (802.1Q-REV/D5.0 13.23 d)), the other components are left as
+ *            they were set at initialization.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ **PROC-**********************************************************************/
+void
+mstp_updtBridgePriorityVector(MSTID_t mstid)
+{
+   if(mstid == MSTP_CISTID)
+   {
+      MSTP_CIST_BRIDGE_PRIORITY.rootID.priority =
+         MSTP_CIST_BRIDGE_IDENTIFIER.priority;
+      MSTP_CIST_BRIDGE_PRIORITY.rgnRootID.priority =
+         MSTP_CIST_BRIDGE_IDENTIFIER.priority;
+      MSTP_CIST_BRIDGE_PRIORITY.dsnBridgeID.priority =
+         MSTP_CIST_BRIDGE_IDENTIFIER.priority;
+   }
+   else if(MSTP_MSTI_INFO(mstid))
+   {
+      MSTP_MSTI_BRIDGE_PRIORITY(mstid).rgnRootID.priority =
+         MSTP_MSTI_BRIDGE_IDENTIFIER(mstid).priority;
+      MSTP_MSTI_BRIDGE_PRIORITY(mstid).dsnBridgeID.priority =
+         MSTP_MSTI_BRIDGE_IDENTIFIER(mstid).priority;
+   }
+}
+
 /**PROC+**********************************************************************
  * Name:      mstp_portAutoDetectParamsSet
  *
@@ -167,42 +314,116 @@ void mstp_setDynReconfigChangeFlag (void)
 void
 mstp_portAutoDetectParamsSet(LPORT_t lport, SPEED_DPLX* speedDplx)
 {
-   MSTID_t                mstid;
-   MSTP_COMM_PORT_INFO_t *commPortPtr;
+   STP_ASSERT(MSTP_ENABLED);
+   STP_ASSERT(IS_VALID_LPORT(lport));
 
+   mstp_portSpeedDplxApply(lport, speedDplx, FALSE);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_portSpeedChange
+ *
+ * Purpose:   Apply a new speed and duplex mode of a port that stays 'Up',
+ *            e.g. a LAG that gained or lost a member. Auto-detected path
+ *            costs that change are applied by reselection on the trees
+ *            they belong to (see 'mstp_setScopedReconfig'), the port keeps
+ *            its role and state otherwise.
+ *
+ * Params:    lport     -> logical port in question
+ *            speedDplx -> new speed and duplex of the port
+ *
+ * Returns:   TRUE if a path cost of the port has changed, FALSE otherwise
+ *
+ * Globals:   none
+ *
+ **PROC-**********************************************************************/
+bool
+mstp_portSpeedChange(LPORT_t lport, SPEED_DPLX* speedDplx)
+{
    STP_ASSERT(MSTP_ENABLED);
    STP_ASSERT(IS_VALID_LPORT(lport));
 
+   if(!MSTP_COMM_PORT_PTR(lport) || !MSTP_CIST_PORT_PTR(lport))
+      return FALSE;
+
+   return mstp_portSpeedDplxApply(lport, speedDplx, TRUE);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_portSpeedDplxApply
+ *
+ * Purpose:   Set the auto-detected path costs of the port on every tree, and
+ *            its operational Point to Point MAC parameter, from the speed
+ *            and duplex mode of the link.
+ *            NOTE: a path cost is auto-detected on a tree the port has no
+ *                  'useCfgPathCost' for. MESH port is being enforced always
+ *                  have the lowest path cost.
+ *
+ * Params:    lport     -> logical port number
+ *            speedDplx -> logical port's speed/duplex information
+ *            reselect  -> TRUE to request reselection on each tree whose
+ *                         path cost has changed (port already 'Up')
+ *
+ * Returns:   TRUE if a path cost of the port has changed, FALSE otherwise
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static bool
+mstp_portSpeedDplxApply(LPORT_t lport, SPEED_DPLX *speedDplx, bool reselect)
+{
+   MSTID_t                mstid;
+   MSTP_COMM_PORT_INFO_t *commPortPtr;
+   MSTP_CIST_PORT_INFO_t *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
+   uint32_t               autoPathCost;
+   bool                   res = FALSE;
+
    commPortPtr = MSTP_COMM_PORT_PTR(lport);
-   STP_ASSERT(commPortPtr);
+   cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+   STP_ASSERT(commPortPtr && cistPortPtr);
 
    /*------------------------------------------------------------------------
     * Set path cost value for the port
-    * NOTE: MESH port is being enforced always have the lowest path cost
     *------------------------------------------------------------------------*/
-      {
-         uint32_t autoPathCost = mstp_convertLportSpeedToPathCost(speedDplx);
+   autoPathCost = mstp_convertLportSpeedToPathCost(speedDplx);
+
+   if((commPortPtr->useCfgPathCost == FALSE) &&
+      (commPortPtr->ExternalPortPathCost != autoPathCost))
+   {
+      commPortPtr->ExternalPortPathCost = autoPathCost;
+      if(reselect)
+         mstp_setScopedReconfig(MSTP_CISTID, lport);
+      res = TRUE;
+   }
 
-         if(commPortPtr->useCfgPathCost == FALSE)
-            commPortPtr->ExternalPortPathCost = autoPathCost;
+   if((cistPortPtr->useCfgPathCost == FALSE) &&
+      (cistPortPtr->InternalPortPathCost != autoPathCost))
+   {
+      cistPortPtr->InternalPortPathCost = autoPathCost;
+      if(reselect)
+         mstp_setScopedReconfig(MSTP_CISTID, lport);
+      res = TRUE;
+   }
 
-         STP_ASSERT(MSTP_CIST_PORT_PTR(lport));
-         if(MSTP_CIST_PORT_PTR(lport)->useCfgPathCost == FALSE)
-            MSTP_CIST_PORT_PTR(lport)->InternalPortPathCost = autoPathCost;
+   for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_INSTANCES_MAX; mstid++)
+   {
+      if(!MSTP_MSTI_VALID(mstid))
+         continue;
 
-         for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_INSTANCES_MAX; mstid++)
-         {
-            if(MSTP_MSTI_VALID(mstid))
-            {
-               STP_ASSERT(MSTP_MSTI_PORT_PTR(mstid, lport));
-               if(MSTP_MSTI_PORT_PTR(mstid, lport)->useCfgPathCost == FALSE)
-               {
-                  MSTP_MSTI_PORT_PTR(mstid, lport)->InternalPortPathCost =
-                                                                  autoPathCost;
-               }
-            }
-         }
+      mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
+      STP_ASSERT(mstiPortPtr);
+      if((mstiPortPtr->useCfgPathCost == FALSE) &&
+         (mstiPortPtr->InternalPortPathCost != autoPathCost))
+      {
+         mstiPortPtr->InternalPortPathCost = autoPathCost;
+         if(reselect)
+            mstp_setScopedReconfig(mstid, lport);
+         res = TRUE;
       }
+   }
+
    /*------------------------------------------------------------------------
     * Set operational value of the port's Point to Point MAC parameter
     *------------------------------------------------------------------------*/
@@ -215,131 +436,385 @@ mstp_portAutoDetectParamsSet(LPORT_t lport, SPEED_DPLX* speedDplx)
          MSTP_COMM_PORT_CLR_BIT(commPortPtr->bitMap,
                                 MSTP_PORT_OPER_POINT_TO_POINT_MAC);
    }
+
+   return res;
 }
 
 /**PROC+**********************************************************************
- * Name:      mstp_portAutoPathCostDetect
+ * Name:      mstp_holdPrs
  *
- * Purpose:   Calculate Path Cost information to be set for the MSTP port
- *            based on the connection speed and duplex mode this port
- *            currently operates with.
+ * Purpose:   Hold Port Role Selection while a batch of link changes is
+ *            applied. The trees 'mstp_prsSm' is called for meanwhile are
+ *            only recorded, 'mstp_releasePrs' runs each of them once.
  *
- * Params:    lport    -> logical port in question
+ * Params:    none
  *
- * Returns:   Path Cost value that corresponds to the current value of the
- *            port's physical link characteristics.
+ * Returns:   none
  *
- * Globals:   none
+ * Globals:   mstp_Bridge
  *
- * Constraints:
  **PROC-**********************************************************************/
-uint32_t
-mstp_portAutoPathCostDetect(LPORT_t lport)
+void
+mstp_holdPrs(void)
 {
-   uint32_t    pathCost;
-   SPEED_DPLX speedDplx;
-
-   STP_ASSERT(IS_VALID_LPORT(lport));
-   /*------------------------------------------------------------------------
-    * NOTE: 'intf_get_lport_speed_duplex' function returns FALSE only if
-    *       'lport' is not connected.
-    *       For not connected port we return '0' path cost value indicating
-    *       that auto speed detection failed. Zero path cost value also
-    *       indicates that the logical port is configured to
-    *       'auto speed detection mode', i.e. port should calculate the path
-    *       cost from the link connection speed rather then use config info.
-    *------------------------------------------------------------------------*/
-   if(intf_get_lport_speed_duplex(lport, &speedDplx))
-      pathCost = mstp_convertLportSpeedToPathCost(&speedDplx);
-   else
-      pathCost = 0;
+   STP_ASSERT(MSTP_ENABLED);
+   STP_ASSERT(mstp_Bridge.prsHold == FALSE);
 
-   return pathCost;
+   mstp_Bridge.prsHold = TRUE;
+   clearBitmap(mstp_Bridge.prsHeldTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
+   mstp_Bridge.prsHeldRgnRootID = MSTP_CIST_ROOT_PRIORITY.rgnRootID;
 }
 
 /**PROC+**********************************************************************
- * Name:      mstp_portDuplexModeDetect
+ * Name:      mstp_releasePrs
  *
- * Purpose:   Find what duplex mode the given logical port currently operates
- *            with.
+ * Purpose:   Release Port Role Selection held by 'mstp_holdPrs' and run it
+ *            for the trees it was requested for, the CIST first. If that
+ *            makes this Bridge the Regional Root or changes the Regional
+ *            Root, the MSTIs of the given ports follow their CIST role,
+ *            as the Port Information state machine does for an aged port
+ *            (see 'mstp_pimSmAgedAct').
  *
- * Params:    lport    -> logical port in question
+ * Params:    syncPorts -> ports the batch enabled, NULL for none
  *
- * Returns:   logical port's current duplex mode.
+ * Returns:   none
  *
- * Globals:   none
+ * Globals:   mstp_Bridge
  *
- * Constraints:
  **PROC-**********************************************************************/
-PORT_DUPLEX
-mstp_portDuplexModeDetect(LPORT_t lport)
+void
+mstp_releasePrs(const PORT_MAP *syncPorts)
 {
-   PORT_DUPLEX portDuplex;
-   SPEED_DPLX  speedDplx;
+   MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
+   MSTID_t                mstid;
+   LPORT_t                lport;
+   int                    bit;
 
-   STP_ASSERT(IS_VALID_LPORT(lport));
+   STP_ASSERT(mstp_Bridge.prsHold == TRUE);
+   mstp_Bridge.prsHold = FALSE;
 
-   /*------------------------------------------------------------------------
-    * NOTE: 'intf_get_lport_speed_duplex' function returns FALSE only if
-    *       'lport' is not connected.
-    *------------------------------------------------------------------------*/
-   if(intf_get_lport_speed_duplex(lport, &speedDplx))
-      portDuplex = speedDplx.duplex;
-   else
-      portDuplex = FULL_DUPLEX;
+   if(isBitSet(mstp_Bridge.prsHeldTrees.map, MSTP_CISTID + 1,
+               MSTP_ROLES_DIRTY_MAP_BITS) && MSTP_CIST_VALID)
+   {
+      mstp_prsSm(MSTP_CISTID);
+      mstp_perfStats.prsHeldRuns++;
 
-   return portDuplex;
+      if(syncPorts &&
+         (MSTP_IS_THIS_BRIDGE_RROOT(MSTP_CISTID) ||
+          !MSTP_BRIDGE_ID_EQUAL(mstp_Bridge.prsHeldRgnRootID,
+                                MSTP_CIST_ROOT_PRIORITY.rgnRootID)))
+      {
+         for(lport = (LPORT_t)find_first_port_set(syncPorts);
+             IS_VALID_LPORT(lport);
+             lport = (LPORT_t)find_next_port_set(syncPorts, lport))
+         {
+            if(!MSTP_COMM_PORT_PTR(lport))
+               continue;
+
+            for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_INSTANCES_MAX; mstid++)
+            {
+               mstiPortPtr = MSTP_MSTI_VALID(mstid) ?
+                             MSTP_MSTI_PORT_PTR(mstid, lport) : NULL;
+               if(mstiPortPtr)
+               {
+                  MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap,
+                                         MSTP_MSTI_PORT_RESELECT);
+                  MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap,
+                                         MSTP_MSTI_PORT_SELECTED);
+                  setBit(mstp_Bridge.prsHeldTrees.map, mstid + 1,
+                         MSTP_ROLES_DIRTY_MAP_BITS);
+               }
+            }
+         }
+      }
+   }
+
+   for(bit = findNextBitSet(mstp_Bridge.prsHeldTrees.map, MSTP_CISTID + 1,
+                            MSTP_ROLES_DIRTY_MAP_BITS);
+       bit > 0;
+       bit = findNextBitSet(mstp_Bridge.prsHeldTrees.map, bit,
+                            MSTP_ROLES_DIRTY_MAP_BITS))
+   {
+      mstid = (MSTID_t)(bit - 1);
+      if(!MSTP_MSTI_VALID(mstid))
+         continue;
+
+      mstp_prsSm(mstid);
+      mstp_perfStats.prsHeldRuns++;
+   }
+
+   clearBitmap(mstp_Bridge.prsHeldTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
 }
 
 /**PROC+**********************************************************************
- * Name:      mstp_isLportFwdOnVlan
+ * Name:      mstp_flapDampLinkDown
  *
- * Purpose:   Return whether logical port is forwarding on the VLAN.
+ * Purpose:   Charge the flap penalty to a port whose link went down. The
+ *            port is suppressed, i.e. its following link ups are ignored,
+ *            once the penalty reaches the suppress threshold. The penalty
+ *            is capped at four times that threshold, so a port that kept
+ *            flapping is not suppressed indefinitely.
  *
  * Params:    lport -> logical port number
- *            vlan  -> vlan number
  *
- * Returns:   TRUE if 'lport' is in FORWARDING state on the 'vlan',
- *            FALSE otherwise
+ * Returns:   TRUE if the port is suppressed, FALSE otherwise
  *
  * Globals:   mstp_Bridge
  *
- * Constraints:
  **PROC-**********************************************************************/
 bool
-mstp_isLportFwdOnVlan(LPORT_t lport, VID_t vlan)
+mstp_flapDampLinkDown(LPORT_t lport)
 {
-   bool res = FALSE;
+   MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
+   uint32_t               ceiling;
 
-   STP_ASSERT(IS_VALID_LPORT(lport));
-   STP_ASSERT(IS_VALID_VID(vlan));
+   if(!commPortPtr || !mstp_Bridge.flapDampEnabled)
+      return FALSE;
 
-   if(MSTP_ENABLED == FALSE)
-   {
-         res = TRUE;
-   }
-   else
+   ceiling = mstp_Bridge.flapSuppress * 4;
+   commPortPtr->flapPenalty += mstp_Bridge.flapPenalty;
+   if(commPortPtr->flapPenalty > ceiling)
+      commPortPtr->flapPenalty = ceiling;
+   set_port(&mstp_Bridge.flapDampLports, lport);
+
+   if(!commPortPtr->flapSuppressed &&
+      (commPortPtr->flapPenalty >= mstp_Bridge.flapSuppress))
    {
-      MSTID_t mstid;
+      char lport_name[PORTNAME_LEN];
 
-       /* Find an MST Instance the VLAN is being mapped to */
-      if(((mstid = mstp_getMstIdForVlan(vlan)) != MSTP_NO_MSTID) &&
-         MSTP_INSTANCE_IS_VALID(mstid))
-      {/* Look at MSTI port state */
-         if(mstid == MSTP_CISTID)
-         {
-            MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+      commPortPtr->flapSuppressed = TRUE;
+      commPortPtr->flapSuppressCnt++;
+      mstp_perfStats.flapSuppressions++;
+      intf_get_port_name(lport, lport_name);
+      VLOG_INFO("MSTP port %s link flapping, suppressed (penalty %u)",
+                lport_name, commPortPtr->flapPenalty);
+   }
 
-            if(cistPortPtr &&
-               (cistPortPtr->pstState == MSTP_PST_STATE_FORWARDING))
-            {
-               res = TRUE;
-            }
-         }
-         else
-         {
-            MSTP_MSTI_PORT_INFO_t *mstiPortPtr =
-                                              MSTP_MSTI_PORT_PTR(mstid, lport);
+   return commPortPtr->flapSuppressed;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_flapDampTick
+ *
+ * Purpose:   Decay the flap penalties by one second of their half-life.
+ *            Ports whose penalty falls to the reuse threshold are no
+ *            longer suppressed, a penalty that falls below half of it is
+ *            forgotten.
+ *
+ * Params:    reuse -> filled with the ports released from suppression
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ **PROC-**********************************************************************/
+void
+mstp_flapDampTick(PORT_MAP *reuse)
+{
+   MSTP_COMM_PORT_INFO_t *commPortPtr;
+   LPORT_t                lport;
+   uint32_t               decay;
+
+   clear_port_map(reuse);
+
+   for(lport = (LPORT_t)find_first_port_set(&mstp_Bridge.flapDampLports);
+       IS_VALID_LPORT(lport);
+       lport = (LPORT_t)find_next_port_set(&mstp_Bridge.flapDampLports, lport))
+   {
+      commPortPtr = MSTP_COMM_PORT_PTR(lport);
+      if(!commPortPtr)
+      {
+         clear_port(&mstp_Bridge.flapDampLports, lport);
+         continue;
+      }
+
+      /* exp(-ln2 / halfLife) per second, to first order */
+      decay = (uint32_t)(((uint64_t)commPortPtr->flapPenalty * 693) /
+                         (1000 * mstp_Bridge.flapHalfLife));
+      if(decay == 0)
+         decay = 1;
+      commPortPtr->flapPenalty = (commPortPtr->flapPenalty > decay) ?
+                                 commPortPtr->flapPenalty - decay : 0;
+
+      if(commPortPtr->flapSuppressed &&
+         (commPortPtr->flapPenalty <= mstp_Bridge.flapReuse))
+      {
+         commPortPtr->flapSuppressed = FALSE;
+         mstp_perfStats.flapReuses++;
+         set_port(reuse, lport);
+      }
+
+      if(!commPortPtr->flapSuppressed &&
+         (commPortPtr->flapPenalty < mstp_Bridge.flapReuse / 2))
+      {
+         commPortPtr->flapPenalty = 0;
+         clear_port(&mstp_Bridge.flapDampLports, lport);
+      }
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_flapDampReset
+ *
+ * Purpose:   Forget all flap penalties, e.g. when dampening is disabled.
+ *
+ * Params:    reuse -> filled with the ports released from suppression
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ **PROC-**********************************************************************/
+void
+mstp_flapDampReset(PORT_MAP *reuse)
+{
+   MSTP_COMM_PORT_INFO_t *commPortPtr;
+   LPORT_t                lport;
+
+   clear_port_map(reuse);
+
+   for(lport = (LPORT_t)find_first_port_set(&mstp_Bridge.flapDampLports);
+       IS_VALID_LPORT(lport);
+       lport = (LPORT_t)find_next_port_set(&mstp_Bridge.flapDampLports, lport))
+   {
+      commPortPtr = MSTP_COMM_PORT_PTR(lport);
+      if(commPortPtr)
+      {
+         if(commPortPtr->flapSuppressed)
+         {
+            commPortPtr->flapSuppressed = FALSE;
+            mstp_perfStats.flapReuses++;
+            set_port(reuse, lport);
+         }
+         commPortPtr->flapPenalty = 0;
+      }
+   }
+   clear_port_map(&mstp_Bridge.flapDampLports);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_portAutoPathCostDetect
+ *
+ * Purpose:   Calculate Path Cost information to be set for the MSTP port
+ *            based on the connection speed and duplex mode this port
+ *            currently operates with.
+ *
+ * Params:    lport    -> logical port in question
+ *
+ * Returns:   Path Cost value that corresponds to the current value of the
+ *            port's physical link characteristics.
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+uint32_t
+mstp_portAutoPathCostDetect(LPORT_t lport)
+{
+   uint32_t    pathCost;
+   SPEED_DPLX speedDplx;
+
+   STP_ASSERT(IS_VALID_LPORT(lport));
+   /*------------------------------------------------------------------------
+    * NOTE: 'intf_get_lport_speed_duplex' function returns FALSE only if
+    *       'lport' is not connected.
+    *       For not connected port we return '0' path cost value indicating
+    *       that auto speed detection failed. Zero path cost value also
+    *       indicates that the logical port is configured to
+    *       'auto speed detection mode', i.e. port should calculate the path
+    *       cost from the link connection speed rather then use config info.
+    *------------------------------------------------------------------------*/
+   if(intf_get_lport_speed_duplex(lport, &speedDplx))
+      pathCost = mstp_convertLportSpeedToPathCost(&speedDplx);
+   else
+      pathCost = 0;
+
+   return pathCost;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_portDuplexModeDetect
+ *
+ * Purpose:   Find what duplex mode the given logical port currently operates
+ *            with.
+ *
+ * Params:    lport    -> logical port in question
+ *
+ * Returns:   logical port's current duplex mode.
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+PORT_DUPLEX
+mstp_portDuplexModeDetect(LPORT_t lport)
+{
+   PORT_DUPLEX portDuplex;
+   SPEED_DPLX  speedDplx;
+
+   STP_ASSERT(IS_VALID_LPORT(lport));
+
+   /*------------------------------------------------------------------------
+    * NOTE: 'intf_get_lport_speed_duplex' function returns FALSE only if
+    *       'lport' is not connected.
+    *------------------------------------------------------------------------*/
+   if(intf_get_lport_speed_duplex(lport, &speedDplx))
+      portDuplex = speedDplx.duplex;
+   else
+      portDuplex = FULL_DUPLEX;
+
+   return portDuplex;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_isLportFwdOnVlan
+ *
+ * Purpose:   Return whether logical port is forwarding on the VLAN.
+ *
+ * Params:    lport -> logical port number
+ *            vlan  -> vlan number
+ *
+ * Returns:   TRUE if 'lport' is in FORWARDING state on the 'vlan',
+ *            FALSE otherwise
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+bool
+mstp_isLportFwdOnVlan(LPORT_t lport, VID_t vlan)
+{
+   bool res = FALSE;
+
+   STP_ASSERT(IS_VALID_LPORT(lport));
+   STP_ASSERT(IS_VALID_VID(vlan));
+
+   if(MSTP_ENABLED == FALSE)
+   {
+         res = TRUE;
+   }
+   else
+   {
+      MSTID_t mstid;
+
+       /* Find an MST Instance the VLAN is being mapped to */
+      if(((mstid = mstp_getMstIdForVlan(vlan)) != MSTP_NO_MSTID) &&
+         MSTP_INSTANCE_IS_VALID(mstid))
+      {/* Look at MSTI port state */
+         if(mstid == MSTP_CISTID)
+         {
+            MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+
+            if(cistPortPtr &&
+               (cistPortPtr->pstState == MSTP_PST_STATE_FORWARDING))
+            {
+               res = TRUE;
+            }
+         }
+         else
+         {
+            MSTP_MSTI_PORT_INFO_t *mstiPortPtr =
+                                              MSTP_MSTI_PORT_PTR(mstid, lport);
 
             if(mstiPortPtr &&
                (mstiPortPtr->pstState == MSTP_PST_STATE_FORWARDING))
@@ -503,7 +978,7 @@ mstp_collectNotForwardingPorts(PORT_MAP *pmap)
     * Collect all MSTP ports that are not in FORWARDING state
     *------------------------------------------------------------------------*/
    clear_port_map(pmap);
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       commPortPtr = MSTP_COMM_PORT_PTR(lport);
       if(commPortPtr &&
@@ -791,7 +1266,7 @@ mstp_enableActiveLogicalPorts(void)
 {
    LPORT_t lport;
 
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       if(MSTP_COMM_PORT_PTR(lport) && !is_lport_down(lport))
       {
@@ -825,14 +1300,14 @@ mstp_utilPrtStatePtr(MSTID_t mstid, LPORT_t lport)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
       STP_ASSERT(cistPortPtr);
-      statePtr = &cistPortPtr->prtState;
+      statePtr = &MSTP_PORT_HOT(cistPortPtr, prtState);
    }
    else
    {
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
       STP_ASSERT(mstiPortPtr);
-      statePtr = &mstiPortPtr->prtState;
+      statePtr = &MSTP_PORT_HOT(mstiPortPtr, prtState);
    }
 
    return statePtr;
@@ -1114,20 +1589,7 @@ mstp_flush(MSTID_t mstid, LPORT_t lport)
    STP_ASSERT((mstid == MSTP_CISTID) || MSTP_VALID_MSTID(mstid));
    STP_ASSERT(IS_VALID_LPORT(lport));
 
-   m = mstp_findMstiPortStateChgMsg(mstid);
-   if(m == NULL)
-   {
-       m = calloc(1, sizeof(MSTP_TREE_MSG_t));
-       if (!m)
-       {
-           STP_ASSERT(0);
-           return;
-       }
-      m->mstid        = mstid;
-      m->link.q_flink = NULL;
-      m->link.q_blink = NULL;
-      insqti_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
-   }
+   m = mstp_getMstiPortStateChgMsg(mstid);
 
    set_port(&m->portsMacAddrFlush, lport);
    MSTP_MSTI_PORT_FLUSH_PRINTF(mstid, lport, MSTP_PORT_STATE_ON_TREE_FMT,
@@ -1365,10 +1827,11 @@ mstp_isOldRootPropagation(MSTID_t mstid, LPORT_t lport, MSTP_MST_BPDU_t *bpdu,
  * Name:     mstp_preventTxOnBridge
  *
  * Purpose:  Postpone any BPDU transmissions on the Bridge (for all ports
- *           for all Trees). We use global 'preventTx' bool variable
+ *           for all Trees). We use global 'preventTx' counter
  *           to indicate whether or not BPDU transmission is allowed on
- *           this Bridge. This function is a counterpart to the
- *           'mstp_doPendingTxOnBridge' function.
+ *           this Bridge. The calls nest, transmission resumes when the
+ *           outermost lock is released. This function is a counterpart
+ *           to the 'mstp_doPendingTxOnBridge' function.
  *
  * Params:   none
  *
@@ -1381,14 +1844,17 @@ void
 mstp_preventTxOnBridge(void)
 {
    STP_ASSERT(MSTP_ENABLED);
-   STP_ASSERT(mstp_Bridge.preventTx == FALSE);
-   mstp_Bridge.preventTx = TRUE;
+   mstp_Bridge.preventTx++;
 }
 
 /**PROC+**********************************************************************
  * Name:     mstp_doPendingTxOnBridge
  *
- * Purpose:  Call PTX SM for all ports that have pending BDPU transmissions.
+ * Purpose:  Release a lock taken by 'mstp_preventTxOnBridge'. When the
+ *           outermost one is released call PTX SM once for each port it
+ *           was kicked for meanwhile, so every port transmits at most one
+ *           BPDU carrying its final information (within 'txHoldCount'
+ *           as enforced by the PTX SM itself).
  *           This function is a counterpart to the 'mstp_preventTxOnBridge'
  *           function.
  *
@@ -1403,25 +1869,26 @@ void
 mstp_doPendingTxOnBridge(void)
 {
    LPORT_t                lport;
-   MSTP_COMM_PORT_INFO_t *commPortPtr;
+   PORT_MAP               pending;
 
    STP_ASSERT(MSTP_ENABLED);
-   STP_ASSERT(mstp_Bridge.preventTx == TRUE);
+   STP_ASSERT(mstp_Bridge.preventTx > 0);
 
-   mstp_Bridge.preventTx = FALSE;
+   if(--mstp_Bridge.preventTx > 0)
+      return;
+
+   copy_port_map(&mstp_Bridge.txPendingLports, &pending);
+   clear_port_map(&mstp_Bridge.txPendingLports);
+   bit_and_port_maps(&mstp_Bridge.activeLports, &pending);
+   mstp_perfStats.txDeferredFlushes++;
 
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   for(lport = (LPORT_t)find_first_port_set(&pending); IS_VALID_LPORT(lport);
+       lport = (LPORT_t)find_next_port_set(&pending, lport))
    {
-      commPortPtr = MSTP_COMM_PORT_PTR(lport);
-      if(commPortPtr)
+      if(MSTP_COMM_PORT_PTR(lport))
       {
-         if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
-                                      MSTP_PORT_NEW_INFO) ||
-            MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
-                                      MSTP_PORT_NEW_INFO_MSTI))
-         {
-            mstp_ptxSm(lport);
-         }
+         mstp_perfStats.txDeferredPorts++;
+         mstp_ptxSm(lport);
       }
    }
 }
@@ -1465,89 +1932,82 @@ mstp_doPendingTxOnBridge(void)
  *
  * Returns:   none
  *
- * Globals:   mstp_DigestSignatureKey
+ *            The MST Configuration Table is kept in 'mstp_MstCfgTable' and
+ *            updated in place by 'mstp_setVidMapMstId', so nothing has to be
+ *            rebuilt here; if no VID changed its MSTID since the last call
+ *            the cached digest is returned without running HMAC-MD5.
+ *
+ * Globals:   mstp_DigestSignatureKey, mstp_MstCfgTable
  *
  **PROC-**********************************************************************/
 void
 mstp_buildMstConfigurationDigest(uint8_t *resDigest)
 {
-   uint8_t   digest[MSTP_DIGEST_SIZE]; /* 16 bytes */
+   static uint8_t       digest[MSTP_DIGEST_SIZE]; /* 16 bytes */
+   static hmac_md5_ctxt hmacKey;
+   static bool          hmacKeyReady = FALSE;
    char     digest_str[200] = {0};
    char temp[10]= {0};
-   MSTID_t *mstCfgTable;
-   VID_t    vid;
-   MSTID_t  mstid;
-   int      mstCfgTableSize;
+   const char *db_digest = NULL;
+   struct timeval start;
    uint32_t i = 0;
    const struct ovsrec_bridge *bridge_row = NULL;
    struct ovsdb_idl_txn *txn = NULL;
    struct smap smap = SMAP_INITIALIZER(&smap);
    STP_ASSERT(resDigest);
    STP_ASSERT(MSTP_DIGEST_SIZE == 16);
-   MSTP_OVSDB_LOCK;
-   txn = ovsdb_idl_txn_create(idl);
-   bridge_row = ovsrec_bridge_first(idl);
-
-   /*------------------------------------------------------------------------
-    * allocate buffer big enough to accomodate MST Configuration Table.
-    *------------------------------------------------------------------------*/
    STP_ASSERT(sizeof(MSTID_t) == MSTP_MST_CFG_ELEM_SIZE);
-   mstCfgTableSize = MSTP_MST_CFG_TBL_SIZE * MSTP_MST_CFG_ELEM_SIZE;
-   mstCfgTable = (MSTID_t *) calloc(1, mstCfgTableSize);
-   if (!mstCfgTable)
+
+   if(mstp_MstCfgTableDirty)
    {
-       ovsdb_idl_txn_destroy(txn);
-       MSTP_OVSDB_UNLOCK;
-       STP_ASSERT(0);
-       return;
+      /*---------------------------------------------------------------------
+       * calculate the digest value
+       * NOTE: the key is constant, its padded blocks are hashed only once
+       *---------------------------------------------------------------------*/
+      gettimeofday(&start, NULL);
+      if(!hmacKeyReady)
+      {
+         hmac_md5_init_key(&hmacKey, mstp_DigestSignatureKey,
+                           MSTP_DIGEST_KEY_LEN);
+         hmacKeyReady = TRUE;
+      }
+      hmac_md5_calc(&hmacKey, (const unsigned char *)mstp_MstCfgTable,
+                    sizeof(mstp_MstCfgTable), digest);
+      mstp_MstCfgTableDirty = FALSE;
+      mstp_perfStats.digestBuilds++;
+      mstp_perfStats.digestUsec += mstp_perfElapsedUsec(&start);
    }
-
-
-   /*------------------------------------------------------------------------
-    * build contents of the MST Configuration Table
-    *------------------------------------------------------------------------*/
-   for(vid = MSTP_MST_CFG_TBL_FIRST_VID_IDX;
-       vid <= MSTP_MST_CFG_TBL_LAST_VID_IDX; vid++)
+   else
    {
-          if((mstid = mstp_getMstIdForVid(vid)) != MSTP_NO_MSTID)
-          {
-               {
-		   /* MSTP digest is calculated only on Primary/Normal VLAN*/
-                   mstCfgTable[vid] = htons(mstid);
-	       }
-
-          }
+      mstp_perfStats.digestSkips++;
    }
 
    /*------------------------------------------------------------------------
-    * calculate the digest value
-    * NOTE: 'hmac_md5_calc' always returns 16 bytes digest value
+    * copy result
     *------------------------------------------------------------------------*/
-   memset(digest, 0, sizeof(digest));
-   hmac_md5((unsigned char*) mstCfgTable, mstCfgTableSize,
-                 (uint8_t*)mstp_DigestSignatureKey, MSTP_DIGEST_KEY_LEN, digest);
+   memcpy(resDigest, digest, sizeof(digest));
+
    for(i=0; i< MSTP_DIGEST_SIZE; i++)
    {
       snprintf(temp,10,"%.2X",digest[i]);
       strncat(digest_str,temp,10);
    }
-   smap_clone(&smap, &bridge_row->status);
-   smap_replace(&smap, "mstp_config_digest" , digest_str);
-   ovsrec_bridge_set_status(bridge_row, &smap);
    VLOG_DBG("Config Digest : %s",digest_str);
 
-   /*------------------------------------------------------------------------
-    * copy result
-    *------------------------------------------------------------------------*/
-   memcpy(resDigest, digest, sizeof(digest));
-
-   /*------------------------------------------------------------------------
-    * free memory used
-    *------------------------------------------------------------------------*/
-   free(mstCfgTable);
-   ovsdb_idl_txn_commit_block(txn);
-   ovsdb_idl_txn_destroy(txn);
-   smap_destroy(&smap);
+   MSTP_OVSDB_LOCK;
+   bridge_row = ovsrec_bridge_first(idl);
+   db_digest = bridge_row ?
+      smap_get(&bridge_row->status, "mstp_config_digest") : NULL;
+   if(bridge_row && (!db_digest || strcmp(db_digest, digest_str) != 0))
+   {
+      txn = ovsdb_idl_txn_create(idl);
+      smap_clone(&smap, &bridge_row->status);
+      smap_replace(&smap, "mstp_config_digest" , digest_str);
+      ovsrec_bridge_set_status(bridge_row, &smap);
+      ovsdb_idl_txn_commit_block(txn);
+      ovsdb_idl_txn_destroy(txn);
+      smap_destroy(&smap);
+   }
    MSTP_OVSDB_UNLOCK;
 }
 
@@ -1927,7 +2387,7 @@ mstp_clearReselectTree(MSTID_t mstid)
          LPORT_t                lport;
          MSTP_CIST_PORT_INFO_t *cistPortPtr;
 
-         for(lport = 1; lport <= MAX_LPORTS; lport++)
+         MSTP_FOR_EACH_ACTIVE_LPORT(lport)
          {
             cistPortPtr = MSTP_CIST_PORT_PTR(lport);
             if(cistPortPtr)
@@ -1942,7 +2402,7 @@ mstp_clearReselectTree(MSTID_t mstid)
          LPORT_t                lport;
          MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
 
-         for(lport = 1; lport <= MAX_LPORTS; lport++)
+         MSTP_FOR_EACH_ACTIVE_LPORT(lport)
          {
             mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
             if(mstiPortPtr)
@@ -2052,8 +2512,8 @@ mstp_newTcWhile(MSTID_t mstid, LPORT_t lport)
     * Get current value of the 'tcWhile' timer
     *------------------------------------------------------------------------*/
    tcWhileVal = (mstid == MSTP_CISTID) ?
-                 MSTP_CIST_PORT_PTR(lport)->tcWhile :
-                 MSTP_MSTI_PORT_PTR(mstid, lport)->tcWhile;
+                 MSTP_PORT_HOT(MSTP_CIST_PORT_PTR(lport), tcWhile) :
+                 MSTP_PORT_HOT(MSTP_MSTI_PORT_PTR(mstid, lport), tcWhile);
    VLOG_DBG("MSTP: New TcWhile : %d",tcWhileVal);
 
    /*------------------------------------------------------------------------
@@ -2103,7 +2563,8 @@ mstp_newTcWhile(MSTID_t mstid, LPORT_t lport)
        *---------------------------------------------------------------------*/
       if(mstid == MSTP_CISTID)
       {
-         MSTP_CIST_PORT_PTR(lport)->tcWhile = tcWhileVal;
+         MSTP_PORT_HOT(MSTP_CIST_PORT_PTR(lport), tcWhile) = tcWhileVal;
+         MSTP_TX_TREE_CHANGED(mstid, lport);
          MSTP_CIST_INFO.topologyChangeCnt++;
          mstp_util_set_cist_table_value(TOP_CHANGE_CNT,MSTP_CIST_INFO.topologyChangeCnt);
          MSTP_CIST_INFO.timeSinceTopologyChange = time(NULL);
@@ -2111,7 +2572,8 @@ mstp_newTcWhile(MSTID_t mstid, LPORT_t lport)
       }
       else
       {
-         MSTP_MSTI_PORT_PTR(mstid, lport)->tcWhile = tcWhileVal;
+         MSTP_PORT_HOT(MSTP_MSTI_PORT_PTR(mstid, lport), tcWhile) = tcWhileVal;
+         MSTP_TX_TREE_CHANGED(mstid, lport);
          mstp_util_set_msti_table_string(TOPOLOGY_CHANGE,"enable",mstid);
          MSTP_MSTI_INFO(mstid)->topologyChangeCnt++;
          mstp_util_set_msti_table_value(TOP_CHANGE_CNT,MSTP_MSTI_INFO(mstid)->topologyChangeCnt,mstid);
@@ -2231,6 +2693,19 @@ mstp_rcvInfo(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
       }
    }
 
+   /*------------------------------------------------------------------------
+    * A periodic BPDU from a stable Designated Bridge carries the same
+    * information as the previous one, which has already been classified as
+    * 'RepeatedDesignatedInfo' and left 'msgPriority' and 'msgTimes' as the
+    * decoding would leave them. Skip the decoding then, the caller still
+    * handles the flags and restarts 'rcvdInfoWhile'.
+    *------------------------------------------------------------------------*/
+   if(mstp_rcvInfoIsRepeated(pkt, mstid, lport))
+   {
+      mstp_perfStats.rcvInfoFastPath++;
+      return MSTP_RCVD_INFO_REPEATED_DESIGNATED;
+   }
+
    /*------------------------------------------------------------------------
     * Extract message priority and timer values from the received BPDU and
     * store them in the 'msgPriority' and 'msgTimes' variables for a given
@@ -2317,7 +2792,7 @@ mstp_rcvInfoCist(MSTP_RX_PDU *pkt, LPORT_t lport)
     * incoming BPDUs and wait for aging out of the 'rcvdInfoWhile' timer on
     * this port, then the 'looped' port will try to negotiate it's state
     * and have a chance to recognize if loop still exists */
-   if(MSTP_COMM_PORT_PTR(lport)->rcvdSelfSentPkt && cistPortPtr->rcvdInfoWhile)
+   if(MSTP_COMM_PORT_PTR(lport)->rcvdSelfSentPkt && MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile))
       return MSTP_RCVD_INFO_OTHER;
 
    /*-------------------------------------------------------------------------
@@ -2711,7 +3186,7 @@ mstp_rcvInfoMsti(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
     * incoming BPDUs and wait for aging out of the 'rcvdInfoWhile' timer on
     * this port, then the 'looped' port will try to negotiate it's state
     * and have a chance to recognize if loop still exists */
-   if(MSTP_COMM_PORT_PTR(lport)->rcvdSelfSentPkt && mstiPortPtr->rcvdInfoWhile)
+   if(MSTP_COMM_PORT_PTR(lport)->rcvdSelfSentPkt && MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile))
       return MSTP_RCVD_INFO_OTHER;
 
    /*------------------------------------------------------------------------
@@ -3054,6 +3529,8 @@ mstp_recordAgreement(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
         * flag */
          MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREED);
          cistAgreed = TRUE;
+         if(cistProposing)
+            MSTP_TX_TREE_CHANGED(mstid, lport);
          MSTP_CIST_PORT_CLR_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSING);
          cistProposing = FALSE;
       }
@@ -3083,6 +3560,10 @@ mstp_recordAgreement(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
                else
                   MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap,
                                          MSTP_MSTI_PORT_AGREED);
+               if(cistProposing != MSTP_MSTI_PORT_IS_BIT_SET(
+                                          mstiPortPtr->bitMap,
+                                          MSTP_MSTI_PORT_PROPOSING))
+                  MSTP_TX_TREE_CHANGED(tmpId, lport);
                if(cistProposing)
                   MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap,
                                          MSTP_MSTI_PORT_PROPOSING);
@@ -3127,6 +3608,9 @@ mstp_recordAgreement(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
              * flag should be cleared. Otherwise the MSTI 'agreed' flag is
              * cleared.   */
             MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREED);
+            if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
+                                         MSTP_MSTI_PORT_PROPOSING))
+               MSTP_TX_TREE_CHANGED(mstid, lport);
             MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap,
                                    MSTP_MSTI_PORT_PROPOSING);
          }
@@ -3504,8 +3988,10 @@ mstp_recordTimes(MSTID_t mstid,  LPORT_t lport)
    if(mstid == MSTP_CISTID)
    {
       MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+      uint16_t               helloTime;
 
       STP_ASSERT(cistPortPtr);
+      helloTime = cistPortPtr->portTimes.helloTime;
       cistPortPtr->portTimes.messageAge = cistPortPtr->msgTimes.messageAge;
       if (cistPortPtr->portTimes.maxAge != cistPortPtr->msgTimes.maxAge) {
           mstp_util_set_cist_table_value(OPER_MAX_AGE, cistPortPtr->msgTimes.maxAge);
@@ -3539,6 +4025,10 @@ mstp_recordTimes(MSTID_t mstid,  LPORT_t lport)
         * to cover this case also */
          cistPortPtr->portTimes.helloTime = MSTP_HELLO_MAX_SEC;
       }
+
+      /* the Hello Time is the only one of the 'portTimes' that is sent */
+      if(cistPortPtr->portTimes.helloTime != helloTime)
+         MSTP_TX_TREE_CHANGED(mstid, lport);
    }
    else
    {
@@ -3708,7 +4198,7 @@ mstp_setReRootTree(MSTID_t mstid)
    {/* set 'reRoot' for CIST for all ports */
       MSTP_CIST_PORT_INFO_t *cistPortPtr;
 
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          cistPortPtr = MSTP_CIST_PORT_PTR(lport);
          if(cistPortPtr)
@@ -3723,7 +4213,7 @@ mstp_setReRootTree(MSTID_t mstid)
 
       STP_ASSERT(MSTP_MSTI_VALID(mstid));
 
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
          if(mstiPortPtr)
@@ -3766,7 +4256,7 @@ mstp_setSelectedTree(MSTID_t mstid)
       MSTP_CIST_PORT_INFO_t *cistPortPtr = NULL;
 
       /* check if 'reselect' is FALSE for all Ports in this tree */
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          if((cistPortPtr = MSTP_CIST_PORT_PTR(lport)))
          {
@@ -3780,7 +4270,7 @@ mstp_setSelectedTree(MSTID_t mstid)
 
       if(!reselect)
       {/* set 'selected' TRUE for this tree for all ports */
-         for(lport = 1; lport <= MAX_LPORTS; lport++)
+         MSTP_FOR_EACH_ACTIVE_LPORT(lport)
          {
             if((cistPortPtr = MSTP_CIST_PORT_PTR(lport)))
             {
@@ -3795,7 +4285,7 @@ mstp_setSelectedTree(MSTID_t mstid)
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr = NULL;
 
       /* check if 'reselect' is FALSE for all Ports in this tree */
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          if((mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport)))
          {
@@ -3809,7 +4299,7 @@ mstp_setSelectedTree(MSTID_t mstid)
 
       if(!reselect)
       {/* set 'selected' TRUE for this tree for all ports */
-         for(lport = 1; lport <= MAX_LPORTS; lport++)
+         MSTP_FOR_EACH_ACTIVE_LPORT(lport)
          {
             if((mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport)))
             {
@@ -3849,7 +4339,7 @@ mstp_setSyncTree(MSTID_t mstid)
    {/* set 'sync' for the CIST for all ports */
       MSTP_CIST_PORT_INFO_t *cistPortPtr;
 
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          if((cistPortPtr = MSTP_CIST_PORT_PTR(lport)))
             MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_SYNC);
@@ -3861,7 +4351,7 @@ mstp_setSyncTree(MSTID_t mstid)
 
       STP_ASSERT(MSTP_MSTI_VALID(mstid));
 
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          if((mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport)))
             MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_SYNC);
@@ -4055,6 +4545,9 @@ mstp_setTcFlags(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
  *            tree (the CIST or a given MSTI) for all other Ports.
  *            (802.1Q-REV/D5.0 13.26 s); 13.26.17)
  *            Called from Topology Change (TCM) state machine.
+ *            Only the ports in the tree's 'tcPropPorts' map are visited,
+ *            on the other ones the TCM is in a state that just clears
+ *            'tcProp' (INACTIVE, LEARNING), so they are left alone.
  *
  * Params:    mstid -> MST Instance Identifier
  *            lport -> logical port number
@@ -4068,6 +4561,10 @@ void
 mstp_setTcPropTree(MSTID_t mstid, LPORT_t lport)
 {
    MSTP_COMM_PORT_INFO_t *commPortPtr;
+   MSTP_CIST_PORT_INFO_t *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
+   PORT_MAP               pmap;
+   struct timeval         start;
    LPORT_t lp;
 
    STP_ASSERT(MSTP_ENABLED);
@@ -4087,55 +4584,53 @@ mstp_setTcPropTree(MSTID_t mstid, LPORT_t lport)
       return;
    }
 
+   gettimeofday(&start, NULL);
+   mstp_perfStats.tcPropCalls++;
+
    /*------------------------------------------------------------------------
-    * Set 'selected' TRUE for this tree (the CIST or a given MSTI) for all
-    * Ports of the Bridge
+    * The ports to set 'tcProp' for are the tree's 'tcPropPorts' that are
+    * still active, minus the port that invoked the procedure. A port's TCM
+    * may change state as a side effect of kicking an earlier one, so the
+    * state is checked again before each kick.
     *------------------------------------------------------------------------*/
-
    if(mstid == MSTP_CISTID)
-   {/* set 'tcProp' for CIST ports */
-      MSTP_CIST_PORT_INFO_t *cistPortPtr;
-
-      for(lp = 1; lp <= MAX_LPORTS; lp++)
-      {
-         if(lp == lport)
-            continue;
+      copy_port_map(&MSTP_CIST_INFO.tcPropPorts, &pmap);
+   else
+   {
+      STP_ASSERT(MSTP_MSTI_VALID(mstid));
+      copy_port_map(&MSTP_MSTI_INFO(mstid)->tcPropPorts, &pmap);
+   }
+   bit_and_port_maps(&mstp_Bridge.activeLports, &pmap);
+   clear_port(&pmap, lport);
 
+   for(lp = (LPORT_t)find_first_port_set(&pmap); IS_VALID_LPORT(lp);
+       lp = (LPORT_t)find_next_port_set(&pmap, lp))
+   {
+      if(mstid == MSTP_CISTID)
+      {/* set 'tcProp' for CIST port */
          cistPortPtr = MSTP_CIST_PORT_PTR(lp);
-         if(cistPortPtr)
-         {
-            MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_TC_PROP);
-
-           /*------------------------------------------------------------------
-            * kick Topology Change state machine  (per-Tree per-Port)
-            *----------------------------------------------------------------*/
-            mstp_tcmSm(mstid, lp);
-         }
+         if(!cistPortPtr ||
+            !MSTP_TCM_STATE_TAKES_TC_PROP(cistPortPtr->tcmState))
+            continue;
+         MSTP_CIST_PORT_SET_BIT(cistPortPtr->bitMap, MSTP_CIST_PORT_TC_PROP);
       }
-   }
-   else
-   {/* set 'tcProp' for MSTI ports */
-      MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
-
-      STP_ASSERT(MSTP_MSTI_VALID(mstid));
-
-      for(lp = 1; lp <= MAX_LPORTS; lp++)
-      {
-         if(lp == lport)
-            continue;
-
+      else
+      {/* set 'tcProp' for MSTI port */
          mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lp);
-         if(mstiPortPtr)
-         {
-            MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_TC_PROP);
-
-           /*------------------------------------------------------------------
-            * kick Topology Change state machine  (per-Tree per-Port)
-            *----------------------------------------------------------------*/
-            mstp_tcmSm(mstid, lp);
-         }
+         if(!mstiPortPtr ||
+            !MSTP_TCM_STATE_TAKES_TC_PROP(mstiPortPtr->tcmState))
+            continue;
+         MSTP_MSTI_PORT_SET_BIT(mstiPortPtr->bitMap, MSTP_MSTI_PORT_TC_PROP);
       }
+
+      /*---------------------------------------------------------------------
+       * kick Topology Change state machine  (per-Tree per-Port)
+       *---------------------------------------------------------------------*/
+      mstp_perfStats.tcPropKicks++;
+      mstp_tcmSm(mstid, lp);
    }
+
+   mstp_perfStats.tcPropUsec += mstp_perfElapsedUsec(&start);
 }
 
 /**PROC+**********************************************************************
@@ -4163,7 +4658,7 @@ mstp_syncMaster(void)
 
    STP_ASSERT(MSTP_ENABLED);
 
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       commPortPtr = MSTP_COMM_PORT_PTR(lport);
       if(commPortPtr &&
@@ -4179,6 +4674,7 @@ mstp_syncMaster(void)
                STP_ASSERT(mstiPortPtr);
                MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap,
                                       MSTP_MSTI_PORT_AGREE);
+               MSTP_TX_TREE_CHANGED(mstid, lport);
                MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap,
                                       MSTP_MSTI_PORT_AGREED);
                MSTP_MSTI_PORT_CLR_BIT(mstiPortPtr->bitMap,
@@ -4304,6 +4800,7 @@ mstp_txTcn(LPORT_t lport)
        STP_ASSERT(FALSE);
    }
    VLOG_DBG("If it is here!! Packet is OUT successfully!!!");
+   mstp_perfFirstBpduTx();
 
 
 }
@@ -4422,7 +4919,7 @@ mstp_txConfig(LPORT_t lport)
    /*------------------------------------------------------------------------
     * set message CIST flags
     *------------------------------------------------------------------------*/
-   if(cistPortPtr->tcWhile != 0)
+   if(MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0)
    {/* (tcWhile != 0), set topology change flag for the Port */
       bpdu->flags |= MSTP_CIST_FLAG_TC;
       /* increment propagated TC flags statistics counter */
@@ -4472,6 +4969,7 @@ mstp_txConfig(LPORT_t lport)
        STP_ASSERT(FALSE);
    }
    VLOG_DBG("If it is here!! Packet is OUT successfully!!!");
+   mstp_perfFirstBpduTx();
 
 }
 
@@ -4511,19 +5009,22 @@ mstp_txConfig(LPORT_t lport)
  *               e) The CIST Remaining Hops.
  *               f) The parameters of each MSTI message, encoded in MSTID order.
  *            (802.1Q-REV/D5.0 13.26.20; 14.3.3; 14.6)
+ *            The BPDU is encoded into the port's template holding the BPDU
+ *            sent last: only the trees marked as changed since (see
+ *            'MSTP_TX_TREE_CHANGED') are encoded again, and only the fields
+ *            whose value changed are written.
  *            Called from Port Transmit (PTX) state machine.
  *
  * Params:    lport -> logical port number
  *
  * Returns:   none
  *
- * Globals:   mstp_CB, mstp_Bridge, stp_multicast
+ * Globals:   mstp_CB, mstp_Bridge, mstp_perfStats
  *
  **PROC-**********************************************************************/
 void
 mstp_txMstp(LPORT_t lport)
 {
-   MSTP_RX_PDU                               *pkt              = NULL;
    MSTP_MST_BPDU_t                   *bpdu             = NULL;
    MSTP_MSTI_INFO_t                  *mstiPtr          = NULL;
    MSTP_COMM_PORT_INFO_t             *commPortPtr      = NULL;
@@ -4532,9 +5033,9 @@ mstp_txMstp(LPORT_t lport)
    MSTP_CIST_DESIGNATED_TIMES_t      *cistDsnTimesPtr  = NULL;
    int                                bpduLen          = 0;
    MSTID_t                            mstid            = MSTP_CISTID;
-   const char *my_mac = NULL;
-   MAC_ADDRESS mac;
+   bool                               cistDirty        = FALSE;
    struct iface_data *idp = NULL;
+   struct timeval start;
    int rc= 0;
 
 
@@ -4566,158 +5067,47 @@ mstp_txMstp(LPORT_t lport)
       return;
 
    /*------------------------------------------------------------------------
-    * allocate pkt buffer
+    * the port's BPDU template, holding the BPDU transmitted last
     *------------------------------------------------------------------------*/
-   if((pkt = (MSTP_RX_PDU *)malloc(sizeof(MSTP_RX_PDU))) == NULL)
+   gettimeofday(&start, NULL);
+   bpdu = mstp_txBpduTemplate(lport, commPortPtr);
+   if(bpdu == NULL)
    {
       return; /* resources exhaustion */
    }
 
-   /*------------------------------------------------------------------------
-    * initialize (zero) BPDU
-    *------------------------------------------------------------------------*/
-   bpdu = (MSTP_MST_BPDU_t *)(pkt->data);
-
-   /* cov-error can be ignored because its safe to write beyond frame[1] */
-   /* coverity[overrun-buffer-arg : FALSE] */
-   memset((char *)bpdu,0,sizeof(MSTP_MST_BPDU_t));
-
-   /*------------------------------------------------------------------------
-    * fill pkt header
-    *------------------------------------------------------------------------*/
-
-   /* destination Multicast address */
-   MAC_ADDR_COPY(stp_multicast, bpdu->lsapHdr.dst);
-
-   /* get the mac address for the port */
-   my_mac = intf_get_mac_addr(lport);
-   VLOG_DBG("MSTP Util : 5 : mac : %s", my_mac);
-   sscanf(my_mac,"%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:%02hhx",&mac[0],&mac[1],&mac[2],&mac[3],&mac[4],&mac[5]);
-   MAC_ADDR_COPY(&mac, bpdu->lsapHdr.src);
-
-   bpduLen            = SNAP + MSTP_RST_BPDU_LEN_MIN;
-   bpdu->lsapHdr.dsap = 0x42;
-   bpdu->lsapHdr.ssap = 0x42;
-   bpdu->lsapHdr.ctrl = MSTP_LSAP_HDR_CTRL_VAL;
-
-   /*------------------------------------------------------------------------
-    * set protocol Id and BPDU type (protocol version will be set further)
-    *------------------------------------------------------------------------*/
-   bpdu->protocolId = MSTP_STP_RST_MST_PROTOCOL_ID;
-   bpdu->bpduType   = MSTP_BPDU_TYPE_MST;
-
-   /*------------------------------------------------------------------------
-    * set message priority vector.
-    * The first six components of the CIST message priority vector
-    * conveyed in the BPDU are set to the value of the CIST's
-    * 'designatedPriority' parameter for this Port.
-    * NOTE: The CIST Internal Root Path Cost and the CIST Designated Bridge
-    *       Identifier are encoded further, if Force Protocol Version parameter
-    *       is set 'D_hpicfBridgeRstpProtocolVersion_ieee8021s'.
-    *------------------------------------------------------------------------*/
-   cistDsnPriVecPtr = &cistPortPtr->designatedPriority;
-
-   /* copy the CIST Root Identifier */
-   MAC_ADDR_COPY(cistDsnPriVecPtr->rootID.mac_address,
-                 bpdu->cistRootId.mac_address);
-   storeShortInPacket(&bpdu->cistRootId.priority,
-                      cistDsnPriVecPtr->rootID.priority);
-
-   /* copy the CIST External Root Path Cost */
-   storeLongInPacket(&bpdu->cistExtPathCost, cistDsnPriVecPtr->extRootPathCost);
-
-   /* copy the CIST Regional Root Identifier */
-   MAC_ADDR_COPY(cistDsnPriVecPtr->rgnRootID.mac_address,
-                 bpdu->cistRgnRootId.mac_address);
-   storeShortInPacket(&bpdu->cistRgnRootId.priority,
-                      cistDsnPriVecPtr->rgnRootID.priority);
-
-   /* copy the CIST Port Identifier:
-    * NOTE: Octets 26 and 27 convey the CIST Port Identifier of the
-    *       transmitting Bridge Port
-    *       (802.1Q-REV/D5.0 14.6 k)) */
-   storeShortInPacket(&bpdu->cistPortId, cistPortPtr->portId);
+   bpduLen = SNAP + MSTP_RST_BPDU_LEN_MIN;
 
    /*------------------------------------------------------------------------
-    * set CIST port role.
-    * NOTE: The Port Role in the BPDU should be set to the current value of
-    *       the 'role' variable for the transmitting port
+    * the parts of the template that may be left as they are: the trees
+    * whose information has not changed since it was sent, unless a
+    * parameter not marked per tree may have
     *------------------------------------------------------------------------*/
-   switch(cistPortPtr->role)
+   if(commPortPtr->txInfoGen != mstp_Bridge.txInfoGen)
    {
-      case MSTP_PORT_ROLE_ROOT:
-         bpdu->cistFlags |= MSTP_BPDU_ROLE_ROOT;
-      break;
-      case MSTP_PORT_ROLE_DESIGNATED:
-         bpdu->cistFlags |= MSTP_BPDU_ROLE_DESIGNATED;
-      break;
-      case MSTP_PORT_ROLE_ALTERNATE:
-      case MSTP_PORT_ROLE_BACKUP:
-         bpdu->cistFlags |= MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP;
-      break;
-      default:
-         STP_ASSERT(0);
-      break;
+      setBitmap(commPortPtr->txDirtyTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
+      commPortPtr->txInfoGen = mstp_Bridge.txInfoGen;
    }
+   cistDirty = isBitSet(commPortPtr->txDirtyTrees.map, MSTP_CISTID + 1,
+                        MSTP_ROLES_DIRTY_MAP_BITS);
+   mstp_perfStats.txTmplMsgs++;
+   if(!cistDirty)
+      mstp_perfStats.txTmplMsgsClean++;
 
-   /*------------------------------------------------------------------------
-    * set message flags.
-    * NOTE: The 'Agreement' and 'Proposal' flags in the BPDU are set to the
-    *       values of the 'agree' and 'proposing' variables for the
-    *       transmitting Port, respectively.
-    *       The CIST topology change flag is set if ('tcWhile' != 0) for the
-    *       Port. The topology change acknowledge flag in the BPDU is never
-    *       used and is set to zero. The 'learning' and 'forwarding' flags in
-    *       the BPDU are set to the values of the 'learning' and 'forwarding'
-    *       variables for the CIST, respectively.
-    *------------------------------------------------------------------------*/
-
-   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREE))
-   {/* 'agree' is set, set 'Agreement' flag */
-      bpdu->cistFlags |= MSTP_CIST_FLAG_AGREEMENT;
-   }
+   cistDsnPriVecPtr = &cistPortPtr->designatedPriority;
+   cistDsnTimesPtr = &cistPortPtr->designatedTimes;
 
-   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSING))
-   {/* 'proposing' is set, set 'Proposal' flag */
-      bpdu->cistFlags |= MSTP_CIST_FLAG_PROPOSAL;
-   }
+   if(cistDirty)
+      mstp_txCistEncode(bpdu, cistPortPtr);
 
-   if(cistPortPtr->tcWhile != 0)
-   {/* (tcWhile != 0), set  CIST topology change flag for the Port */
-      VLOG_DBG("MSTP tcWhile : %d port : %d", cistPortPtr->tcWhile, lport);
-      bpdu->cistFlags |= MSTP_CIST_FLAG_TC;
+   if(MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0)
+   {/* (tcWhile != 0), the CIST topology change flag is set */
+      VLOG_DBG("MSTP tcWhile : %d port : %d", MSTP_PORT_HOT(cistPortPtr, tcWhile), lport);
       /* increment propagated TC flags statistics counter */
       cistPortPtr->dbgCnts.tcFlagTxCnt++;
       cistPortPtr->dbgCnts.tcFlagTxCntLastUpdated = time(NULL);
    }
 
-   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARNING))
-   {/* set 'learning' flag */
-      bpdu->cistFlags |= MSTP_CIST_FLAG_LEARNING;
-   }
-
-   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARDING))
-   {/* set 'forwarding' flag */
-      bpdu->cistFlags |= MSTP_CIST_FLAG_FORWADING;
-   }
-
-   /*------------------------------------------------------------------------
-    * set message times parameters.
-    * The value of the Message Age, Max Age, and Fwd Delay parameters conveyed
-    * in the BPDU are set to the values held in the CIST's 'designatedTimes'
-    * parameter for the Port. The value of the Hello Time parameter conveyed in
-    * the BPDU is set to the value held in the CIST's 'portTimes' parameter for
-    * the Port.
-    * NOTE: Times in message are carried in units of 1/256 second
-    *       (802.1D-2004 9.2.8)
-    *------------------------------------------------------------------------*/
-   cistDsnTimesPtr = &cistPortPtr->designatedTimes;
-
-   storeShortInPacket(&bpdu->msgAge, cistDsnTimesPtr->messageAge << 8);
-   storeShortInPacket(&bpdu->maxAge, cistDsnTimesPtr->maxAge << 8);
-   storeShortInPacket(&bpdu->fwdDelay, cistDsnTimesPtr->fwdDelay << 8);
-   storeShortInPacket(&bpdu->helloTime, cistPortPtr->portTimes.helloTime << 8);
-
    /*------------------------------------------------------------------------
     * check the state of Force Protocol Version parameter
     *------------------------------------------------------------------------*/
@@ -4725,7 +5115,10 @@ mstp_txMstp(LPORT_t lport)
    {/* If the value of the Force Protocol Version parameter is less than 3,
      * no further parameters are encoded in the BPDU and the protocol version
      * parameter is set to 2 (denoting an RST BPDU) */
-     bpdu->protocolVersionId = MSTP_PROTOCOL_VERSION_ID_RST;
+     uint8_t version = MSTP_PROTOCOL_VERSION_ID_RST;
+
+     if(cistDirty)
+        mstp_txPatch(&bpdu->protocolVersionId, &version, sizeof(version));
      /* Update RST BPDUs TX statistics */
      cistPortPtr->dbgCnts.rstBpduTxCnt++;
      cistPortPtr->dbgCnts.rstBpduTxCntLastUpdated = time(NULL);
@@ -4736,7 +5129,12 @@ mstp_txMstp(LPORT_t lport)
      * NOTE: we will update the 'version3Length' parameter along the
      *       remained encoding process */
       MSTP_MSTI_CONFIG_MSG_t *mstiMsgPtr  = NULL;
+      MSTP_MSTI_CONFIG_MSG_t  mstiMsg;
+      MSTP_MST_CONFIGURATION_ID_t cfgId;
       uint16_t                 version3Len = 0;
+      uint8_t                  version = MSTP_PROTOCOL_VERSION_ID_MST;
+      uint8_t                  hops;
+      bool                     msgsMoved = FALSE;
 
       /*---------------------------------------------------------------------
        * update Ethernet frame total length to include the size of the
@@ -4744,211 +5142,120 @@ mstp_txMstp(LPORT_t lport)
        *---------------------------------------------------------------------*/
       bpduLen += sizeof(bpdu->version3Length);
 
-      /*---------------------------------------------------------------------
-       * the protocol version parameter
-       *---------------------------------------------------------------------*/
-      bpdu->protocolVersionId = MSTP_PROTOCOL_VERSION_ID_MST;
-
-      /*---------------------------------------------------------------------
-       * the MST Configuration Identifier parameter of the BPDU is set
-       * to the value of the 'MstConfigId' variable for the Bridge
-       *---------------------------------------------------------------------*/
-      memcpy(&bpdu->mstConfigurationId, &mstp_Bridge.MstConfigId,
-             sizeof(bpdu->mstConfigurationId));
-      storeShortInPacket(&bpdu->mstConfigurationId.revisionLevel,
-              mstp_Bridge.MstConfigId.revisionLevel);
+      if(cistDirty)
+      {
+         /*------------------------------------------------------------------
+          * the protocol version parameter
+          *------------------------------------------------------------------*/
+         mstp_txPatch(&bpdu->protocolVersionId, &version, sizeof(version));
 
-      version3Len += sizeof(bpdu->mstConfigurationId);
+         /*------------------------------------------------------------------
+          * the MST Configuration Identifier parameter of the BPDU is set
+          * to the value of the 'MstConfigId' variable for the Bridge
+          *------------------------------------------------------------------*/
+         memcpy(&cfgId, &mstp_Bridge.MstConfigId, sizeof(cfgId));
+         storeShortInPacket(&cfgId.revisionLevel,
+                 mstp_Bridge.MstConfigId.revisionLevel);
+         mstp_txPatch(&bpdu->mstConfigurationId, &cfgId, sizeof(cfgId));
 
-      /*---------------------------------------------------------------------
-       * copy the CIST Internal Root Path Cost */
-      storeLongInPacket(&bpdu->cistIntRootPathCost,
-                        cistDsnPriVecPtr->intRootPathCost);
-      version3Len += sizeof(bpdu->cistIntRootPathCost);
+         /*------------------------------------------------------------------
+          * copy the CIST Internal Root Path Cost */
+         mstp_txPatchLong(&bpdu->cistIntRootPathCost,
+                          cistDsnPriVecPtr->intRootPathCost);
 
-      /*---------------------------------------------------------------------
-       * copy the CIST Designated Bridge Identifier
-       * NOTE: Octets 94 through 101 convey the CIST Bridge Identifier of the
-       *       transmitting Bridge. The 12 bit system id extension component
-       *       of the CIST Bridge Identifier shall be transmitted as 0.
-       *       The behavior on receipt is unspecified if it is non-zero
-       *      (802.1Q-REV/D5.0 14.6 t))
-       *---------------------------------------------------------------------*/
-      STP_ASSERT(MSTP_GET_BRIDGE_SYS_ID(MSTP_CIST_BRIDGE_IDENTIFIER) == 0);
-      MAC_ADDR_COPY(cistDsnPriVecPtr->dsnBridgeID.mac_address,
-                    bpdu->cistBridgeId.mac_address);
-      storeShortInPacket(&bpdu->cistBridgeId.priority,
-                         cistDsnPriVecPtr->dsnBridgeID.priority);
-      version3Len += sizeof(bpdu->cistBridgeId);
+         /*------------------------------------------------------------------
+          * copy the CIST Designated Bridge Identifier
+          * NOTE: Octets 94 through 101 convey the CIST Bridge Identifier of
+          *       the transmitting Bridge. The 12 bit system id extension
+          *       component of the CIST Bridge Identifier shall be
+          *       transmitted as 0. The behavior on receipt is unspecified
+          *       if it is non-zero (802.1Q-REV/D5.0 14.6 t))
+          *------------------------------------------------------------------*/
+         STP_ASSERT(MSTP_GET_BRIDGE_SYS_ID(MSTP_CIST_BRIDGE_IDENTIFIER) == 0);
+         mstp_txPatchBridgeId(&bpdu->cistBridgeId,
+                              &cistDsnPriVecPtr->dsnBridgeID);
 
-      /*---------------------------------------------------------------------
-       * the CIST Remaining Hops
-       *---------------------------------------------------------------------*/
-      bpdu->cistRemainingHops = cistDsnTimesPtr->hops;
-      version3Len += sizeof(bpdu->cistRemainingHops);
+         /*------------------------------------------------------------------
+          * the CIST Remaining Hops
+          *------------------------------------------------------------------*/
+         hops = cistDsnTimesPtr->hops;
+         mstp_txPatch(&bpdu->cistRemainingHops, &hops, sizeof(hops));
+      }
+      version3Len += sizeof(bpdu->mstConfigurationId) +
+                     sizeof(bpdu->cistIntRootPathCost) +
+                     sizeof(bpdu->cistBridgeId) +
+                     sizeof(bpdu->cistRemainingHops);
 
       /*---------------------------------------------------------------------
        * The parameters of each MSTI message, encoded in MSTID order:
        * NOTE: No more than 64 MSTIs may be supported, as no more than 64
        *       MSTI Configuration Messages may be encoded in one MST BPDU
        *       (in a standard sized Ethernet frame).
+       *       A message is encoded again only if the MSTI has changed it
+       *       or it is not where it was sent last, i.e. the set of MSTIs
+       *       with a message has changed before it.
        *---------------------------------------------------------------------*/
       mstiMsgPtr = (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
       for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_MSTID_MAX; mstid++)
       {
+         MSTP_MSTI_PORT_INFO_t *mstiPortPtr = NULL;
+         bool                   included    = FALSE;
+
          /*------------------------------------------------------------------
           * to facilitate references
           *------------------------------------------------------------------*/
          mstiPtr = MSTP_MSTI_INFO(mstid);
          if(mstiPtr)
          {
-            MSTP_MSTI_PORT_INFO_t *mstiPortPtr =
-                                              MSTP_MSTI_PORT_PTR(mstid, lport);
+            mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
             STP_ASSERT(mstiPortPtr);
+            included = ((mstiPortPtr->role != MSTP_PORT_ROLE_UNKNOWN) &&
+                        (mstiPortPtr->role != MSTP_PORT_ROLE_DISABLED));
+         }
 
-            if((mstiPortPtr->role != MSTP_PORT_ROLE_UNKNOWN) &&
-               (mstiPortPtr->role != MSTP_PORT_ROLE_DISABLED))
-            {
-               MSTP_MSTI_DESIGNATED_PRI_VECTOR_t *mstiDsnPriVecPtr = NULL;
-               uint16_t                            priorityVal      = 0;
-
-               /*------------------------------------------------------------
-                * clear placeholder for the MSTI Configuration message as it
-                * may contain the garbage left from the previous usage
-                * of the packet buffer
-                *------------------------------------------------------------*/
-               memset((char *)mstiMsgPtr, 0, sizeof(MSTP_MSTI_CONFIG_MSG_t));
-
-               /*------------------------------------------------------------
-                * to facilitate the reference to 'designatedPriority' content
-                *------------------------------------------------------------*/
-               mstiDsnPriVecPtr = &mstiPortPtr->designatedPriority;
-
-               /*------------------------------------------------------------
-                * MSTI Regional Root Identifier */
-               MAC_ADDR_COPY(mstiDsnPriVecPtr->rgnRootID.mac_address,
-                             mstiMsgPtr->mstiRgnRootId.mac_address);
-               storeShortInPacket(&mstiMsgPtr->mstiRgnRootId.priority,
-                                  mstiDsnPriVecPtr->rgnRootID.priority);
-
-               /*------------------------------------------------------------
-                * MSTI Internal Root Path Cost */
-               storeLongInPacket(&mstiMsgPtr->mstiIntRootPathCost,
-                                 mstiDsnPriVecPtr->intRootPathCost);
-
-               /*------------------------------------------------------------
-                * MSTI Bridge Priority
-                * NOTE: Bits 5 through 8 of Octet 14 convey the value of the
-                *       Bridge Identifier Priority for this MSTI. Bits 1
-                *       through 4 of Octet 14 shall be transmitted as 0, and
-                *       ignored on receipt (802.1Q-REV/D5.0 14.6.1 d)).
-                *------------------------------------------------------------*/
-               priorityVal =
-                           MSTP_GET_BRIDGE_PRIORITY(mstiPtr->BridgeIdentifier);
-               mstiMsgPtr->mstiBridgePriority = ((priorityVal / 4096) << 4);
-
-               /*------------------------------------------------------------
-                * MSTI Port Priority
-                * NOTE: Bits 5 through 8 of Octet 15 convey the value of the
-                *       Port Identifier Priority for this MSTI. Bits 1 through
-                *       4 of Octet 15 shall be transmitted as 0, and ignored
-                *       on receipt (802.1Q-REV/D5.0 14.6.1 e)).
-                *------------------------------------------------------------*/
-               priorityVal = MSTP_GET_PORT_PRIORITY(mstiPortPtr->portId);
-               mstiMsgPtr->mstiPortPriority = ((priorityVal / 16) << 4);
-
-               /*------------------------------------------------------------
-                * MSTI Remaning Hops
-                *------------------------------------------------------------*/
-               mstiMsgPtr->mstiRemainingHops =
-                                             mstiPortPtr->designatedTimes.hops;
-
-               /*------------------------------------------------------------
-                * set MSTI port role
-                *------------------------------------------------------------*/
-               switch(mstiPortPtr->role)
-               {
-                  case MSTP_PORT_ROLE_ROOT:
-                     mstiMsgPtr->mstiFlags |= MSTP_BPDU_ROLE_ROOT;
-                     break;
-                  case MSTP_PORT_ROLE_MASTER:
-                     mstiMsgPtr->mstiFlags |= MSTP_BPDU_ROLE_MASTER_PORT;
-                     break;
-                  case MSTP_PORT_ROLE_DESIGNATED:
-                     mstiMsgPtr->mstiFlags |= MSTP_BPDU_ROLE_DESIGNATED;
-                     break;
-                  case MSTP_PORT_ROLE_ALTERNATE:
-                  case MSTP_PORT_ROLE_BACKUP:
-                     mstiMsgPtr->mstiFlags |= MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP;
-                     break;
-                  default:
-                     STP_ASSERT(0);
-                     break;
-               }
-
-               /*------------------------------------------------------------
-                * set other MSTI flags
-                *------------------------------------------------------------*/
-
-               if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
-                                            MSTP_MSTI_PORT_AGREE))
-               {/* 'agree' is set, set 'Agreement' flag */
-                  mstiMsgPtr->mstiFlags |= MSTP_MSTI_FLAG_AGREEMENT;
-               }
-
-               if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
-                                            MSTP_MSTI_PORT_PROPOSING))
-               {/* 'proposing' is set, set 'Proposal' flag */
-                  mstiMsgPtr->mstiFlags |= MSTP_MSTI_FLAG_PROPOSAL;
-               }
-
-               if(mstiPortPtr->tcWhile != 0)
-               {/* (tcWhile != 0), set MSTI topology change flag */
-                  mstiMsgPtr->mstiFlags |= MSTP_MSTI_FLAG_TC;
-                  /* increment propagated TC flags statistics counter */
-                  mstiPortPtr->dbgCnts.tcFlagTxCnt++;
-                  mstiPortPtr->dbgCnts.tcFlagTxCntLastUpdated =
-                                                         time(NULL);
-               }
-
-               if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
-                                            MSTP_MSTI_PORT_LEARNING))
-               {/* 'learning' is set, set 'learning' flag */
-                  mstiMsgPtr->mstiFlags |= MSTP_MSTI_FLAG_LEARNING;
-               }
-
-               if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
-                                            MSTP_MSTI_PORT_FORWARDING))
-               {/* 'forwarding' is set, set 'forwarding' flag */
-                  mstiMsgPtr->mstiFlags |= MSTP_MSTI_FLAG_FORWADING;
-               }
-
-               if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
-                                            MSTP_MSTI_PORT_MASTER))
-               {/* 'master' variable is set, set 'Master' flag */
-                  mstiMsgPtr->mstiFlags |= MSTP_MSTI_FLAG_MASTER;
-               }
+         if(included != isBitSet(commPortPtr->txMstiSent.map, mstid + 1,
+                                 MSTP_ROLES_DIRTY_MAP_BITS))
+         {
+            msgsMoved = TRUE;
+            if(included)
+               setBit(commPortPtr->txMstiSent.map, mstid + 1,
+                      MSTP_ROLES_DIRTY_MAP_BITS);
+            else
+               clrBit(commPortPtr->txMstiSent.map, mstid + 1,
+                      MSTP_ROLES_DIRTY_MAP_BITS);
+         }
 
-               version3Len += sizeof(MSTP_MSTI_CONFIG_MSG_t);
+         if(!included)
+            continue;
 
-               /* update MSTI CFG MSGs TX statistics */
-               mstiPortPtr->dbgCnts.mstiMsgTxCnt++;
-               mstiPortPtr->dbgCnts.mstiMsgTxCntLastUpdated =
-                                                         time(NULL);
+         if(msgsMoved || isBitSet(commPortPtr->txDirtyTrees.map, mstid + 1,
+                                  MSTP_ROLES_DIRTY_MAP_BITS))
+         {
+            mstp_txMstiMsgEncode(mstiPtr, mstiPortPtr, &mstiMsg);
+            mstp_txPatch(mstiMsgPtr, &mstiMsg, sizeof(mstiMsg));
+         }
+         else
+            mstp_perfStats.txTmplMsgsClean++;
+         mstp_perfStats.txTmplMsgs++;
+         version3Len += sizeof(MSTP_MSTI_CONFIG_MSG_t);
+
+         if(MSTP_PORT_HOT(mstiPortPtr, tcWhile) != 0)
+         {/* increment propagated TC flags statistics counter */
+            mstiPortPtr->dbgCnts.tcFlagTxCnt++;
+            mstiPortPtr->dbgCnts.tcFlagTxCntLastUpdated = time(NULL);
+         }
 
-               /*------------------------------------------------------------
-                * debug trace, if enabled
-                *------------------------------------------------------------*/
-               mstiMsgPtr++;
+         /* update MSTI CFG MSGs TX statistics */
+         mstiPortPtr->dbgCnts.mstiMsgTxCnt++;
+         mstiPortPtr->dbgCnts.mstiMsgTxCntLastUpdated = time(NULL);
 
-            }
-         }
+         mstiMsgPtr++;
       }
 
       /*---------------------------------------------------------------------
        * set Version 3 Length field of the BPDU
        *---------------------------------------------------------------------*/
-      storeShortInPacket(&bpdu->version3Length, version3Len);
+      mstp_txPatchShort(&bpdu->version3Length, version3Len);
 
       /*---------------------------------------------------------------------
        * update Ethernet frame total length to include MST Configuration Data
@@ -4964,11 +5271,12 @@ mstp_txMstp(LPORT_t lport)
    /*------------------------------------------------------------------------
     * convert Ethernet frame length to the network byte order
     *------------------------------------------------------------------------*/
-   storeShortInPacket(&bpdu->lsapHdr.len, bpduLen);
+   mstp_txPatchShort(&bpdu->lsapHdr.len, bpduLen);
+   clearBitmap(commPortPtr->txDirtyTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
+   mstp_perfStats.txTmplSends++;
+   mstp_perfStats.txTmplFrameBytes += ENET_HDR_SIZ + bpduLen;
+   mstp_perfStats.txTmplUsec += mstp_perfElapsedUsec(&start);
 
-   /*------------------------------------------------------------------------
-    * set pkt frame
-    *------------------------------------------------------------------------*/
    /*------------------------------------------------------------------------
     * debug trace, if enabled
     *------------------------------------------------------------------------*/
@@ -4991,14 +5299,14 @@ mstp_txMstp(LPORT_t lport)
                "port=%s", idp->name);
        STP_ASSERT(FALSE);
    }
-   pkt->pktLen = ENET_HDR_SIZ + bpduLen;
-   rc = sendto(idp->pdu_sockfd, pkt->data, pkt->pktLen, 0, NULL, 0);
+   rc = sendto(idp->pdu_sockfd, bpdu, ENET_HDR_SIZ + bpduLen, 0, NULL, 0);
    if (rc == -1) {
        VLOG_ERR("Failed to send MSTPDU for interface=%s, rc=%d, sockfd = %d, errno : %s",
                idp->name, rc, idp->pdu_sockfd, strerror(errno));
        return;
    }
    VLOG_DBG("If it is here!! Packet is OUT successfully!!!");
+   mstp_perfFirstBpduTx();
 
 }
 
@@ -5073,14 +5381,14 @@ mstp_updtRcvdInfoWhile(MSTID_t mstid, LPORT_t lport)
          uint8_t min = MSTP_HELLO_MAX_SEC;   /* 10 seconds */
          uint8_t max = MSTP_HELLO_MAX_SEC*3; /* 30 seconds */
 
-         cistPortPtr->rcvdInfoWhile = min + (rand() % (1 + max - min));
-         STP_ASSERT((cistPortPtr->rcvdInfoWhile >= min) &&
-                (cistPortPtr->rcvdInfoWhile <= max));
+         MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) = min + (rand() % (1 + max - min));
+         STP_ASSERT((MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) >= min) &&
+                (MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) <= max));
       }
       else
       {/* On the 'looped' MSTI port let synchronise the 'rcvdInfoWhile' aging
         * timer with the value currently set for the 'looped' CIST port */
-         mstiPortPtr->rcvdInfoWhile = cistPortPtr->rcvdInfoWhile;
+         MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) = MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile);
       }
 
       return;
@@ -5129,7 +5437,7 @@ mstp_updtRcvdInfoWhile(MSTID_t mstid, LPORT_t lport)
     *------------------------------------------------------------------------*/
    if(mstid == MSTP_CISTID)
    {
-      cistPortPtr->rcvdInfoWhile = rcvdInfoWhile;
+      MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) = rcvdInfoWhile;
 
       if(!rcvdInternal && (messageAge > maxAge))
       {/* Message Age exceeds Max Age */
@@ -5146,7 +5454,7 @@ mstp_updtRcvdInfoWhile(MSTID_t mstid, LPORT_t lport)
    }
    else
    {
-      mstiPortPtr->rcvdInfoWhile = rcvdInfoWhile;
+      MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) = rcvdInfoWhile;
       if(remainingHops <= 0)
       {/* 'remainingHops' is less than or equal to zero */
          mstiPortPtr->dbgCnts.exceededHopsMsgCnt++;
@@ -5178,51 +5486,375 @@ void
 mstp_updtRolesTree(MSTID_t mstid)
 {
    struct ovsdb_idl_txn *txn = NULL;
+   struct timeval        start;
    STP_ASSERT(MSTP_ENABLED);
    STP_ASSERT(mstid == MSTP_CISTID || MSTP_VALID_MSTID(mstid));
+   gettimeofday(&start, NULL);
+   /* port roles and root vectors may change, received BPDUs recorded so
+    * far can no longer be taken for repeated ones */
+   mstp_Bridge.rxInfoGen++;
    MSTP_OVSDB_LOCK;
    txn = ovsdb_idl_txn_create(idl);
    if(mstid == MSTP_CISTID)
+   {
       mstp_updtRolesCist();
+      mstp_perfStats.rolesCistCalls++;
+   }
    else
+   {
       mstp_updtRolesMsti(mstid);
+      mstp_perfStats.rolesMstiCalls++;
+   }
    ovsdb_idl_txn_commit_block(txn);
    ovsdb_idl_txn_destroy(txn);
    MSTP_OVSDB_UNLOCK;
+
+   mstp_perfStats.rolesUsec += mstp_perfElapsedUsec(&start);
 }
 
 /**PROC+**********************************************************************
- * Name:      mstp_updtRolesCist
+ * Name:      mstp_roleInputsChanged
  *
- * Purpose:   Helper function called by the 'updtRolesTree' function to
- *            calculate the CIST Priority Vectors (13.9, 13.10) and Timer
- *            Values. It also assignes the CIST Port Role for each
- *            Port and updates Port's Port Priority Vector and Spanning
- *            Tree Timer Information.
- *            (802.1Q-REV/D5.0 13.26.23)
+ * Purpose:   Check if anything the Port Role Selection of the tree reads has
+ *            changed since the port roles of the tree were last computed:
+ *            the Bridge Priority Vector and Times, the set of ports, and for
+ *            each port its priority vectors, times, path costs, Port
+ *            Identifier, 'infoIs', and the port flags the selection tests
+ *            (for the MSTIs, also the CIST 'infoIs' and selected Port Role
+ *            a boundary port's role follows). The stored copy of the inputs
+ *            is brought up to date.
+ *            Called from Port Role Selection (PRS) state machine, the roles
+ *            computed last time still hold if nothing has changed.
  *
- * Params:    none
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
  *
- * Returns:   none
+ * Returns:   TRUE if the roles of the tree have to be computed again,
+ *            FALSE otherwise
  *
- * Globals:   mstp_CB, mstp_Bridge
+ * Globals:   mstp_Bridge
  *
  **PROC-**********************************************************************/
-static void
-mstp_updtRolesCist(void)
+bool
+mstp_roleInputsChanged(MSTID_t mstid)
 {
-   MSTP_COMM_PORT_INFO_t         *commPortPtr        = NULL;
-   MSTP_CIST_PORT_INFO_t         *cistPortPtr        = NULL;
-   bool                          cistRgnRootChanged = FALSE;
-   bool                          hadNonZeroCistEPC  = FALSE;
-   MSTP_CIST_BRIDGE_PRI_VECTOR_t  cistRootPriVec;
-   MSTP_PORT_ID_t                 cistRootPortId;
-   LPORT_t                        lport;
-   MSTP_PORT_ROLE_t               selectedRole = MSTP_PORT_ROLE_UNKNOWN;
-   MSTP_CIST_ROOT_TIMES_t         cistRootTimes;
-   bool                           rootTimeChange = FALSE;
-   uint16_t                       rootHelloTime = 0;
-   char                           oldRootPortName[PORTNAME_LEN];
+   STP_ASSERT(mstid == MSTP_CISTID || MSTP_VALID_MSTID(mstid));
+
+   if(mstid == MSTP_CISTID)
+      return mstp_cistRoleInputsChanged();
+   else
+      return mstp_mstiRoleInputsChanged(mstid);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_roleInputsPortCurrent
+ *
+ * Purpose:   Check if the port is a Designated Port whose priority vector,
+ *            times and 'infoIs' are still as the last Port Role Selection of
+ *            the tree read them. Called from the Port Information (PIM)
+ *            state machine before it makes them the designated ones, see
+ *            'mstp_roleInputsPortUpdated'.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   TRUE if they are, FALSE otherwise
+ *
+ * Globals:   mstp_Bridge
+ *
+ **PROC-**********************************************************************/
+bool
+mstp_roleInputsPortCurrent(MSTID_t mstid, LPORT_t lport)
+{
+   if(mstid == MSTP_CISTID)
+   {
+      MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+
+      STP_ASSERT(cistPortPtr);
+      return (MSTP_CIST_INFO.rolesValid &&
+              (cistPortPtr->selectedRole == MSTP_PORT_ROLE_DESIGNATED) &&
+              !cistPortPtr->loopInconsistent &&
+              (cistPortPtr->roleInputs.infoIs == cistPortPtr->infoIs) &&
+              (memcmp(&cistPortPtr->roleInputs.portPriority,
+                      &cistPortPtr->portPriority,
+                      sizeof(cistPortPtr->portPriority)) == 0) &&
+              (memcmp(&cistPortPtr->roleInputs.portTimes,
+                      &cistPortPtr->portTimes,
+                      sizeof(cistPortPtr->portTimes)) == 0));
+   }
+   else
+   {
+      MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
+
+      STP_ASSERT(mstiPortPtr);
+      return (MSTP_MSTI_INFO(mstid)->rolesValid &&
+              (mstiPortPtr->selectedRole == MSTP_PORT_ROLE_DESIGNATED) &&
+              !mstiPortPtr->loopInconsistent &&
+              (mstiPortPtr->roleInputs.infoIs == mstiPortPtr->infoIs) &&
+              (memcmp(&mstiPortPtr->roleInputs.portPriority,
+                      &mstiPortPtr->portPriority,
+                      sizeof(mstiPortPtr->portPriority)) == 0) &&
+              (memcmp(&mstiPortPtr->roleInputs.portTimes,
+                      &mstiPortPtr->portTimes,
+                      sizeof(mstiPortPtr->portTimes)) == 0));
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_roleInputsPortUpdated
+ *
+ * Purpose:   A Designated Port has taken the designated priority vector and
+ *            times the last Port Role Selection of the tree computed for it,
+ *            with 'infoIs' Mine. Selecting the roles again would give the
+ *            same result, the stored inputs of the port are brought up to
+ *            date so that it is not run for that.
+ *
+ * Params:    mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints: only if 'mstp_roleInputsPortCurrent' was TRUE for the port
+ *              before the change
+ **PROC-**********************************************************************/
+void
+mstp_roleInputsPortUpdated(MSTID_t mstid, LPORT_t lport)
+{
+   if(mstid == MSTP_CISTID)
+   {
+      MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+
+      STP_ASSERT(cistPortPtr);
+      memcpy(&cistPortPtr->roleInputs.portPriority,
+             &cistPortPtr->portPriority, sizeof(cistPortPtr->portPriority));
+      memcpy(&cistPortPtr->roleInputs.portTimes,
+             &cistPortPtr->portTimes, sizeof(cistPortPtr->portTimes));
+      cistPortPtr->roleInputs.infoIs = cistPortPtr->infoIs;
+   }
+   else
+   {
+      MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
+
+      STP_ASSERT(mstiPortPtr);
+      memcpy(&mstiPortPtr->roleInputs.portPriority,
+             &mstiPortPtr->portPriority, sizeof(mstiPortPtr->portPriority));
+      memcpy(&mstiPortPtr->roleInputs.portTimes,
+             &mstiPortPtr->portTimes, sizeof(mstiPortPtr->portTimes));
+      mstiPortPtr->roleInputs.infoIs = mstiPortPtr->infoIs;
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_roleInputFlags
+ *
+ * Purpose:   Collect the port flags the Port Role Selection tests.
+ *
+ * Params:    commPortPtr   -> CIST and MSTIs common port information
+ *            loopInconsist -> loop guard state of the port for the tree
+ *            rcvdInfoWhile -> 'rcvdInfoWhile' of the port for the tree
+ *
+ * Returns:   MSTP_ROLE_INPUT_XXX flags
+ *
+ * Globals:   none
+ *
+ **PROC-**********************************************************************/
+static uint8_t
+mstp_roleInputFlags(MSTP_COMM_PORT_INFO_t *commPortPtr, bool loopInconsist,
+                    uint8_t rcvdInfoWhile)
+{
+   uint8_t flags = 0;
+
+   if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap, MSTP_PORT_PORT_ENABLED))
+      flags |= MSTP_ROLE_INPUT_PORT_ENABLED;
+   if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
+                                MSTP_PORT_RESTRICTED_ROLE))
+      flags |= MSTP_ROLE_INPUT_RESTRICTED_ROLE;
+   if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap, MSTP_PORT_RCVD_INTERNAL))
+      flags |= MSTP_ROLE_INPUT_RCVD_INTERNAL;
+   if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap, MSTP_PORT_SEND_RSTP))
+      flags |= MSTP_ROLE_INPUT_SEND_RSTP;
+   if(commPortPtr->rcvdSelfSentPkt)
+      flags |= MSTP_ROLE_INPUT_SELF_SENT_PKT;
+   if(loopInconsist)
+      flags |= MSTP_ROLE_INPUT_LOOP_INCONSISTENT;
+   if(rcvdInfoWhile != 0)
+      flags |= MSTP_ROLE_INPUT_INFO_NOT_AGED;
+
+   return flags;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_cistRoleInputsChanged
+ *
+ * Purpose:   Helper function called by the 'roleInputsChanged' function
+ *            for the CIST.
+ *
+ * Params:    none
+ *
+ * Returns:   TRUE if the CIST roles have to be computed again,
+ *            FALSE otherwise
+ *
+ * Globals:   mstp_Bridge
+ *
+ **PROC-**********************************************************************/
+static bool
+mstp_cistRoleInputsChanged(void)
+{
+   MSTP_CIST_TREE_ROLE_INPUTS_t  tree;
+   MSTP_CIST_ROLE_INPUTS_t       port;
+   MSTP_COMM_PORT_INFO_t        *commPortPtr;
+   MSTP_CIST_PORT_INFO_t        *cistPortPtr;
+   LPORT_t                       lport;
+   bool                          changed = !MSTP_CIST_INFO.rolesValid;
+
+   memset(&tree, 0, sizeof(tree));
+   tree.lports         = mstp_Bridge.activeLports;
+   tree.BridgePriority = MSTP_CIST_BRIDGE_PRIORITY;
+   tree.BridgeTimes    = MSTP_CIST_BRIDGE_TIMES;
+   tree.FwdDelay       = mstp_Bridge.FwdDelay;
+   tree.HelloTime      = mstp_Bridge.HelloTime;
+   tree.MaxAge         = mstp_Bridge.MaxAge;
+   tree.TxHoldCount    = mstp_Bridge.TxHoldCount;
+   if(memcmp(&tree, &MSTP_CIST_INFO.roleInputs, sizeof(tree)) != 0)
+   {
+      memcpy(&MSTP_CIST_INFO.roleInputs, &tree, sizeof(tree));
+      changed = TRUE;
+   }
+
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
+   {
+      commPortPtr = MSTP_COMM_PORT_PTR(lport);
+      cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+      if(!commPortPtr || !cistPortPtr)
+         continue;
+
+      memset(&port, 0, sizeof(port));
+      port.portPriority         = cistPortPtr->portPriority;
+      port.msgPriority          = cistPortPtr->msgPriority;
+      port.portTimes            = cistPortPtr->portTimes;
+      port.ExternalPortPathCost = commPortPtr->ExternalPortPathCost;
+      port.InternalPortPathCost = cistPortPtr->InternalPortPathCost;
+      port.portId               = cistPortPtr->portId;
+      port.infoIs               = cistPortPtr->infoIs;
+      port.flags = mstp_roleInputFlags(commPortPtr,
+                                       cistPortPtr->loopInconsistent,
+                                       MSTP_PORT_HOT(cistPortPtr,
+                                                     rcvdInfoWhile));
+      if(memcmp(&port, &cistPortPtr->roleInputs, sizeof(port)) != 0)
+      {
+         memcpy(&cistPortPtr->roleInputs, &port, sizeof(port));
+         changed = TRUE;
+      }
+   }
+
+   MSTP_CIST_INFO.rolesValid = TRUE;
+   return changed;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_mstiRoleInputsChanged
+ *
+ * Purpose:   Helper function called by the 'roleInputsChanged' function
+ *            for an MSTI.
+ *
+ * Params:    mstid -> MST Instance Identifier
+ *
+ * Returns:   TRUE if the MSTI roles have to be computed again,
+ *            FALSE otherwise
+ *
+ * Globals:   mstp_Bridge
+ *
+ **PROC-**********************************************************************/
+static bool
+mstp_mstiRoleInputsChanged(MSTID_t mstid)
+{
+   MSTP_MSTI_INFO_t             *mstiPtr = MSTP_MSTI_INFO(mstid);
+   MSTP_MSTI_TREE_ROLE_INPUTS_t  tree;
+   MSTP_MSTI_ROLE_INPUTS_t       port;
+   MSTP_COMM_PORT_INFO_t        *commPortPtr;
+   MSTP_CIST_PORT_INFO_t        *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t        *mstiPortPtr;
+   LPORT_t                       lport;
+   bool                          changed;
+
+   STP_ASSERT(mstiPtr);
+   changed = !mstiPtr->rolesValid;
+
+   memset(&tree, 0, sizeof(tree));
+   tree.lports         = mstp_Bridge.activeLports;
+   tree.BridgePriority = MSTP_MSTI_BRIDGE_PRIORITY(mstid);
+   tree.BridgeTimes    = MSTP_MSTI_BRIDGE_TIMES(mstid);
+   if(memcmp(&tree, &mstiPtr->roleInputs, sizeof(tree)) != 0)
+   {
+      memcpy(&mstiPtr->roleInputs, &tree, sizeof(tree));
+      changed = TRUE;
+   }
+
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
+   {
+      commPortPtr = MSTP_COMM_PORT_PTR(lport);
+      cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+      mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
+      if(!commPortPtr || !cistPortPtr || !mstiPortPtr)
+         continue;
+
+      memset(&port, 0, sizeof(port));
+      port.portPriority         = mstiPortPtr->portPriority;
+      port.msgPriority          = mstiPortPtr->msgPriority;
+      port.portTimes            = mstiPortPtr->portTimes;
+      port.InternalPortPathCost = mstiPortPtr->InternalPortPathCost;
+      port.portId               = mstiPortPtr->portId;
+      port.infoIs               = mstiPortPtr->infoIs;
+      port.cistInfoIs           = cistPortPtr->infoIs;
+      port.cistSelectedRole     = cistPortPtr->selectedRole;
+      port.flags = mstp_roleInputFlags(commPortPtr,
+                                       mstiPortPtr->loopInconsistent,
+                                       MSTP_PORT_HOT(mstiPortPtr,
+                                                     rcvdInfoWhile));
+      if(memcmp(&port, &mstiPortPtr->roleInputs, sizeof(port)) != 0)
+      {
+         memcpy(&mstiPortPtr->roleInputs, &port, sizeof(port));
+         changed = TRUE;
+      }
+   }
+
+   mstiPtr->rolesValid = TRUE;
+   return changed;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_updtRolesCist
+ *
+ * Purpose:   Helper function called by the 'updtRolesTree' function to
+ *            calculate the CIST Priority Vectors (13.9, 13.10) and Timer
+ *            Values. It also assignes the CIST Port Role for each
+ *            Port and updates Port's Port Priority Vector and Spanning
+ *            Tree Timer Information.
+ *            (802.1Q-REV/D5.0 13.26.23)
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_CB, mstp_Bridge
+ *
+ **PROC-**********************************************************************/
+static void
+mstp_updtRolesCist(void)
+{
+   MSTP_COMM_PORT_INFO_t         *commPortPtr        = NULL;
+   MSTP_CIST_PORT_INFO_t         *cistPortPtr        = NULL;
+   bool                          cistRgnRootChanged = FALSE;
+   bool                          hadNonZeroCistEPC  = FALSE;
+   MSTP_CIST_BRIDGE_PRI_VECTOR_t  cistRootPriVec;
+   MSTP_PORT_ID_t                 cistRootPortId;
+   LPORT_t                        lport;
+   MSTP_PORT_ROLE_t               selectedRole = MSTP_PORT_ROLE_UNKNOWN;
+   MSTP_CIST_ROOT_TIMES_t         cistRootTimes;
+   bool                           rootTimeChange = FALSE;
+   uint16_t                       rootHelloTime = 0;
+   char                           oldRootPortName[PORTNAME_LEN];
    char                           newRootPortName[PORTNAME_LEN];
    char                           designatedRoot[MSTP_ROOT_ID] = {0};
    char                           regionalRoot[MSTP_ROOT_ID] = {0};
@@ -5254,7 +5886,7 @@ mstp_updtRolesCist(void)
     * Address component is not equal to that component of the Bridge's own
     * Bridge Priority Vector and Port's 'restrictedRole' parameter is FALSE
     *------------------------------------------------------------------------*/
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       commPortPtr = MSTP_COMM_PORT_PTR(lport);
       cistPortPtr = MSTP_CIST_PORT_PTR(lport);
@@ -5264,10 +5896,11 @@ mstp_updtRolesCist(void)
 
       if(commPortPtr && cistPortPtr)
       {
+         mstp_perfStats.rolesPortsVisited++;
          if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                                       MSTP_PORT_PORT_ENABLED) &&
             (cistPortPtr->infoIs == MSTP_INFO_IS_RECEIVED) &&
-            (cistPortPtr->rcvdInfoWhile != 0))
+            (MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) != 0))
 
          {/* port is not 'Disabled', and has a Port Priority Vector that has
            * been recorded from a received message and not aged out
@@ -5348,7 +5981,7 @@ mstp_updtRolesCist(void)
            }
          }
       }/* end 'if(commPortPtr && cistPortPtr)' statement */
-   }/* end 'for(lport = 1; lport <= MAX_LPORTS; lport++)' loop */
+   }/* end 'for(lport ...)' loop */
 
    cistRgnRootChanged = !MSTP_BRIDGE_ID_EQUAL(MSTP_CIST_ROOT_PRIORITY.rgnRootID,
                                               cistRootPriVec.rgnRootID);
@@ -5520,7 +6153,7 @@ mstp_updtRolesCist(void)
     *     Designated Times (PIM SM will do the update by looking at the
     *     'updtInfo' status).
     *------------------------------------------------------------------------*/
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       selectedRole = MSTP_PORT_ROLE_UNKNOWN;
       commPortPtr = MSTP_COMM_PORT_PTR(lport);
@@ -5531,6 +6164,7 @@ mstp_updtRolesCist(void)
 
       if(commPortPtr && cistPortPtr)
       {
+         mstp_perfStats.rolesPortsVisited++;
          /*-------------------------------------------------------------------
           * Update the Designated Priority Vector for the Port. (Steps
           * 1-4 below).
@@ -5548,6 +6182,9 @@ mstp_updtRolesCist(void)
           * 1). Copy Bridge's Root Priority Vector to the
           *     Port's Designated Priority Vector
           *------------------------------------------------------------------*/
+         MSTP_CIST_DESIGNATED_PRI_VECTOR_t dsnPriority =
+                                            cistPortPtr->designatedPriority;
+         MSTP_CIST_DESIGNATED_TIMES_t dsnTimes = cistPortPtr->designatedTimes;
          char designatedRoot[MSTP_ROOT_ID] = {0};
          char regionalRoot[MSTP_ROOT_ID] = {0};
          char port_name[PORTNAME_LEN] = {0};
@@ -5608,6 +6245,12 @@ mstp_updtRolesCist(void)
           *-----------------------------------------------------------------*/
          cistPortPtr->designatedTimes = MSTP_CIST_ROOT_TIMES;
 
+         /* both are conveyed in the port's BPDUs */
+         if(memcmp(&dsnPriority, &cistPortPtr->designatedPriority,
+                   sizeof(dsnPriority)) ||
+            memcmp(&dsnTimes, &cistPortPtr->designatedTimes, sizeof(dsnTimes)))
+            MSTP_TX_TREE_CHANGED(MSTP_CISTID, lport);
+
          /* Clear the root inconsistent  flag */
          cistPortPtr->rootInconsistent = FALSE;
 
@@ -5810,7 +6453,7 @@ mstp_updtRolesCist(void)
             cistPortPtr->selectedRole = selectedRole;
          }
       }/* end 'if(commPortPtr && cistPortPtr)' statement */
-   }/* end 'for(lport = 1; lport <= MAX_LPORTS; lport++)' loop */
+   }/* end 'for(lport ...)' loop */
 
 }
 
@@ -5872,7 +6515,7 @@ mstp_updtRolesMsti(MSTID_t mstid)
     * Address component is not equal to that component of the Bridge's own
     * Bridge Priority Vector and Port's 'restrictedRole' parameter is FALSE
     *------------------------------------------------------------------------*/
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       commPortPtr = MSTP_COMM_PORT_PTR(lport);
       mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
@@ -5884,10 +6527,11 @@ mstp_updtRolesMsti(MSTID_t mstid)
 
       if(commPortPtr && mstiPortPtr)
       {
+         mstp_perfStats.rolesPortsVisited++;
          if(MSTP_COMM_PORT_IS_BIT_SET(commPortPtr->bitMap,
                                       MSTP_PORT_PORT_ENABLED) &&
             (mstiPortPtr->infoIs == MSTP_INFO_IS_RECEIVED) &&
-            (mstiPortPtr->rcvdInfoWhile != 0))
+            (MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) != 0))
          {/* port is not 'Disabled', and has a Port Priority Vector that has
            * been recorded from a received message and not aged out
            * ('infoIs' == 'Received') */
@@ -5947,7 +6591,7 @@ mstp_updtRolesMsti(MSTID_t mstid)
 
          }
       }/* end of '(commPortPtr && mstiPortPtr)' statement */
-   }/* end of 'for(lport = 1; lport <= MAX_LPORTS; lport++)' */
+   }/* end of 'for(lport ...)' */
 
    /*-------------------------------------------------------------------------
     * Check if the MSTI Regional Root has been changed, if so then update
@@ -6069,7 +6713,7 @@ mstp_updtRolesMsti(MSTID_t mstid)
     *     Designated Times (PIM SM will do the update by looking at the
     *     'updtInfo' status).
     *------------------------------------------------------------------------*/
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       selectedRole = MSTP_PORT_ROLE_UNKNOWN;
       commPortPtr = MSTP_COMM_PORT_PTR(lport);
@@ -6085,6 +6729,7 @@ mstp_updtRolesMsti(MSTID_t mstid)
          MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
 
          STP_ASSERT(cistPortPtr);
+         mstp_perfStats.rolesPortsVisited++;
 
          /*-------------------------------------------------------------------
           * Update the Designated Priority Vector for the Port. (Steps
@@ -6100,6 +6745,9 @@ mstp_updtRolesMsti(MSTID_t mstid)
           * 1). Copy Bridge's Root Priority Vector to the
           *     Port's Designated Priority Vector
           *------------------------------------------------------------------*/
+         MSTP_MSTI_DESIGNATED_PRI_VECTOR_t dsnPriority =
+                                            mstiPortPtr->designatedPriority;
+         MSTP_MSTI_DESIGNATED_TIMES_t dsnTimes = mstiPortPtr->designatedTimes;
          mstiPortPtr->designatedPriority = MSTP_MSTI_ROOT_PRIORITY(mstid);
          char designatedRoot[MSTP_ROOT_ID] = {0};
          snprintf(designatedRoot,MSTP_ROOT_ID,"%d.%d.%02x:%02x:%02x:%02x:%02x:%02x",mstiPortPtr->designatedPriority.rgnRootID.priority,
@@ -6147,6 +6795,12 @@ mstp_updtRolesMsti(MSTID_t mstid)
           *-----------------------------------------------------------------*/
          mstiPortPtr->designatedTimes = MSTP_MSTI_ROOT_TIMES(mstid);
 
+         /* both are conveyed in the port's BPDUs */
+         if(memcmp(&dsnPriority, &mstiPortPtr->designatedPriority,
+                   sizeof(dsnPriority)) ||
+            memcmp(&dsnTimes, &mstiPortPtr->designatedTimes, sizeof(dsnTimes)))
+            MSTP_TX_TREE_CHANGED(mstid, lport);
+
 
          mstiPortPtr->rootInconsistent = FALSE;
          /*------------------------------------------------------------------
@@ -6391,7 +7045,7 @@ mstp_updtRolesMsti(MSTID_t mstid)
             mstiPortPtr->selectedRole = selectedRole;
          }
       }/* end of '(commPortPtr && mstiPortPtr)' statement */
-   }/* end of 'for(lport = 1; lport <= MAX_LPORTS; lport++)' loop */
+   }/* end of 'for(lport ...)' loop */
 }
 
 /**PROC+**********************************************************************
@@ -6422,7 +7076,8 @@ mstp_updtRolesDisabledTree(MSTID_t mstid)
    {/* set all CIST ports */
       MSTP_CIST_PORT_INFO_t *cistPortPtr;
 
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_CIST_INFO.rolesValid = FALSE;
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          cistPortPtr = MSTP_CIST_PORT_PTR(lport);
          if(cistPortPtr)
@@ -6433,7 +7088,8 @@ mstp_updtRolesDisabledTree(MSTID_t mstid)
    {/* set all ports for a given MSTI */
       MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
 
-      for(lport = 1; lport <= MAX_LPORTS; lport++)
+      MSTP_MSTI_INFO(mstid)->rolesValid = FALSE;
+      MSTP_FOR_EACH_ACTIVE_LPORT(lport)
       {
          mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
          if(mstiPortPtr)
@@ -6502,7 +7158,7 @@ mstp_AllSyncedCondition(MSTID_t mstid, LPORT_t lport)
                                                       MSTP_CIST_PORT_UPDT_INFO);
       if(roleEqSelectedRole && !updtInfo)
       {
-         for(lportTmp = 1; lportTmp <= MAX_LPORTS; lportTmp++)
+         MSTP_FOR_EACH_ACTIVE_LPORT(lportTmp)
          {
             if((cistPortPtr = MSTP_CIST_PORT_PTR(lportTmp)))
             {
@@ -6554,7 +7210,7 @@ mstp_AllSyncedCondition(MSTID_t mstid, LPORT_t lport)
                                                       MSTP_MSTI_PORT_UPDT_INFO);
       if(roleEqSelectedRole && !updtInfo)
       {
-         for(lportTmp = 1; lportTmp <= MAX_LPORTS; lportTmp++)
+         MSTP_FOR_EACH_ACTIVE_LPORT(lportTmp)
          {
             if((mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lportTmp)))
             {
@@ -6706,7 +7362,7 @@ mstp_ReRootedCondition(MSTID_t mstid, LPORT_t lport)
   /*------------------------------------------------------------------------
    * Check for the 'reRooted' condition
    *------------------------------------------------------------------------*/
-   for(lportTmp = 1; lportTmp <= MAX_LPORTS; lportTmp++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lportTmp)
    {
       if(lportTmp == lport)
          continue;
@@ -6715,7 +7371,7 @@ mstp_ReRootedCondition(MSTID_t mstid, LPORT_t lport)
       {
          MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lportTmp);
 
-         if(cistPortPtr && (cistPortPtr->rrWhile != 0))
+         if(cistPortPtr && (MSTP_PORT_HOT(cistPortPtr, rrWhile) != 0))
             res = FALSE;
       }
       else
@@ -6723,7 +7379,7 @@ mstp_ReRootedCondition(MSTID_t mstid, LPORT_t lport)
          MSTP_MSTI_PORT_INFO_t *mstiPortPtr =
                                            MSTP_MSTI_PORT_PTR(mstid, lportTmp);
 
-         if(mstiPortPtr && (mstiPortPtr->rrWhile != 0))
+         if(mstiPortPtr && (MSTP_PORT_HOT(mstiPortPtr, rrWhile) != 0))
             res = FALSE;
       }
 
@@ -7021,30 +7677,87 @@ mstp_logNewRootId(MSTP_BRIDGE_IDENTIFIER_t oldRootId,
 /**PROC+**********************************************************************
  * Name:      mstp_findMstiPortStateChgMsg
  *
- * Purpose:   Find ports state change information block on the global
- *            queue for the given MST Instance.
+ * Purpose:   Find ports state change information block pending for the
+ *            given MST Instance.
  *
  * Params:    mstid -> MST Instance Identifier in question.
  *
  * Returns:   pointer to the tree change information block corresponding to
- *            the given 'mstid' if found, NULL otherwise.
+ *            the given 'mstid' if it holds pending info, NULL otherwise.
  *
- * Globals:   none
+ * Globals:   mstp_CB
  *
  **PROC-**********************************************************************/
 MSTP_TREE_MSG_t *
 mstp_findMstiPortStateChgMsg(MSTID_t mstid)
 {
-   MSTP_TREE_MSG_t *m = (MSTP_TREE_MSG_t *)qfirst_nodis(&MSTP_TREE_MSGS_QUEUE);
+   uint32_t slot = MSTP_TREE_MSG_SLOT(mstid);
+
+   STP_ASSERT(slot < MSTP_TREE_MSG_SLOTS);
+
+   if(!isBitSet(MSTP_TREE_MSGS_DIRTY.map, slot + 1, MSTP_TREE_MSG_SLOTS))
+      return NULL;
+
+   return &MSTP_TREE_MSGS[slot];
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_getMstiPortStateChgMsg
+ *
+ * Purpose:   Get the ports state change information block of the given MST
+ *            Instance to add state change info to, taking its slot in use
+ *            if it does not hold pending info yet.
+ *
+ * Params:    mstid -> MST Instance Identifier in question.
+ *
+ * Returns:   pointer to the tree change information block corresponding to
+ *            the given 'mstid'
+ *
+ * Globals:   mstp_CB
+ *
+ **PROC-**********************************************************************/
+MSTP_TREE_MSG_t *
+mstp_getMstiPortStateChgMsg(MSTID_t mstid)
+{
+   uint32_t slot = MSTP_TREE_MSG_SLOT(mstid);
 
-   for(; m != (MSTP_TREE_MSG_t *) Q_NULL;
-         m  = (MSTP_TREE_MSG_t *) qnext_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link))
+   STP_ASSERT(slot < MSTP_TREE_MSG_SLOTS);
+
+   if(!isBitSet(MSTP_TREE_MSGS_DIRTY.map, slot + 1, MSTP_TREE_MSG_SLOTS))
    {
-      if (m->mstid == mstid)
-         break;
+      setBit(MSTP_TREE_MSGS_DIRTY.map, slot + 1, MSTP_TREE_MSG_SLOTS);
+      MSTP_TREE_MSGS[slot].mstid = mstid;
+      mstp_perfStats.treeMsgSlotsUsed++;
    }
 
-   return m;
+   return &MSTP_TREE_MSGS[slot];
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_clearMstiPortStateChgMsg
+ *
+ * Purpose:   Discard the ports state change information pending for the
+ *            given MST Instance, if any.
+ *
+ * Params:    mstid -> MST Instance Identifier in question.
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_CB
+ *
+ **PROC-**********************************************************************/
+void
+mstp_clearMstiPortStateChgMsg(MSTID_t mstid)
+{
+   uint32_t slot = MSTP_TREE_MSG_SLOT(mstid);
+
+   STP_ASSERT(slot < MSTP_TREE_MSG_SLOTS);
+
+   if(isBitSet(MSTP_TREE_MSGS_DIRTY.map, slot + 1, MSTP_TREE_MSG_SLOTS))
+   {
+      memset(&MSTP_TREE_MSGS[slot], 0, sizeof(MSTP_TREE_MSG_t));
+      clrBit(MSTP_TREE_MSGS_DIRTY.map, slot + 1, MSTP_TREE_MSG_SLOTS);
+   }
 }
 
 /**PROC+*********************************************************************
@@ -7098,69 +7811,164 @@ mstp_getMstiVidMap(MSTID_t mstid, VID_MAP *vidMap)
 MSTID_t
 mstp_getMstIdForVid(VID_t vid)
 {
-   MSTID_t mstid = MSTP_NO_MSTID;
-   MSTID_t tmpMstid;
-
    STP_ASSERT(IS_VALID_VID(vid));
 
+   return mstp_VidMstIdTable[vid];
+}
 
-   /*------------------------------------------------------------------------
-    * Search in 'mstp_MstiVidTable'
-    *------------------------------------------------------------------------*/
-   for(tmpMstid = MSTP_CISTID; tmpMstid <= MSTP_INSTANCES_MAX; tmpMstid++)
+/**PROC+**********************************************************************
+ * Name:      mstp_setVidMapMstId
+ *
+ * Purpose:   Record in 'mstp_VidMstIdTable' that all VIDs of the given map
+ *            now belong to the given MST Instance. Must be called whenever
+ *            VIDs are moved between entries of 'mstp_MstiVidTable'.
+ *
+ * Params:    vidMap -> VIDs being (re)mapped
+ *            mstid  -> MST Instance Identifier, or MSTP_NO_MSTID to unmap
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_VidMstIdTable
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_setVidMapMstId(const VID_MAP *vidMap, uint16_t mstid)
+{
+   VID_t   vid;
+   MSTID_t cfgMstid;
+
+   STP_ASSERT(vidMap);
+   STP_ASSERT(mstid == MSTP_NO_MSTID || mstid <= MSTP_INSTANCES_MAX);
+
+   /* the MST Configuration Table carries 0 for unmapped VIDs */
+   cfgMstid = htons((mstid == MSTP_NO_MSTID) ? 0 : mstid);
+   for(vid = find_first_vid_set(vidMap); IS_VALID_VID(vid);
+       vid = find_next_vid(vidMap, vid))
    {
-      if(is_vid_set(&mstp_MstiVidTable[tmpMstid], vid))
+      mstp_VidMstIdTable[vid] = (uint8_t)mstid;
+      if(vid >= MSTP_MST_CFG_TBL_FIRST_VID_IDX &&
+         vid <= MSTP_MST_CFG_TBL_LAST_VID_IDX &&
+         mstp_MstCfgTable[vid] != cfgMstid)
       {
-         mstid = tmpMstid;
-         break;
+         mstp_MstCfgTable[vid] = cfgMstid;
+         mstp_MstCfgTableDirty = TRUE;
       }
    }
-
-   return mstid;
 }
 
 /**PROC+**********************************************************************
- * Name:      mstp_getComponentId
+ * Name:      mstp_clearVidMstIdTable
  *
- * Purpose:   Convert VID map from SNMP format to the switch's internal fromat
- *            NOTE: MSTP MIB objects representing VIDs information designed
- *                  so that VIDs are encoded bitwise from left to right, which
- *                  may differ from the internal bit map representation.
+ * Purpose:   Mark all VIDs as not mapped to any tree in both the lookup
+ *            table and the MST Configuration Table used for the digest.
  *
- * Params:    vidMap  -> VID map to convert
+ * Params:    none
  *
  * Returns:   none
  *
- * Globals:   none
+ * Globals:   mstp_VidMstIdTable, mstp_MstCfgTable
  *
  * Constraints:
  **PROC-**********************************************************************/
-int  mstp_getComponentId()
+void
+mstp_clearVidMstIdTable(void)
 {
-  return MSTP_MIN_COMPONENT_ID;
+   memset(mstp_VidMstIdTable, MSTP_NO_MSTID, sizeof(mstp_VidMstIdTable));
+   memset(mstp_MstCfgTable, 0, sizeof(mstp_MstCfgTable));
+   mstp_MstCfgTableDirty = TRUE;
 }
 
-
 /**PROC+**********************************************************************
- * Name:      mstp_getMstiUptime
- *
- * Purpose    Get Uptime of each port
- *
+ * Name:      mstp_vidMstIdTableMismatches
  *
- * Params:    lport
+ * Purpose:   Cross-check 'mstp_VidMstIdTable' against 'mstp_MstiVidTable'.
+ *            A VID must be set in the VID map of the tree the lookup table
+ *            points to, and in no VID map at all if it is unmapped.
+ *            The check walks every VID, it is only run on demand from the
+ *            'mstp_digest' dump and never on the VID mapping path.
  *
+ * Params:    none
  *
- * Returns:   PortUptime
+ * Returns:   number of VIDs for which the two tables disagree
  *
- * Globals:   none
+ * Globals:   mstp_VidMstIdTable, mstp_MstiVidTable
  *
  * Constraints:
  **PROC-**********************************************************************/
-int
-mstp_getMstiUptime(MSTID_t mstid, LPORT_t lport)
+uint32_t
+mstp_vidMstIdTableMismatches(void)
 {
- uint32_t     mstiPort_uptime;
- MSTP_MSTI_PORT_INFO_t *mstiPortPtr = NULL;
+   uint32_t cnt = 0;
+   MSTID_t  mstid;
+   VID_t    vid;
+
+   for(vid = MIN_VLAN_ID; vid <= MAX_VLAN_ID; vid++)
+   {
+      mstid = mstp_VidMstIdTable[vid];
+      if(mstid != MSTP_NO_MSTID)
+      {
+         if(!is_vid_set(&mstp_MstiVidTable[mstid], vid))
+            cnt++;
+      }
+      else
+      {
+         for(mstid = MSTP_CISTID; mstid <= MSTP_INSTANCES_MAX; mstid++)
+         {
+            if(is_vid_set(&mstp_MstiVidTable[mstid], vid))
+            {
+               cnt++;
+               break;
+            }
+         }
+      }
+   }
+
+   return cnt;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_getComponentId
+ *
+ * Purpose:   Convert VID map from SNMP format to the switch's internal fromat
+ *            NOTE: MSTP MIB objects representing VIDs information designed
+ *                  so that VIDs are encoded bitwise from left to right, which
+ *                  may differ from the internal bit map representation.
+ *
+ * Params:    vidMap  -> VID map to convert
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int  mstp_getComponentId()
+{
+  return MSTP_MIN_COMPONENT_ID;
+}
+
+
+/**PROC+**********************************************************************
+ * Name:      mstp_getMstiUptime
+ *
+ * Purpose    Get Uptime of each port
+ *
+ *
+ * Params:    lport
+ *
+ *
+ * Returns:   PortUptime
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+mstp_getMstiUptime(MSTID_t mstid, LPORT_t lport)
+{
+ uint32_t     mstiPort_uptime;
+ MSTP_MSTI_PORT_INFO_t *mstiPortPtr = NULL;
 
  mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
@@ -7216,7 +8024,7 @@ mstp_isTopologyChange(MSTID_t mstid)
    STP_ASSERT(mstid <= MSTP_INSTANCES_MAX);
 
 
-   for(lport = 1;lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       /*------------------------------------------------------------------------
        * check the CIST
@@ -7225,7 +8033,7 @@ mstp_isTopologyChange(MSTID_t mstid)
       {
          cistPortPtr = MSTP_CIST_PORT_PTR(lport);
          STP_ASSERT(cistPortPtr);
-         if(cistPortPtr && (cistPortPtr->tcWhile != 0))
+         if(cistPortPtr && (MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0))
          {
             return TRUE;
          }
@@ -7239,7 +8047,7 @@ mstp_isTopologyChange(MSTID_t mstid)
          STP_ASSERT(mstid <= MSTP_INSTANCES_MAX);
          mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
          STP_ASSERT(mstiPortPtr);
-         if(mstiPortPtr && (mstiPortPtr->tcWhile != 0))
+         if(mstiPortPtr && (MSTP_PORT_HOT(mstiPortPtr, tcWhile) != 0))
          {
             return TRUE;
          }
@@ -7490,17 +8298,7 @@ mstp_vidMapToVidStr(VID_MAP *srcVidMap, char *buf, uint16_t bufLen)
 static void
 mstp_updtMstiRootInfoChg(MSTID_t mstid)
 {
-   MSTP_TREE_MSG_t *m = mstp_findMstiPortStateChgMsg(mstid);
-
-
-   if(m == NULL)
-   {
-      m = calloc(1, sizeof(MSTP_TREE_MSG_t));
-      m->mstid        = mstid;
-      m->link.q_flink = NULL;
-      m->link.q_blink = NULL;
-      insqti_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
-   }
+   MSTP_TREE_MSG_t *m = mstp_getMstiPortStateChgMsg(mstid);
 
    m->rootInfoChanged = TRUE;
 }
@@ -7526,16 +8324,7 @@ static void
 mstp_updtMstiPortStateChgMsg(MSTID_t mstid, LPORT_t lport,
                              MSTP_ACT_TYPE_t state)
 {
-   MSTP_TREE_MSG_t *m = mstp_findMstiPortStateChgMsg(mstid);
-
-   if(m == NULL)
-   {
-      m = calloc(1, sizeof(MSTP_TREE_MSG_t));
-      m->mstid        = mstid;
-      m->link.q_flink = NULL;
-      m->link.q_blink = NULL;
-      insqti_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
-   }
+   MSTP_TREE_MSG_t *m = mstp_getMstiPortStateChgMsg(mstid);
 
    switch(state)
    {
@@ -7972,13 +8761,50 @@ mstp_mstRgnCfgConsistencyCheck(MSTP_MST_BPDU_t *bpdu, LPORT_t lport)
    }
 }
 
+/**PROC+**********************************************************************
+ * Name:      mstp_bridgeIdKey
+ *
+ * Purpose:   Pack a Bridge Identifier into a single integer whose numerical
+ *            order is the Bridge Identifier order: the priority occupies the
+ *            most significant 16 bits, followed by the MAC address taken in
+ *            network (big-endian) byte order.
+ *
+ * Params:    id -> a pointer to the Bridge Identifier
+ *
+ * Returns:   the packed 64-bit key
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static inline uint64_t
+mstp_bridgeIdKey(const MSTP_BRIDGE_IDENTIFIER_t *id)
+{
+   const uint8_t *mac = id->mac_address;
+
+   return (((uint64_t)id->priority << 48) |
+           ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) |
+           ((uint64_t)mac[2] << 24) | ((uint64_t)mac[3] << 16) |
+           ((uint64_t)mac[4] << 8)  |  (uint64_t)mac[5]);
+}
+
+/*---------------------------------------------------------------------------
+ * Return from the enclosing compare function as soon as the two keys differ
+ *---------------------------------------------------------------------------*/
+#define MSTP_PRI_VEC_KEY_CMP(k1, k2)                                         \
+   do {                                                                      \
+      if((k1) != (k2))                                                       \
+         return ((k1) < (k2)) ? -1 : 1;                                      \
+   } while(0)
+
 /**PROC+**********************************************************************
  * Name:      mstp_cistPriorityVectorsCompare
  *
  * Purpose:   Compares two CIST priority vectors.
  *            NOTE: For all components of a priority vector a lesser
  *                  numerical value is better, and earlier components
- *                  are more significant.
+ *                  are more significant. Each Bridge Identifier is
+ *                  compared as one packed integer (see 'mstp_bridgeIdKey').
  *            (802.1Q-REV/D5.0 13.9; 13.10)
  *
  * Params:    v1 -> a pointer to the first CIST priority vector
@@ -7992,64 +8818,23 @@ mstp_mstRgnCfgConsistencyCheck(MSTP_MST_BPDU_t *bpdu, LPORT_t lport)
  *
  * Constraints:
  **PROC-**********************************************************************/
-static int
+int
 mstp_cistPriorityVectorsCompare(MSTP_CIST_BRIDGE_PRI_VECTOR_t *v1,
                                 MSTP_CIST_BRIDGE_PRI_VECTOR_t *v2)
 {
-   int res;
-
    STP_ASSERT(v1 && v2);
 
-   if((MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID))
-      &&
-      (v1->extRootPathCost == v2->extRootPathCost)
-      &&
-      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID))
-      &&
-      (v1->intRootPathCost == v2->intRootPathCost)
-      &&
-      (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID))
-      &&
-      (v1->dsnPortID == v2->dsnPortID))
-   {/* the first priority vector is the same as the second one */
-      res = 0;
-   }
-   else
-   if((MSTP_BRIDGE_ID_LOWER(v1->rootID, v2->rootID))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
-       (v1->extRootPathCost < v2->extRootPathCost))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
-       (v1->extRootPathCost == v2->extRootPathCost) &&
-       (MSTP_BRIDGE_ID_LOWER(v1->rgnRootID, v2->rgnRootID)))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
-       (v1->extRootPathCost == v2->extRootPathCost) &&
-       (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID)) &&
-       (v1->intRootPathCost < v2->intRootPathCost))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
-       (v1->extRootPathCost == v2->extRootPathCost) &&
-       (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID)) &&
-       (v1->intRootPathCost == v2->intRootPathCost) &&
-       MSTP_BRIDGE_ID_LOWER(v1->dsnBridgeID, v2->dsnBridgeID))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
-       (v1->extRootPathCost == v2->extRootPathCost) &&
-       (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID)) &&
-       (v1->intRootPathCost == v2->intRootPathCost) &&
-       (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID)) &&
-       (v1->dsnPortID < v2->dsnPortID)))
-   {/* the first priority vector is better than the second one */
-      res = -1;
-   }
-   else
-   {/* the first priority vector is worse than the second one */
-      res = 1;
-   }
+   MSTP_PRI_VEC_KEY_CMP(mstp_bridgeIdKey(&v1->rootID),
+                        mstp_bridgeIdKey(&v2->rootID));
+   MSTP_PRI_VEC_KEY_CMP(v1->extRootPathCost, v2->extRootPathCost);
+   MSTP_PRI_VEC_KEY_CMP(mstp_bridgeIdKey(&v1->rgnRootID),
+                        mstp_bridgeIdKey(&v2->rgnRootID));
+   MSTP_PRI_VEC_KEY_CMP(v1->intRootPathCost, v2->intRootPathCost);
+   MSTP_PRI_VEC_KEY_CMP(mstp_bridgeIdKey(&v1->dsnBridgeID),
+                        mstp_bridgeIdKey(&v2->dsnBridgeID));
+   MSTP_PRI_VEC_KEY_CMP(v1->dsnPortID, v2->dsnPortID);
 
-   return res;
+   return 0;
 }
 
 /**PROC+**********************************************************************
@@ -8058,7 +8843,8 @@ mstp_cistPriorityVectorsCompare(MSTP_CIST_BRIDGE_PRI_VECTOR_t *v1,
  * Purpose:   Compares two MSTI priority vectors.
  *            NOTE: For all components of a priority vector a lesser
  *                  numerical value is better, and earlier components
- *                  are more significant.
+ *                  are more significant. Each Bridge Identifier is
+ *                  compared as one packed integer (see 'mstp_bridgeIdKey').
  *            (802.1Q-REV/D5.0 13.9; 13.11)
  *
  * Params:    v1 -> a pointer to the first MSTI priority vector
@@ -8072,47 +8858,20 @@ mstp_cistPriorityVectorsCompare(MSTP_CIST_BRIDGE_PRI_VECTOR_t *v1,
  *
  * Constraints:
  **PROC-**********************************************************************/
-static int
+int
 mstp_mstiPriorityVectorsCompare(MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v1,
                                 MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v2)
 {
-   int res;
-
    STP_ASSERT(v1 && v2);
 
-   if((MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID))
-      &&
-      (v1->intRootPathCost == v2->intRootPathCost)
-      &&
-      (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID))
-      &&
-      (v1->dsnPortID == v2->dsnPortID))
-   {/* the first priority vector is the same as the second one */
-      res = 0;
-   }
-   else
-   if((MSTP_BRIDGE_ID_LOWER(v1->rgnRootID, v2->rgnRootID))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID) &&
-       (v1->intRootPathCost < v2->intRootPathCost))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID) &&
-       (v1->intRootPathCost == v2->intRootPathCost) &&
-       (MSTP_BRIDGE_ID_LOWER(v1->dsnBridgeID, v2->dsnBridgeID)))
-      ||
-      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID) &&
-       (v1->intRootPathCost == v2->intRootPathCost) &&
-       (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID)) &&
-       (v1->dsnPortID < v2->dsnPortID)))
-   {/* the first priority vector is better than the second one */
-      res = -1;
-   }
-   else
-   {/* the first priority vector is worse than the second one */
-      res = 1;
-   }
+   MSTP_PRI_VEC_KEY_CMP(mstp_bridgeIdKey(&v1->rgnRootID),
+                        mstp_bridgeIdKey(&v2->rgnRootID));
+   MSTP_PRI_VEC_KEY_CMP(v1->intRootPathCost, v2->intRootPathCost);
+   MSTP_PRI_VEC_KEY_CMP(mstp_bridgeIdKey(&v1->dsnBridgeID),
+                        mstp_bridgeIdKey(&v2->dsnBridgeID));
+   MSTP_PRI_VEC_KEY_CMP(v1->dsnPortID, v2->dsnPortID);
 
-   return res;
+   return 0;
 }
 
 /**PROC+**********************************************************************
@@ -8153,6 +8912,12 @@ mstp_findMstiCfgMsgInBpdu(MSTP_RX_PDU *pkt, MSTID_t mstid)
       return NULL;
    }
 
+   /*------------------------------------------------------------------------
+    * the BPDU being processed has its messages already indexed by MSTID
+    *------------------------------------------------------------------------*/
+   if(pkt == mstp_rxBpduDesc.pkt)
+      return mstp_rxBpduDesc.mstiMsg[mstid];
+
    bpdu = (MSTP_MST_BPDU_t *)(pkt->data);
    len  = MSTP_MSTI_CFG_MSGS_SIZE(bpdu);
    if(len == 0)
@@ -8361,6 +9126,9 @@ mstp_isMstBpdu(MSTP_RX_PDU *pkt)
    bool             res = FALSE;
 
    STP_ASSERT(pkt);
+   if(pkt == mstp_rxBpduDesc.pkt)
+      return (mstp_rxBpduDesc.bpduType == MSTP_BPDU_TYPE_MSTP);
+
    bpdu   = (MSTP_MST_BPDU_t *)(pkt->data);
    length = MSTP_BPDU_LENGTH(bpdu);
 
@@ -8378,94 +9146,760 @@ mstp_isMstBpdu(MSTP_RX_PDU *pkt)
          res = TRUE;
    }
 
-   return res;
+   return res;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_isSelfSentPkt
+ *
+ * Purpose:   Perform the check if the packet was received as a result of an
+ *            'external' loop condition (i.e. packet relayed through the port
+ *            is looping back on the port).
+ *
+ * Params:    pkt -> pointer to the packet buffer
+ *
+ * Returns:   TRUE if received packet is self sent packet, FALSE otherwise
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static bool
+mstp_isSelfSentPkt(MSTP_RX_PDU *pkt)
+{
+    bool res = FALSE;
+   ENET_HDR    *enetHdr;  /* pointer to start of ethernet header */
+   LPORT_t      lport;    /* logical port pkt arrived on */
+   const char *my_mac = NULL;
+   MAC_ADDRESS  portSrc;  /* port's own source MAC address */
+   MAC_ADDRESS *src_mac = NULL;
+
+   STP_ASSERT(pkt);
+   lport = GET_PKT_LOGICAL_PORT(pkt);
+   /* Get the logical port's source MAC address */
+   my_mac = intf_get_mac_addr(lport);
+   sscanf(my_mac,"%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:%02hhx",&portSrc[0],&portSrc[1],&portSrc[2],&portSrc[3],&portSrc[4],&portSrc[5]);
+   src_mac = (MAC_ADDRESS *)pkt->data + ENET_ADDR_SIZE;
+   res = MAC_ADDRS_EQUAL(src_mac,portSrc);
+
+   /* Extract ethernet header from the received frame */
+   enetHdr = (ENET_HDR *)(pkt->data);
+   /* Compare source MAC addresses */
+   res = MAC_ADDRS_EQUAL(enetHdr->src, portSrc);
+
+   return res;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_getBpduType
+ *
+ * Purpose:   Identify type of the received BPDU
+ *
+ * Params:    pkt -> pointer to the packet buffer with BPDU in
+ *            NOTE: the order of BPDU type verification is important as
+ *                      the rules defined in 802.1Q-REV/D5.0 14.4 d) case 1
+ *                      and 14.4 e) case 1 overlap, that may cause MST BPDU
+ *                      be identified as RST BPDU if MST BPDU does not
+ *                      carry optional MSTI Configuration Messages. So we
+ *                      do a check first for MST BPDU type and only if it
+ *                      fails we do a check for RST BPDU type.
+ *
+ * Returns:   one of the following:
+ *            'MSTP_BPDU_TYPE_MSTP'    if MST BPDU or
+ *            'MSTP_BPDU_TYPE_RSTP'    if RST BPDU or
+ *            'MSTP_BPDU_TYPE_STP'     if STP Configuration BPDU or
+ *            'MSTP_BPDU_TYPE_TCN'     if STP TCN BPDU or
+ *            'MSTP_BPDU_TYPE_UNKNOWN' if none of the above
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+MSTP_BPDU_TYPE_t
+mstp_getBpduType(MSTP_RX_PDU *pkt)
+{
+   MSTP_BPDU_TYPE_t bpduType;
+
+   STP_ASSERT(pkt);
+
+   if(mstp_isMstBpdu(pkt))
+      bpduType = MSTP_BPDU_TYPE_MSTP;
+   else if(mstp_isRstBpdu(pkt))
+      bpduType = MSTP_BPDU_TYPE_RSTP;
+   else if(mstp_isStpConfigBpdu(pkt))
+      bpduType = MSTP_BPDU_TYPE_STP;
+   else if(mstp_isStpTcnBpdu(pkt))
+      bpduType = MSTP_BPDU_TYPE_TCN;
+   else
+      bpduType = MSTP_BPDU_TYPE_UNKNOWN;
+
+   return bpduType;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_parseRxBpdu
+ *
+ * Purpose:   Validate the received BPDU once and record what the state
+ *            machines need from it: the BPDU type, the Version 3 Length
+ *            and, for MST BPDUs, the location of the MSTI Configuration
+ *            Message of each MSTI indexed by MSTID. Until the descriptor
+ *            is cleared 'mstp_isMstBpdu' and 'mstp_findMstiCfgMsgInBpdu'
+ *            answer for this packet from the descriptor.
+ *
+ * Params:    pkt -> pointer to the packet buffer with BPDU in
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_rxBpduDesc
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_parseRxBpdu(MSTP_RX_PDU *pkt)
+{
+   MSTP_MST_BPDU_t        *bpdu;
+   MSTP_MSTI_CONFIG_MSG_t *msg;
+   MSTP_MSTI_CONFIG_MSG_t *end;
+   MSTID_t                 mstid;
+
+   STP_ASSERT(pkt);
+
+   mstp_clearRxBpduDesc();
+   mstp_rxBpduDesc.bpduType = mstp_getBpduType(pkt);
+
+   if(mstp_rxBpduDesc.bpduType == MSTP_BPDU_TYPE_MSTP)
+   {
+      bpdu = (MSTP_MST_BPDU_t *)(pkt->data);
+      mstp_rxBpduDesc.v3Len = ntohs(bpdu->version3Length);
+
+      msg = (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+      end = (MSTP_MSTI_CONFIG_MSG_t *)((char *)msg +
+                                       MSTP_MSTI_CFG_MSGS_SIZE(bpdu));
+      for(; msg < end; msg++)
+      {
+         mstp_rxBpduDesc.numMstiMsgs++;
+         mstid = MSTP_GET_BRIDGE_SYS_ID_FROM_PKT(msg->mstiRgnRootId);
+         /* the first message for an MSTI wins, as with a linear search */
+         if(MSTP_VALID_MSTID(mstid) && !mstp_rxBpduDesc.mstiMsg[mstid])
+            mstp_rxBpduDesc.mstiMsg[mstid] = msg;
+      }
+   }
+
+   mstp_rxBpduDesc.pkt = pkt;
+
+   if((mstp_rxBpduDesc.bpduType == MSTP_BPDU_TYPE_MSTP) ||
+      (mstp_rxBpduDesc.bpduType == MSTP_BPDU_TYPE_RSTP))
+   {
+      MSTP_COMM_PORT_INFO_t *commPortPtr =
+                               MSTP_COMM_PORT_PTR(GET_PKT_LOGICAL_PORT(pkt));
+
+      if(commPortPtr && mstp_isRxBpduRepeated(pkt, commPortPtr))
+      {
+         mstp_rxBpduDesc.repeated = TRUE;
+         mstp_perfStats.rxBpduRepeats++;
+      }
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_clearRxBpduDesc
+ *
+ * Purpose:   Invalidate the received BPDU descriptor, called when the
+ *            processing of the BPDU it describes is over.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_rxBpduDesc
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_clearRxBpduDesc(void)
+{
+   memset(&mstp_rxBpduDesc, 0, sizeof(mstp_rxBpduDesc));
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_isRxBpduRepeated
+ *
+ * Purpose:   Check if the received BPDU is the same as the last one decoded
+ *            on the port and nothing has changed on the Bridge since then
+ *            that could make it classified differently. The CIST and MSTI
+ *            flags are compared by the Port Role bits only, the remaining
+ *            flags are not used to classify the received information.
+ *
+ * Params:    pkt         -> pointer to the packet buffer with BPDU in
+ *            commPortPtr -> common data of the receiving port
+ *
+ * Returns:   TRUE if the BPDU is a repeated one, FALSE otherwise
+ *
+ * Globals:   mstp_Bridge, mstp_rxBpduDesc
+ *
+ * Constraints: called once 'mstp_rxBpduDesc' describes the MST or RST BPDU
+ **PROC-**********************************************************************/
+static bool
+mstp_isRxBpduRepeated(MSTP_RX_PDU *pkt,
+                      const MSTP_COMM_PORT_INFO_t *commPortPtr)
+{
+   const uint8_t *cur = pkt->data;
+   const uint8_t *old = commPortPtr->lastRxBpdu;
+   size_t         len = pkt->pktLen;
+   size_t         prev;
+   size_t         flags;
+   uint8_t        i;
+
+   if(!old || (commPortPtr->lastRxBpduLen != len) ||
+      (commPortPtr->lastRxBpduGen != mstp_Bridge.rxInfoGen))
+      return FALSE;
+
+   flags = offsetof(MSTP_MST_BPDU_t, cistFlags);
+   if((memcmp(cur, old, flags) != 0) ||
+      ((cur[flags] ^ old[flags]) & MSTP_CIST_FLAG_PORT_ROLE))
+      return FALSE;
+   prev = flags + 1;
+
+   for(i = 0; i < mstp_rxBpduDesc.numMstiMsgs; i++)
+   {
+      flags = offsetof(MSTP_MST_BPDU_t, mstiConfigMsgs) +
+              i * sizeof(MSTP_MSTI_CONFIG_MSG_t) +
+              offsetof(MSTP_MSTI_CONFIG_MSG_t, mstiFlags);
+      if((memcmp(cur + prev, old + prev, flags - prev) != 0) ||
+         ((cur[flags] ^ old[flags]) & MSTP_MSTI_FLAG_PORT_ROLE))
+         return FALSE;
+      prev = flags + 1;
+   }
+
+   return (memcmp(cur + prev, old + prev, len - prev) == 0);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_recordRxBpdu
+ *
+ * Purpose:   Keep a copy of the MST or RST BPDU that is being decoded on the
+ *            port, stamped with the current 'rxInfoGen', to recognize the
+ *            next BPDU repeating it.
+ *
+ * Params:    pkt         -> pointer to the packet buffer with BPDU in
+ *            commPortPtr -> common data of the receiving port
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge, mstp_rxBpduDesc
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_recordRxBpdu(MSTP_RX_PDU *pkt, MSTP_COMM_PORT_INFO_t *commPortPtr)
+{
+   commPortPtr->lastRxBpduLen = 0;
+
+   if((pkt != mstp_rxBpduDesc.pkt) ||
+      ((mstp_rxBpduDesc.bpduType != MSTP_BPDU_TYPE_MSTP) &&
+       (mstp_rxBpduDesc.bpduType != MSTP_BPDU_TYPE_RSTP)) ||
+      (pkt->pktLen > MAX_MSTP_BPDU_PKT_SIZE))
+      return;
+
+   if(!commPortPtr->lastRxBpdu)
+   {
+      commPortPtr->lastRxBpdu = malloc(MAX_MSTP_BPDU_PKT_SIZE);
+      if(!commPortPtr->lastRxBpdu)
+         return;
+   }
+
+   memcpy(commPortPtr->lastRxBpdu, pkt->data, pkt->pktLen);
+   commPortPtr->lastRxBpduLen = pkt->pktLen;
+   commPortPtr->lastRxBpduGen = mstp_Bridge.rxInfoGen;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_txBpduTemplate
+ *
+ * Purpose:   Get the BPDU template of the port, i.e. the buffer holding the
+ *            MST BPDU transmitted last on it. On first use the buffer is
+ *            allocated and the parts that do not change for the port (LSAP
+ *            header addresses, protocol Id and BPDU type) are filled in.
+ *            The source address is that of the first interface of the
+ *            port, 'mstp_txBpduTemplateReset' drops the template when it
+ *            changes, e.g. a LAG member is added or removed. Every tree is
+ *            encoded into a new template.
+ *
+ * Params:    lport       -> logical port number
+ *            commPortPtr -> common data of the transmitting port
+ *
+ * Returns:   pointer to the template, NULL if it could not be allocated
+ *
+ * Globals:   mstp_perfStats, stp_multicast
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static MSTP_MST_BPDU_t *
+mstp_txBpduTemplate(LPORT_t lport, MSTP_COMM_PORT_INFO_t *commPortPtr)
+{
+   MSTP_MST_BPDU_t *bpdu   = NULL;
+   const char      *my_mac = NULL;
+   MAC_ADDRESS      mac;
+
+   if(commPortPtr->txBpdu)
+      return (MSTP_MST_BPDU_t *)commPortPtr->txBpdu;
+
+   commPortPtr->txBpdu = calloc(1, MAX_MSTP_BPDU_PKT_SIZE);
+   if(!commPortPtr->txBpdu)
+      return NULL;
+
+   bpdu = (MSTP_MST_BPDU_t *)commPortPtr->txBpdu;
+
+   /* nothing of any tree is in it yet */
+   setBitmap(commPortPtr->txDirtyTrees.map, MSTP_ROLES_DIRTY_MAP_BITS);
+   clearBitmap(commPortPtr->txMstiSent.map, MSTP_ROLES_DIRTY_MAP_BITS);
+
+   /* destination Multicast address */
+   MAC_ADDR_COPY(stp_multicast, bpdu->lsapHdr.dst);
+
+   /* get the mac address for the port */
+   my_mac = intf_get_mac_addr(lport);
+   VLOG_DBG("MSTP Util : 5 : mac : %s", my_mac);
+   sscanf(my_mac,"%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:%02hhx",&mac[0],&mac[1],&mac[2],&mac[3],&mac[4],&mac[5]);
+   MAC_ADDR_COPY(&mac, bpdu->lsapHdr.src);
+
+   bpdu->lsapHdr.dsap = 0x42;
+   bpdu->lsapHdr.ssap = 0x42;
+   bpdu->lsapHdr.ctrl = MSTP_LSAP_HDR_CTRL_VAL;
+
+   /* protocol Id and BPDU type (the rest is patched on transmission) */
+   bpdu->protocolId = MSTP_STP_RST_MST_PROTOCOL_ID;
+   bpdu->bpduType   = MSTP_BPDU_TYPE_MST;
+
+   mstp_perfStats.txTmplBuilds++;
+   mstp_perfStats.txTmplBytes += offsetof(MSTP_MST_BPDU_t, cistFlags);
+
+   return bpdu;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_txBpduTemplateReset
+ *
+ * Purpose:   Drop the BPDU template of the port, so the next transmission
+ *            builds it again with the current MAC address of the port.
+ *
+ * Params:    lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_txBpduTemplateReset(LPORT_t lport)
+{
+   MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
+
+   if(!commPortPtr)
+      return;
+
+   free(commPortPtr->txBpdu);
+   commPortPtr->txBpdu = NULL;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_txPatch
+ *
+ * Purpose:   Write an encoded BPDU field into the port's BPDU template,
+ *            only if it differs from the value transmitted last.
+ *
+ * Params:    dst -> the field in the template
+ *            src -> its new encoded value
+ *            len -> the field size
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_txPatch(void *dst, const void *src, size_t len)
+{
+   if(memcmp(dst, src, len) != 0)
+   {
+      memcpy(dst, src, len);
+      mstp_perfStats.txTmplBytes += len;
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_txPatchShort / mstp_txPatchLong
+ *
+ * Purpose:   Encode the value in the network byte order and patch it into
+ *            the port's BPDU template (see 'mstp_txPatch').
+ *
+ * Params:    dst   -> the field in the template
+ *            value -> the value in the host byte order
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_txPatchShort(uint16_t *dst, uint16_t value)
+{
+   uint16_t encoded;
+
+   storeShortInPacket(&encoded, value);
+   mstp_txPatch(dst, &encoded, sizeof(encoded));
+}
+
+static void
+mstp_txPatchLong(uint32_t *dst, uint32_t value)
+{
+   uint32_t encoded;
+
+   storeLongInPacket(&encoded, value);
+   mstp_txPatch(dst, &encoded, sizeof(encoded));
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_txPatchBridgeId
+ *
+ * Purpose:   Encode the Bridge Identifier and patch it into the port's BPDU
+ *            template (see 'mstp_txPatch').
+ *
+ * Params:    dst -> the Bridge Identifier in the template
+ *            src -> the Bridge Identifier in the host byte order
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_txPatchBridgeId(MSTP_BRIDGE_IDENTIFIER_t *dst,
+                     const MSTP_BRIDGE_IDENTIFIER_t *src)
+{
+   MSTP_BRIDGE_IDENTIFIER_t encoded;
+
+   memset(&encoded, 0, sizeof(encoded));
+   MAC_ADDR_COPY(src->mac_address, encoded.mac_address);
+   storeShortInPacket(&encoded.priority, src->priority);
+   mstp_txPatch(dst, &encoded, sizeof(encoded));
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_txCistEncode
+ *
+ * Purpose:   Patch the CIST message priority vector, Port Role, flags and
+ *            times of the port into its BPDU template (see 'mstp_txMstp').
+ *
+ * Params:    bpdu        -> the port's BPDU template
+ *            cistPortPtr -> CIST data of the transmitting port
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_txCistEncode(MSTP_MST_BPDU_t *bpdu, MSTP_CIST_PORT_INFO_t *cistPortPtr)
+{
+   MSTP_CIST_DESIGNATED_PRI_VECTOR_t *cistDsnPriVecPtr = NULL;
+   MSTP_CIST_DESIGNATED_TIMES_t      *cistDsnTimesPtr  = NULL;
+   uint8_t                            cistFlags        = 0;
+
+   /*------------------------------------------------------------------------
+    * set message priority vector.
+    * The first six components of the CIST message priority vector
+    * conveyed in the BPDU are set to the value of the CIST's
+    * 'designatedPriority' parameter for this Port.
+    * NOTE: The CIST Internal Root Path Cost and the CIST Designated Bridge
+    *       Identifier are encoded further, if Force Protocol Version parameter
+    *       is set 'D_hpicfBridgeRstpProtocolVersion_ieee8021s'.
+    *------------------------------------------------------------------------*/
+   cistDsnPriVecPtr = &cistPortPtr->designatedPriority;
+
+   /* copy the CIST Root Identifier */
+   mstp_txPatchBridgeId(&bpdu->cistRootId, &cistDsnPriVecPtr->rootID);
+
+   /* copy the CIST External Root Path Cost */
+   mstp_txPatchLong(&bpdu->cistExtPathCost, cistDsnPriVecPtr->extRootPathCost);
+
+   /* copy the CIST Regional Root Identifier */
+   mstp_txPatchBridgeId(&bpdu->cistRgnRootId, &cistDsnPriVecPtr->rgnRootID);
+
+   /* copy the CIST Port Identifier:
+    * NOTE: Octets 26 and 27 convey the CIST Port Identifier of the
+    *       transmitting Bridge Port
+    *       (802.1Q-REV/D5.0 14.6 k)) */
+   mstp_txPatchShort(&bpdu->cistPortId, cistPortPtr->portId);
+
+   /*------------------------------------------------------------------------
+    * set CIST port role.
+    * NOTE: The Port Role in the BPDU should be set to the current value of
+    *       the 'role' variable for the transmitting port
+    *------------------------------------------------------------------------*/
+   switch(cistPortPtr->role)
+   {
+      case MSTP_PORT_ROLE_ROOT:
+         cistFlags |= MSTP_BPDU_ROLE_ROOT;
+      break;
+      case MSTP_PORT_ROLE_DESIGNATED:
+         cistFlags |= MSTP_BPDU_ROLE_DESIGNATED;
+      break;
+      case MSTP_PORT_ROLE_ALTERNATE:
+      case MSTP_PORT_ROLE_BACKUP:
+         cistFlags |= MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP;
+      break;
+      default:
+         STP_ASSERT(0);
+      break;
+   }
+
+   /*------------------------------------------------------------------------
+    * set message flags.
+    * NOTE: The 'Agreement' and 'Proposal' flags in the BPDU are set to the
+    *       values of the 'agree' and 'proposing' variables for the
+    *       transmitting Port, respectively.
+    *       The CIST topology change flag is set if ('tcWhile' != 0) for the
+    *       Port. The topology change acknowledge flag in the BPDU is never
+    *       used and is set to zero. The 'learning' and 'forwarding' flags in
+    *       the BPDU are set to the values of the 'learning' and 'forwarding'
+    *       variables for the CIST, respectively.
+    *------------------------------------------------------------------------*/
+
+   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_AGREE))
+   {/* 'agree' is set, set 'Agreement' flag */
+      cistFlags |= MSTP_CIST_FLAG_AGREEMENT;
+   }
+
+   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_PROPOSING))
+   {/* 'proposing' is set, set 'Proposal' flag */
+      cistFlags |= MSTP_CIST_FLAG_PROPOSAL;
+   }
+
+   if(MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0)
+   {/* (tcWhile != 0), set  CIST topology change flag for the Port */
+      cistFlags |= MSTP_CIST_FLAG_TC;
+   }
+
+   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_LEARNING))
+   {/* set 'learning' flag */
+      cistFlags |= MSTP_CIST_FLAG_LEARNING;
+   }
+
+   if(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap, MSTP_CIST_PORT_FORWARDING))
+   {/* set 'forwarding' flag */
+      cistFlags |= MSTP_CIST_FLAG_FORWADING;
+   }
+
+   mstp_txPatch(&bpdu->cistFlags, &cistFlags, sizeof(cistFlags));
+
+   /*------------------------------------------------------------------------
+    * set message times parameters.
+    * The value of the Message Age, Max Age, and Fwd Delay parameters conveyed
+    * in the BPDU are set to the values held in the CIST's 'designatedTimes'
+    * parameter for the Port. The value of the Hello Time parameter conveyed in
+    * the BPDU is set to the value held in the CIST's 'portTimes' parameter for
+    * the Port.
+    * NOTE: Times in message are carried in units of 1/256 second
+    *       (802.1D-2004 9.2.8)
+    *------------------------------------------------------------------------*/
+   cistDsnTimesPtr = &cistPortPtr->designatedTimes;
+
+   mstp_txPatchShort(&bpdu->msgAge, cistDsnTimesPtr->messageAge << 8);
+   mstp_txPatchShort(&bpdu->maxAge, cistDsnTimesPtr->maxAge << 8);
+   mstp_txPatchShort(&bpdu->fwdDelay, cistDsnTimesPtr->fwdDelay << 8);
+   mstp_txPatchShort(&bpdu->helloTime, cistPortPtr->portTimes.helloTime << 8);
 }
 
 /**PROC+**********************************************************************
- * Name:      mstp_isSelfSentPkt
+ * Name:      mstp_txMstiMsgEncode
  *
- * Purpose:   Perform the check if the packet was received as a result of an
- *            'external' loop condition (i.e. packet relayed through the port
- *            is looping back on the port).
+ * Purpose:   Encode the MSTI Configuration Message of the port
+ *            (802.1Q-REV/D5.0 14.6.1).
  *
- * Params:    pkt -> pointer to the packet buffer
+ * Params:    mstiPtr     -> MSTI data
+ *            mstiPortPtr -> MSTI data of the transmitting port
+ *            mstiMsg     -> the message is encoded in it
  *
- * Returns:   TRUE if received packet is self sent packet, FALSE otherwise
+ * Returns:   none
  *
  * Globals:   none
  *
  * Constraints:
  **PROC-**********************************************************************/
-static bool
-mstp_isSelfSentPkt(MSTP_RX_PDU *pkt)
+static void
+mstp_txMstiMsgEncode(MSTP_MSTI_INFO_t *mstiPtr,
+                     MSTP_MSTI_PORT_INFO_t *mstiPortPtr,
+                     MSTP_MSTI_CONFIG_MSG_t *mstiMsg)
 {
-    bool res = FALSE;
-   ENET_HDR    *enetHdr;  /* pointer to start of ethernet header */
-   LPORT_t      lport;    /* logical port pkt arrived on */
-   const char *my_mac = NULL;
-   MAC_ADDRESS  portSrc;  /* port's own source MAC address */
-   MAC_ADDRESS *src_mac = NULL;
+   MSTP_MSTI_DESIGNATED_PRI_VECTOR_t *mstiDsnPriVecPtr = NULL;
+   uint16_t                            priorityVal      = 0;
 
-   STP_ASSERT(pkt);
-   lport = GET_PKT_LOGICAL_PORT(pkt);
-   /* Get the logical port's source MAC address */
-   my_mac = intf_get_mac_addr(lport);
-   sscanf(my_mac,"%02hhx:%02hhx:%02hhx:%02hhx:%02hhx:%02hhx",&portSrc[0],&portSrc[1],&portSrc[2],&portSrc[3],&portSrc[4],&portSrc[5]);
-   src_mac = (MAC_ADDRESS *)pkt->data + ENET_ADDR_SIZE;
-   res = MAC_ADDRS_EQUAL(src_mac,portSrc);
+   memset((char *)mstiMsg, 0, sizeof(*mstiMsg));
 
-   /* Extract ethernet header from the received frame */
-   enetHdr = (ENET_HDR *)(pkt->data);
-   /* Compare source MAC addresses */
-   res = MAC_ADDRS_EQUAL(enetHdr->src, portSrc);
+   /*------------------------------------------------------------------------
+    * to facilitate the reference to 'designatedPriority' content
+    *------------------------------------------------------------------------*/
+   mstiDsnPriVecPtr = &mstiPortPtr->designatedPriority;
 
-   return res;
+   /*------------------------------------------------------------------------
+    * MSTI Regional Root Identifier */
+   MAC_ADDR_COPY(mstiDsnPriVecPtr->rgnRootID.mac_address,
+                 mstiMsg->mstiRgnRootId.mac_address);
+   storeShortInPacket(&mstiMsg->mstiRgnRootId.priority,
+                      mstiDsnPriVecPtr->rgnRootID.priority);
+
+   /*------------------------------------------------------------------------
+    * MSTI Internal Root Path Cost */
+   storeLongInPacket(&mstiMsg->mstiIntRootPathCost,
+                     mstiDsnPriVecPtr->intRootPathCost);
+
+   /*------------------------------------------------------------------------
+    * MSTI Bridge Priority
+    * NOTE: Bits 5 through 8 of Octet 14 convey the value of the Bridge
+    *       Identifier Priority for this MSTI. Bits 1 through 4 of Octet 14
+    *       shall be transmitted as 0, and ignored on receipt
+    *       (802.1Q-REV/D5.0 14.6.1 d)).
+    *------------------------------------------------------------------------*/
+   priorityVal = MSTP_GET_BRIDGE_PRIORITY(mstiPtr->BridgeIdentifier);
+   mstiMsg->mstiBridgePriority = ((priorityVal / 4096) << 4);
+
+   /*------------------------------------------------------------------------
+    * MSTI Port Priority
+    * NOTE: Bits 5 through 8 of Octet 15 convey the value of the Port
+    *       Identifier Priority for this MSTI. Bits 1 through 4 of Octet 15
+    *       shall be transmitted as 0, and ignored on receipt
+    *       (802.1Q-REV/D5.0 14.6.1 e)).
+    *------------------------------------------------------------------------*/
+   priorityVal = MSTP_GET_PORT_PRIORITY(mstiPortPtr->portId);
+   mstiMsg->mstiPortPriority = ((priorityVal / 16) << 4);
+
+   /*------------------------------------------------------------------------
+    * MSTI Remaning Hops
+    *------------------------------------------------------------------------*/
+   mstiMsg->mstiRemainingHops = mstiPortPtr->designatedTimes.hops;
+
+   /*------------------------------------------------------------------------
+    * set MSTI port role
+    *------------------------------------------------------------------------*/
+   switch(mstiPortPtr->role)
+   {
+      case MSTP_PORT_ROLE_ROOT:
+         mstiMsg->mstiFlags |= MSTP_BPDU_ROLE_ROOT;
+         break;
+      case MSTP_PORT_ROLE_MASTER:
+         mstiMsg->mstiFlags |= MSTP_BPDU_ROLE_MASTER_PORT;
+         break;
+      case MSTP_PORT_ROLE_DESIGNATED:
+         mstiMsg->mstiFlags |= MSTP_BPDU_ROLE_DESIGNATED;
+         break;
+      case MSTP_PORT_ROLE_ALTERNATE:
+      case MSTP_PORT_ROLE_BACKUP:
+         mstiMsg->mstiFlags |= MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP;
+         break;
+      default:
+         STP_ASSERT(0);
+         break;
+   }
+
+   /*------------------------------------------------------------------------
+    * set other MSTI flags
+    *------------------------------------------------------------------------*/
+
+   if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap, MSTP_MSTI_PORT_AGREE))
+   {/* 'agree' is set, set 'Agreement' flag */
+      mstiMsg->mstiFlags |= MSTP_MSTI_FLAG_AGREEMENT;
+   }
+
+   if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap, MSTP_MSTI_PORT_PROPOSING))
+   {/* 'proposing' is set, set 'Proposal' flag */
+      mstiMsg->mstiFlags |= MSTP_MSTI_FLAG_PROPOSAL;
+   }
+
+   if(MSTP_PORT_HOT(mstiPortPtr, tcWhile) != 0)
+   {/* (tcWhile != 0), set MSTI topology change flag */
+      mstiMsg->mstiFlags |= MSTP_MSTI_FLAG_TC;
+   }
+
+   if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap, MSTP_MSTI_PORT_LEARNING))
+   {/* 'learning' is set, set 'learning' flag */
+      mstiMsg->mstiFlags |= MSTP_MSTI_FLAG_LEARNING;
+   }
+
+   if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap,
+                                MSTP_MSTI_PORT_FORWARDING))
+   {/* 'forwarding' is set, set 'forwarding' flag */
+      mstiMsg->mstiFlags |= MSTP_MSTI_FLAG_FORWADING;
+   }
+
+   if(MSTP_MSTI_PORT_IS_BIT_SET(mstiPortPtr->bitMap, MSTP_MSTI_PORT_MASTER))
+   {/* 'master' variable is set, set 'Master' flag */
+      mstiMsg->mstiFlags |= MSTP_MSTI_FLAG_MASTER;
+   }
 }
 
 /**PROC+**********************************************************************
- * Name:      mstp_getBpduType
+ * Name:      mstp_rcvInfoIsRepeated
  *
- * Purpose:   Identify type of the received BPDU
+ * Purpose:   Decide whether the received BPDU may be classified for the
+ *            given Tree as 'RepeatedDesignatedInfo' without decoding it,
+ *            i.e. the BPDU repeats the previous one, that one was
+ *            classified as such and the port has kept the received
+ *            information. A BPDU that is going to be decoded on the CIST
+ *            is recorded for the next check.
+ *            The port must not be Designated for the Tree, as then
+ *            'mstp_rcvInfoCist' also depends on the 'proposing' flag.
  *
- * Params:    pkt -> pointer to the packet buffer with BPDU in
- *            NOTE: the order of BPDU type verification is important as
- *                      the rules defined in 802.1Q-REV/D5.0 14.4 d) case 1
- *                      and 14.4 e) case 1 overlap, that may cause MST BPDU
- *                      be identified as RST BPDU if MST BPDU does not
- *                      carry optional MSTI Configuration Messages. So we
- *                      do a check first for MST BPDU type and only if it
- *                      fails we do a check for RST BPDU type.
+ * Params:    pkt   -> pointer to the packet buffer with BPDU in
+ *            mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number
  *
- * Returns:   one of the following:
- *            'MSTP_BPDU_TYPE_MSTP'    if MST BPDU or
- *            'MSTP_BPDU_TYPE_RSTP'    if RST BPDU or
- *            'MSTP_BPDU_TYPE_STP'     if STP Configuration BPDU or
- *            'MSTP_BPDU_TYPE_TCN'     if STP TCN BPDU or
- *            'MSTP_BPDU_TYPE_UNKNOWN' if none of the above
+ * Returns:   TRUE if the BPDU decoding may be skipped, FALSE otherwise
  *
- * Globals:   none
+ * Globals:   mstp_Bridge, mstp_rxBpduDesc
  *
  * Constraints:
  **PROC-**********************************************************************/
-MSTP_BPDU_TYPE_t
-mstp_getBpduType(MSTP_RX_PDU *pkt)
+static bool
+mstp_rcvInfoIsRepeated(MSTP_RX_PDU *pkt, MSTID_t mstid, LPORT_t lport)
 {
-   MSTP_BPDU_TYPE_t bpduType;
+   MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
+   bool                   repeated;
 
-   STP_ASSERT(pkt);
+   STP_ASSERT(commPortPtr);
 
-   if(mstp_isMstBpdu(pkt))
-      bpduType = MSTP_BPDU_TYPE_MSTP;
-   else if(mstp_isRstBpdu(pkt))
-      bpduType = MSTP_BPDU_TYPE_RSTP;
-   else if(mstp_isStpConfigBpdu(pkt))
-      bpduType = MSTP_BPDU_TYPE_STP;
-   else if(mstp_isStpTcnBpdu(pkt))
-      bpduType = MSTP_BPDU_TYPE_TCN;
+   repeated = (pkt == mstp_rxBpduDesc.pkt) && mstp_rxBpduDesc.repeated &&
+              !commPortPtr->rcvdSelfSentPkt;
+
+   if(mstid == MSTP_CISTID)
+   {
+      MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+
+      STP_ASSERT(cistPortPtr);
+      repeated = repeated &&
+                 (cistPortPtr->rcvdInfo == MSTP_RCVD_INFO_REPEATED_DESIGNATED) &&
+                 (cistPortPtr->infoIs == MSTP_INFO_IS_RECEIVED) &&
+                 (cistPortPtr->role != MSTP_PORT_ROLE_DESIGNATED);
+      if(!repeated)
+         mstp_recordRxBpdu(pkt, commPortPtr);
+   }
    else
-      bpduType = MSTP_BPDU_TYPE_UNKNOWN;
+   {
+      MSTP_MSTI_PORT_INFO_t *mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
 
-   return bpduType;
+      STP_ASSERT(mstiPortPtr);
+      repeated = repeated &&
+                 (mstiPortPtr->rcvdInfo == MSTP_RCVD_INFO_REPEATED_DESIGNATED) &&
+                 (mstiPortPtr->infoIs == MSTP_INFO_IS_RECEIVED) &&
+                 (mstiPortPtr->role != MSTP_PORT_ROLE_DESIGNATED);
+   }
+
+   return repeated;
 }
 
 /*===========================================================================
@@ -8715,7 +10149,7 @@ mstp_clrMstiDbgCntsInfo(MSTID_t mstid)
    /*------------------------------------------------------------------------
     * Clear the CIST's/MSTI's Debug Information maintained on a per-port basis
     *------------------------------------------------------------------------*/
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       if(MSTP_COMM_PORT_PTR(lport))
          mstp_clrMstiPortDbgCntInfo(mstid, lport);
@@ -8997,7 +10431,7 @@ mstp_getMstiPortsDbgCntInfo(MSTID_t mstid, uint32_t cntId)
     * Tree Instance
     *------------------------------------------------------------------------*/
    STP_ASSERT(MSTP_INSTANCE_IS_VALID(mstid));
-   for(lport = 1; lport <= MAX_LPORTS; lport++)
+   MSTP_FOR_EACH_ACTIVE_LPORT(lport)
    {
       if(MSTP_COMM_PORT_PTR(lport))
          value += mstp_getMstiPortDbgCntInfo(mstid, lport, cntId, NULL);
@@ -10259,7 +11693,7 @@ mstp_dot1dStpPortState(LPORT_t lport)
       state = 5;
    else if(cistPortPtr->pstState == MSTP_PST_STATE_DISCARDING)
    {
-      if(cistPortPtr->prtState == MSTP_PRT_STATE_DESIGNATED_DISCARD)
+      if(MSTP_PORT_HOT(cistPortPtr, prtState) == MSTP_PRT_STATE_DESIGNATED_DISCARD)
          state = 3;
          //state = D_hpicfBridgeMSTPortState_listening;
       else
@@ -11077,16 +12511,7 @@ mstpGetTcHistoryEntry(bool                   originated,
  **PROC-*****************************************************************/
 void mstp_updatePortOperEdgeState(MSTID_t mstid, LPORT_t lport, bool state)
 {
-   MSTP_TREE_MSG_t *m = mstp_findMstiPortStateChgMsg(mstid);
-
-   if(m == NULL)
-   {
-      m = calloc(1, sizeof(MSTP_TREE_MSG_t));
-      m->mstid        = mstid;
-      m->link.q_flink = NULL;
-      m->link.q_blink = NULL;
-      insqti_nodis(&MSTP_TREE_MSGS_QUEUE, &m->link);
-   }
+   MSTP_TREE_MSG_t *m = mstp_getMstiPortStateChgMsg(mstid);
    if (state == TRUE)
    {
       set_port(&m->portsSetEdge, lport);
@@ -11456,6 +12881,274 @@ bool intf_get_lport_speed_duplex(LPORT_t lport, SPEED_DPLX *sd)
     }
     return(FALSE);
 }
+
+/* NOTE: These  MSTP LAG IDs are only used for MSTP  state machine.
+ *       They are not necessarily the same as h/w LAG ID. */
+#define MSTP_LAG_ID_IN_USE   1
+#define VALID_MSTP_LAG_ID(x) ((x)>=mstp_min_lag_id && (x)<=mstp_max_lag_id)
+
+static const uint16_t mstp_min_lag_id = 1;
+static uint16_t mstp_max_lag_id = 0; // set in mstpd_init_lag_id_pool
+static uint16_t *mstp_lag_id_pool = NULL;
+/* Stack of the free LAG IDs, the next one to allocate on top. */
+static uint16_t *mstp_lag_id_free = NULL;
+static uint16_t mstp_lag_id_n_free = 0;
+
+void
+mstpd_init_lag_id_pool(uint16_t count)
+{
+    if (mstp_lag_id_pool == NULL) {
+        /* Track how many we're allocating. */
+        mstp_max_lag_id = count;
+
+        /* Allocate an extra one to skip LAG ID 0. */
+        mstp_lag_id_pool = (uint16_t *)xcalloc(count+1, sizeof(uint16_t));
+
+        /* Push in reverse, so the lowest IDs are handed out first. */
+        mstp_lag_id_free = (uint16_t *)xcalloc(count, sizeof(uint16_t));
+        for (mstp_lag_id_n_free = 0; mstp_lag_id_n_free < count;
+             mstp_lag_id_n_free++) {
+            mstp_lag_id_free[mstp_lag_id_n_free] =
+                mstp_max_lag_id - mstp_lag_id_n_free;
+        }
+        VLOG_DBG("mstpd: allocated %d LAG IDs", count);
+    }
+} /* mstpd_init_lag_id_pool */
+
+uint16_t
+mstpd_alloc_lag_id(void)
+{
+    if (mstp_lag_id_pool != NULL) {
+        uint16_t id;
+
+        if (mstp_lag_id_n_free > 0) {
+            /* Take the available LAG_ID on top of the free stack. */
+            id = mstp_lag_id_free[--mstp_lag_id_n_free];
+            mstp_lag_id_pool[id] = MSTP_LAG_ID_IN_USE;
+            return id;
+        }
+    } else {
+        VLOG_ERR("MSTP LAG ID pool not initialized!");
+    }
+
+    /* No free MSTP LAG ID available if we get here. */
+    return 0;
+
+} /* mstpd_alloc_lag_id */
+
+void
+mstpd_free_lag_id(uint16_t id)
+{
+    if ((mstp_lag_id_pool != NULL) && VALID_MSTP_LAG_ID(id)) {
+        if (mstp_lag_id_pool[id] == MSTP_LAG_ID_IN_USE) {
+            mstp_lag_id_pool[id] = 0;
+            mstp_lag_id_free[mstp_lag_id_n_free++] = id;
+        } else {
+            VLOG_ERR("Trying to free an unused MSTP LAGID (%d)!", id);
+        }
+    } else {
+        if (mstp_lag_id_pool == NULL) {
+            VLOG_ERR("Attempt to free MSTP LAG ID when"
+                     "pool is not initialized!");
+        } else {
+            VLOG_ERR("Attempt to free invalid MSTP LAG ID %d!", id);
+        }
+    }
+
+} /* mstpd_free_lag_id */
+
+/**PROC+**********************************************************************
+ * Name:      mstp_perfElapsedMsec
+ *
+ * Purpose:   Milliseconds elapsed since the given time stamp.
+ *
+ * Params:    start -> time stamp taken with gettimeofday()
+ *
+ * Returns:   elapsed time in msec
+ *
+ * Globals:   none
+ **PROC-**********************************************************************/
+uint32_t
+mstp_perfElapsedMsec(const struct timeval *start)
+{
+   struct timeval now;
+
+   STP_ASSERT(start);
+   gettimeofday(&now, NULL);
+   return (uint32_t)((now.tv_sec - start->tv_sec) * 1000 +
+                     (now.tv_usec - start->tv_usec) / 1000);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_perfElapsedUsec
+ *
+ * Purpose:   Microseconds elapsed since the given time stamp.
+ *
+ * Params:    start -> time stamp taken with gettimeofday()
+ *
+ * Returns:   elapsed time in usec
+ *
+ * Globals:   none
+ **PROC-**********************************************************************/
+uint32_t
+mstp_perfElapsedUsec(const struct timeval *start)
+{
+   struct timeval now;
+
+   STP_ASSERT(start);
+   gettimeofday(&now, NULL);
+   return (uint32_t)((now.tv_sec - start->tv_sec) * 1000000 +
+                     (now.tv_usec - start->tv_usec));
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_perfFirstBpduTx
+ *
+ * Purpose:   Record the time from daemon start to the first transmitted
+ *            BPDU. Called after every successful BPDU transmission, only
+ *            the first call has any effect.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ **PROC-**********************************************************************/
+void
+mstp_perfFirstBpduTx(void)
+{
+   if(mstp_perfStats.firstBpduTxDone)
+      return;
+
+   mstp_perfStats.firstBpduTxDone = TRUE;
+   mstp_perfStats.firstBpduTxMsec =
+      mstp_perfElapsedMsec(&mstp_perfStats.daemonStartTime);
+   VLOG_INFO("MSTP first BPDU transmitted %u msec after daemon start",
+             mstp_perfStats.firstBpduTxMsec);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_smEnter
+ *
+ * Purpose:   Register the start of a state machine invocation. The state
+ *            machines kick each other directly, so while processing one
+ *            event the same machine for the same tree and port can be
+ *            called again from within its own actions. For the per-port
+ *            PRT, PST and TCM machines such a nested call is not run, it
+ *            is merged into the invocation in progress, which then makes
+ *            one more pass once it has settled ('mstp_smRerun'). Every
+ *            machine is evaluated until none of its conditions holds, as
+ *            the standard requires, only without the redundant nesting.
+ *            PIM (called with a BPDU) and PRS (whose callers rely on the
+ *            roles being updated on return, except while 'mstp_holdPrs'
+ *            defers it to 'mstp_releasePrs') are never merged.
+ *            Nothing is merged while 'mstp_smMergeNested' is cleared.
+ *
+ * Params:    sm    -> state machine
+ *            mstid -> MST Instance Identifier (the CIST or an MSTI)
+ *            lport -> logical port number, 0 for per-tree machines
+ *
+ * Returns:   TRUE if the caller should run the machine and then call
+ *            'mstp_smLeave', FALSE if the call has been merged
+ *
+ * Globals:   mstp_perfStats, mstp_smMergeNested
+ *
+ * Constraints: protocol thread only
+ **PROC-**********************************************************************/
+bool
+mstp_smEnter(MSTP_SM_ID_t sm, MSTID_t mstid, LPORT_t lport)
+{
+   MSTP_SM_FRAME_t *frame;
+   uint32_t         i;
+   uint32_t         n;
+
+   n = (mstp_smDepth < MSTP_SM_FRAMES_MAX) ? mstp_smDepth : MSTP_SM_FRAMES_MAX;
+
+   if(mstp_smMergeNested && (sm != MSTP_SM_ID_PIM) && (sm != MSTP_SM_ID_PRS))
+   {
+      for(i = 0; i < n; i++)
+      {
+         frame = &mstp_smFrames[i];
+         if((frame->sm == sm) && (frame->mstid == mstid) &&
+            (frame->lport == lport))
+         {
+            frame->pending = TRUE;
+            mstp_perfStats.smMerged++;
+            return FALSE;
+         }
+      }
+   }
+
+   /* beyond the frame array nesting is still counted, just not merged */
+   if(mstp_smDepth < MSTP_SM_FRAMES_MAX)
+   {
+      frame = &mstp_smFrames[mstp_smDepth];
+      frame->sm      = sm;
+      frame->mstid   = mstid;
+      frame->lport   = lport;
+      frame->pending = FALSE;
+   }
+
+   mstp_smDepth++;
+   mstp_perfStats.smRuns++;
+   if(mstp_smDepth > mstp_perfStats.smMaxDepth)
+      mstp_perfStats.smMaxDepth = mstp_smDepth;
+
+   return TRUE;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_smRerun
+ *
+ * Purpose:   Check whether a nested call has been merged into the innermost
+ *            state machine invocation since it started its last pass.
+ *
+ * Params:    none
+ *
+ * Returns:   TRUE if the machine has to make one more pass
+ *
+ * Globals:   mstp_perfStats
+ *
+ * Constraints: called for an invocation 'mstp_smEnter' returned TRUE for
+ **PROC-**********************************************************************/
+bool
+mstp_smRerun(void)
+{
+   MSTP_SM_FRAME_t *frame;
+
+   STP_ASSERT(mstp_smDepth > 0);
+   if(mstp_smDepth > MSTP_SM_FRAMES_MAX)
+      return FALSE;
+
+   frame = &mstp_smFrames[mstp_smDepth - 1];
+   if(!frame->pending)
+      return FALSE;
+
+   frame->pending = FALSE;
+   mstp_perfStats.smReruns++;
+   return TRUE;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_smLeave
+ *
+ * Purpose:   Register the end of the innermost state machine invocation.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:
+ *
+ * Constraints: called for an invocation 'mstp_smEnter' returned TRUE for
+ **PROC-**********************************************************************/
+void
+mstp_smLeave(void)
+{
+   STP_ASSERT(mstp_smDepth > 0);
+   mstp_smDepth--;
+}
+
 int mstp_util_get_valid_l2_ports(const struct ovsrec_bridge *bridge_row) {
     int i = 0, port_count = 0;
 
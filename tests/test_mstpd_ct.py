@@ -16,6 +16,10 @@
 import os
 import sys
 import time
+import random
+import hmac
+import hashlib
+import struct
 import pytest
 import subprocess
 import json
@@ -23,6 +27,10 @@ from opsvsi.docker import *
 from opsvsi.opsvsitest import *
 
 
+# Key of the MST Configuration Digest (802.1Q 13.7)
+MSTP_DIGEST_KEY = '13AC06A62E47FD51F95D2BA243CD0346'
+
+
 class mstpdTests(OpsVsiTest):
 
     def setupNet(self):
@@ -75,6 +83,140 @@ class mstpdTests(OpsVsiTest):
         assert ('Vlans mapped:  1-4095' in output),\
             "Failed: mstpd_remove_vlan_from_cist"
 
+    def perf_stat(self, s1, name):
+        output = s1.cmd("ovs-appctl -t ops-stpd mstpd/daemon/perf_stats")
+        debug(output)
+        for line in output.splitlines():
+            if line.startswith(name):
+                return [int(v) for v in line.split(':')[1].split('/')]
+        assert False, "Failed: no '%s' in perf_stats" % name
+
+    def config_digest(self, s1):
+        output = s1.cmd("ovs-appctl -t ops-stpd mstpd/daemon/mstp_digest")
+        debug(output)
+        for line in output.splitlines():
+            if line.startswith('Digest Value:'):
+                return line.split('0x')[1].strip().upper()
+        assert False, "Failed: no digest in mstp_digest"
+
+    def expected_digest(self, vid_to_mstid):
+        # MST Configuration Table: VIDs 0 and 4095 carry 0, unmapped VIDs
+        # belong to the CIST
+        table = b''.join(struct.pack('>H', vid_to_mstid.get(vid, 0))
+                         for vid in range(4096))
+        key = bytearray.fromhex(MSTP_DIGEST_KEY)
+        return hmac.new(bytes(key), table, hashlib.md5).hexdigest().upper()
+
+    def db_vlan_count(self, s1, table):
+        output = s1.cmd("ovs-vsctl --columns=vlans list %s" % table)
+        debug(output)
+        count = 0
+        for line in output.splitlines():
+            if line.startswith('vlans'):
+                refs = line.split(':', 1)[1].strip().strip('[]').strip()
+                count += len(refs.split(',')) if refs else 0
+        return count
+
+    def mstpd_add_vlan_range_to_cist(self):
+        info('\n########## Test Adding vlan range to CIST ##########')
+        s1 = self.net.switches[0]
+        vids = range(100, 400)
+
+        s1.cmdCLI("configure terminal")
+        s1.cmdCLI("vlan 150")
+        s1.cmdCLI("exit")
+        s1.cmdCLI("spanning-tree instance 1 vlan 150")
+        s1.cmdCLI("end")
+        cist_vlans = self.db_vlan_count(s1, "mstp_common_instance")
+        msti_vlans = self.db_vlan_count(s1, "mstp_instance")
+        assert (msti_vlans == 1),\
+            "Failed: mstpd_add_vlan_range_to_cist VLAN 150 not in MSTI 1"
+
+        # Create the range in a single DB transaction, it has to reach the
+        # protocol thread as one add event carrying every new VLAN and
+        # land in the CIST row in one go. VLAN 150 is owned by MSTI 1.
+        add_events, add_vids = self.perf_stat(s1, 'VLAN add events')
+        s1.cmd("ovs-vsctl " + " -- ".join(
+            ["add-vlan bridge_normal %d" % vid for vid in vids
+             if vid != 150]))
+        time.sleep(2)
+        events, vlans = self.perf_stat(s1, 'VLAN add events')
+        assert (events - add_events == 1 and
+                vlans - add_vids == len(vids) - 1),\
+            "Failed: mstpd_add_vlan_range_to_cist add batching"
+        assert (self.db_vlan_count(s1, "mstp_common_instance") ==
+                cist_vlans + len(vids) - 1),\
+            "Failed: mstpd_add_vlan_range_to_cist CIST VLANs"
+        assert (self.db_vlan_count(s1, "mstp_instance") == 1),\
+            "Failed: mstpd_add_vlan_range_to_cist MSTI 1 VLANs"
+
+        # Delete the whole range, VLAN 150 included, in one transaction:
+        # one delete event, the CIST gets back to its previous VLANs and
+        # MSTI 1 loses its only VLAN.
+        del_events, del_vids = self.perf_stat(s1, 'VLAN delete events')
+        s1.cmd("ovs-vsctl " + " -- ".join(
+            ["del-vlan bridge_normal %d" % vid for vid in vids]))
+        time.sleep(2)
+        events, vlans = self.perf_stat(s1, 'VLAN delete events')
+        assert (events - del_events == 1 and
+                vlans - del_vids == len(vids)),\
+            "Failed: mstpd_add_vlan_range_to_cist delete batching"
+        assert (self.db_vlan_count(s1, "mstp_common_instance") ==
+                cist_vlans),\
+            "Failed: mstpd_add_vlan_range_to_cist CIST VLANs cleanup"
+        assert (self.db_vlan_count(s1, "mstp_instance") == 0),\
+            "Failed: mstpd_add_vlan_range_to_cist MSTI 1 VLANs cleanup"
+
+        s1.cmdCLI("configure terminal")
+        s1.cmdCLI("no spanning-tree instance 1")
+        s1.cmdCLI("end")
+
+    def mstpd_vid_to_mstid_random_mapping(self):
+        info('\n########## Test random VLAN to instance mapping ##########')
+        s1 = self.net.switches[0]
+        seed = int(time.time())
+        info('\n### Random seed: %d ###' % seed)
+        rnd = random.Random(seed)
+        vids = range(2, 42)
+
+        s1.cmdCLI("configure terminal")
+        for vid in vids:
+            s1.cmdCLI("vlan %d" % vid)
+            s1.cmdCLI("exit")
+        s1.cmdCLI("spanning-tree")
+
+        for rounds in range(3):
+            mapping = {}
+            for vid in rnd.sample(vids, 20):
+                mapping[vid] = rnd.randint(1, 4)
+            for vid, inst in mapping.items():
+                s1.cmdCLI("spanning-tree instance %d vlan %d" % (inst, vid))
+
+            # A VLAN already owned by an instance must be rejected
+            vid = rnd.choice(list(mapping.keys()))
+            other = mapping[vid] % 4 + 1
+            output = s1.cmdCLI("spanning-tree instance %d vlan %d" %
+                               (other, vid))
+            assert ('already mapped' in output),\
+                "Failed: mstpd_vid_to_mstid_random_mapping reject"
+
+            output = s1.cmd("ovs-appctl -t ops-stpd mstpd/daemon/mstp_digest")
+            debug(output)
+            assert ('VID to MSTID table mismatches: 0' in output),\
+                "Failed: mstpd_vid_to_mstid_random_mapping seed %d" % seed
+
+            for inst in set(mapping.values()):
+                s1.cmdCLI("no spanning-tree instance %d" % inst)
+
+        output = s1.cmd("ovs-appctl -t ops-stpd mstpd/daemon/mstp_digest")
+        debug(output)
+        assert ('VID to MSTID table mismatches: 0' in output),\
+            "Failed: mstpd_vid_to_mstid_random_mapping cleanup seed %d" % seed
+
+        for vid in vids:
+            s1.cmdCLI("no vlan %d" % vid)
+        s1.cmdCLI("end")
+
     def mstpd_add_ports_to_cist(self):
         info('\n########## Test Adding ports to CIST ##########')
         s1 = self.net.switches[0]
@@ -91,6 +233,154 @@ class mstpdTests(OpsVsiTest):
         assert ('1            Disabled       Blocking' in output),\
                 "Failed: mstpd_add_ports_to_cist"
 
+    def mstpd_add_port_range_to_cist(self):
+        info('\n########## Test Adding port range to CIST ##########')
+        s1 = self.net.switches[0]
+        ports = range(2, 6)
+
+        # Every port of the range goes through the bulk add, which has to
+        # stop cleanly once it has walked the whole port map.
+        add_events, add_ports = self.perf_stat(s1, 'L2 port add events')
+        s1.cmdCLI("configure terminal")
+        for port in ports:
+            s1.cmdCLI("interface %d" % port)
+            s1.cmdCLI("no routing")
+            s1.cmdCLI("exit")
+        s1.cmdCLI("end")
+        time.sleep(2)
+
+        assert (s1.cmd("pidof ops-stpd").strip() != ''),\
+            "Failed: mstpd_add_port_range_to_cist daemon died"
+        events, lports = self.perf_stat(s1, 'L2 port add events')
+        assert (events > add_events and
+                lports - add_ports == len(ports)),\
+            "Failed: mstpd_add_port_range_to_cist port add events"
+        output = s1.cmdCLI("show spanning-tree")
+        output += s1.cmd("echo")
+        debug(output)
+        for port in ports:
+            assert ('%-13d' % port in output),\
+                "Failed: mstpd_add_port_range_to_cist port %d" % port
+
+        s1.cmdCLI("configure terminal")
+        for port in ports:
+            s1.cmdCLI("interface %d" % port)
+            s1.cmdCLI("routing")
+            s1.cmdCLI("exit")
+        s1.cmdCLI("end")
+        assert (s1.cmd("pidof ops-stpd").strip() != ''),\
+            "Failed: mstpd_add_port_range_to_cist daemon died on removal"
+
+    def mstpd_resync_after_db_reconnect(self):
+        info('\n########## Test MSTP state across OVSDB reconnect ##########')
+        s1 = self.net.switches[0]
+
+        before = s1.cmdCLI("show spanning-tree")
+        before += s1.cmd("echo")
+        debug(before)
+
+        # Drop every OVSDB client session, mstpd has to reconnect and
+        # reconcile against the DB without re-running the protocol.
+        s1.cmd("ovs-appctl -t ovsdb-server ovsdb-server/reconnect")
+        time.sleep(5)
+
+        after = s1.cmdCLI("show spanning-tree")
+        after += s1.cmd("echo")
+        debug(after)
+
+        assert ('1            Disabled       Blocking' in after),\
+            "Failed: mstpd_resync_after_db_reconnect port state"
+        before_ports = [l for l in before.splitlines() if l.startswith('1 ')]
+        after_ports = [l for l in after.splitlines() if l.startswith('1 ')]
+        assert (before_ports == after_ports),\
+            "Failed: mstpd_resync_after_db_reconnect port changed state"
+
+        output = s1.cmd("ovs-appctl -t ops-stpd mstpd/daemon/perf_stats")
+        debug(output)
+        for line in output.splitlines():
+            if 'DB resyncs after reconnect' in line:
+                assert (int(line.split(':')[1]) >= 1),\
+                    "Failed: mstpd_resync_after_db_reconnect no resync"
+
+        # Swap VLANs between two instances while mstpd is disconnected,
+        # the row counts stay the same and only the content differs.
+        s1.cmdCLI("configure terminal")
+        for vid in [2, 3, 4, 5]:
+            s1.cmdCLI("vlan %d" % vid)
+            s1.cmdCLI("exit")
+        s1.cmdCLI("spanning-tree instance 1 vlan 2")
+        s1.cmdCLI("spanning-tree instance 1 vlan 3")
+        s1.cmdCLI("spanning-tree instance 2 vlan 4")
+        s1.cmdCLI("spanning-tree instance 2 vlan 5")
+        s1.cmdCLI("end")
+        digest = self.config_digest(s1)
+        expected = self.expected_digest({2: 1, 3: 1, 4: 2, 5: 2})
+        assert (digest == expected),\
+            "Failed: mstpd_resync_after_db_reconnect digest %s not %s"\
+            % (digest, expected)
+
+        pid = s1.cmd("pidof ops-stpd").strip()
+        s1.cmd("kill -STOP %s" % pid)
+        s1.cmd("ovs-appctl -t ovsdb-server ovsdb-server/reconnect")
+        s1.cmdCLI("configure terminal")
+        s1.cmdCLI("no spanning-tree instance 1 vlan 3")
+        s1.cmdCLI("no spanning-tree instance 2 vlan 5")
+        s1.cmdCLI("spanning-tree instance 1 vlan 5")
+        s1.cmdCLI("spanning-tree instance 2 vlan 3")
+        s1.cmdCLI("end")
+        s1.cmd("kill -CONT %s" % pid)
+        time.sleep(5)
+
+        digest = self.config_digest(s1)
+        expected = self.expected_digest({2: 1, 5: 1, 4: 2, 3: 2})
+        assert (digest == expected),\
+            "Failed: mstpd_resync_after_db_reconnect change made while "\
+            "disconnected not applied, digest %s not %s" % (digest, expected)
+
+        s1.cmdCLI("configure terminal")
+        s1.cmdCLI("no spanning-tree instance 1")
+        s1.cmdCLI("no spanning-tree instance 2")
+        for vid in [2, 3, 4, 5]:
+            s1.cmdCLI("no vlan %d" % vid)
+        s1.cmdCLI("end")
+
+    def mstpd_config_digest_known_answers(self):
+        info('\n########## Test MD5 and MST config digest values ##########')
+        s1 = self.net.switches[0]
+
+        # All VLANs mapped to the CIST
+        digest = self.config_digest(s1)
+        assert (digest == 'AC36177F50283CD4B83821D8AB26DE62'),\
+            "Failed: mstpd_config_digest_known_answers CIST digest %s"\
+            % digest
+
+        s1.cmdCLI("configure terminal")
+        for vid in [2, 3, 4]:
+            s1.cmdCLI("vlan %d" % vid)
+            s1.cmdCLI("exit")
+        s1.cmdCLI("spanning-tree instance 1 vlan 2")
+        s1.cmdCLI("spanning-tree instance 1 vlan 3")
+        s1.cmdCLI("spanning-tree instance 2 vlan 4")
+        s1.cmdCLI("end")
+
+        digest = self.config_digest(s1)
+        expected = self.expected_digest({2: 1, 3: 1, 4: 2})
+        assert (digest == expected),\
+            "Failed: mstpd_config_digest_known_answers digest %s not %s"\
+            % (digest, expected)
+
+        s1.cmdCLI("configure terminal")
+        s1.cmdCLI("no spanning-tree instance 1")
+        s1.cmdCLI("no spanning-tree instance 2")
+        for vid in [2, 3, 4]:
+            s1.cmdCLI("no vlan %d" % vid)
+        s1.cmdCLI("end")
+
+        digest = self.config_digest(s1)
+        assert (digest == 'AC36177F50283CD4B83821D8AB26DE62'),\
+            "Failed: mstpd_config_digest_known_answers cleanup digest %s"\
+            % digest
+
     def mstpd_remove_ports_from_cist(self):
         info('\n########## Test Removing ports from CIST ##########')
         s1 = self.net.switches[0]
@@ -142,10 +432,30 @@ class Test_mstpd:
     def test_mstpd_remove_vlan_from_cist_commands(self):
         self.test.mstpd_remove_vlan_from_cist()
 
+    # mstpd add vlan range to cist.
+    def test_mstpd_add_vlan_range_to_cist_commands(self):
+        self.test.mstpd_add_vlan_range_to_cist()
+
+    # mstpd VLAN to instance lookup stays consistent.
+    def test_mstpd_vid_to_mstid_random_mapping_commands(self):
+        self.test.mstpd_vid_to_mstid_random_mapping()
+
     # mstpd add ports to cist.
     def test_mstpd_add_ports_to_cist_commands(self):
         self.test.mstpd_add_ports_to_cist()
 
+    # mstpd add several ports to cist and keep running.
+    def test_mstpd_add_port_range_to_cist_commands(self):
+        self.test.mstpd_add_port_range_to_cist()
+
+    # mstpd keeps port states across an OVSDB reconnect.
+    def test_mstpd_resync_after_db_reconnect_commands(self):
+        self.test.mstpd_resync_after_db_reconnect()
+
+    # mstpd MD5 and config digest match their known values.
+    def test_mstpd_config_digest_known_answers_commands(self):
+        self.test.mstpd_config_digest_known_answers()
+
     # mstpd remove ports from cist.
     def test_mstpd_remove_ports_from_cist_commands(self):
         self.test.mstpd_remove_ports_from_cist()
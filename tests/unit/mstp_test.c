@@ -0,0 +1,77 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : mstp_test.c
+ *    Description        : MSTP unit tests common routines
+ **********************************************************************************/
+#include "mstp_test.h"
+
+/* number of failed checks of the running test */
+uint32_t mstp_testFailures;
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testRand
+ *
+ * Purpose:   Small xorshift pseudo random generator, so that every run of
+ *            a test goes through the same inputs.
+ *
+ * Params:    seed -> generator state, updated on return (must not be 0)
+ *
+ * Returns:   next pseudo random value
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+uint32_t
+mstp_testRand(uint32_t *seed)
+{
+   uint32_t x = *seed;
+
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   *seed = x;
+
+   return x;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testResult
+ *
+ * Purpose:   Report the outcome of a test.
+ *
+ * Params:    name -> test name
+ *
+ * Returns:   exit status of the test program: 0 if no check failed
+ *
+ * Globals:   mstp_testFailures
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+mstp_testResult(const char *name)
+{
+   if(mstp_testFailures)
+   {
+      printf("%s: %u checks failed\n", name, mstp_testFailures);
+      return 1;
+   }
+
+   printf("%s: passed\n", name);
+   return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : mstp_test.h
+ *    Description        : MSTP unit tests common definitions
+ **********************************************************************************/
+#ifndef __MSTP_TEST_H__
+#define __MSTP_TEST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*---------------------------------------------------------------------------
+ * Count a failed check and report where it is, the test goes on
+ *---------------------------------------------------------------------------*/
+#define MSTP_TEST_CHECK(cond)                                                \
+   do {                                                                      \
+      if(!(cond))                                                            \
+      {                                                                      \
+         fprintf(stderr, "%s:%d: check failed: %s\n",                        \
+                 __FILE__, __LINE__, #cond);                                 \
+         mstp_testFailures++;                                                \
+      }                                                                      \
+   } while(0)
+
+extern uint32_t mstp_testFailures;
+
+uint32_t mstp_testRand(uint32_t *seed);
+int      mstp_testResult(const char *name);
+
+#endif /* __MSTP_TEST_H__ */
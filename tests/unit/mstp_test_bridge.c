@@ -0,0 +1,350 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : mstp_test_bridge.c
+ *    Description        : MSTP unit tests Bridge harness. The Bridge is brought
+ *                         up with the same events the OVSDB interface sends,
+ *                         but for the ones that would open packet sockets:
+ *                         each port gets a socket pair instead, the engine
+ *                         transmits on one end, the test reads the other.
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_inlines.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+#include "mstp_test_bridge.h"
+
+/* test end of the socket pair of each port */
+static int mstp_testPeerFd[MAX_LPORTS + 1];
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testEvent
+ *
+ * Purpose:   Run the protocol for one event, as the protocol thread does
+ *            for the events the OVSDB interface queues.
+ *
+ * Params:    type -> event type
+ *            msg  -> event data, still owned by the caller
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_testEvent(int type, void *msg)
+{
+   mstpd_message event;
+
+   memset(&event, 0, sizeof(event));
+   event.msg_type = type;
+   event.msg = msg;
+   mstpd_process_event(&event);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBridgeInit
+ *
+ * Purpose:   Initialize the Bridge with the default global and CIST
+ *            configuration, MSTP still disabled.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints: called once, before any other harness routine
+ **PROC-**********************************************************************/
+void
+mstp_testBridgeInit(void)
+{
+   mstp_global_config global;
+   mstp_cist_config   cist;
+
+   mstp_Bridge.ForceVersion = MSTP_PROTOCOL_VERSION_ID_MST;
+   mstpInitialInit();
+
+   memset(&global, 0, sizeof(global));
+   strncpy(global.config_name, "unit-test", sizeof(global.config_name) - 1);
+   global.flap_penalty = DEF_FLAP_PENALTY;
+   global.flap_suppress = DEF_FLAP_SUPPRESS;
+   global.flap_reuse = DEF_FLAP_REUSE;
+   global.flap_half_life = DEF_FLAP_HALF_LIFE;
+   mstp_testEvent(e_mstpd_global_config, &global);
+
+   memset(&cist, 0, sizeof(cist));
+   cist.priority = DEF_BRIDGE_PRIORITY;
+   cist.hello_time = DEF_HELLO_TIME;
+   cist.forward_delay = DEF_FORWARD_DELAY;
+   cist.max_age = DEF_MAX_AGE;
+   cist.max_hop_count = DEF_MAX_HOPS;
+   cist.tx_hold_count = DEF_HOLD_COUNT;
+   mstp_testEvent(e_mstpd_cist_config, &cist);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testMstiAdd
+ *
+ * Purpose:   Create an MSTI carrying one VID, with the default priority.
+ *
+ * Params:    mstid -> MST Instance Identifier
+ *            vid   -> VLAN mapped to it
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints: the ports are added first, as the daemon does
+ **PROC-**********************************************************************/
+void
+mstp_testMstiAdd(MSTID_t mstid, VID_t vid)
+{
+   mstp_msti_config msti;
+
+   memset(&msti, 0, sizeof(msti));
+   msti.mstid = mstid;
+   msti.n_vlans = 1;
+   set_vid(&msti.vlans, vid);
+   msti.priority = DEF_BRIDGE_PRIORITY;
+   mstp_testEvent(e_mstpd_msti_config, &msti);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testPortAdd
+ *
+ * Purpose:   Add a full duplex port that is up. Its BPDUs are sent on a
+ *            datagram socket pair, 'mstp_testBpduTx' reads them.
+ *
+ * Params:    lport -> logical port number
+ *            speed -> port speed (SPEED_xxx)
+ *
+ * Returns:   none
+ *
+ * Globals:   idp_lookup, l2ports
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_testPortAdd(LPORT_t lport, uint32_t speed)
+{
+   struct iface_data *idp;
+   int                fds[2];
+   int                rc;
+
+   idp = calloc(1, sizeof(*idp));
+   STP_ASSERT(idp);
+   idp->name = malloc(PORTNAME_LEN);
+   idp->mac_in_use = malloc(MSTP_MAC_STR_LEN);
+   STP_ASSERT(idp->name && idp->mac_in_use);
+   snprintf(idp->name, PORTNAME_LEN, "%u", lport);
+   snprintf(idp->mac_in_use, MSTP_MAC_STR_LEN, "00:00:00:00:02:%02x", lport);
+   idp->lport_id = lport;
+   idp->link_speed = speed;
+   idp->duplex = FULL_DUPLEX;
+   idp->link_state = INTERFACE_LINK_STATE_UP;
+
+   rc = socketpair(AF_UNIX, SOCK_DGRAM, 0, fds);
+   STP_ASSERT(rc == 0);
+   fcntl(fds[1], F_SETFL, O_NONBLOCK);
+   idp->pdu_sockfd = fds[0];
+   idp->pdu_registered = TRUE;
+   mstp_testPeerFd[lport] = fds[1];
+
+   idp_lookup[lport] = idp;
+   set_port(&l2ports, lport);
+   update_mstp_on_lport_add(lport);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBridgeEnable
+ *
+ * Purpose:   Enable MSTP, as the admin status event does once the ports
+ *            are registered for BPDUs.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_testBridgeEnable(void)
+{
+   mstp_adminStatusUpdate(TRUE);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testTick
+ *
+ * Purpose:   Let time go by, one timer event per second.
+ *
+ * Params:    ticks -> number of seconds
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_testTick(int ticks)
+{
+   while(ticks-- > 0)
+      mstp_testEvent(e_mstpd_timer, NULL);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBpduBuild
+ *
+ * Purpose:   Build the MST BPDU a neighbor in our Region sends to the port:
+ *            it is the CIST Root and the Regional Root of every MSTI, with
+ *            a better priority than ours, and its port is Designated and
+ *            forwarding on all of them.
+ *
+ * Params:    pkt   -> packet buffer to fill
+ *            lport -> port the BPDU is received on
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints: MSTP is enabled (the Configuration Digest is built)
+ **PROC-**********************************************************************/
+void
+mstp_testBpduBuild(MSTP_RX_PDU *pkt, LPORT_t lport)
+{
+   static const MAC_ADDRESS peer = {0x00, 0x00, 0x00, 0x00, 0x03, 0x00};
+   MSTP_MST_BPDU_t         *bpdu = (MSTP_MST_BPDU_t *)pkt->data;
+   MSTP_MSTI_CONFIG_MSG_t  *msg;
+   uint16_t                 v3Len = 64;
+   uint16_t                 len;
+   MSTID_t                  mstid;
+
+   memset(pkt, 0, sizeof(*pkt));
+   pkt->lport = lport;
+
+   MAC_ADDR_COPY(stp_multicast, bpdu->lsapHdr.dst);
+   MAC_ADDR_COPY(peer, bpdu->lsapHdr.src);
+   bpdu->lsapHdr.dsap = 0x42;
+   bpdu->lsapHdr.ssap = 0x42;
+   bpdu->lsapHdr.ctrl = MSTP_LSAP_HDR_CTRL_VAL;
+
+   bpdu->protocolId = MSTP_STP_RST_MST_PROTOCOL_ID;
+   bpdu->protocolVersionId = MSTP_PROTOCOL_VERSION_ID_MST;
+   bpdu->bpduType = MSTP_BPDU_TYPE_MST;
+   bpdu->cistFlags = MSTP_BPDU_ROLE_DESIGNATED | MSTP_CIST_FLAG_LEARNING |
+                     MSTP_CIST_FLAG_FORWADING;
+
+   storeShortInPacket(&bpdu->cistRootId.priority, MSTP_TEST_PEER_PRIORITY);
+   MAC_ADDR_COPY(peer, bpdu->cistRootId.mac_address);
+   bpdu->cistRgnRootId = bpdu->cistRootId;
+   bpdu->cistBridgeId = bpdu->cistRootId;
+   storeShortInPacket(&bpdu->cistPortId, 0x8001);
+
+   storeShortInPacket(&bpdu->maxAge, mstp_Bridge.MaxAge << 8);
+   storeShortInPacket(&bpdu->helloTime, mstp_Bridge.HelloTime << 8);
+   storeShortInPacket(&bpdu->fwdDelay, mstp_Bridge.FwdDelay << 8);
+
+   bpdu->mstConfigurationId = mstp_Bridge.MstConfigId;
+   storeShortInPacket(&bpdu->mstConfigurationId.revisionLevel,
+                      mstp_Bridge.MstConfigId.revisionLevel);
+   bpdu->cistRemainingHops = mstp_Bridge.MaxHops;
+
+   msg = (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+   for(mstid = MSTP_MSTID_MIN; mstid <= MSTP_MSTID_MAX; mstid++)
+   {
+      if(!MSTP_MSTI_VALID(mstid))
+         continue;
+
+      storeShortInPacket(&msg->mstiRgnRootId.priority,
+                         MSTP_TEST_PEER_PRIORITY | mstid);
+      MAC_ADDR_COPY(peer, msg->mstiRgnRootId.mac_address);
+      msg->mstiFlags = MSTP_BPDU_ROLE_DESIGNATED | MSTP_MSTI_FLAG_LEARNING |
+                       MSTP_MSTI_FLAG_FORWADING;
+      msg->mstiBridgePriority = (MSTP_TEST_PEER_PRIORITY / 4096) << 4;
+      msg->mstiPortPriority = 0x80;
+      msg->mstiRemainingHops = mstp_Bridge.MaxHops;
+      msg++;
+      v3Len += sizeof(MSTP_MSTI_CONFIG_MSG_t);
+   }
+   storeShortInPacket(&bpdu->version3Length, v3Len);
+
+   len = SNAP + MSTP_RST_BPDU_LEN_MIN + sizeof(bpdu->version3Length) + v3Len;
+   storeShortInPacket(&bpdu->lsapHdr.len, len);
+   pkt->pktLen = ENET_HDR_SIZ + len;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBpduRx
+ *
+ * Purpose:   Receive a BPDU, as the receive thread queues it.
+ *
+ * Params:    pkt -> packet buffer with the BPDU, its port set
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+void
+mstp_testBpduRx(MSTP_RX_PDU *pkt)
+{
+   mstp_testEvent(e_mstpd_rx_bpdu, pkt);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBpduTx
+ *
+ * Purpose:   Read the BPDUs transmitted on the port so far, keep the last.
+ *
+ * Params:    lport -> logical port number
+ *            buf   -> buffer for the last BPDU
+ *            size  -> buffer size
+ *
+ * Returns:   length of the last BPDU, 0 if none was transmitted
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+mstp_testBpduTx(LPORT_t lport, uint8_t *buf, size_t size)
+{
+   uint8_t frame[MAX_MSTP_BPDU_PKT_SIZE];
+   ssize_t n;
+   int     len = 0;
+
+   while((n = recv(mstp_testPeerFd[lport], frame, sizeof(frame), 0)) > 0)
+   {
+      len = (n < (ssize_t)size) ? n : (ssize_t)size;
+      memcpy(buf, frame, len);
+   }
+
+   return len;
+}
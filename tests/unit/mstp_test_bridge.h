@@ -0,0 +1,42 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : mstp_test_bridge.h
+ *    Description        : MSTP unit tests Bridge harness: runs the protocol
+ *                         engine on ports whose BPDUs go through socket
+ *                         pairs, without the OVSDB interface
+ **********************************************************************************/
+#ifndef __MSTP_TEST_BRIDGE_H__
+#define __MSTP_TEST_BRIDGE_H__
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_recv.h"
+
+/* Bridge priority of the neighbor built BPDUs come from, better than ours */
+#define MSTP_TEST_PEER_PRIORITY  4096
+
+void    mstp_testBridgeInit(void);
+void    mstp_testMstiAdd(MSTID_t mstid, VID_t vid);
+void    mstp_testPortAdd(LPORT_t lport, uint32_t speed);
+void    mstp_testBridgeEnable(void);
+void    mstp_testTick(int ticks);
+void    mstp_testEvent(int type, void *msg);
+void    mstp_testBpduBuild(MSTP_RX_PDU *pkt, LPORT_t lport);
+void    mstp_testBpduRx(MSTP_RX_PDU *pkt);
+int     mstp_testBpduTx(LPORT_t lport, uint8_t *buf, size_t size);
+
+#endif /* __MSTP_TEST_BRIDGE_H__ */
@@ -0,0 +1,181 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : mstp_test_stubs.c
+ *    Description        : Stand-ins for the OVSDB interface of the MSTP daemon,
+ *                         so that the protocol engine can be unit tested
+ *                         without a database. Nothing is written back, the
+ *                         interfaces are the ones of 'idp_lookup'.
+ **********************************************************************************/
+#include <stdio.h>
+#include <pthread.h>
+#include <string.h>
+#include <vswitch-idl.h>
+#include <ovsdb-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_fsm.h"
+
+pthread_mutex_t ovsdb_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* system MAC address the Bridge Identifiers are built from */
+char mstp_testSystemMac[MSTP_MAC_STR_LEN] = "00:00:00:00:01:00";
+
+struct iface_data *
+find_iface_data_by_index(int index)
+{
+   return idp_lookup[index];
+}
+
+struct iface_data *
+find_iface_data_by_name(char *name)
+{
+   int i;
+
+   for(i = 1; i <= MAX_ENTRIES_IN_POOL; i++)
+   {
+      if(idp_lookup[i] && (strcmp(idp_lookup[i]->name, name) == 0))
+         return idp_lookup[i];
+   }
+   return NULL;
+}
+
+const char *
+intf_get_mac_addr(uint16_t lport)
+{
+   struct iface_data *idp = find_iface_data_by_index(lport);
+
+   return (idp) ? idp->mac_in_use : NULL;
+}
+
+void
+system_get_mac_addr(const char *mac_buffer)
+{
+   memcpy((void *)mac_buffer, mstp_testSystemMac, MSTP_MAC_STR_LEN - 1);
+}
+
+bool
+is_lport_down(int lport)
+{
+   struct iface_data *idp = find_iface_data_by_index(lport);
+
+   return (idp == NULL) || (idp->link_state != INTERFACE_LINK_STATE_UP);
+}
+
+void
+mstp_convertPortRoleEnumToString(MSTP_PORT_ROLE_t role, char *string)
+{
+   snprintf(string, 20, "%d", (int)role);
+}
+
+bool
+mstpd_is_valid_port_row(const struct ovsrec_port *prow)
+{
+   return FALSE;
+}
+
+void add_port_entries_in_mstp_instances(const PORT_MAP *lports) {}
+void disable_logical_port(int lport) {}
+void enable_logical_port(int lport) {}
+void enable_or_disable_port(int lport, bool enable) {}
+void handle_vlan_add_in_mstp_config(const VID_MAP *vids) {}
+void handle_vlan_delete_in_mstp_config(const VID_MAP *vids) {}
+void mstp_config_reinit() {}
+void mstp_util_cist_flush_mac_address(const char *port_name) {}
+void mstp_util_msti_flush_mac_address(int mstid, int lport) {}
+void mstp_util_set_cist_table_value(const char *key, int64_t value) {}
+void mstp_util_set_cist_table_string(const char *key, const char *string) {}
+void mstp_util_set_cist_port_table_value(const char *if_name,
+                                         const char *key, int64_t value) {}
+void mstp_util_set_cist_port_table_string(const char *if_name,
+                                          const char *key, char *string) {}
+void mstp_util_set_msti_table_string(const char *key, const char *string,
+                                     int mstid) {}
+void mstp_util_set_msti_table_value(const char *key, int64_t value,
+                                    int mstid) {}
+void mstp_util_set_msti_port_table_value(const char *key, int64_t value,
+                                         int mstid, int lport) {}
+void mstp_util_set_msti_port_table_string(const char *key, char *string,
+                                          int mstid, int lport) {}
+void update_mstp_counters(LPORT_t lport, const char *key) {}
+void update_port_entry_in_cist_mstp_instances(char *name, int operation) {}
+void update_port_entry_in_msti_mstp_instances(char *name, int operation) {}
+
+/*---------------------------------------------------------------------------
+ * The engine writes some port states straight to the database, there is
+ * no database: no row is ever found and the transactions do nothing. A
+ * transaction is still handed out, the engine treats NULL as a failure.
+ *---------------------------------------------------------------------------*/
+static char mstp_testTxn;
+
+struct ovsdb_idl_txn *
+ovsdb_idl_txn_create(struct ovsdb_idl *idl_)
+{
+   return (struct ovsdb_idl_txn *)&mstp_testTxn;
+}
+
+enum ovsdb_idl_txn_status
+ovsdb_idl_txn_commit_block(struct ovsdb_idl_txn *txn)
+{
+   return TXN_UNCHANGED;
+}
+
+void ovsdb_idl_txn_destroy(struct ovsdb_idl_txn *txn) {}
+
+const struct ovsrec_bridge *
+ovsrec_bridge_first(const struct ovsdb_idl *idl_)
+{
+   return NULL;
+}
+
+void ovsrec_bridge_set_status(const struct ovsrec_bridge *row,
+                              const struct smap *status) {}
+
+const struct ovsrec_port *
+ovsrec_port_first(const struct ovsdb_idl *idl_)
+{
+   return NULL;
+}
+
+const struct ovsrec_port *
+ovsrec_port_next(const struct ovsrec_port *row)
+{
+   return NULL;
+}
+
+void ovsrec_port_set_hw_config(const struct ovsrec_port *row,
+                               const struct smap *hw_config) {}
+
+const struct ovsrec_mstp_common_instance_port *
+ovsrec_mstp_common_instance_port_first(const struct ovsdb_idl *idl_)
+{
+   return NULL;
+}
+
+const struct ovsrec_mstp_common_instance_port *
+ovsrec_mstp_common_instance_port_next(
+                           const struct ovsrec_mstp_common_instance_port *row)
+{
+   return NULL;
+}
+
+void ovsrec_mstp_common_instance_port_set_port_state(
+                           const struct ovsrec_mstp_common_instance_port *row,
+                           const char *port_state) {}
+void ovsrec_mstp_instance_port_set_port_state(
+                           const struct ovsrec_mstp_instance_port *row,
+                           const char *port_state) {}
@@ -0,0 +1,316 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_bitmap.c
+ *    Description        : Word parallel bitmap helpers of mstpd_inlines.c
+ *                         against word at a time versions of them
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "mstp_inlines.h"
+#include "mstp_test.h"
+
+/*---------------------------------------------------------------------------
+ * Operations checked against their word at a time versions
+ *---------------------------------------------------------------------------*/
+typedef enum
+{
+   MSTP_BM_CHECK_OR,
+   MSTP_BM_CHECK_AND,
+   MSTP_BM_CHECK_XOR,
+   MSTP_BM_CHECK_SUB,
+   MSTP_BM_CHECK_OPS
+} MSTP_BM_CHECK_OP_t;
+
+/* bitmap sizes always checked, the rest are picked at random */
+static const uint32_t mstp_bmCheckSizes[] =
+{
+   33, 63, 64, 65, 127, 128, 129, 511, 512, 513, 4095, 4096
+};
+
+#define MSTP_BM_CHECK_WORDS         132  /* 4160 bits and a spare word */
+#define MSTP_BM_CHECK_ROUNDS        1000
+
+/**PROC+**********************************************************************
+ * Name:      mstp_bmRefFindNext
+ *
+ * Purpose:   Reference 'findNextBitSet': one 32-bit word at a time.
+ *
+ * Params:    map     -> bitmap
+ *            prevBit -> 1-based bit to search after (0 to search from start)
+ *            maxBits -> size of the bitmap
+ *
+ * Returns:   1-based number of the next bit set, -1 if there is none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static int
+mstp_bmRefFindNext(const uint32_t *map, uint32_t prevBit, uint32_t maxBits)
+{
+   uint32_t word = prevBit >> 5;
+   uint32_t mask = ~(1u << (prevBit - (word << 5))) + 1u;
+   uint32_t i;
+   uint32_t lsb;
+
+   map += word;
+   for(i = word * 32; i < maxBits; i += 32)
+   {
+      mask &= *map;
+      if(mask)
+      {
+         lsb = __builtin_ctz(mask) + 1;
+         return ((i + lsb) > maxBits) ? -1 : (int)(i + lsb);
+      }
+      map++;
+      mask = ~0u;
+   }
+
+   return -1;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_bmRefBulkOp
+ *
+ * Purpose:   Reference OR/AND/XOR/SUB of two bitmaps: one 32-bit word at a
+ *            time, with the bits past 'maxBits' cleared in the final word.
+ *
+ * Params:    fromMap -> source bitmap
+ *            toMap   -> destination bitmap
+ *            maxBits -> size of the bitmaps
+ *            op      -> operation
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_bmRefBulkOp(const uint32_t *fromMap, uint32_t *toMap, uint32_t maxBits,
+                 MSTP_BM_CHECK_OP_t op)
+{
+   uint32_t i;
+
+   for(i = 0; i < (maxBits + 31) / 32; i++)
+   {
+      switch(op)
+      {
+         case MSTP_BM_CHECK_OR:  toMap[i] |= fromMap[i];  break;
+         case MSTP_BM_CHECK_AND: toMap[i] &= fromMap[i];  break;
+         case MSTP_BM_CHECK_XOR: toMap[i] ^= fromMap[i];  break;
+         default:                toMap[i] &= ~fromMap[i]; break;
+      }
+   }
+   if(maxBits % 32)
+      toMap[maxBits / 32] &= ~(-(1u << (maxBits % 32)));
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_bmCheckFill
+ *
+ * Purpose:   Fill a bitmap for the bitmap helpers check. The density is
+ *            picked at random: empty, a single bit, sparse, half or dense.
+ *
+ * Params:    map  -> bitmap, MSTP_BM_CHECK_WORDS long
+ *            seed -> test generator state
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_bmCheckFill(uint32_t *map, uint32_t *seed)
+{
+   uint32_t density = mstp_testRand(seed) % 5;
+   uint32_t r;
+   int      i;
+
+   memset(map, 0, MSTP_BM_CHECK_WORDS * sizeof(uint32_t));
+   if(density == 1)
+   {
+      r = mstp_testRand(seed) % (MSTP_BM_CHECK_WORDS * 32);
+      map[r / 32] = 1u << (r % 32);
+      return;
+   }
+   for(i = 0; density && (i < MSTP_BM_CHECK_WORDS); i++)
+   {
+      r = mstp_testRand(seed);
+      if(density == 2)
+      {  /* a few bits in a few words */
+         if((r & 0x7) == 0)
+            r = mstp_testRand(seed) & mstp_testRand(seed) &
+                mstp_testRand(seed);
+         else
+            r = 0;
+      }
+      else
+      if(density == 4)
+         r |= mstp_testRand(seed);
+      map[i] = r;
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Cross-check the word parallel multi-word bitmap helpers that
+ *            back PORT_MAP and VID_MAP against word at a time versions of
+ *            them: find first/next (a full walk of the map), OR, AND, XOR,
+ *            SUB, overlap, any bit set, count and equal. The maps are
+ *            random, with random density and size, and start either on
+ *            an even or on an odd 32-bit word. The sizes that matter most
+ *            (PORT_MAP, VID_MAP, around word and vector boundaries) are
+ *            always part of the mix.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every result is the same as the reference one
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(int argc, char *argv[])
+{
+   static uint32_t    buf1[MSTP_BM_CHECK_WORDS + 1];
+   static uint32_t    buf2[MSTP_BM_CHECK_WORDS + 1];
+   static uint32_t    res[MSTP_BM_CHECK_WORDS + 1];
+   static uint32_t    ref[MSTP_BM_CHECK_WORDS + 1];
+   uint32_t           seed = 0x6C8E9CF5;
+   uint32_t           checked = 0;
+   uint32_t           round;
+   uint32_t           maxBits;
+   uint32_t           words;
+   uint32_t           refCount;
+   uint32_t           i;
+   uint32_t           off;
+   uint32_t          *map1;
+   uint32_t          *map2;
+   int                bit;
+   int                refBit;
+   bool               refAny;
+   MSTP_BM_CHECK_OP_t op;
+   const uint32_t     numSizes = sizeof(mstp_bmCheckSizes) /
+                                 sizeof(mstp_bmCheckSizes[0]);
+
+   for(round = 0; round < MSTP_BM_CHECK_ROUNDS; round++)
+   {
+      if(round < numSizes)
+         maxBits = mstp_bmCheckSizes[round];
+      else
+         maxBits = 33 + mstp_testRand(&seed) % (4160 - 33 + 1);
+      words = (maxBits + 31) / 32;
+
+      off  = mstp_testRand(&seed) & 1;
+      map1 = buf1 + off;
+      map2 = buf2 + off;
+      mstp_bmCheckFill(map1, &seed);
+      if(mstp_testRand(&seed) & 1)
+         mstp_bmCheckFill(map2, &seed);
+      else
+      {  /* a copy, with maybe one bit changed */
+         memcpy(map2, map1, MSTP_BM_CHECK_WORDS * sizeof(uint32_t));
+         i = mstp_testRand(&seed) % (words * 32 + 1);
+         if(i < words * 32)
+            map2[i / 32] ^= 1u << (i % 32);
+      }
+
+      /*---------------------------------------------------------------------
+       * walk the map
+       *---------------------------------------------------------------------*/
+      bit    = findFirstBitSet(map1, maxBits);
+      refBit = mstp_bmRefFindNext(map1, 0, maxBits);
+      while(1)
+      {
+         checked++;
+         MSTP_TEST_CHECK(bit == refBit);
+         if((bit != refBit) || (bit < 0))
+            break;
+         bit    = findNextBitSet(map1, (uint32_t)bit, maxBits);
+         refBit = mstp_bmRefFindNext(map1, (uint32_t)refBit, maxBits);
+      }
+
+      /*---------------------------------------------------------------------
+       * OR, AND, XOR and SUB, the words past the map must be left alone
+       *---------------------------------------------------------------------*/
+      for(op = MSTP_BM_CHECK_OR; op < MSTP_BM_CHECK_OPS; op++)
+      {
+         memcpy(res + off, map2, MSTP_BM_CHECK_WORDS * sizeof(uint32_t));
+         memcpy(ref + off, map2, MSTP_BM_CHECK_WORDS * sizeof(uint32_t));
+         switch(op)
+         {
+            case MSTP_BM_CHECK_OR:
+               bitOrBitmaps(map1, res + off, maxBits);
+               break;
+            case MSTP_BM_CHECK_AND:
+               bitAndBitmaps(map1, res + off, maxBits);
+               break;
+            case MSTP_BM_CHECK_XOR:
+               bitXorBitmaps(map1, res + off, maxBits);
+               break;
+            default:
+               bitSubBitmaps(map1, res + off, maxBits);
+               break;
+         }
+         mstp_bmRefBulkOp(map1, ref + off, maxBits, op);
+         MSTP_TEST_CHECK(memcmp(res + off, ref + off,
+                                MSTP_BM_CHECK_WORDS * sizeof(uint32_t)) == 0);
+         checked++;
+      }
+
+      /*---------------------------------------------------------------------
+       * overlap, any bit set, count and equal
+       *---------------------------------------------------------------------*/
+      memcpy(ref, map1, words * sizeof(uint32_t));
+      mstp_bmRefBulkOp(map2, ref, maxBits, MSTP_BM_CHECK_AND);
+      refAny = false;
+      for(i = 0; i < words; i++)
+         refAny = refAny || (ref[i] != 0);
+      MSTP_TEST_CHECK(bitmapsOverlap(map1, map2, maxBits) == refAny);
+
+      refAny = false;
+      refCount = 0;
+      for(i = 0; i < words; i++)
+      {
+         uint32_t w = map1[i];
+
+         refAny = refAny || (w != 0);
+         for(; w; w &= w - 1)
+            refCount++;
+      }
+      MSTP_TEST_CHECK(areAnyBitsSetInBitmap(map1, maxBits) == refAny);
+      MSTP_TEST_CHECK(getNumOfBitsSetInBitmap(map1, maxBits) == refCount);
+
+      refAny = true;
+      for(i = 0; i < words; i++)
+         refAny = refAny && (map1[i] == map2[i]);
+      MSTP_TEST_CHECK(areBitmapsEqual(map1, map2, maxBits) == refAny);
+
+      checked += 4;
+   }
+
+   printf("%u bitmap operation results\n", checked);
+
+   return mstp_testResult("test_mstp_bitmap");
+}
@@ -0,0 +1,255 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_lag.c
+ *    Description        : MSTP LAG IDs are handed out lowest first and reused
+ *                         last freed first, a LAG that changes speed gets its
+ *                         auto-detected path costs without being bounced
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_inlines.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+#include "mstp_test_bridge.h"
+
+#define MSTP_TEST_LPORT      1
+#define MSTP_TEST_MSTID      1
+#define MSTP_TEST_LAG_IDS    4
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testLagIds
+ *
+ * Purpose:   Allocate and free MSTP LAG IDs from a small pool.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testLagIds(void)
+{
+   uint16_t id;
+
+   /* nothing to hand out before the pool exists */
+   MSTP_TEST_CHECK(mstpd_alloc_lag_id() == 0);
+
+   mstpd_init_lag_id_pool(MSTP_TEST_LAG_IDS);
+   mstpd_init_lag_id_pool(2 * MSTP_TEST_LAG_IDS);
+
+   for(id = 1; id <= MSTP_TEST_LAG_IDS; id++)
+      MSTP_TEST_CHECK(mstpd_alloc_lag_id() == id);
+   MSTP_TEST_CHECK(mstpd_alloc_lag_id() == 0);
+
+   /* the last freed is the next allocated */
+   mstpd_free_lag_id(2);
+   mstpd_free_lag_id(3);
+   MSTP_TEST_CHECK(mstpd_alloc_lag_id() == 3);
+   MSTP_TEST_CHECK(mstpd_alloc_lag_id() == 2);
+   MSTP_TEST_CHECK(mstpd_alloc_lag_id() == 0);
+
+   /* an ID freed twice, or out of range, is not pushed again */
+   mstpd_free_lag_id(1);
+   mstpd_free_lag_id(1);
+   mstpd_free_lag_id(0);
+   mstpd_free_lag_id(MSTP_TEST_LAG_IDS + 1);
+   MSTP_TEST_CHECK(mstpd_alloc_lag_id() == 1);
+   MSTP_TEST_CHECK(mstpd_alloc_lag_id() == 0);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testPortIsUp
+ *
+ * Purpose:   Check that the port is enabled and forwarding on the CIST and
+ *            the MSTI, in the given roles.
+ *
+ * Params:    lport    -> logical port number
+ *            cistRole -> expected CIST Port Role
+ *            mstiRole -> expected MSTI Port Role
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testPortIsUp(LPORT_t lport, MSTP_PORT_ROLE_t cistRole,
+                  MSTP_PORT_ROLE_t mstiRole)
+{
+   MSTP_CIST_PORT_INFO_t *cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+   MSTP_MSTI_PORT_INFO_t *mstiPortPtr =
+                                 MSTP_MSTI_PORT_PTR(MSTP_TEST_MSTID, lport);
+
+   MSTP_TEST_CHECK(MSTP_COMM_PORT_IS_BIT_SET(
+                           MSTP_COMM_PORT_PTR(lport)->bitMap,
+                           MSTP_PORT_PORT_ENABLED));
+   MSTP_TEST_CHECK(cistPortPtr->role == cistRole);
+   MSTP_TEST_CHECK(mstiPortPtr->role == mstiRole);
+   MSTP_TEST_CHECK(cistPortPtr->pstState == MSTP_PST_STATE_FORWARDING);
+   MSTP_TEST_CHECK(mstiPortPtr->pstState == MSTP_PST_STATE_FORWARDING);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testSpeedChange
+ *
+ * Purpose:   Change the speed of a LAG port (its link speed as the OVSDB
+ *            interface would record it, then the event).
+ *
+ * Params:    lport -> logical port number
+ *            speed -> new link speed in Mbps
+ *
+ * Returns:   none
+ *
+ * Globals:   idp_lookup
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testSpeedChange(LPORT_t lport, uint32_t speed)
+{
+   mstp_lport_state_change state;
+
+   idp_lookup[lport]->link_speed = speed;
+   memset(&state, 0, sizeof(state));
+   state.lportname = idp_lookup[lport]->name;
+   state.lportindex = lport;
+   mstp_testEvent(e_mstpd_lport_speed_change, &state);
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Check the MSTP LAG ID pool, then bring up a Bridge with one
+ *            MSTI, its Root Port facing a better neighbor, and change the
+ *            speed of that port as a LAG gaining members would.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every check passed, 1 otherwise
+ *
+ * Globals:   mstp_perfStats, mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(void)
+{
+   MSTP_RX_PDU            pkt;
+   MSTP_RX_PDU            copy;
+   MSTP_COMM_PORT_INFO_t *commPortPtr;
+   MSTP_CIST_PORT_INFO_t *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t *mstiPortPtr;
+   uint32_t               costChgs;
+   uint32_t               tcDetected;
+   int                    i;
+
+   mstp_testLagIds();
+
+   mstp_testBridgeInit();
+   mstp_testPortAdd(MSTP_TEST_LPORT, SPEED_1000MB);
+   mstp_testPortAdd(MSTP_TEST_LPORT + 1, SPEED_1000MB);
+   mstp_testMstiAdd(MSTP_TEST_MSTID, 10);
+   mstp_testBridgeEnable();
+   mstp_testTick(1);
+
+   commPortPtr = MSTP_COMM_PORT_PTR(MSTP_TEST_LPORT);
+   cistPortPtr = MSTP_CIST_PORT_PTR(MSTP_TEST_LPORT);
+   mstiPortPtr = MSTP_MSTI_PORT_PTR(MSTP_TEST_MSTID, MSTP_TEST_LPORT);
+   MSTP_TEST_CHECK(commPortPtr && cistPortPtr && mstiPortPtr);
+   if(!commPortPtr || !cistPortPtr || !mstiPortPtr)
+      return mstp_testResult("test_mstp_lag");
+
+   /*------------------------------------------------------------------------
+    * the neighbor's BPDUs every hello time until both ports forward
+    *------------------------------------------------------------------------*/
+   mstp_testBpduBuild(&pkt, MSTP_TEST_LPORT);
+   for(i = 0; i <= 2 * DEF_FORWARD_DELAY; i += DEF_HELLO_TIME)
+   {
+      copy = pkt;
+      mstp_testBpduRx(&copy);
+      mstp_testTick(DEF_HELLO_TIME);
+   }
+   mstp_testPortIsUp(MSTP_TEST_LPORT, MSTP_PORT_ROLE_ROOT,
+                     MSTP_PORT_ROLE_ROOT);
+   mstp_testPortIsUp(MSTP_TEST_LPORT + 1, MSTP_PORT_ROLE_DESIGNATED,
+                     MSTP_PORT_ROLE_DESIGNATED);
+   MSTP_TEST_CHECK(cistPortPtr->InternalPortPathCost ==
+                   MSTP_PORT_PATH_COST_1000MB);
+   MSTP_TEST_CHECK(MSTP_CIST_ROOT_PRIORITY.intRootPathCost ==
+                   MSTP_PORT_PATH_COST_1000MB);
+
+   /*------------------------------------------------------------------------
+    * ten times the speed: every auto-detected path cost follows, the root
+    * path costs with them, and no port leaves the Forwarding state or
+    * detects a topology change
+    *------------------------------------------------------------------------*/
+   costChgs = mstp_perfStats.lportSpeedCostChgs;
+   tcDetected = cistPortPtr->dbgCnts.tcDetectCnt;
+   mstp_testSpeedChange(MSTP_TEST_LPORT, SPEED_10000MB);
+   MSTP_TEST_CHECK(mstp_perfStats.lportSpeedCostChgs == costChgs + 1);
+   MSTP_TEST_CHECK(commPortPtr->ExternalPortPathCost ==
+                   MSTP_PORT_PATH_COST_10000MB);
+   MSTP_TEST_CHECK(cistPortPtr->InternalPortPathCost ==
+                   MSTP_PORT_PATH_COST_10000MB);
+   MSTP_TEST_CHECK(mstiPortPtr->InternalPortPathCost ==
+                   MSTP_PORT_PATH_COST_10000MB);
+   MSTP_TEST_CHECK(MSTP_CIST_ROOT_PRIORITY.intRootPathCost ==
+                   MSTP_PORT_PATH_COST_10000MB);
+   MSTP_TEST_CHECK(MSTP_MSTI_ROOT_PRIORITY(MSTP_TEST_MSTID).intRootPathCost ==
+                   MSTP_PORT_PATH_COST_10000MB);
+   MSTP_TEST_CHECK(cistPortPtr->dbgCnts.tcDetectCnt == tcDetected);
+   mstp_testPortIsUp(MSTP_TEST_LPORT, MSTP_PORT_ROLE_ROOT,
+                     MSTP_PORT_ROLE_ROOT);
+   mstp_testPortIsUp(MSTP_TEST_LPORT + 1, MSTP_PORT_ROLE_DESIGNATED,
+                     MSTP_PORT_ROLE_DESIGNATED);
+
+   /* and still so a hello time later */
+   copy = pkt;
+   mstp_testBpduRx(&copy);
+   mstp_testTick(DEF_HELLO_TIME);
+   mstp_testPortIsUp(MSTP_TEST_LPORT, MSTP_PORT_ROLE_ROOT,
+                     MSTP_PORT_ROLE_ROOT);
+   mstp_testPortIsUp(MSTP_TEST_LPORT + 1, MSTP_PORT_ROLE_DESIGNATED,
+                     MSTP_PORT_ROLE_DESIGNATED);
+
+   /*------------------------------------------------------------------------
+    * the same speed again changes nothing, nor does a configured path cost
+    * follow the speed
+    *------------------------------------------------------------------------*/
+   mstp_testSpeedChange(MSTP_TEST_LPORT, SPEED_10000MB);
+   MSTP_TEST_CHECK(mstp_perfStats.lportSpeedCostChgs == costChgs + 1);
+
+   mstiPortPtr->useCfgPathCost = TRUE;
+   mstp_testSpeedChange(MSTP_TEST_LPORT, SPEED_1000MB);
+   MSTP_TEST_CHECK(mstp_perfStats.lportSpeedCostChgs == costChgs + 2);
+   MSTP_TEST_CHECK(cistPortPtr->InternalPortPathCost ==
+                   MSTP_PORT_PATH_COST_1000MB);
+   MSTP_TEST_CHECK(mstiPortPtr->InternalPortPathCost ==
+                   MSTP_PORT_PATH_COST_10000MB);
+   mstp_testPortIsUp(MSTP_TEST_LPORT, MSTP_PORT_ROLE_ROOT,
+                     MSTP_PORT_ROLE_ROOT);
+
+   return mstp_testResult("test_mstp_lag");
+}
@@ -0,0 +1,217 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_md5.c
+ *    Description        : MD5 and MST Configuration Digest known answers
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_inlines.h"
+#include "mstp_fsm.h"
+#include "md5.h"
+#include "mstp_test.h"
+
+/*---------------------------------------------------------------------------
+ * MD5 test suite of RFC 1321 (A.5)
+ *---------------------------------------------------------------------------*/
+static const struct
+{
+   const char *msg;
+   const char *md5;
+} mstp_md5KnownAnswers[] =
+{
+   {"", "d41d8cd98f00b204e9800998ecf8427e"},
+   {"a", "0cc175b9c0f1b6a831c399e269772661"},
+   {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+   {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+   {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+   {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+    "d174ab98d277d9f5a5611c2c9f419d9f"},
+   {"1234567890123456789012345678901234567890"
+    "1234567890123456789012345678901234567890",
+    "57edf4a22be3c955ac49da2e2107b67a"},
+};
+
+/*---------------------------------------------------------------------------
+ * Configuration Digests of the MST Configuration Tables of 802.1Q 13.7:
+ * all VIDs mapped to the CIST, all VIDs mapped to MSTID 1, and every VID
+ * mapped to MSTID (VID modulo 32) + 1
+ *---------------------------------------------------------------------------*/
+static const struct
+{
+   uint16_t    mod;     /* MSTID = (VID % mod) + base, or base if 0 */
+   uint16_t    base;
+   const char *digest;
+} mstp_digestKnownAnswers[] =
+{
+   {0,  0, "ac36177f50283cd4b83821d8ab26de62"},
+   {0,  1, "e13a80f11ed0856acd4ee3476941c73b"},
+   {32, 1, "9d145c267dbe9fb5d893441be3ba08ce"},
+};
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testHexEqual
+ *
+ * Purpose:   Compare a 16 octet MD5 result with its expected value given
+ *            as a string of lower case hex digits.
+ *
+ * Params:    res -> MD5 result
+ *            hex -> expected value
+ *
+ * Returns:   TRUE if the two are the same, FALSE otherwise
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static bool
+mstp_testHexEqual(const uint8_t *res, const char *hex)
+{
+   char buf[2 * MSTP_DIGEST_SIZE + 1];
+   int  i;
+
+   for(i = 0; i < MSTP_DIGEST_SIZE; i++)
+      snprintf(&buf[2 * i], 3, "%.2x", res[i]);
+
+   return (strcmp(buf, hex) == 0);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testMd5
+ *
+ * Purpose:   Check the MD5 implementation against the RFC 1321 test suite,
+ *            with every message fed both at once and one octet at a time.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testMd5(void)
+{
+   MD5_CTX ctx;
+   uint8_t res[MSTP_DIGEST_SIZE];
+   size_t  len;
+   size_t  i;
+   size_t  j;
+
+   for(i = 0; i < sizeof(mstp_md5KnownAnswers) /
+              sizeof(mstp_md5KnownAnswers[0]); i++)
+   {
+      len = strlen(mstp_md5KnownAnswers[i].msg);
+
+      MD5Init(&ctx);
+      MD5Update(&ctx, mstp_md5KnownAnswers[i].msg, len);
+      MD5Final(res, &ctx);
+      MSTP_TEST_CHECK(mstp_testHexEqual(res, mstp_md5KnownAnswers[i].md5));
+
+      MD5Init(&ctx);
+      for(j = 0; j < len; j++)
+         MD5Update(&ctx, &mstp_md5KnownAnswers[i].msg[j], 1);
+      MD5Final(res, &ctx);
+      MSTP_TEST_CHECK(mstp_testHexEqual(res, mstp_md5KnownAnswers[i].md5));
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testConfigDigest
+ *
+ * Purpose:   Check the digest of the MST Configuration Tables given by
+ *            802.1Q 13.7, first with HMAC-MD5 over a table built here in
+ *            network byte order, then with the table the daemon keeps up
+ *            to date through 'mstp_setVidMapMstId' and digests in
+ *            'mstp_buildMstConfigurationDigest'.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_DigestSignatureKey
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testConfigDigest(void)
+{
+   static MSTID_t cfgTable[MSTP_MST_CFG_TBL_SIZE];
+   static VID_MAP vidMaps[MSTP_INSTANCES_MAX + 1];
+   hmac_md5_ctxt  hmacKey;
+   uint8_t        res[MSTP_DIGEST_SIZE];
+   size_t         i;
+   VID_t          vid;
+   uint16_t       mstid;
+
+   hmac_md5_init_key(&hmacKey, mstp_DigestSignatureKey, MSTP_DIGEST_KEY_LEN);
+   for(i = 0; i < sizeof(mstp_digestKnownAnswers) /
+              sizeof(mstp_digestKnownAnswers[0]); i++)
+   {
+      memset(cfgTable, 0, sizeof(cfgTable));
+      for(mstid = 0; mstid <= MSTP_INSTANCES_MAX; mstid++)
+         clear_vid_map(&vidMaps[mstid]);
+      for(vid = MSTP_MST_CFG_TBL_FIRST_VID_IDX;
+          vid <= MSTP_MST_CFG_TBL_LAST_VID_IDX; vid++)
+      {
+         mstid = mstp_digestKnownAnswers[i].base;
+         if(mstp_digestKnownAnswers[i].mod)
+            mstid += vid % mstp_digestKnownAnswers[i].mod;
+         cfgTable[vid] = htons(mstid);
+         set_vid(&vidMaps[mstid], vid);
+      }
+
+      hmac_md5_calc(&hmacKey, (const unsigned char *)cfgTable,
+                    sizeof(cfgTable), res);
+      MSTP_TEST_CHECK(mstp_testHexEqual(res,
+                                        mstp_digestKnownAnswers[i].digest));
+
+      mstp_clearVidMstIdTable();
+      for(mstid = 0; mstid <= MSTP_INSTANCES_MAX; mstid++)
+         mstp_setVidMapMstId(&vidMaps[mstid], mstid);
+      mstp_buildMstConfigurationDigest(res);
+      MSTP_TEST_CHECK(mstp_testHexEqual(res,
+                                        mstp_digestKnownAnswers[i].digest));
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Run the MD5 and the Configuration Digest known answers.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every result is the expected one
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(int argc, char *argv[])
+{
+   mstp_testMd5();
+   mstp_testConfigDigest();
+
+   return mstp_testResult("test_mstp_md5");
+}
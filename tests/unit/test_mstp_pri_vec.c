@@ -0,0 +1,296 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_pri_vec.c
+ *    Description        : Packed key priority vectors compare against the field
+ *                         by field compare of 802.1Q 13.10 and 13.11
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+
+/*---------------------------------------------------------------------------
+ * Number of random pairs of priority vectors compared
+ *---------------------------------------------------------------------------*/
+#define MSTP_PRI_VEC_CHECK_PAIRS    100000
+
+/**PROC+**********************************************************************
+ * Name:      mstp_cistPriorityVectorsCompareRef
+ *
+ * Purpose:   Reference CIST priority vectors compare, done field by field
+ *            with the Bridge ID compare macros, the way it was done before
+ *            'mstp_cistPriorityVectorsCompare' packed the Bridge IDs.
+ *            (802.1Q-REV/D5.0 13.9; 13.10)
+ *
+ * Params:    v1 -> a pointer to the first CIST priority vector
+ *            v2 -> a pointer to the second CIST priority vector
+ *
+ * Returns:   -1, 0 or 1 if 'v1' is better, the same or worse than 'v2'
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static int
+mstp_cistPriorityVectorsCompareRef(MSTP_CIST_BRIDGE_PRI_VECTOR_t *v1,
+                                   MSTP_CIST_BRIDGE_PRI_VECTOR_t *v2)
+{
+   int res;
+
+   STP_ASSERT(v1 && v2);
+
+   if((MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID))
+      &&
+      (v1->extRootPathCost == v2->extRootPathCost)
+      &&
+      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID))
+      &&
+      (v1->intRootPathCost == v2->intRootPathCost)
+      &&
+      (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID))
+      &&
+      (v1->dsnPortID == v2->dsnPortID))
+   {/* the first priority vector is the same as the second one */
+      res = 0;
+   }
+   else
+   if((MSTP_BRIDGE_ID_LOWER(v1->rootID, v2->rootID))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
+       (v1->extRootPathCost < v2->extRootPathCost))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
+       (v1->extRootPathCost == v2->extRootPathCost) &&
+       (MSTP_BRIDGE_ID_LOWER(v1->rgnRootID, v2->rgnRootID)))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
+       (v1->extRootPathCost == v2->extRootPathCost) &&
+       (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID)) &&
+       (v1->intRootPathCost < v2->intRootPathCost))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
+       (v1->extRootPathCost == v2->extRootPathCost) &&
+       (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID)) &&
+       (v1->intRootPathCost == v2->intRootPathCost) &&
+       MSTP_BRIDGE_ID_LOWER(v1->dsnBridgeID, v2->dsnBridgeID))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rootID, v2->rootID) &&
+       (v1->extRootPathCost == v2->extRootPathCost) &&
+       (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID)) &&
+       (v1->intRootPathCost == v2->intRootPathCost) &&
+       (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID)) &&
+       (v1->dsnPortID < v2->dsnPortID)))
+   {/* the first priority vector is better than the second one */
+      res = -1;
+   }
+   else
+   {/* the first priority vector is worse than the second one */
+      res = 1;
+   }
+
+   return res;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_mstiPriorityVectorsCompareRef
+ *
+ * Purpose:   Reference MSTI priority vectors compare, done field by field
+ *            with the Bridge ID compare macros, the way it was done before
+ *            'mstp_mstiPriorityVectorsCompare' packed the Bridge IDs.
+ *            (802.1Q-REV/D5.0 13.9; 13.11)
+ *
+ * Params:    v1 -> a pointer to the first MSTI priority vector
+ *            v2 -> a pointer to the second MSTI priority vector
+ *
+ * Returns:   -1, 0 or 1 if 'v1' is better, the same or worse than 'v2'
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static int
+mstp_mstiPriorityVectorsCompareRef(MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v1,
+                                   MSTP_MSTI_BRIDGE_PRI_VECTOR_t *v2)
+{
+   int res;
+
+   STP_ASSERT(v1 && v2);
+
+   if((MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID))
+      &&
+      (v1->intRootPathCost == v2->intRootPathCost)
+      &&
+      (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID))
+      &&
+      (v1->dsnPortID == v2->dsnPortID))
+   {/* the first priority vector is the same as the second one */
+      res = 0;
+   }
+   else
+   if((MSTP_BRIDGE_ID_LOWER(v1->rgnRootID, v2->rgnRootID))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID) &&
+       (v1->intRootPathCost < v2->intRootPathCost))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID) &&
+       (v1->intRootPathCost == v2->intRootPathCost) &&
+       (MSTP_BRIDGE_ID_LOWER(v1->dsnBridgeID, v2->dsnBridgeID)))
+      ||
+      (MSTP_BRIDGE_ID_EQUAL(v1->rgnRootID, v2->rgnRootID) &&
+       (v1->intRootPathCost == v2->intRootPathCost) &&
+       (MSTP_BRIDGE_ID_EQUAL(v1->dsnBridgeID, v2->dsnBridgeID)) &&
+       (v1->dsnPortID < v2->dsnPortID)))
+   {/* the first priority vector is better than the second one */
+      res = -1;
+   }
+   else
+   {/* the first priority vector is worse than the second one */
+      res = 1;
+   }
+
+   return res;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBridgeIdVary
+ *
+ * Purpose:   Change a single component of a Bridge Identifier by one: the
+ *            priority or one octet of the MAC address.
+ *
+ * Params:    id   -> Bridge Identifier to change
+ *            seed -> test generator state
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testBridgeIdVary(MSTP_BRIDGE_IDENTIFIER_t *id, uint32_t *seed)
+{
+   uint32_t r   = mstp_testRand(seed);
+   int      idx = (int)(r % (ENET_ADDR_SIZE + 1));
+   int      inc = (r & 0x100) ? 1 : -1;
+
+   if(idx == ENET_ADDR_SIZE)
+      id->priority = (uint16_t)(id->priority + inc);
+   else
+      id->mac_address[idx] = (uint8_t)(id->mac_address[idx] + inc);
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Compare random pairs of priority vectors with the packed key
+ *            compare functions and with the field by field ones. Every pair
+ *            is made of a random vector and a copy of it with at most one
+ *            component changed by one, so that ties on the leading
+ *            components are the common case. Equal vectors and vectors that
+ *            differ only in the low bits of the Designated Port ID are part
+ *            of the mix. Both orders of every pair are compared, for the
+ *            CIST vectors and for the MSTI vectors made of their tails.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every compare agrees with the field by field one
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(int argc, char *argv[])
+{
+   MSTP_CIST_BRIDGE_PRI_VECTOR_t c1, c2;
+   MSTP_MSTI_BRIDGE_PRI_VECTOR_t m1, m2;
+   uint32_t                      seed = 0x2545F491;
+   uint32_t                      checked = 0;
+   uint32_t                      i;
+   int                           j;
+
+   for(i = 0; i < MSTP_PRI_VEC_CHECK_PAIRS; i++)
+   {
+      c1.rootID.priority      = (uint16_t)mstp_testRand(&seed);
+      c1.rgnRootID.priority   = (uint16_t)mstp_testRand(&seed);
+      c1.dsnBridgeID.priority = (uint16_t)mstp_testRand(&seed);
+      for(j = 0; j < ENET_ADDR_SIZE; j++)
+      {
+         c1.rootID.mac_address[j]      = (uint8_t)mstp_testRand(&seed);
+         c1.rgnRootID.mac_address[j]   = (uint8_t)mstp_testRand(&seed);
+         c1.dsnBridgeID.mac_address[j] = (uint8_t)mstp_testRand(&seed);
+      }
+      c1.extRootPathCost = mstp_testRand(&seed);
+      c1.intRootPathCost = mstp_testRand(&seed);
+      c1.dsnPortID       = (MSTP_PORT_ID_t)mstp_testRand(&seed);
+
+      c2 = c1;
+      switch(mstp_testRand(&seed) % 8)
+      {
+         case 0:  /* equal vectors */
+            break;
+         case 1:
+            mstp_testBridgeIdVary(&c2.rootID, &seed);
+            break;
+         case 2:
+            c2.extRootPathCost += (mstp_testRand(&seed) & 1) ? 1 : -1;
+            break;
+         case 3:
+            mstp_testBridgeIdVary(&c2.rgnRootID, &seed);
+            break;
+         case 4:
+            c2.intRootPathCost += (mstp_testRand(&seed) & 1) ? 1 : -1;
+            break;
+         case 5:
+            mstp_testBridgeIdVary(&c2.dsnBridgeID, &seed);
+            break;
+         default: /* only the low bits of the port ID differ */
+            c2.dsnPortID ^= (MSTP_PORT_ID_t)
+                            (1 + (mstp_testRand(&seed) & 0x3));
+            break;
+      }
+
+      MSTP_TEST_CHECK(mstp_cistPriorityVectorsCompare(&c1, &c2) ==
+                      mstp_cistPriorityVectorsCompareRef(&c1, &c2));
+      MSTP_TEST_CHECK(mstp_cistPriorityVectorsCompare(&c2, &c1) ==
+                      mstp_cistPriorityVectorsCompareRef(&c2, &c1));
+
+      m1.rgnRootID       = c1.rgnRootID;
+      m1.intRootPathCost = c1.intRootPathCost;
+      m1.dsnBridgeID     = c1.dsnBridgeID;
+      m1.dsnPortID       = c1.dsnPortID;
+      m2.rgnRootID       = c2.rgnRootID;
+      m2.intRootPathCost = c2.intRootPathCost;
+      m2.dsnBridgeID     = c2.dsnBridgeID;
+      m2.dsnPortID       = c2.dsnPortID;
+
+      MSTP_TEST_CHECK(mstp_mstiPriorityVectorsCompare(&m1, &m2) ==
+                      mstp_mstiPriorityVectorsCompareRef(&m1, &m2));
+      MSTP_TEST_CHECK(mstp_mstiPriorityVectorsCompare(&m2, &m1) ==
+                      mstp_mstiPriorityVectorsCompareRef(&m2, &m1));
+
+      checked += 4;
+   }
+
+   printf("%u priority vector compares\n", checked);
+
+   return mstp_testResult("test_mstp_pri_vec");
+}
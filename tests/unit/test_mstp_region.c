@@ -0,0 +1,178 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_region.c
+ *    Description        : A change of the MST Configuration Identifier of the
+ *                         Bridge leaves the ports as they are, the next BPDU
+ *                         received moves a port across the Region boundary
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_inlines.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+#include "mstp_test_bridge.h"
+
+#define MSTP_TEST_LPORT   1
+#define MSTP_TEST_MSTID   1
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testRegionName
+ *
+ * Purpose:   Change the MST Configuration Name of the Bridge, the other
+ *            global parameters are left at their defaults.
+ *
+ * Params:    name -> new MST Configuration Name
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testRegionName(const char *name)
+{
+   mstp_global_config global;
+
+   memset(&global, 0, sizeof(global));
+   strncpy(global.config_name, name, sizeof(global.config_name) - 1);
+   global.flap_penalty = DEF_FLAP_PENALTY;
+   global.flap_suppress = DEF_FLAP_SUPPRESS;
+   global.flap_reuse = DEF_FLAP_REUSE;
+   global.flap_half_life = DEF_FLAP_HALF_LIFE;
+   mstp_testEvent(e_mstpd_global_config, &global);
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Bring up a Bridge with two MSTIs whose port receives a
+ *            proposal with a topology change from a better neighbor in the
+ *            Region, rename the Region and check that nothing of that BPDU
+ *            is acted upon again, then that the neighbor's next BPDU puts
+ *            the port at the Region boundary.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every check passed, 1 otherwise
+ *
+ * Globals:   mstp_perfStats, mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(void)
+{
+   MSTP_RX_PDU             pkt;
+   MSTP_RX_PDU             copy;
+   MSTP_MST_BPDU_t        *bpdu = (MSTP_MST_BPDU_t *)pkt.data;
+   MSTP_MSTI_CONFIG_MSG_t *msg  =
+                              (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+   MSTP_CIST_PORT_INFO_t  *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t  *mstiPortPtr;
+   MSTP_CIST_PORT_INFO_t   cistBefore;
+   MSTP_MSTI_PORT_INFO_t   mstiBefore;
+   uint8_t                 cistInfoWhile;
+   uint8_t                 mstiInfoWhile;
+   uint32_t                boundaryChgs;
+
+   mstp_testBridgeInit();
+   mstp_testPortAdd(MSTP_TEST_LPORT, SPEED_1000MB);
+   mstp_testPortAdd(MSTP_TEST_LPORT + 1, SPEED_1000MB);
+   mstp_testMstiAdd(MSTP_TEST_MSTID, 10);
+   mstp_testMstiAdd(MSTP_TEST_MSTID + 1, 20);
+   mstp_testBridgeEnable();
+   mstp_testTick(1);
+
+   cistPortPtr = MSTP_CIST_PORT_PTR(MSTP_TEST_LPORT);
+   mstiPortPtr = MSTP_MSTI_PORT_PTR(MSTP_TEST_MSTID, MSTP_TEST_LPORT);
+   MSTP_TEST_CHECK(cistPortPtr && mstiPortPtr);
+   if(!cistPortPtr || !mstiPortPtr)
+      return mstp_testResult("test_mstp_region");
+
+   /*------------------------------------------------------------------------
+    * the neighbor proposes and signals a topology change on every tree
+    *------------------------------------------------------------------------*/
+   mstp_testBpduBuild(&pkt, MSTP_TEST_LPORT);
+   bpdu->cistFlags |= MSTP_CIST_FLAG_PROPOSAL | MSTP_CIST_FLAG_TC;
+   msg->mstiFlags |= MSTP_MSTI_FLAG_PROPOSAL | MSTP_MSTI_FLAG_TC;
+   copy = pkt;
+   mstp_testBpduRx(&copy);
+   MSTP_TEST_CHECK(cistPortPtr->role == MSTP_PORT_ROLE_ROOT);
+   MSTP_TEST_CHECK(mstiPortPtr->role == MSTP_PORT_ROLE_ROOT);
+   MSTP_TEST_CHECK(cistPortPtr->dbgCnts.tcFlagRxCnt == 1);
+
+   mstp_testTick(DEF_HELLO_TIME);
+   cistBefore = *cistPortPtr;
+   mstiBefore = *mstiPortPtr;
+   cistInfoWhile = MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile);
+   mstiInfoWhile = MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile);
+   MSTP_TEST_CHECK(cistInfoWhile < 3 * DEF_HELLO_TIME);
+   boundaryChgs = mstp_perfStats.rgnBoundaryChgs;
+
+   /*------------------------------------------------------------------------
+    * another Region name: the port is found to move across the boundary,
+    * but keeps its roles, the received flags are not counted or acted
+    * upon again and the received information ages as it did
+    *------------------------------------------------------------------------*/
+   mstp_testRegionName("unit-test-2");
+   MSTP_TEST_CHECK(mstp_perfStats.rgnBoundaryChgs == boundaryChgs + 1);
+   MSTP_TEST_CHECK(cistPortPtr->role == MSTP_PORT_ROLE_ROOT);
+   MSTP_TEST_CHECK(mstiPortPtr->role == MSTP_PORT_ROLE_ROOT);
+   MSTP_TEST_CHECK(memcmp(&cistPortPtr->dbgCnts, &cistBefore.dbgCnts,
+                          sizeof(cistBefore.dbgCnts)) == 0);
+   MSTP_TEST_CHECK(memcmp(&mstiPortPtr->dbgCnts, &mstiBefore.dbgCnts,
+                          sizeof(mstiBefore.dbgCnts)) == 0);
+   MSTP_TEST_CHECK(cistPortPtr->bitMap[0] == cistBefore.bitMap[0]);
+   MSTP_TEST_CHECK(mstiPortPtr->bitMap[0] == mstiBefore.bitMap[0]);
+   MSTP_TEST_CHECK(MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) ==
+                   cistInfoWhile);
+   MSTP_TEST_CHECK(MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) ==
+                   mstiInfoWhile);
+
+   /*------------------------------------------------------------------------
+    * the neighbor's next BPDU is decoded against the new identifier: the
+    * port is at the boundary, its MSTI role follows the CIST one
+    *------------------------------------------------------------------------*/
+   mstp_testBpduBuild(&pkt, MSTP_TEST_LPORT);
+   memset(bpdu->mstConfigurationId.configName, 0, MSTP_MST_CONFIG_NAME_LEN);
+   memcpy(bpdu->mstConfigurationId.configName, "unit-test", 9);
+   copy = pkt;
+   mstp_testBpduRx(&copy);
+   MSTP_TEST_CHECK(cistPortPtr->dbgCnts.mstBpduRxCnt ==
+                   cistBefore.dbgCnts.mstBpduRxCnt + 1);
+   MSTP_TEST_CHECK(!MSTP_COMM_PORT_IS_BIT_SET(
+                           MSTP_COMM_PORT_PTR(MSTP_TEST_LPORT)->bitMap,
+                           MSTP_PORT_RCVD_INTERNAL));
+   MSTP_TEST_CHECK(cistPortPtr->role == MSTP_PORT_ROLE_ROOT);
+   MSTP_TEST_CHECK(mstiPortPtr->role == MSTP_PORT_ROLE_MASTER);
+
+   /* and back in the Region with the former name */
+   mstp_testRegionName("unit-test");
+   MSTP_TEST_CHECK(mstp_perfStats.rgnBoundaryChgs == boundaryChgs + 2);
+   copy = pkt;
+   mstp_testBpduRx(&copy);
+   copy = pkt;
+   mstp_testBpduRx(&copy);
+   MSTP_TEST_CHECK(mstiPortPtr->role == MSTP_PORT_ROLE_ROOT);
+
+   return mstp_testResult("test_mstp_region");
+}
@@ -0,0 +1,165 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_roles.c
+ *    Description        : The Port Role Selection of a tree is skipped when
+ *                         nothing it reads has changed since the roles were
+ *                         last computed, and run when anything did
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_inlines.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+#include "mstp_test_bridge.h"
+
+#define MSTP_TEST_LPORT   1
+
+/* role selection counters before the BPDU under test */
+static uint32_t mstp_testCistCalls;
+static uint32_t mstp_testMstiCalls;
+static uint32_t mstp_testSkipped;
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testRx
+ *
+ * Purpose:   Receive the BPDU on the test port, remembering the role
+ *            selection counters as they were before.
+ *
+ * Params:    pkt -> packet buffer with the BPDU
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testRx(MSTP_RX_PDU *pkt)
+{
+   MSTP_RX_PDU copy = *pkt;
+
+   mstp_testCistCalls = mstp_perfStats.rolesCistCalls;
+   mstp_testMstiCalls = mstp_perfStats.rolesMstiCalls;
+   mstp_testSkipped = mstp_perfStats.rolesSkipped;
+   mstp_testBpduRx(&copy);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testRolesAre
+ *
+ * Purpose:   Check the role of the test port on the CIST and both MSTIs.
+ *
+ * Params:    cistRole -> expected CIST Port Role
+ *            mstiRole -> expected MSTI Port Role
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testRolesAre(MSTP_PORT_ROLE_t cistRole, MSTP_PORT_ROLE_t mstiRole)
+{
+   MSTP_TEST_CHECK(MSTP_CIST_PORT_PTR(MSTP_TEST_LPORT)->role == cistRole);
+   MSTP_TEST_CHECK(MSTP_MSTI_PORT_PTR(1, MSTP_TEST_LPORT)->role == mstiRole);
+   MSTP_TEST_CHECK(MSTP_MSTI_PORT_PTR(2, MSTP_TEST_LPORT)->role == mstiRole);
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Bring up a Bridge with two MSTIs whose port receives the BPDUs
+ *            of a better neighbor, change the information of one tree at a
+ *            time and check which role selections are run.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every check passed, 1 otherwise
+ *
+ * Globals:   mstp_perfStats, mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(void)
+{
+   MSTP_RX_PDU             pkt;
+   MSTP_MST_BPDU_t        *bpdu = (MSTP_MST_BPDU_t *)pkt.data;
+   MSTP_MSTI_CONFIG_MSG_t *msg  =
+                              (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+
+   mstp_testBridgeInit();
+   mstp_testPortAdd(MSTP_TEST_LPORT, SPEED_1000MB);
+   mstp_testPortAdd(MSTP_TEST_LPORT + 1, SPEED_1000MB);
+   mstp_testMstiAdd(1, 10);
+   mstp_testMstiAdd(2, 20);
+   mstp_testBridgeEnable();
+   mstp_testTick(1);
+
+   mstp_testBpduBuild(&pkt, MSTP_TEST_LPORT);
+   mstp_testRx(&pkt);
+   mstp_testRolesAre(MSTP_PORT_ROLE_ROOT, MSTP_PORT_ROLE_ROOT);
+
+   /*------------------------------------------------------------------------
+    * a new CIST Regional Root in the same Region: the CIST roles are
+    * computed again, and both MSTIs are resynchronized with the CIST port,
+    * but nothing their role selection reads has changed
+    *------------------------------------------------------------------------*/
+   storeShortInPacket(&bpdu->cistRgnRootId.priority, 0);
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rolesCistCalls > mstp_testCistCalls);
+   MSTP_TEST_CHECK(mstp_perfStats.rolesMstiCalls == mstp_testMstiCalls);
+   MSTP_TEST_CHECK(mstp_perfStats.rolesSkipped >= mstp_testSkipped + 2);
+   mstp_testRolesAre(MSTP_PORT_ROLE_ROOT, MSTP_PORT_ROLE_ROOT);
+
+   /*------------------------------------------------------------------------
+    * a new Regional Root for MSTI 1 only: MSTI 1 roles are computed again,
+    * the CIST and MSTI 2 ones are not
+    *------------------------------------------------------------------------*/
+   storeShortInPacket(&msg->mstiRgnRootId.priority, 1);
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rolesCistCalls == mstp_testCistCalls);
+   MSTP_TEST_CHECK(mstp_perfStats.rolesMstiCalls == mstp_testMstiCalls + 1);
+   MSTP_TEST_CHECK(MSTP_MSTI_ROOT_PRIORITY(1).rgnRootID.priority == 1);
+   MSTP_TEST_CHECK(MSTP_MSTI_ROOT_PRIORITY(2).rgnRootID.priority ==
+                   (MSTP_TEST_PEER_PRIORITY | 2));
+   mstp_testRolesAre(MSTP_PORT_ROLE_ROOT, MSTP_PORT_ROLE_ROOT);
+
+   /*------------------------------------------------------------------------
+    * the neighbor moves to another Region: the MSTI roles of the boundary
+    * port follow the CIST one, though no MSTI information was received
+    *------------------------------------------------------------------------*/
+   bpdu->mstConfigurationId.configName[0] ^= 1;
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rolesMstiCalls == mstp_testMstiCalls + 2);
+   mstp_testRolesAre(MSTP_PORT_ROLE_ROOT, MSTP_PORT_ROLE_MASTER);
+
+   /*------------------------------------------------------------------------
+    * and back in: the MSTI information is received again
+    *------------------------------------------------------------------------*/
+   bpdu->mstConfigurationId.configName[0] ^= 1;
+   mstp_testRx(&pkt);
+   mstp_testRx(&pkt);
+   mstp_testRolesAre(MSTP_PORT_ROLE_ROOT, MSTP_PORT_ROLE_ROOT);
+
+   return mstp_testResult("test_mstp_roles");
+}
@@ -0,0 +1,230 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_rx.c
+ *    Description        : Received BPDUs repeating the previous one from the
+ *                         Designated Bridge skip the decoding, anything that
+ *                         may classify them differently does not
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+#include "mstp_test_bridge.h"
+
+#define MSTP_TEST_LPORT   1
+#define MSTP_TEST_MSTID   1
+
+/* counters of the receive fast path before the BPDU under test */
+static uint32_t mstp_testRepeats;
+static uint32_t mstp_testFastPath;
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testRx
+ *
+ * Purpose:   Receive the BPDU on the test port, remembering the fast path
+ *            counters as they were before.
+ *
+ * Params:    pkt -> packet buffer with the BPDU
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testRx(MSTP_RX_PDU *pkt)
+{
+   MSTP_RX_PDU copy = *pkt;
+
+   mstp_testRepeats = mstp_perfStats.rxBpduRepeats;
+   mstp_testFastPath = mstp_perfStats.rcvInfoFastPath;
+   mstp_testBpduRx(&copy);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testRxSettle
+ *
+ * Purpose:   Receive the neighbor's BPDU until its repeats take the fast
+ *            path again: once to get it decoded, once more in case that
+ *            changed the roles, then the repeat.
+ *
+ * Params:    pkt -> packet buffer, the BPDU is built in it
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testRxSettle(MSTP_RX_PDU *pkt)
+{
+   mstp_testBpduBuild(pkt, MSTP_TEST_LPORT);
+   mstp_testRx(pkt);
+   mstp_testRx(pkt);
+   mstp_testRx(pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats + 1);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath + 2);
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Bring up a Bridge with one MSTI whose port receives the BPDUs
+ *            of a better neighbor, then check which of them are recognized
+ *            as repeated and decoded only once.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every check passed, 1 otherwise
+ *
+ * Globals:   mstp_perfStats, mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(void)
+{
+   MSTP_RX_PDU             pkt;
+   MSTP_MST_BPDU_t        *bpdu = (MSTP_MST_BPDU_t *)pkt.data;
+   MSTP_MSTI_CONFIG_MSG_t *msg  =
+                              (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+   MSTP_CIST_PORT_INFO_t  *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t  *mstiPortPtr;
+   mstp_cist_config        cist;
+   uint32_t                tcRx;
+
+   mstp_testBridgeInit();
+   mstp_testPortAdd(MSTP_TEST_LPORT, SPEED_1000MB);
+   mstp_testPortAdd(MSTP_TEST_LPORT + 1, SPEED_1000MB);
+   mstp_testMstiAdd(MSTP_TEST_MSTID, 10);
+   mstp_testBridgeEnable();
+   mstp_testTick(1);
+
+   cistPortPtr = MSTP_CIST_PORT_PTR(MSTP_TEST_LPORT);
+   mstiPortPtr = MSTP_MSTI_PORT_PTR(MSTP_TEST_MSTID, MSTP_TEST_LPORT);
+   MSTP_TEST_CHECK(cistPortPtr && mstiPortPtr);
+   if(!cistPortPtr || !mstiPortPtr)
+      return mstp_testResult("test_mstp_rx");
+
+   /*------------------------------------------------------------------------
+    * the first BPDU is superior, the port becomes Root on both trees. The
+    * role update forgets the recorded BPDU, the second one is decoded and
+    * classified as repeated, the third one repeats it and takes the fast
+    * path on both trees.
+    *------------------------------------------------------------------------*/
+   mstp_testBpduBuild(&pkt, MSTP_TEST_LPORT);
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats);
+   MSTP_TEST_CHECK(cistPortPtr->role == MSTP_PORT_ROLE_ROOT);
+   MSTP_TEST_CHECK(mstiPortPtr->role == MSTP_PORT_ROLE_ROOT);
+
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath);
+   MSTP_TEST_CHECK(cistPortPtr->rcvdInfo ==
+                   MSTP_RCVD_INFO_REPEATED_DESIGNATED);
+   MSTP_TEST_CHECK(mstiPortPtr->rcvdInfo ==
+                   MSTP_RCVD_INFO_REPEATED_DESIGNATED);
+
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats + 1);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath + 2);
+
+   /*------------------------------------------------------------------------
+    * the same BPDU once more, a hello time later: the fast path restarts
+    * 'rcvdInfoWhile' on both trees as the decoding would do it
+    *------------------------------------------------------------------------*/
+   mstp_testTick(DEF_HELLO_TIME);
+   MSTP_TEST_CHECK(MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) <
+                   3 * DEF_HELLO_TIME);
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats + 1);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath + 2);
+   MSTP_TEST_CHECK(MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile) ==
+                   3 * DEF_HELLO_TIME);
+   MSTP_TEST_CHECK(MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile) ==
+                   3 * DEF_HELLO_TIME);
+   MSTP_TEST_CHECK(cistPortPtr->role == MSTP_PORT_ROLE_ROOT);
+
+   /*------------------------------------------------------------------------
+    * a changed Port Role flag is decoded again, on the CIST and the MSTI
+    *------------------------------------------------------------------------*/
+   bpdu->cistFlags = (bpdu->cistFlags & ~MSTP_CIST_FLAG_PORT_ROLE) |
+                     MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP;
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath);
+   MSTP_TEST_CHECK(cistPortPtr->rcvdInfo !=
+                   MSTP_RCVD_INFO_REPEATED_DESIGNATED);
+
+   mstp_testRxSettle(&pkt);
+
+   msg->mstiFlags = (msg->mstiFlags & ~MSTP_MSTI_FLAG_PORT_ROLE) |
+                    MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP;
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath);
+
+   /*------------------------------------------------------------------------
+    * the other flags are not decoded, but still acted upon: a TC flag in a
+    * repeated BPDU takes the fast path and is counted as received
+    *------------------------------------------------------------------------*/
+   mstp_testRxSettle(&pkt);
+   tcRx = cistPortPtr->dbgCnts.tcFlagRxCnt;
+   bpdu->cistFlags |= MSTP_CIST_FLAG_TC;
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats + 1);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath + 2);
+   MSTP_TEST_CHECK(cistPortPtr->dbgCnts.tcFlagRxCnt == tcRx + 1);
+
+   /*------------------------------------------------------------------------
+    * any other event may change the classification (configuration, ports),
+    * it bumps 'rxInfoGen' and the same BPDU is decoded again
+    *------------------------------------------------------------------------*/
+   mstp_testRxSettle(&pkt);
+
+   memset(&cist, 0, sizeof(cist));
+   cist.priority = DEF_BRIDGE_PRIORITY;
+   cist.hello_time = DEF_HELLO_TIME;
+   cist.forward_delay = DEF_FORWARD_DELAY;
+   cist.max_age = DEF_MAX_AGE;
+   cist.max_hop_count = DEF_MAX_HOPS;
+   cist.tx_hold_count = DEF_HOLD_COUNT;
+   mstp_testEvent(e_mstpd_cist_config, &cist);
+
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath);
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats + 1);
+   MSTP_TEST_CHECK(mstp_perfStats.rcvInfoFastPath == mstp_testFastPath + 2);
+
+   /*------------------------------------------------------------------------
+    * the same BPDU on another port is not a repeat of this port's one
+    *------------------------------------------------------------------------*/
+   pkt.lport = MSTP_TEST_LPORT + 1;
+   mstp_testRx(&pkt);
+   MSTP_TEST_CHECK(mstp_perfStats.rxBpduRepeats == mstp_testRepeats);
+
+   return mstp_testResult("test_mstp_rx");
+}
@@ -0,0 +1,411 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_sm_order.c
+ *    Description        : Merging the nested PRT, PST and TCM invocations
+ *                         leaves the Bridge in the same state as running
+ *                         them in place, for a sequence of received BPDUs
+ *                         and link flaps
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_inlines.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+#include "mstp_test_bridge.h"
+
+#define MSTP_TEST_PORTS   3
+#define MSTP_TEST_TREES   3   /* the CIST and MSTIs 1 and 2 */
+#define MSTP_TEST_STEPS   400
+#define MSTP_TEST_TX_MAX  128
+
+/* state of a port for a tree */
+typedef struct MSTP_TEST_PORT_STATE_t
+{
+   uint8_t  role;
+   uint8_t  selectedRole;
+   uint8_t  infoIs;
+   uint8_t  pimState;
+   uint8_t  prtState;
+   uint8_t  pstState;
+   uint8_t  tcmState;
+   uint8_t  fdWhile;
+   uint8_t  rrWhile;
+   uint8_t  rbWhile;
+   uint8_t  tcWhile;
+   uint8_t  rcvdInfoWhile;
+   uint32_t bitMap;
+} MSTP_TEST_PORT_STATE_t;
+
+/* state of the Bridge after a step of the scenario */
+typedef struct MSTP_TEST_STATE_t
+{
+   MSTP_TEST_PORT_STATE_t ports[MSTP_TEST_TREES][MSTP_TEST_PORTS];
+   uint32_t               commBitMap[MSTP_TEST_PORTS];
+   uint16_t               txLen[MSTP_TEST_PORTS];
+   uint8_t                tx[MSTP_TEST_PORTS][MSTP_TEST_TX_MAX];
+} MSTP_TEST_STATE_t;
+
+/* the outcome of one run of the scenario */
+typedef struct MSTP_TEST_RUN_t
+{
+   MSTP_TEST_STATE_t      steps[MSTP_TEST_STEPS];
+   uint32_t               stepCnt;
+   uint64_t               smMerged;
+   uint32_t               smMaxDepth;
+   bool                   done;
+} MSTP_TEST_RUN_t;
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testSnapshot
+ *
+ * Purpose:   Record the state of every port on every tree, and the last
+ *            BPDU each port has transmitted.
+ *
+ * Params:    run -> run to record the state in, as its next step
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testSnapshot(MSTP_TEST_RUN_t *run)
+{
+   MSTP_TEST_STATE_t      *state;
+   MSTP_TEST_PORT_STATE_t *p;
+   MSTP_CIST_PORT_INFO_t  *cistPortPtr;
+   MSTP_MSTI_PORT_INFO_t  *mstiPortPtr;
+   LPORT_t                 lport;
+   MSTID_t                 mstid;
+   int                     i;
+   int                     len;
+
+   STP_ASSERT(run->stepCnt < MSTP_TEST_STEPS);
+   state = &run->steps[run->stepCnt++];
+   memset(state, 0, sizeof(*state));
+
+   for(i = 0; i < MSTP_TEST_PORTS; i++)
+   {
+      lport = i + 1;
+      cistPortPtr = MSTP_CIST_PORT_PTR(lport);
+      p = &state->ports[0][i];
+      p->role          = cistPortPtr->role;
+      p->selectedRole  = cistPortPtr->selectedRole;
+      p->infoIs        = cistPortPtr->infoIs;
+      p->pimState      = cistPortPtr->pimState;
+      p->prtState      = MSTP_PORT_HOT(cistPortPtr, prtState);
+      p->pstState      = cistPortPtr->pstState;
+      p->tcmState      = cistPortPtr->tcmState;
+      p->fdWhile       = MSTP_PORT_HOT(cistPortPtr, fdWhile);
+      p->rrWhile       = MSTP_PORT_HOT(cistPortPtr, rrWhile);
+      p->rbWhile       = MSTP_PORT_HOT(cistPortPtr, rbWhile);
+      p->tcWhile       = MSTP_PORT_HOT(cistPortPtr, tcWhile);
+      p->rcvdInfoWhile = MSTP_PORT_HOT(cistPortPtr, rcvdInfoWhile);
+      p->bitMap        = cistPortPtr->bitMap[0];
+
+      for(mstid = 1; mstid < MSTP_TEST_TREES; mstid++)
+      {
+         mstiPortPtr = MSTP_MSTI_PORT_PTR(mstid, lport);
+         p = &state->ports[mstid][i];
+         p->role          = mstiPortPtr->role;
+         p->selectedRole  = mstiPortPtr->selectedRole;
+         p->infoIs        = mstiPortPtr->infoIs;
+         p->pimState      = mstiPortPtr->pimState;
+         p->prtState      = MSTP_PORT_HOT(mstiPortPtr, prtState);
+         p->pstState      = mstiPortPtr->pstState;
+         p->tcmState      = mstiPortPtr->tcmState;
+         p->fdWhile       = MSTP_PORT_HOT(mstiPortPtr, fdWhile);
+         p->rrWhile       = MSTP_PORT_HOT(mstiPortPtr, rrWhile);
+         p->rbWhile       = MSTP_PORT_HOT(mstiPortPtr, rbWhile);
+         p->tcWhile       = MSTP_PORT_HOT(mstiPortPtr, tcWhile);
+         p->rcvdInfoWhile = MSTP_PORT_HOT(mstiPortPtr, rcvdInfoWhile);
+         p->bitMap        = mstiPortPtr->bitMap[0];
+      }
+
+      state->commBitMap[i] = MSTP_COMM_PORT_PTR(lport)->bitMap[0];
+      len = mstp_testBpduTx(lport, state->tx[i], MSTP_TEST_TX_MAX);
+      state->txLen[i] = (uint16_t)len;
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBpduRandom
+ *
+ * Purpose:   Build a BPDU from one of a few neighbors, better or worse than
+ *            the Bridge, with a random Port Role and random proposal,
+ *            agreement and topology change flags on every tree, sometimes
+ *            from another Region.
+ *
+ * Params:    pkt  -> packet buffer, the BPDU is built in it
+ *            seed -> random generator state
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testBpduRandom(MSTP_RX_PDU *pkt, uint32_t *seed)
+{
+   static const uint16_t   priorities[] = {0, 4096, 32768, 61440};
+   static const uint8_t    roles[] = {MSTP_BPDU_ROLE_DESIGNATED,
+                                      MSTP_BPDU_ROLE_DESIGNATED,
+                                      MSTP_BPDU_ROLE_ROOT,
+                                      MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP};
+   static const uint8_t    flags[] = {MSTP_CIST_FLAG_PROPOSAL,
+                                      MSTP_CIST_FLAG_AGREEMENT,
+                                      MSTP_CIST_FLAG_TC,
+                                      MSTP_CIST_FLAG_TC_ACK};
+   MSTP_MST_BPDU_t        *bpdu = (MSTP_MST_BPDU_t *)pkt->data;
+   MSTP_MSTI_CONFIG_MSG_t *msg;
+   uint32_t                peer;
+   uint32_t                r;
+   int                     i;
+   int                     m;
+
+   mstp_testBpduBuild(pkt, 1 + mstp_testRand(seed) % MSTP_TEST_PORTS);
+
+   /* one of four neighbors, each with the same priority on every tree */
+   peer = mstp_testRand(seed) % 4;
+   bpdu->cistBridgeId.mac_address[5] = (uint8_t)peer;
+   storeShortInPacket(&bpdu->cistBridgeId.priority, priorities[peer]);
+   if(mstp_testRand(seed) % 2)
+      bpdu->cistRootId = bpdu->cistBridgeId;
+   bpdu->cistRgnRootId = bpdu->cistBridgeId;
+   storeShortInPacket(&bpdu->cistPortId,
+                      0x8001 + mstp_testRand(seed) % 2);
+   storeLongInPacket(&bpdu->cistExtPathCost,
+                     (mstp_testRand(seed) % 3) * 20000);
+
+   r = mstp_testRand(seed);
+   bpdu->cistFlags = roles[r % 4] | MSTP_CIST_FLAG_LEARNING |
+                     MSTP_CIST_FLAG_FORWADING;
+   for(i = 0; i < 4; i++)
+      if((r >> (2 + 2 * i)) % 4 == 0)
+         bpdu->cistFlags |= flags[i];
+
+   msg = (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+   for(m = 0; m < MSTP_TEST_TREES - 1; m++)
+   {
+      msg[m].mstiRgnRootId = bpdu->cistBridgeId;
+      storeShortInPacket(&msg[m].mstiRgnRootId.priority,
+                         priorities[peer] | (m + 1));
+      msg[m].mstiBridgePriority = (priorities[peer] / 4096) << 4;
+
+      r = mstp_testRand(seed);
+      msg[m].mstiFlags = roles[r % 4] | MSTP_MSTI_FLAG_LEARNING |
+                         MSTP_MSTI_FLAG_FORWADING;
+      for(i = 0; i < 3; i++)
+         if((r >> (2 + 2 * i)) % 4 == 0)
+            msg[m].mstiFlags |= flags[i];
+   }
+
+   if(mstp_testRand(seed) % 8 == 0)
+      bpdu->mstConfigurationId.configName[0] ^= 1;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testLinkFlap
+ *
+ * Purpose:   Take the link of a port down and bring it back up, each in a
+ *            reconfigure pass of its own.
+ *
+ * Params:    lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:   idp_lookup
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testLinkFlap(LPORT_t lport)
+{
+   mstp_lport_link_change change;
+
+   memset(&change, 0, sizeof(change));
+   idp_lookup[lport]->link_state = INTERFACE_LINK_STATE_DOWN;
+   set_port(&change.down, lport);
+   mstp_testEvent(e_mstpd_lport_link_change, &change);
+
+   memset(&change, 0, sizeof(change));
+   idp_lookup[lport]->link_state = INTERFACE_LINK_STATE_UP;
+   set_port(&change.up, lport);
+   mstp_testEvent(e_mstpd_lport_link_change, &change);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testScenario
+ *
+ * Purpose:   Bring up a Bridge with two MSTIs and three ports, then feed it
+ *            a pseudo random sequence of BPDUs with some time going by in
+ *            between, recording the state of the Bridge after each step.
+ *
+ * Params:    run -> run to record the states in
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_perfStats
+ *
+ * Constraints: runs in a process of its own, the Bridge is not cleaned up
+ **PROC-**********************************************************************/
+static void
+mstp_testScenario(MSTP_TEST_RUN_t *run)
+{
+   MSTP_RX_PDU pkt;
+   uint32_t    seed = 0x4d535450;
+   int         i;
+
+   mstp_testBridgeInit();
+   for(i = 1; i <= MSTP_TEST_PORTS; i++)
+      mstp_testPortAdd(i, SPEED_1000MB);
+   mstp_testMstiAdd(1, 10);
+   mstp_testMstiAdd(2, 20);
+   mstp_testBridgeEnable();
+   mstp_testTick(1);
+   mstp_testSnapshot(run);
+
+   while(run->stepCnt < MSTP_TEST_STEPS)
+   {
+      if(mstp_testRand(&seed) % 16 == 0)
+         mstp_testLinkFlap(1 + mstp_testRand(&seed) % MSTP_TEST_PORTS);
+      mstp_testBpduRandom(&pkt, &seed);
+      mstp_testBpduRx(&pkt);
+      if(mstp_testRand(&seed) % 4 == 0)
+         mstp_testTick(1 + mstp_testRand(&seed) % DEF_HELLO_TIME);
+      mstp_testSnapshot(run);
+   }
+
+   run->smMerged = mstp_perfStats.smMerged;
+   run->smMaxDepth = mstp_perfStats.smMaxDepth;
+   run->done = TRUE;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testRunScenario
+ *
+ * Purpose:   Run the scenario in a child process, with the nested state
+ *            machine invocations merged or run in place.
+ *
+ * Params:    run   -> shared memory to record the states in
+ *            merge -> whether nested invocations are merged
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_smMergeNested
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testRunScenario(MSTP_TEST_RUN_t *run, bool merge)
+{
+   pid_t pid;
+   int   status;
+
+   memset(run, 0, sizeof(*run));
+   pid = fork();
+   STP_ASSERT(pid >= 0);
+   if(pid == 0)
+   {
+      mstp_smMergeNested = merge;
+      mstp_testScenario(run);
+      _exit(0);
+   }
+   waitpid(pid, &status, 0);
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Run the same scenario with and without merging the nested
+ *            state machine invocations, and compare the state of the Bridge
+ *            after every step.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every check passed, 1 otherwise
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(void)
+{
+   MSTP_TEST_RUN_t *runs;
+   uint32_t         roles = 0;
+   uint32_t         step;
+   int              i;
+   int              t;
+
+   runs = mmap(NULL, 2 * sizeof(*runs), PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   STP_ASSERT(runs != MAP_FAILED);
+
+   mstp_testRunScenario(&runs[0], FALSE);
+   mstp_testRunScenario(&runs[1], TRUE);
+
+   MSTP_TEST_CHECK(runs[0].done && runs[1].done);
+   MSTP_TEST_CHECK(runs[0].stepCnt == runs[1].stepCnt);
+   MSTP_TEST_CHECK(runs[0].smMerged == 0);
+
+   /*------------------------------------------------------------------------
+    * the sequence does nest the machines. A nested PRT, PST or TCM call for
+    * the tree and port being run is only merged when there is one, the
+    * runs have to end up in the same state either way.
+    *------------------------------------------------------------------------*/
+   MSTP_TEST_CHECK(runs[1].smMaxDepth > 2);
+
+   for(step = 0; step < runs[0].stepCnt; step++)
+   {
+      MSTP_TEST_STATE_t *inPlace = &runs[0].steps[step];
+      MSTP_TEST_STATE_t *merged  = &runs[1].steps[step];
+
+      for(t = 0; t < MSTP_TEST_TREES; t++)
+      {
+         for(i = 0; i < MSTP_TEST_PORTS; i++)
+         {
+            if(memcmp(&inPlace->ports[t][i], &merged->ports[t][i],
+                      sizeof(inPlace->ports[t][i])) != 0)
+               fprintf(stderr, "step %u tree %d port %d differs\n",
+                       step, t, i + 1);
+         }
+      }
+      MSTP_TEST_CHECK(memcmp(inPlace, merged, sizeof(*inPlace)) == 0);
+
+      for(t = 0; t < MSTP_TEST_TREES; t++)
+         for(i = 0; i < MSTP_TEST_PORTS; i++)
+            roles |= 1 << merged->ports[t][i].role;
+   }
+
+   /* and it does go through the roles a port can take */
+   MSTP_TEST_CHECK(roles & (1 << MSTP_PORT_ROLE_ROOT));
+   MSTP_TEST_CHECK(roles & (1 << MSTP_PORT_ROLE_DESIGNATED));
+   MSTP_TEST_CHECK(roles & (1 << MSTP_PORT_ROLE_ALTERNATE));
+   MSTP_TEST_CHECK(roles & (1 << MSTP_PORT_ROLE_MASTER));
+
+   return mstp_testResult("test_mstp_sm_order");
+}
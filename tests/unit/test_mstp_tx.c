@@ -0,0 +1,373 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**********************************************************************************
+ *    File               : test_mstp_tx.c
+ *    Description        : A BPDU sent from the port's template, where only
+ *                         the trees changed since the last BPDU are encoded
+ *                         again, is the same as one encoded from scratch
+ **********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <vswitch-idl.h>
+
+#include "mstp_ovsdb_if.h"
+#include "mstp_inlines.h"
+#include "mstp_fsm.h"
+#include "mstp_test.h"
+#include "mstp_test_bridge.h"
+
+#define MSTP_TEST_PORTS   3
+#define MSTP_TEST_TREES   3   /* the CIST and MSTIs 1 and 2 */
+#define MSTP_TEST_STEPS   400
+
+/* number of ports whose BPDU was compared */
+static uint32_t mstp_testCompared;
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testTxCompare
+ *
+ * Purpose:   Send a BPDU on the port from its template, then one from a
+ *            new template with every tree encoded, and check that both are
+ *            the same frame. The port keeps its template afterwards.
+ *
+ * Params:    lport -> logical port number
+ *
+ * Returns:   none
+ *
+ * Globals:   mstp_Bridge
+ *
+ * Constraints: a port with the Disabled CIST role sends nothing
+ **PROC-**********************************************************************/
+static void
+mstp_testTxCompare(LPORT_t lport)
+{
+   MSTP_COMM_PORT_INFO_t *commPortPtr = MSTP_COMM_PORT_PTR(lport);
+   uint8_t                sent[MAX_MSTP_BPDU_PKT_SIZE];
+   uint8_t                fresh[MAX_MSTP_BPDU_PKT_SIZE];
+   uint8_t               *tmpl;
+   int                    sentLen;
+   int                    freshLen;
+
+   if(!commPortPtr ||
+      (MSTP_CIST_PORT_PTR(lport)->role == MSTP_PORT_ROLE_DISABLED))
+      return;
+
+   mstp_testBpduTx(lport, sent, sizeof(sent));
+   mstp_txMstp(lport);
+   sentLen = mstp_testBpduTx(lport, sent, sizeof(sent));
+
+   tmpl = commPortPtr->txBpdu;
+   commPortPtr->txBpdu = NULL;
+   mstp_txMstp(lport);
+   freshLen = mstp_testBpduTx(lport, fresh, sizeof(fresh));
+   mstp_txBpduTemplateReset(lport);
+   commPortPtr->txBpdu = tmpl;
+
+   MSTP_TEST_CHECK(sentLen > 0);
+   MSTP_TEST_CHECK(sentLen == freshLen);
+   MSTP_TEST_CHECK(memcmp(sent, fresh, sentLen) == 0);
+   mstp_testCompared++;
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testTxCompareAll
+ *
+ * Purpose:   Compare the BPDU sent on every port with a fresh one.
+ *
+ * Params:    none
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testTxCompareAll(void)
+{
+   LPORT_t lport;
+
+   for(lport = 1; lport <= MSTP_TEST_PORTS; lport++)
+      mstp_testTxCompare(lport);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testMacChange
+ *
+ * Purpose:   Give the port another MAC address, as the removal of the
+ *            first member of a LAG does, then the event.
+ *
+ * Params:    lport -> logical port number
+ *            last  -> last octet of the new address
+ *
+ * Returns:   none
+ *
+ * Globals:   idp_lookup
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testMacChange(LPORT_t lport, uint8_t last)
+{
+   mstp_lport_state_change state;
+
+   snprintf(idp_lookup[lport]->mac_in_use, MSTP_MAC_STR_LEN,
+            "00:00:00:00:03:%02x", last);
+   memset(&state, 0, sizeof(state));
+   state.lportname = idp_lookup[lport]->name;
+   state.lportindex = lport;
+   mstp_testEvent(e_mstpd_lport_mac_change, &state);
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBpduWorse
+ *
+ * Purpose:   Build the BPDU of a neighbor worse than the Bridge on every
+ *            tree, that does not agree to its proposals.
+ *
+ * Params:    pkt   -> packet buffer, the BPDU is built in it
+ *            lport -> logical port number to receive it on
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testBpduWorse(MSTP_RX_PDU *pkt, LPORT_t lport)
+{
+   MSTP_MST_BPDU_t        *bpdu = (MSTP_MST_BPDU_t *)pkt->data;
+   MSTP_MSTI_CONFIG_MSG_t *msg  =
+                              (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+   int                     m;
+
+   mstp_testBpduBuild(pkt, lport);
+   bpdu->cistRootId.mac_address[5] = 0x33;
+   storeShortInPacket(&bpdu->cistRootId.priority, 61440);
+   bpdu->cistRgnRootId = bpdu->cistRootId;
+   bpdu->cistBridgeId = bpdu->cistRootId;
+   for(m = 0; m < MSTP_TEST_TREES - 1; m++)
+   {
+      msg[m].mstiRgnRootId = bpdu->cistRootId;
+      storeShortInPacket(&msg[m].mstiRgnRootId.priority, 61440 | (m + 1));
+      msg[m].mstiBridgePriority = (61440 / 4096) << 4;
+   }
+}
+
+/**PROC+**********************************************************************
+ * Name:      mstp_testBpduRandom
+ *
+ * Purpose:   Build a BPDU from one of a few neighbors, better or worse than
+ *            the Bridge, with a random Port Role and random proposal,
+ *            agreement and topology change flags on every tree, sometimes
+ *            from another Region.
+ *
+ * Params:    pkt  -> packet buffer, the BPDU is built in it
+ *            seed -> random generator state
+ *
+ * Returns:   none
+ *
+ * Globals:   none
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+static void
+mstp_testBpduRandom(MSTP_RX_PDU *pkt, uint32_t *seed)
+{
+   static const uint16_t   priorities[] = {0, 4096, 32768, 61440};
+   static const uint8_t    roles[] = {MSTP_BPDU_ROLE_DESIGNATED,
+                                      MSTP_BPDU_ROLE_DESIGNATED,
+                                      MSTP_BPDU_ROLE_ROOT,
+                                      MSTP_BPDU_ROLE_ALTERNATE_OR_BACKUP};
+   static const uint8_t    flags[] = {MSTP_CIST_FLAG_PROPOSAL,
+                                      MSTP_CIST_FLAG_AGREEMENT,
+                                      MSTP_CIST_FLAG_TC,
+                                      MSTP_CIST_FLAG_TC_ACK};
+   MSTP_MST_BPDU_t        *bpdu = (MSTP_MST_BPDU_t *)pkt->data;
+   MSTP_MSTI_CONFIG_MSG_t *msg;
+   uint32_t                peer;
+   uint32_t                r;
+   int                     i;
+   int                     m;
+
+   mstp_testBpduBuild(pkt, 1 + mstp_testRand(seed) % MSTP_TEST_PORTS);
+
+   /* one of four neighbors, each with the same priority on every tree */
+   peer = mstp_testRand(seed) % 4;
+   bpdu->cistBridgeId.mac_address[5] = (uint8_t)peer;
+   storeShortInPacket(&bpdu->cistBridgeId.priority, priorities[peer]);
+   if(mstp_testRand(seed) % 2)
+      bpdu->cistRootId = bpdu->cistBridgeId;
+   bpdu->cistRgnRootId = bpdu->cistBridgeId;
+   storeShortInPacket(&bpdu->cistPortId,
+                      0x8001 + mstp_testRand(seed) % 2);
+   storeLongInPacket(&bpdu->cistExtPathCost,
+                     (mstp_testRand(seed) % 3) * 20000);
+   bpdu->cistRemainingHops = 20 - mstp_testRand(seed) % 4;
+
+   r = mstp_testRand(seed);
+   bpdu->cistFlags = roles[r % 4] | MSTP_CIST_FLAG_LEARNING |
+                     MSTP_CIST_FLAG_FORWADING;
+   for(i = 0; i < 4; i++)
+      if((r >> (2 + 2 * i)) % 4 == 0)
+         bpdu->cistFlags |= flags[i];
+
+   msg = (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+   for(m = 0; m < MSTP_TEST_TREES - 1; m++)
+   {
+      msg[m].mstiRgnRootId = bpdu->cistBridgeId;
+      storeShortInPacket(&msg[m].mstiRgnRootId.priority,
+                         priorities[peer] | (m + 1));
+      msg[m].mstiBridgePriority = (priorities[peer] / 4096) << 4;
+      msg[m].mstiRemainingHops = bpdu->cistRemainingHops;
+
+      r = mstp_testRand(seed);
+      msg[m].mstiFlags = roles[r % 4] | MSTP_MSTI_FLAG_LEARNING |
+                         MSTP_MSTI_FLAG_FORWADING;
+      for(i = 0; i < 3; i++)
+         if((r >> (2 + 2 * i)) % 4 == 0)
+            msg[m].mstiFlags |= flags[i];
+   }
+
+   if(mstp_testRand(seed) % 8 == 0)
+      bpdu->mstConfigurationId.configName[0] ^= 1;
+}
+
+/**PROC+**********************************************************************
+ * Name:      main
+ *
+ * Purpose:   Bring up a Bridge with two MSTIs and three ports, then change
+ *            the roles, flags and timers of its ports and the MAC address
+ *            of one of them, each time checking that the BPDUs sent from
+ *            the templates are those encoded from scratch.
+ *
+ * Params:    none
+ *
+ * Returns:   0 if every check passed, 1 otherwise
+ *
+ * Globals:   mstp_perfStats, mstp_Bridge
+ *
+ * Constraints:
+ **PROC-**********************************************************************/
+int
+main(void)
+{
+   MSTP_RX_PDU             pkt;
+   MSTP_MST_BPDU_t        *bpdu = (MSTP_MST_BPDU_t *)pkt.data;
+   MSTP_MSTI_CONFIG_MSG_t *msg  =
+                              (MSTP_MSTI_CONFIG_MSG_t *)bpdu->mstiConfigMsgs;
+   MSTP_CIST_PORT_INFO_t  *cistPortPtr;
+   MSTP_MST_BPDU_t        *sent;
+   uint64_t                clean;
+   uint32_t                seed = 0x54584d53;
+   int                     i;
+
+   mstp_testBridgeInit();
+   for(i = 1; i <= MSTP_TEST_PORTS; i++)
+      mstp_testPortAdd(i, SPEED_1000MB);
+   mstp_testMstiAdd(1, 10);
+   mstp_testMstiAdd(2, 20);
+   mstp_testBridgeEnable();
+   mstp_testTick(1);
+   mstp_testTxCompareAll();
+
+   /*------------------------------------------------------------------------
+    * a better neighbor proposes on every tree: new roles and agreements,
+    * then the ports learn and forward as time goes by, the one facing a
+    * worse neighbor only when its 'fdWhile' expires
+    *------------------------------------------------------------------------*/
+   mstp_testBpduBuild(&pkt, 1);
+   bpdu->cistFlags |= MSTP_CIST_FLAG_PROPOSAL;
+   msg[0].mstiFlags |= MSTP_MSTI_FLAG_PROPOSAL;
+   msg[1].mstiFlags |= MSTP_MSTI_FLAG_PROPOSAL;
+   mstp_testBpduRx(&pkt);
+   MSTP_TEST_CHECK(MSTP_CIST_PORT_PTR(1)->role == MSTP_PORT_ROLE_ROOT);
+   mstp_testTxCompareAll();
+
+   /* unchanged trees are not encoded again */
+   clean = mstp_perfStats.txTmplMsgsClean;
+   mstp_testTxCompareAll();
+   MSTP_TEST_CHECK(mstp_perfStats.txTmplMsgsClean >=
+                   clean + MSTP_TEST_PORTS * MSTP_TEST_TREES);
+
+   for(i = 0; i <= 2 * DEF_FORWARD_DELAY; i++)
+   {
+      if(i % DEF_HELLO_TIME == 0)
+      {
+         mstp_testBpduBuild(&pkt, 1);
+         mstp_testBpduRx(&pkt);
+         mstp_testBpduWorse(&pkt, MSTP_TEST_PORTS);
+         mstp_testBpduRx(&pkt);
+      }
+      mstp_testTick(1);
+      mstp_testTxCompareAll();
+   }
+   cistPortPtr = MSTP_CIST_PORT_PTR(MSTP_TEST_PORTS);
+   MSTP_TEST_CHECK(cistPortPtr->role == MSTP_PORT_ROLE_DESIGNATED);
+   MSTP_TEST_CHECK(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
+                                             MSTP_CIST_PORT_FORWARDING));
+   cistPortPtr = MSTP_CIST_PORT_PTR(2);
+   MSTP_TEST_CHECK(MSTP_CIST_PORT_IS_BIT_SET(cistPortPtr->bitMap,
+                                             MSTP_CIST_PORT_FORWARDING));
+
+   /*------------------------------------------------------------------------
+    * the neighbor signals a topology change on every tree: the TC flag is
+    * set on the other ports, and cleared when their 'tcWhile' expires
+    *------------------------------------------------------------------------*/
+   mstp_testBpduBuild(&pkt, 1);
+   bpdu->cistFlags |= MSTP_CIST_FLAG_TC;
+   msg[0].mstiFlags |= MSTP_MSTI_FLAG_TC;
+   msg[1].mstiFlags |= MSTP_MSTI_FLAG_TC;
+   mstp_testBpduRx(&pkt);
+   MSTP_TEST_CHECK(MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0);
+   mstp_testTxCompareAll();
+   while(MSTP_PORT_HOT(cistPortPtr, tcWhile) != 0)
+   {
+      mstp_testTick(1);
+      mstp_testTxCompareAll();
+   }
+
+   /*------------------------------------------------------------------------
+    * another MAC address for a port: its next BPDU is sent from it
+    *------------------------------------------------------------------------*/
+   mstp_testMacChange(2, 0x22);
+   MSTP_TEST_CHECK(MSTP_COMM_PORT_PTR(2)->txBpdu == NULL);
+   mstp_testTxCompareAll();
+   sent = (MSTP_MST_BPDU_t *)MSTP_COMM_PORT_PTR(2)->txBpdu;
+   MSTP_TEST_CHECK(sent && (sent->lsapHdr.src[4] == 0x03) &&
+                   (sent->lsapHdr.src[5] == 0x22));
+
+   /*------------------------------------------------------------------------
+    * random neighbors, roles and flags, time going by in between and the
+    * MAC address of a port changing from time to time
+    *------------------------------------------------------------------------*/
+   for(i = 0; i < MSTP_TEST_STEPS; i++)
+   {
+      mstp_testBpduRandom(&pkt, &seed);
+      mstp_testBpduRx(&pkt);
+      if(mstp_testRand(&seed) % 4 == 0)
+         mstp_testTick(1 + mstp_testRand(&seed) % DEF_HELLO_TIME);
+      if(mstp_testRand(&seed) % 32 == 0)
+         mstp_testMacChange(1 + mstp_testRand(&seed) % MSTP_TEST_PORTS,
+                            (uint8_t)i);
+      mstp_testTxCompareAll();
+   }
+   MSTP_TEST_CHECK(mstp_testCompared > MSTP_TEST_STEPS);
+
+   return mstp_testResult("test_mstp_tx");
+}